@@ -37,24 +37,45 @@ class BinaryPatcher:
             f.write(self.data)
         print(f"[+] Saved {len(self.data)} bytes")
         
-    def virtual_to_file_offset(self, virtual_addr, image_base=0x00400000):
+    def virtual_to_file_offset(self, virtual_addr, image_base=None):
         """
-        Convert virtual address to file offset
-        
-        Based on your binary:
-        VA 0x00533c5b -> File Offset 0x133c5b
-        This means: FileOffset = VA - ImageBase + 0x1000
+        Convert virtual address to file offset using the PE section table.
+
+        Raises ValueError if the address isn't backed by file data (it falls
+        between sections or in a section's zero filled tail).
         """
+        e_lfanew = struct.unpack_from('<I', self.data, 0x3c)[0]
+        number_of_sections = struct.unpack_from('<H', self.data, e_lfanew + 6)[0]
+        size_of_optional_header = struct.unpack_from('<H', self.data, e_lfanew + 20)[0]
+        optional_header = e_lfanew + 24
+
+        if image_base is None:
+            image_base = struct.unpack_from('<I', self.data, optional_header + 28)[0]
+
+        size_of_headers = struct.unpack_from('<I', self.data, optional_header + 60)[0]
+
         # Calculate RVA (Relative Virtual Address)
         rva = virtual_addr - image_base
-        
-        # For this binary: FileOffset = RVA + 0x1000
-        # Example: 0x533c5b - 0x400000 = 0x133c5b (RVA)
-        #          0x133c5b (RVA) = 0x133c5b (FileOffset - direct mapping)
-        file_offset = rva
-            
-        return file_offset
-    
+
+        if 0 <= rva < size_of_headers:
+            return rva
+
+        section_headers = optional_header + size_of_optional_header
+
+        for i in range(number_of_sections):
+            virtual_size, virtual_address, size_of_raw_data, pointer_to_raw_data = \
+                struct.unpack_from('<IIII', self.data, section_headers + i * 40 + 8)
+
+            # Raw data is padded to FileAlignment, anything past VirtualSize isn't mapped.
+            mapped_size = size_of_raw_data
+            if virtual_size != 0:
+                mapped_size = min(virtual_size, size_of_raw_data)
+
+            if virtual_address <= rva < virtual_address + mapped_size:
+                return rva - virtual_address + pointer_to_raw_data
+
+        raise ValueError(f"VA 0x{virtual_addr:08x} is not backed by file data")
+
     def apply_patch(self, virtual_addr, patch_bytes, description=""):
         """Apply a patch at the given virtual address"""
         file_offset = self.virtual_to_file_offset(virtual_addr)
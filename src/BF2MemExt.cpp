@@ -2,29 +2,664 @@
 //
 
 #include "apply_patches.hpp"
+#include "batch.hpp"
+#include "bench.hpp"
+#include "budget.hpp"
+#include "capacities.hpp"
+#include "delta.hpp"
+#include "exe_patcher.hpp"
 #include "file_helpers.hpp"
+#include "fingerprint.hpp"
 #include "gui.hpp"
+#include "json_helpers.hpp"
+#include "patch_locator.hpp"
+#include "port.hpp"
+#include "undo_journal.hpp"
+#include "xrefs.hpp"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+static void print_usage()
+{
+   printf("Usage: [/stream] [/laa] [/nojournal] [/metrics <file>] [capacities] <file>\r\n"
+          "       /batch [/jobs <count>] [/io <count>] [/verbose] [/stream] [/laa] [/nojournal] "
+          "[/cache <file>] [/metrics <file>] [capacities] <file|directory|@list>...\r\n"
+          "       /variants [/jobs <count>] [/io <count>] [/verbose] [/laa] [/nojournal] "
+          "[/metrics <file>] [capacities] <file> <variant list>\r\n"
+          "       /unpatch <file>...\r\n"
+          "       /export [/stream] [/laa] [capacities] <file> <delta file>\r\n"
+          "       /delta <delta file> <file> [output file]\r\n"
+          "       /verify [/json] [/jobs <count>] [/io <count>] [/cache <file>] [capacities] "
+          "<file|directory|@list>...\r\n"
+          "       /fingerprint <file>...\r\n"
+          "       /capacities [capacities]\r\n"
+          "       /budget [/laa] [capacities] <file>...\r\n"
+          "       /xrefs [/range <begin> <end|+size>] [/imm <value>]... [/region <name>] "
+          "[/capacity <name>] <file>\r\n"
+          "       /port [/jobs <count>] <source file> <target file>\r\n"
+          "       /bench [/size <MB>] [/sections <count>] [/density <patches per MB>] [/ext] "
+          "[/iterations <count>] [/jobs <count>] [/files <count>] [/json] [directory]\r\n"
+          "Capacities: /set <name>=<value> and /profile <file>, in any number and order.\r\n"
+          "Options end at the first argument that isn't one. Use -- before a file named like "
+          "an option.\r\n"
+          "Metrics: phase timings and counters are appended to the file as JSON lines.\r\n");
+}
+
+static void print_phase_to_metrics(void* context, const apply_phase_event& event)
+{
+   print_apply_phase_json(static_cast<const char*>(context), event, print_json_lines);
+}
+
+/// @brief Handle a /set or /profile argument, consuming its value.
+/// @param failed Set if the argument was one of them but its value wasn't valid.
+/// @return False if the argument isn't /set or /profile.
+static bool parse_capacity_option(int arg_count, const char** args, int& arg,
+                                  capacity_values& capacities, bool& failed)
+{
+   failed = false;
+
+   if (arg + 1 >= arg_count) return false;
+
+   if (strcmp(args[arg], "/set") == 0) {
+      failed = not set_capacity(capacities, args[++arg], printf);
+
+      return true;
+   }
+
+   if (strcmp(args[arg], "/profile") == 0) {
+      failed = not load_capacity_profile(capacities, args[++arg], printf);
+
+      return true;
+   }
+
+   return false;
+}
+
+/// @brief Print every capacity with the value the other arguments give it.
+static int run_capacities_command(int arg_count, const char** args)
+{
+   capacity_values capacities;
+
+   for (int arg = 0; arg < arg_count; ++arg) {
+      bool failed = false;
+
+      if (not parse_capacity_option(arg_count, args, arg, capacities, failed)) {
+         print_usage();
+
+         return 1;
+      }
+
+      if (failed) return 1;
+   }
+
+   print_capacities(capacities, printf);
+
+   return 0;
+}
+
+/// @brief Restore each file from its undo journal.
+static int run_unpatch_command(int arg_count, const char** args)
+{
+   if (arg_count == 0) {
+      print_usage();
+
+      return 1;
+   }
+
+   int result = 0;
+
+   for (int arg = 0; arg < arg_count; ++arg) {
+      if (not unpatch(args[arg], printf)) result = 1;
+   }
+
+   return result;
+}
+
+/// @brief Patch a copy of a file and save what changed as a delta.
+static int run_export_command(int arg_count, const char** args)
+{
+   apply_options options;
+   capacity_values capacities;
+   int arg = 0;
+
+   // The last two arguments are always the files.
+   for (; arg + 2 < arg_count; ++arg) {
+      bool failed = false;
+
+      if (strcmp(args[arg], "/stream") == 0) {
+         options.streamed = true;
+      }
+      else if (strcmp(args[arg], "/laa") == 0) {
+         options.large_address_aware = true;
+      }
+      else if (parse_capacity_option(arg_count - 2, args, arg, capacities, failed)) {
+         if (failed) return 1;
+
+         options.capacities = &capacities;
+      }
+      else {
+         print_usage();
+
+         return 1;
+      }
+   }
+
+   if (arg + 2 != arg_count) {
+      print_usage();
+
+      return 1;
+   }
+
+   return export_delta(args[arg], args[arg + 1], printf, options) ? 0 : 1;
+}
+
+/// @brief Apply a delta to a file, in place or into a new file.
+static int run_delta_command(int arg_count, const char** args)
+{
+   if (arg_count != 2 and arg_count != 3) {
+      print_usage();
+
+      return 1;
+   }
+
+   return apply_delta(args[0], args[1], arg_count == 3 ? args[2] : nullptr, printf) ? 0 : 1;
+}
+
+/// @brief Print the fingerprint of each file and the build it's identified as, for filling in
+/// the fingerprints of patch lists.
+static int run_fingerprint_command(int arg_count, const char** args)
+{
+   if (arg_count == 0) {
+      print_usage();
+
+      return 1;
+   }
+
+   int result = 0;
+
+   for (int arg = 0; arg < arg_count; ++arg) {
+      exe_patcher editor;
+      uint32_t fingerprint = 0;
+
+      if (not editor.load(args[arg], load_mode::read_only) or
+          not fingerprint_exe(editor, fingerprint)) {
+         printf("%s: not a PE image\r\n", args[arg]);
+
+         result = 1;
+
+         continue;
+      }
+
+      patch_locator locator;
+      bool located = false;
+      const exe_patch_list* list = identify_exe(editor, locator, located);
+
+      printf("0x%08x %s: %s%s\r\n", fingerprint, args[arg], list ? list->name : "unrecognized",
+             located ? " (signatures)" : "");
+   }
+
+   return result;
+}
+
+/// @brief Print the address space each file would reserve at startup once patched with the
+/// given capacities.
+/// @return 1 if any file couldn't be checked or would go over its ceiling.
+static int run_budget_command(int arg_count, const char** args)
+{
+   capacity_values capacities;
+   bool large_address_aware = false;
+   bool failed = false;
+   int arg = 0;
+
+   // Options end at the first argument that isn't one, so absolute paths are taken as files, or
+   // at a -- for files named like an option.
+   for (; arg < arg_count; ++arg) {
+      if (strcmp(args[arg], "--") == 0) {
+         arg += 1;
+
+         break;
+      }
+
+      if (strcmp(args[arg], "/laa") == 0) {
+         large_address_aware = true;
+      }
+      else if (parse_capacity_option(arg_count, args, arg, capacities, failed)) {
+         if (failed) return 1;
+      }
+      else {
+         break;
+      }
+   }
+
+   if (arg == arg_count) {
+      print_usage();
+
+      return 1;
+   }
+
+   int result = 0;
+
+   for (; arg < arg_count; ++arg) {
+      exe_patcher editor;
+      patch_locator locator;
+      bool located = false;
+      const exe_patch_list* list = nullptr;
+
+      if (editor.load(args[arg], load_mode::read_only)) {
+         list = identify_exe(editor, locator, located);
+      }
+
+      if (not list) {
+         printf("%s: unrecognized\r\n", args[arg]);
+
+         result = 1;
+
+         continue;
+      }
+
+      bool enabled[PATCH_COUNT] = {};
+
+      for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+         enabled[i] = not located or locator.can_locate(list->patches[i]);
+      }
+
+      address_budget budget;
+
+      if (not compute_budget(editor, *list, enabled, capacities, large_address_aware, budget)) {
+         printf("%s: extension section regions don't fit in the address space\r\n", args[arg]);
+
+         result = 1;
+
+         continue;
+      }
+
+      printf("%s: %s\r\n", args[arg], list->name);
+      print_budget(budget, printf);
+
+      if (not budget.fits()) result = 1;
+   }
+
+   return result;
+}
+
+/// @brief Print the references to a global and the uses of a size in a file as patch table
+/// entries, for moving the global into the extension section.
+static int run_xrefs_command(int arg_count, const char** args)
+{
+   xref_query query;
+   int arg = 0;
+
+   // The last argument is always the file.
+   for (; arg + 1 < arg_count; ++arg) {
+      if (strcmp(args[arg], "/range") == 0 and arg + 3 < arg_count) {
+         query.range_begin = (uint32_t)strtoul(args[++arg], nullptr, 0);
+
+         const char* end = args[++arg];
+
+         query.range_end = end[0] == '+'
+                              ? query.range_begin + (uint32_t)strtoul(end + 1, nullptr, 0)
+                              : (uint32_t)strtoul(end, nullptr, 0);
+      }
+      else if (strcmp(args[arg], "/imm") == 0 and arg + 2 < arg_count) {
+         query.constants.push_back((uint32_t)strtoul(args[++arg], nullptr, 0));
+      }
+      else if (strcmp(args[arg], "/region") == 0 and arg + 2 < arg_count) {
+         query.region = find_region_id(args[++arg]);
+
+         if (query.region == es_region_id::none) {
+            printf("%s: no such region\r\n", args[arg]);
+
+            return 1;
+         }
+      }
+      else if (strcmp(args[arg], "/capacity") == 0 and arg + 2 < arg_count) {
+         query.capacity = find_capacity(args[++arg]);
+
+         if (query.capacity == capacity_id::none) {
+            printf("%s: no such capacity\r\n", args[arg]);
+
+            return 1;
+         }
+      }
+      else {
+         print_usage();
+
+         return 1;
+      }
+   }
+
+   if (arg + 1 != arg_count or
+       (query.range_end <= query.range_begin and query.constants.size() == 0)) {
+      print_usage();
+
+      return 1;
+   }
+
+   exe_patcher editor;
+   slim_vector<xref> xrefs;
+
+   if (not editor.load(args[arg], load_mode::read_only) or not find_xrefs(editor, query, xrefs)) {
+      printf("%s: not a PE image\r\n", args[arg]);
+
+      return 1;
+   }
+
+   print_xrefs(query, xrefs, printf);
+
+   return 0;
+}
+
+/// @brief Port the patch list of a known build to another build and print it as patch table
+/// source.
+static int run_port_command(int arg_count, const char** args)
+{
+   uint32_t thread_count = 0;
+   int arg = 0;
+
+   for (; arg + 2 < arg_count; ++arg) {
+      if (strcmp(args[arg], "/jobs") == 0 and arg + 3 < arg_count) {
+         thread_count = (uint32_t)strtoul(args[++arg], nullptr, 10);
+      }
+      else {
+         print_usage();
+
+         return 1;
+      }
+   }
+
+   if (arg + 2 != arg_count) {
+      print_usage();
+
+      return 1;
+   }
+
+   exe_patcher source;
+   exe_patcher target;
+   patch_locator locator;
+   bool located = false;
+   const exe_patch_list* list = nullptr;
+
+   if (source.load(args[arg], load_mode::read_only)) {
+      list = identify_exe(source, locator, located);
+   }
+
+   // The source's sites have to be exactly where its list says they are.
+   if (not list or located) {
+      printf("%s: not a build with a patch list\r\n", args[arg]);
+
+      return 1;
+   }
+
+   if (not target.load(args[arg + 1], load_mode::read_only)) {
+      printf("%s: not a PE image\r\n", args[arg + 1]);
+
+      return 1;
+   }
+
+   port_result result;
+
+   if (not port_patch_list(source, *list, target, thread_count, result)) {
+      printf("%s: couldn't read the code of both builds\r\n", args[arg + 1]);
+
+      return 1;
+   }
+
+   print_ported_list(result, args[arg + 1], printf);
+
+   return 0;
+}
+
+/// @brief Time each step of patching on a synthetic executable written to a directory.
+static int run_bench_command(int arg_count, const char** args)
+{
+   bench_options options;
+   int arg = 0;
+
+   // Options end as they do for /budget.
+   for (; arg < arg_count; ++arg) {
+      if (strcmp(args[arg], "--") == 0) {
+         arg += 1;
+
+         break;
+      }
+
+      if (strcmp(args[arg], "/ext") == 0) {
+         options.image.ext_section = true;
+      }
+      else if (strcmp(args[arg], "/json") == 0) {
+         options.json = true;
+      }
+      else if (strcmp(args[arg], "/size") == 0 and arg + 1 < arg_count) {
+         options.image.size = (size_t)strtoul(args[++arg], nullptr, 10) * 1024 * 1024;
+      }
+      else if (strcmp(args[arg], "/sections") == 0 and arg + 1 < arg_count) {
+         options.image.section_count = (uint32_t)strtoul(args[++arg], nullptr, 10);
+      }
+      else if (strcmp(args[arg], "/density") == 0 and arg + 1 < arg_count) {
+         options.image.patch_density = (uint32_t)strtoul(args[++arg], nullptr, 10);
+      }
+      else if (strcmp(args[arg], "/iterations") == 0 and arg + 1 < arg_count) {
+         options.iterations = (uint32_t)strtoul(args[++arg], nullptr, 10);
+      }
+      else if (strcmp(args[arg], "/jobs") == 0 and arg + 1 < arg_count) {
+         options.jobs = (uint32_t)strtoul(args[++arg], nullptr, 10);
+      }
+      else if (strcmp(args[arg], "/files") == 0 and arg + 1 < arg_count) {
+         options.batch_files = (uint32_t)strtoul(args[++arg], nullptr, 10);
+      }
+      else {
+         break;
+      }
+   }
+
+   if (arg + 1 < arg_count) {
+      print_usage();
+
+      return 1;
+   }
+
+   if (arg < arg_count) options.directory = args[arg];
+
+   return run_bench(options, printf) ? 0 : 1;
+}
+
+enum class batch_command { patch, verify, variants };
+
+static int run_batch_command(int arg_count, const char** args, batch_command command)
+{
+   batch_options options;
+   capacity_values capacities;
+   bool failed = false;
+   int arg = 0;
+
+   const bool verify = command == batch_command::verify;
+   const bool variants = command == batch_command::variants;
+
+   options.verify = verify;
+   options.journal = not verify;
+
+   // Options end as they do for /budget.
+   for (; arg < arg_count; ++arg) {
+      if (strcmp(args[arg], "--") == 0) {
+         arg += 1;
+
+         break;
+      }
+
+      if (strcmp(args[arg], "/verbose") == 0 and not verify) {
+         options.verbose = true;
+      }
+      else if (strcmp(args[arg], "/stream") == 0 and not verify and not variants) {
+         options.streamed = true;
+      }
+      else if (strcmp(args[arg], "/laa") == 0 and not verify) {
+         options.large_address_aware = true;
+      }
+      else if (strcmp(args[arg], "/nojournal") == 0 and not verify) {
+         options.journal = false;
+      }
+      else if (strcmp(args[arg], "/json") == 0 and verify) {
+         options.json = true;
+      }
+      else if (strcmp(args[arg], "/jobs") == 0 and arg + 1 < arg_count) {
+         options.jobs = (uint32_t)strtoul(args[++arg], nullptr, 10);
+      }
+      else if (strcmp(args[arg], "/io") == 0 and arg + 1 < arg_count) {
+         options.io_limit = (uint32_t)strtoul(args[++arg], nullptr, 10);
+      }
+      else if (strcmp(args[arg], "/cache") == 0 and arg + 1 < arg_count and not variants) {
+         options.cache_path = args[++arg];
+      }
+      else if (strcmp(args[arg], "/metrics") == 0 and arg + 1 < arg_count and not verify) {
+         options.metrics_path = args[++arg];
+      }
+      else if (parse_capacity_option(arg_count, args, arg, capacities, failed)) {
+         if (failed) return BATCH_NOTHING_TO_DO;
+
+         options.capacities = &capacities;
+      }
+      else {
+         break;
+      }
+   }
+
+   if (arg == arg_count or (variants and arg + 2 != arg_count)) {
+      print_usage();
+
+      return BATCH_NOTHING_TO_DO;
+   }
+
+   if (variants) return run_variants(args[arg], args[arg + 1], options, printf);
+
+   return run_batch(args + arg, (size_t)(arg_count - arg), options, printf);
+}
+
 int main(int arg_count, const char** args)
 {
+#ifdef _WIN32
    if (arg_count == 1) {
       return show_gui();
    }
+#endif
 
    init_cstdio();
 
-   if (arg_count != 2 or strcmp(args[1], "/?") == 0) {
-      printf("Usage: <file>\r\n");
+   if (arg_count >= 2 and strcmp(args[1], "/batch") == 0) {
+      return run_batch_command(arg_count - 2, args + 2, batch_command::patch);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/verify") == 0) {
+      return run_batch_command(arg_count - 2, args + 2, batch_command::verify);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/variants") == 0) {
+      return run_batch_command(arg_count - 2, args + 2, batch_command::variants);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/unpatch") == 0) {
+      return run_unpatch_command(arg_count - 2, args + 2);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/export") == 0) {
+      return run_export_command(arg_count - 2, args + 2);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/delta") == 0) {
+      return run_delta_command(arg_count - 2, args + 2);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/fingerprint") == 0) {
+      return run_fingerprint_command(arg_count - 2, args + 2);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/capacities") == 0) {
+      return run_capacities_command(arg_count - 2, args + 2);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/budget") == 0) {
+      return run_budget_command(arg_count - 2, args + 2);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/xrefs") == 0) {
+      return run_xrefs_command(arg_count - 2, args + 2);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/port") == 0) {
+      return run_port_command(arg_count - 2, args + 2);
+   }
+
+   if (arg_count >= 2 and strcmp(args[1], "/bench") == 0) {
+      return run_bench_command(arg_count - 2, args + 2);
+   }
+
+   apply_options options;
+   capacity_values capacities;
+   const char* metrics_path = nullptr;
+   int arg = 1;
+
+   options.journal = true;
+
+   // The last argument is always the file, so paths starting with / aren't taken as options.
+   for (; arg + 1 < arg_count; ++arg) {
+      bool failed = false;
+
+      if (strcmp(args[arg], "/stream") == 0) {
+         options.streamed = true;
+      }
+      else if (strcmp(args[arg], "/laa") == 0) {
+         options.large_address_aware = true;
+      }
+      else if (strcmp(args[arg], "/nojournal") == 0) {
+         options.journal = false;
+      }
+      else if (strcmp(args[arg], "/metrics") == 0 and arg + 2 < arg_count) {
+         metrics_path = args[++arg];
+      }
+      else if (parse_capacity_option(arg_count - 1, args, arg, capacities, failed)) {
+         if (failed) return 1;
+
+         options.capacities = &capacities;
+      }
+      else {
+         print_usage();
+
+         return 1;
+      }
+   }
+
+   if (arg + 1 != arg_count or strcmp(args[arg], "/?") == 0) {
+      print_usage();
 
       return 1;
    }
 
-   const char* file_path = args[1];
+   const char* file_path = args[arg];
+
+   if (not metrics_path) return apply(file_path, printf, options) ? 0 : 1;
+
+   if (not open_json_lines(metrics_path)) {
+      printf("Failed to open %s for metrics.\r\n", metrics_path);
+
+      return 1;
+   }
+
+   apply_report report;
+   apply_metrics metrics;
+
+   options.report = &report;
+   options.metrics = &metrics;
+   options.on_phase = print_phase_to_metrics;
+   options.phase_context = const_cast<char*>(file_path);
+
+   const bool patched = apply(file_path, printf, options);
+
+   print_apply_metrics_json(file_path, report, metrics, print_json_lines);
+
+   if (not close_json_lines()) printf("Failed to write metrics to %s.\r\n", metrics_path);
 
-   return apply(file_path, printf) ? 0 : 1;
+   return patched ? 0 : 1;
 }
 
 // Run program: Ctrl + F5 or Debug > Start Without Debugging menu
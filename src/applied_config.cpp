@@ -0,0 +1,189 @@
+#include "applied_config.hpp"
+#include "crc32c.hpp"
+#include "exe_patcher.hpp"
+
+#include <stddef.h>
+#include <string.h>
+
+static const char config_magic[8] = {'B', 'F', '2', 'C', 'O', 'N', 'F', 'G'};
+constexpr uint32_t config_version = 1;
+
+struct config_record {
+   char magic[8];
+   uint32_t version;
+   /// @brief patch_table_hash of the table the configuration was applied with.
+   uint32_t table_hash;
+   uint8_t list_index;
+   uint8_t located;
+   uint8_t large_address_aware;
+   uint8_t reserved;
+   /// @brief A bit for every enabled set.
+   uint32_t enabled_sets;
+   uint32_t layout_size;
+   uint32_t layout_hash;
+   uint32_t capacities[capacity_id_count];
+   /// @brief CRC-32C of everything before it.
+   uint32_t crc;
+};
+
+static_assert(PATCH_COUNT <= 32, "config_record::enabled_sets can't hold every set.");
+static_assert(EXE_COUNT < UINT8_MAX, "config_record::list_index can't hold every list index.");
+static_assert(sizeof(config_record) == 36 + capacity_id_count * sizeof(uint32_t));
+
+static auto record_crc(const config_record& record) noexcept -> uint32_t
+{
+   return crc32c(0, &record, offsetof(config_record, crc));
+}
+
+auto layout_hash(const es_layout& layout) noexcept -> uint32_t
+{
+   uint32_t crc = 0;
+
+   for (const es_placement& placement : layout.placements) {
+      const uint32_t fields[] = {(uint32_t)placement.region->id, placement.offset, placement.size,
+                                 placement.alignment};
+
+      crc = crc32c(crc, fields, sizeof(fields));
+   }
+
+   return crc32c(crc, &layout.size, sizeof(layout.size));
+}
+
+bool read_applied_config(const exe_patcher& editor, applied_config& out) noexcept
+{
+   out = {};
+
+   config_record record;
+
+   if (not editor.read_header_tail(&record, sizeof(record))) return false;
+
+   if (memcmp(record.magic, config_magic, sizeof(config_magic)) != 0) return false;
+   if (record.version != config_version) return false;
+   if (record.crc != record_crc(record)) return false;
+   if (record.table_hash != patch_table_hash()) return false;
+   if (record.list_index >= EXE_COUNT) return false;
+
+   out.list_index = record.list_index;
+   out.located = record.located != 0;
+   out.large_address_aware = record.large_address_aware != 0;
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      out.enabled[i] = (record.enabled_sets >> i) & 1;
+   }
+
+   memcpy(out.capacities.values, record.capacities, sizeof(record.capacities));
+
+   out.layout_size = record.layout_size;
+   out.layout_hash = record.layout_hash;
+
+   return true;
+}
+
+bool write_applied_config(exe_patcher& editor, const applied_config& config) noexcept
+{
+   config_record record;
+
+   // Only ever replace zeros or an earlier record, whatever else is there belongs to someone.
+   if (not editor.read_header_tail(&record, sizeof(record))) return false;
+
+   if (memcmp(record.magic, config_magic, sizeof(config_magic)) != 0) {
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+
+      for (uint32_t i = 0; i < sizeof(record); ++i) {
+         if (bytes[i] != 0) return false;
+      }
+   }
+
+   record = {};
+
+   memcpy(record.magic, config_magic, sizeof(config_magic));
+   record.version = config_version;
+   record.table_hash = patch_table_hash();
+   record.list_index = (uint8_t)config.list_index;
+   record.located = config.located;
+   record.large_address_aware = config.large_address_aware;
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      if (config.enabled[i]) record.enabled_sets |= 1u << i;
+   }
+
+   record.layout_size = config.layout_size;
+   record.layout_hash = config.layout_hash;
+
+   memcpy(record.capacities, config.capacities.values, sizeof(record.capacities));
+
+   record.crc = record_crc(record);
+
+   return editor.write_header_tail(&record, sizeof(record));
+}
+
+/// @brief Check if every site of a set holds its replacement for the default capacities, or
+/// every site holds its expected bytes.
+/// @return foreign if the sites are mixed or any holds something else.
+static auto set_state(const exe_patcher& editor, const patch_set& set) noexcept -> patch_state
+{
+   const capacity_values default_capacities;
+   uint32_t patched = 0;
+   uint32_t original = 0;
+
+   const auto count = [&](patch_state state) {
+      if (state == patch_state::patched) patched += 1;
+      if (state == patch_state::original) original += 1;
+   };
+
+   for (const patch& patch : set.patches) {
+      ::patch expected = patch;
+
+      if (not patch_value(patch, default_capacities, expected.replacement_value)) {
+         return patch_state::foreign;
+      }
+
+      count(editor.classify(expected));
+   }
+
+   for (const code_patch& patch : set.code_patches) count(editor.classify(patch));
+   for (const trampoline& patch : set.trampolines) count(editor.classify(patch));
+
+   const uint32_t sites =
+      (uint32_t)(set.patches.size() + set.code_patches.size() + set.trampolines.size());
+
+   if (sites != 0 and patched == sites) return patch_state::patched;
+   if (original == sites) return patch_state::original;
+
+   return patch_state::foreign;
+}
+
+bool read_legacy_config(exe_patcher& editor, const exe_patch_list& list, applied_config& out,
+                        es_layout& layout) noexcept
+{
+   out = {};
+
+   plan_legacy_es_layout(list, layout);
+
+   if (not editor.find_ext_section(layout)) return false;
+
+   bool uses_layout = false;
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      const patch_set& set = list.patches[i];
+      const patch_state state = set_state(editor, set);
+
+      out.enabled[i] = state == patch_state::patched;
+
+      // A set that points into a region elsewhere was laid out by this version. The hi rez area
+      // is at the same offset in both, so it takes the other regions to tell them apart.
+      if (set.regions.size() == 0) continue;
+      if (state == patch_state::foreign) return false;
+
+      uses_layout |= out.enabled[i];
+   }
+
+   if (not uses_layout) return false;
+
+   out.list_index = (uint32_t)(&list - patch_lists);
+   out.large_address_aware = editor.large_address_aware();
+   out.layout_size = layout.size;
+   out.layout_hash = layout_hash(layout);
+
+   return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "capacities.hpp"
+#include "es_layout.hpp"
+#include "patch_table.hpp"
+
+#include <stdint.h>
+
+struct exe_patcher;
+
+/// @brief What a run applied to an executable. It's stamped into the end of the header space so
+/// the next run can tell what changed by reading only the headers, instead of checking every
+/// patch site.
+struct applied_config {
+   /// @brief The index of the patch list in patch_lists.
+   uint32_t list_index = 0;
+   /// @brief If the patch sites were found using signatures.
+   bool located = false;
+   bool large_address_aware = false;
+   bool enabled[PATCH_COUNT] = {};
+   capacity_values capacities;
+   /// @brief es_layout::size of the layout the sets were applied with.
+   uint32_t layout_size = 0;
+   /// @brief See layout_hash.
+   uint32_t layout_hash = 0;
+};
+
+/// @brief Hash where every region of a layout was placed.
+[[nodiscard]] auto layout_hash(const es_layout& layout) noexcept -> uint32_t;
+
+/// @brief Read the configuration stamped into an executable's headers. Nothing past the headers
+/// is read.
+/// @return False if there's no record, it's damaged or it was written against a different patch
+/// table.
+[[nodiscard]] bool read_applied_config(const exe_patcher& editor, applied_config& out) noexcept;
+
+/// @brief Stamp a configuration into an executable's headers, replacing any earlier record.
+/// @return False if there's no room, or the space holds something that isn't a record.
+[[nodiscard]] bool write_applied_config(exe_patcher& editor, const applied_config& config) noexcept;
+
+/// @brief Recognize an executable patched by a version from before runs were recorded, which laid
+/// the extension section out as plan_legacy_es_layout does and patched with the default
+/// capacities.
+/// @param out Filled in as a record of that run. The sets whose every site holds its replacement
+/// are enabled.
+/// @param layout The layout that run used. The editor's extension section is found with it.
+/// @return False if there's no extension section, a set with regions is neither fully patched
+/// nor untouched in that layout, or no set with regions is patched.
+[[nodiscard]] bool read_legacy_config(exe_patcher& editor, const exe_patch_list& list,
+                                      applied_config& out, es_layout& layout) noexcept;
@@ -1,73 +1,773 @@
+#ifdef _MSC_VER
+#pragma warning(disable : 4530)
+#endif
+
+#include "apply_patches.hpp"
+#include "applied_config.hpp"
+#include "budget.hpp"
+#include "capacities.hpp"
+#include "es_layout.hpp"
 #include "exe_patcher.hpp"
+#include "json_helpers.hpp"
+#include "patch_locator.hpp"
 #include "patch_table.hpp"
+#include "slim_vector.hpp"
+#include "thread_pool.hpp"
+#include "undo_journal.hpp"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-bool apply(const char* file_path, int (*print)(const char* format, ...)) noexcept
+#include <chrono>
+
+/// @brief Times the phases of a call to apply and fills in its metrics when it returns, however
+/// it returns.
+struct apply_recorder {
+   plan_outcome outcome;
+
+   apply_recorder(const apply_options& options, const exe_patcher& editor) noexcept
+      : _options{options}, _editor{editor}
+   {
+   }
+
+   ~apply_recorder()
+   {
+      if (not _options.metrics) return;
+
+      apply_metrics& metrics = *_options.metrics;
+      const io_counters counters = _editor.counters();
+
+      metrics.total_milliseconds = milliseconds_since(_start);
+      metrics.bytes_read = counters.bytes_read;
+      metrics.bytes_written = counters.bytes_written;
+      metrics.bytes_compared = counters.bytes_compared;
+      metrics.sites_already_patched = outcome.sites_already_patched;
+      metrics.sites_patched = outcome.sites_patched;
+      metrics.allocations = slim_vector_allocations - _allocations;
+   }
+
+   /// @brief Start the next phase now, leaving out the time since the last one finished.
+   void restart() noexcept
+   {
+      _phase_start = std::chrono::steady_clock::now();
+   }
+
+   /// @brief Finish the current phase and start the next.
+   void finish(apply_phase phase, const char* set_name = nullptr) noexcept
+   {
+      apply_phase_event event;
+
+      event.phase = phase;
+      event.set_name = set_name;
+      event.milliseconds = milliseconds_since(_phase_start);
+
+      if (_options.metrics) {
+         _options.metrics->phase_milliseconds[(uint32_t)phase] += event.milliseconds;
+      }
+
+      if (_options.on_phase) _options.on_phase(_options.phase_context, event);
+
+      restart();
+   }
+
+private:
+   using clock = std::chrono::steady_clock;
+
+   const apply_options& _options;
+   const exe_patcher& _editor;
+   const clock::time_point _start = clock::now();
+   clock::time_point _phase_start = _start;
+   const uint64_t _allocations = slim_vector_allocations;
+
+   static auto milliseconds_since(clock::time_point start) noexcept -> double
+   {
+      return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+   }
+};
+
+/// @brief Resolve every patch and code patch of a set into the plan, tagged with the set's index.
+/// @param trampolines Also allocate and plan the set's trampolines.
+static bool plan_set(exe_patcher& editor, const patch_set& set, uint32_t set_index,
+                     const patch_locator* locator, const capacity_values& capacities,
+                     bool trampolines, write_plan& plan) noexcept
 {
-   if (not print) print = printf;
+   for (const patch& patch : set.patches) {
+      ::patch located = patch;
 
-   exe_patcher editor;
+      if (locator and not locator->locate(patch.address, located.address)) return false;
+      if (not patch_value(patch, capacities, located.replacement_value)) return false;
+      if (not editor.plan(located, set_index, plan)) return false;
+   }
 
-   if (not editor.load(file_path)) {
-      print("Failed to open %s for patching.\r\n", file_path);
+   for (const code_patch& cp : set.code_patches) {
+      code_patch located = cp;
 
-      return false;
+      if (locator and not locator->locate(cp.address, located.address)) return false;
+      if (not editor.plan(located, set_index, plan)) return false;
+   }
+
+   for (const trampoline& trampoline : set.trampolines) {
+      if (not trampolines) break;
+
+      ::trampoline located = trampoline;
+
+      if (locator and not locator->locate(trampoline.address, located.address)) return false;
+      if (not editor.plan(located, set_index, plan)) return false;
+   }
+
+   return true;
+}
+
+/// @brief Check if a run would write exactly what an earlier one did. Signature located sets
+/// aren't located again, the earlier run found them in the same file.
+static bool same_config(const applied_config& previous, const capacity_values& capacities,
+                        bool large_address_aware) noexcept
+{
+   if (large_address_aware and not previous.large_address_aware) return false;
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      if (not previous.located and not previous.enabled[i]) return false;
    }
 
-   bool found_compatible_list = false;
+   return memcmp(previous.capacities.values, capacities.values, sizeof(capacities.values)) == 0;
+}
+
+/// @brief Check if trampolines would need to move or change. They're allocated in order in the
+/// code cave section, so they can only be left where they are.
+static bool trampolines_change(const exe_patch_list& list, const applied_config& previous,
+                               const bool (&enabled)[PATCH_COUNT], uint32_t layout_hash) noexcept
+{
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      if (list.patches[i].trampolines.size() == 0) continue;
+      if (previous.enabled[i] != enabled[i]) return true;
+      if (enabled[i] and previous.layout_hash != layout_hash) return true;
+   }
+
+   return false;
+}
+
+/// @brief Plan only the sites whose bytes differ between what an earlier run wrote and what
+/// this one writes. Sites both wrote are expected to hold what the earlier run wrote, sites
+/// only this one writes are expected to be original and sites only the earlier run wrote are
+/// put back.
+/// @param unchanged_count The number of sites left out because both runs write the same bytes.
+/// @return False if the plans overlap differently, they can't come from the same list then.
+static bool diff_plans(write_plan& previous, write_plan& next, size_t image_size, write_plan& out,
+                       uint32_t& unchanged_count) noexcept
+{
+   unchanged_count = 0;
+
+   if (not previous.build(image_size) or not next.build(image_size)) return false;
+
+   const slim_vector<write_site>& previous_sites = previous.sites();
+   const slim_vector<write_site>& next_sites = next.sites();
+   size_t i = 0;
+   size_t j = 0;
+
+   while (i < previous_sites.size() or j < next_sites.size()) {
+      if (j == next_sites.size() or
+          (i < previous_sites.size() and previous_sites[i].offset < next_sites[j].offset)) {
+         const write_site& site = previous_sites[i++];
+
+         out.add(site.offset, previous.site_replacement(site), previous.site_expected(site),
+                 site.size, site.tag);
+
+         continue;
+      }
+
+      if (i == previous_sites.size() or next_sites[j].offset < previous_sites[i].offset) {
+         const write_site& site = next_sites[j++];
+
+         out.add(site.offset, next.site_expected(site), next.site_replacement(site), site.size,
+                 site.tag);
 
-   for (const exe_patch_list& exe_list : patch_lists) {
-      if (not editor.compatible(exe_list.id_address, exe_list.expected_id)) {
+         continue;
+      }
+
+      const write_site& previous_site = previous_sites[i++];
+      const write_site& site = next_sites[j++];
+
+      if (previous_site.size != site.size) return false;
+
+      if (memcmp(previous.site_replacement(previous_site), next.site_replacement(site),
+                 site.size) == 0) {
+         unchanged_count += 1;
 
          continue;
       }
 
-      print("Identified executable as: %s. Applying patches.\r\n", exe_list.name);
+      out.add(site.offset, previous.site_replacement(previous_site), next.site_replacement(site),
+              site.size, site.tag);
+   }
+
+   return true;
+}
 
-      if (not editor.prepare(ext_section_size)) {
-         print("Failed add new executable section for patch data. %s is unmodified.\r\n", file_path);
+/// @brief Pick up the journal of an earlier patch if the file is still what it was written for,
+/// or start a new one, and have the patcher record into it.
+/// @param previous Receives the journal picked up, or an empty one, to put back if the
+/// executable fails to save.
+static void start_journal(exe_patcher& editor, const char* file_path, undo_journal& journal,
+                          undo_journal& previous, int (*print)(const char* format, ...)) noexcept
+{
+   char* path = journal_path(file_path);
+
+   if (path and journal.load(path)) {
+      switch (journal.check(editor)) {
+      case journal_state::patched:
+         previous = journal;
+         break;
+      case journal_state::original:
+         journal.reset(editor.size());
+         break;
+      case journal_state::changed:
+         print("Warning: %s changed since its undo journal was written, starting a new one.\r\n",
+               file_path);
+
+         journal.reset(editor.size());
+         break;
+      }
+   }
+   else {
+      journal.reset(editor.size());
+   }
+
+   free(path);
+
+   editor.set_journal(&journal);
+}
+
+/// @brief Write the journal next to the executable. It's written before the executable is saved,
+/// so a patched executable is never left without one. A journal with nothing in it isn't written.
+/// @return False if the journal couldn't be written.
+[[nodiscard]] static bool save_journal(const char* file_path, const undo_journal& journal) noexcept
+{
+   if (journal.ranges().size() == 0) return true;
+
+   char* path = journal_path(file_path);
+   const bool saved = path and journal.save(path);
+
+   free(path);
+
+   return saved;
+}
+
+/// @brief Put back the journal save_journal replaced, after the executable failed to save and
+/// still holds what that one was written for. With no earlier journal the new one is deleted.
+static void restore_journal(const char* file_path, const undo_journal& previous) noexcept
+{
+   char* path = journal_path(file_path);
+
+   if (not path) return;
+
+   if (previous.ranges().size() == 0 or not previous.save(path)) remove(path);
+
+   free(path);
+}
+
+/// @brief Write the image to the output buffer.
+static bool save_to_buffer(exe_patcher& editor, const apply_options& options,
+                           apply_report& report, int (*print)(const char* format, ...)) noexcept
+{
+   report.output_size = editor.size();
+
+   if (options.output_capacity < editor.size()) {
+      print("The output buffer holds %zu bytes, the patched image needs %zu.\r\n",
+            options.output_capacity, editor.size());
+
+      report.result = apply_result::output_too_small;
+
+      return false;
+   }
+
+   if (not editor.save(options.output_buffer, options.output_capacity)) {
+      print("Failed to write the patched image.\r\n");
+
+      report.result = apply_result::failed;
+
+      return false;
+   }
+
+   return true;
+}
+
+bool apply(const char* file_path, int (*print)(const char* format, ...),
+           const apply_options& options) noexcept
+{
+   if (not print) print = printf;
+
+   apply_report unused_report;
+   apply_report& report = options.report ? *options.report : unused_report;
+
+   report = {};
+
+   if (options.metrics) *options.metrics = {};
+
+   exe_patcher editor;
+   apply_recorder recorder{options, editor};
+   undo_journal journal;
+   undo_journal previous_journal;
+   patch_locator own_locator;
+   const patch_locator* locator = &own_locator;
+   const exe_patch_list* exe_list = nullptr;
+   bool located = false;
+   applied_config previous;
+   es_layout previous_layout;
+   bool incremental = false;
+   bool legacy = false;
+
+   const capacity_values default_capacities;
+   const capacity_values& capacities =
+      options.capacities ? *options.capacities : default_capacities;
+   const char* save_path = options.output_path ? options.output_path : file_path;
+   const bool journaled = options.journal and not options.output_buffer;
+
+   {
+      // Identifying faults in the pages of the mapping it reads, with signatures that's most of
+      // the file.
+      io_scope io{options.io};
+
+      recorder.restart();
+
+      const load_mode mode = options.streamed ? load_mode::streamed : load_mode::mapped;
+
+      if (options.base and not options.output_path and not options.output_buffer) {
+         print("A variant of %s needs a file to be saved to.\r\n", file_path);
 
          return false;
       }
 
-      found_compatible_list = true;
+      if (options.base ? not editor.load_overlay(options.base->image)
+                       : not editor.load(file_path, mode)) {
+         print("Failed to open %s for patching.\r\n", file_path);
 
-      for (const patch_set& set : exe_list.patches) {
-         print("Applying patch set: %s\r\n", set.name);
+         report.result = apply_result::open_failed;
 
-         for (const patch& patch : set.patches) {
-            if (not editor.apply(patch)) {
-               print("Failed to apply patch. %s is unmodified.\r\n", file_path);
+         return false;
+      }
 
-               return false;
+      recorder.finish(apply_phase::load);
+
+      // What an earlier run applied is recorded in the headers. Identifying the build and
+      // checking every site can be skipped if nothing changed since.
+      if (read_applied_config(editor, previous)) {
+         const exe_patch_list& list = patch_lists[previous.list_index];
+
+         if (same_config(previous, capacities, options.large_address_aware)) {
+            print("%s is already patched as %s with these capacities, nothing to do.\r\n",
+                  file_path, list.name);
+
+            report.result = apply_result::patched;
+            report.exe_name = list.name;
+            report.located = previous.located;
+
+            for (const bool set_enabled : previous.enabled) {
+               if (set_enabled) {
+                  report.sets_applied += 1;
+               }
+               else {
+                  report.sets_skipped += 1;
+               }
             }
-         }
 
-         for (const code_patch& cp : set.code_patches) {
-            if (not editor.apply(cp)) {
-               print("Failed to apply code patch. %s is unmodified.\r\n", file_path);
+            if (options.output_buffer) {
+               return save_to_buffer(editor, options, report, print);
+            }
+
+            if (options.output_path and not clone_file(file_path, options.output_path)) {
+               print("Failed to copy %s to %s.\r\n", file_path, options.output_path);
+
+               report.result = apply_result::failed;
 
                return false;
             }
+
+            return true;
          }
+
+         incremental = not previous.located and
+                       editor.compatible(list.id_address, list.expected_id);
+
+         if (incremental) exe_list = &list;
       }
 
-      break;
+      // A base was identified when it was loaded.
+      if (options.base and not incremental) {
+         exe_list = options.base->list;
+         located = options.base->located;
+         locator = &options.base->locator;
+      }
+      else if (not incremental) {
+         exe_list = identify_exe(editor, own_locator, located);
+      }
+
+      recorder.finish(apply_phase::identify);
    }
 
-   if (not found_compatible_list) {
+   if (not exe_list) {
       print("Couldn't identify executable. Unable to patch.\r\n");
 
+      report.result = apply_result::unrecognized;
+
       return false;
    }
 
-   if (not editor.save(file_path)) {
-      print("Failed to save %s after patching.\r\n", file_path);
+   report.exe_name = exe_list->name;
+   report.located = located;
+
+   if (located) {
+      print("Unrecognized executable, located patch sites using signatures from: %s. Applying "
+            "patches.\r\n",
+            exe_list->name);
+   }
+   else {
+      print("Identified executable as: %s. Applying patches.\r\n", exe_list->name);
+   }
+
+   // Versions from before runs were recorded laid the extension section out differently. Their
+   // sites are moved to this version's layout as if by an incremental run from theirs.
+   if (not incremental and not located and
+       read_legacy_config(editor, *exe_list, previous, previous_layout)) {
+      print("%s was patched by an earlier version of this tool, moving its extension section "
+            "regions to the current layout.\r\n",
+            file_path);
+
+      incremental = true;
+      legacy = true;
+   }
+
+   if (journaled) start_journal(editor, save_path, journal, previous_journal, print);
+
+   bool enabled[PATCH_COUNT] = {};
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      enabled[i] = not located or locator->can_locate(exe_list->patches[i]);
+   }
+
+   if (not check_capacities(*exe_list, enabled, capacities, print)) {
+      print("The capacities don't fit this executable. %s is unmodified.\r\n", file_path);
+
+      report.result = apply_result::invalid_capacities;
 
       return false;
    }
 
+   // Skipped sets get no space in the extension section.
+   es_layout layout;
+
+   if (not plan_es_layout(*exe_list, enabled, capacities, layout)) {
+      print("Extension section regions don't fit in the address space. %s is unmodified.\r\n",
+            file_path);
+
+      report.result = apply_result::invalid_capacities;
+
+      return false;
+   }
+
+   print_es_layout(layout, print);
+
+   // The earlier run's layout is planned again to know what it wrote. If it comes out different
+   // the earlier run was made by a version that lays regions out differently.
+   if (incremental and not legacy) {
+      if (not plan_es_layout(*exe_list, previous.enabled, previous.capacities, previous_layout) or
+          previous_layout.size != previous.layout_size or
+          layout_hash(previous_layout) != previous.layout_hash) {
+         print("%s was patched by a different version of this tool. Unpatch it before patching it "
+               "again.\r\n",
+               file_path);
+
+         return false;
+      }
+   }
+
+   if (incremental) {
+      if (trampolines_change(*exe_list, previous, enabled, layout_hash(layout))) {
+         print("The trampolines of %s can't be moved. Unpatch it before patching it with these "
+               "capacities.\r\n",
+               file_path);
+
+         return false;
+      }
+   }
+
+   if (address_budget budget; compute_budget(editor, *exe_list, enabled, capacities,
+                                             options.large_address_aware, budget) and
+                              not budget.fits()) {
+      print("Warning: the executable reserves more address space than it has at startup.\r\n");
+      print_budget(budget, print);
+   }
+
+   write_plan previous_plan;
+
+   if (incremental) {
+      // Planned against the earlier layout before prepare switches to the new one. Trampolines
+      // stay where they are, so they're left out of both plans.
+      (void)editor.find_ext_section(previous_layout);
+
+      for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+         if (not previous.enabled[i]) continue;
+
+         if (not plan_set(editor, exe_list->patches[i], i, nullptr, previous.capacities, false,
+                          previous_plan)) {
+            print("Failed to resolve what was patched by the last run. %s is unmodified.\r\n",
+                  file_path);
+
+            return false;
+         }
+      }
+   }
+
+   if (not editor.prepare(layout, code_cave_size(*exe_list, enabled))) {
+      print("Failed add new executable section for patch data. %s is unmodified.\r\n", file_path);
+
+      return false;
+   }
+
+   recorder.finish(apply_phase::prepare);
+
+   write_plan plan;
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      const patch_set& set = exe_list->patches[i];
+
+      if (not enabled[i]) {
+         print("Skipping patch set: %s (patch sites not found)\r\n", set.name);
+
+         report.sets_skipped += 1;
+
+         continue;
+      }
+
+      print("Applying patch set: %s\r\n", set.name);
+
+      recorder.restart();
+
+      if (not plan_set(editor, set, i, located ? locator : nullptr, capacities, not incremental,
+                       plan)) {
+         print("Failed to resolve patch set: %s. %s is unmodified.\r\n", set.name, file_path);
+
+         return false;
+      }
+
+      recorder.finish(apply_phase::patch_set, set.name);
+
+      report.sets_applied += 1;
+   }
+
+   recorder.restart();
+
+   if (incremental) {
+      write_plan changes;
+      uint32_t unchanged_count = 0;
+
+      if (not diff_plans(previous_plan, plan, editor.size(), changes, unchanged_count)) {
+         print("Failed to apply patches, patch sites overlap. %s is unmodified.\r\n", file_path);
+
+         report.sets_applied = 0;
+
+         return false;
+      }
+
+      print("Updating %zu patch sites, %u are unchanged since the last run.\r\n",
+            changes.sites().size(), unchanged_count);
+
+      plan = changes;
+   }
+
+   // Every set is verified together and only committed if all of them can be.
+   if (uint32_t failed_set = 0; not editor.apply(plan, failed_set, &recorder.outcome)) {
+      if (failed_set < PATCH_COUNT) {
+         print("Failed to apply patch set: %s. %s is unmodified.\r\n",
+               exe_list->patches[failed_set].name, file_path);
+      }
+      else {
+         print("Failed to apply patches, patch sites overlap. %s is unmodified.\r\n", file_path);
+      }
+
+      report.sets_applied = 0;
+
+      return false;
+   }
+
+   applied_config config;
+
+   config.list_index = (uint32_t)(exe_list - patch_lists);
+   config.located = located;
+   config.large_address_aware = options.large_address_aware or editor.large_address_aware();
+   config.capacities = capacities;
+   config.layout_size = layout.size;
+   config.layout_hash = layout_hash(layout);
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) config.enabled[i] = enabled[i];
+
+   if (not write_applied_config(editor, config)) {
+      print("No room in the headers to record what was applied, the next run will check every "
+            "patch site.\r\n");
+   }
+
+   if (options.large_address_aware) {
+      print("Setting the large address aware flag.\r\n");
+
+      if (not editor.set_large_address_aware() or not editor.update_checksum()) {
+         print("Failed to set the large address aware flag. %s is unmodified.\r\n", file_path);
+
+         report.sets_applied = 0;
+
+         return false;
+      }
+   }
+
+   if (journaled and not journal.finish(editor)) {
+      print("Failed to record the original bytes for the undo journal. %s is unmodified.\r\n",
+            file_path);
+
+      return false;
+   }
+
+   recorder.finish(apply_phase::apply);
+
+   io_scope io{options.io};
+
+   recorder.restart();
+
+   if (journaled and not save_journal(save_path, journal)) {
+      print("Failed to save the undo journal. %s is unmodified.\r\n", file_path);
+
+      return false;
+   }
+
+   if (options.output_buffer) {
+      if (not save_to_buffer(editor, options, report, print)) return false;
+   }
+   else if (not editor.save(save_path)) {
+      print("Failed to save %s after patching.\r\n", save_path);
+
+      if (journaled and journal.ranges().size() != 0) restore_journal(save_path, previous_journal);
+
+      return false;
+   }
+
+   recorder.finish(apply_phase::save);
+
+   if (journaled and journal.ranges().size() != 0) {
+      if (char* path = journal_path(save_path); path) {
+         print("Saved the original bytes to %s.\r\n", path);
+
+         free(path);
+      }
+   }
+
+   report.result = apply_result::patched;
+   report.output_size = editor.size();
+
    return true;
-}
\ No newline at end of file
+}
+
+bool load_apply_base(const char* file_path, apply_base& out,
+                     int (*print)(const char* format, ...)) noexcept
+{
+   if (not print) print = printf;
+
+   out.list = nullptr;
+   out.located = false;
+
+   if (not out.image.load(file_path, load_mode::read_only)) {
+      print("Failed to open %s.\r\n", file_path);
+
+      return false;
+   }
+
+   out.list = identify_exe(out.image, out.locator, out.located);
+
+   if (not out.list) {
+      print("Couldn't identify %s.\r\n", file_path);
+
+      return false;
+   }
+
+   return true;
+}
+
+auto apply_phase_name(apply_phase phase) noexcept -> const char*
+{
+   switch (phase) {
+   case apply_phase::load:
+      return "load";
+   case apply_phase::identify:
+      return "identify";
+   case apply_phase::prepare:
+      return "prepare";
+   case apply_phase::patch_set:
+      return "patch_set";
+   case apply_phase::apply:
+      return "apply";
+   case apply_phase::save:
+      return "save";
+   }
+
+   return "unknown";
+}
+
+static auto apply_result_name(apply_result result) noexcept -> const char*
+{
+   switch (result) {
+   case apply_result::patched:
+      return "patched";
+   case apply_result::open_failed:
+      return "open_failed";
+   case apply_result::unrecognized:
+      return "unrecognized";
+   case apply_result::invalid_capacities:
+      return "invalid_capacities";
+   case apply_result::output_too_small:
+      return "output_too_small";
+   case apply_result::failed:
+   default:
+      return "failed";
+   }
+}
+
+void print_apply_phase_json(const char* file_path, const apply_phase_event& event,
+                            int (*print)(const char* format, ...)) noexcept
+{
+   print("{\"file\":");
+   print_json_string(print, file_path);
+   print(",\"phase\":\"%s\"", apply_phase_name(event.phase));
+
+   if (event.set_name) {
+      print(",\"set\":");
+      print_json_string(print, event.set_name);
+   }
+
+   print(",\"ms\":%.3f}\r\n", event.milliseconds);
+}
+
+void print_apply_metrics_json(const char* file_path, const apply_report& report,
+                              const apply_metrics& metrics,
+                              int (*print)(const char* format, ...)) noexcept
+{
+   print("{\"file\":");
+   print_json_string(print, file_path);
+   print(",\"result\":\"%s\"", apply_result_name(report.result));
+
+   if (report.exe_name) {
+      print(",\"build\":");
+      print_json_string(print, report.exe_name);
+      print(",\"located\":%s,\"sets_applied\":%u,\"sets_skipped\":%u",
+            report.located ? "true" : "false", report.sets_applied, report.sets_skipped);
+   }
+
+   print(",\"total_ms\":%.3f,\"phase_ms\":{", metrics.total_milliseconds);
+
+   for (uint32_t i = 0; i < apply_phase_count; ++i) {
+      print(i == 0 ? "\"%s\":%.3f" : ",\"%s\":%.3f", apply_phase_name((apply_phase)i),
+            metrics.phase_milliseconds[i]);
+   }
+
+   print("},\"bytes_read\":%llu,\"bytes_written\":%llu,\"bytes_compared\":%llu,"
+         "\"sites_already_patched\":%u,\"sites_patched\":%u,\"allocations\":%llu}\r\n",
+         (unsigned long long)metrics.bytes_read, (unsigned long long)metrics.bytes_written,
+         (unsigned long long)metrics.bytes_compared, metrics.sites_already_patched,
+         metrics.sites_patched, (unsigned long long)metrics.allocations);
+}
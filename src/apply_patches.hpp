@@ -1,3 +1,144 @@
 #pragma once
 
-[[nodiscard]] bool apply(const char* file_path, int (*print)(const char* format, ...)) noexcept;
+#include "exe_patcher.hpp"
+#include "patch_locator.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct capacity_values;
+struct io_limiter;
+
+enum class apply_result : uint8_t {
+   patched,
+   open_failed,
+   unrecognized,
+   failed,
+   /// @brief The capacities don't fit the executable's instructions or address space.
+   invalid_capacities,
+   /// @brief The output buffer can't hold the patched image, see apply_report::output_size.
+   output_too_small,
+};
+
+/// @brief What happened to an executable, for callers patching more than one.
+struct apply_report {
+   apply_result result = apply_result::failed;
+   /// @brief The name of the patch list used, null if the executable wasn't identified.
+   const char* exe_name = nullptr;
+   /// @brief If the patch sites were found using signatures instead of a known build's id.
+   bool located = false;
+   uint32_t sets_applied = 0;
+   uint32_t sets_skipped = 0;
+   /// @brief The size of the patched image, once it's known. Also set when the output buffer was
+   /// too small.
+   size_t output_size = 0;
+};
+
+enum class apply_phase : uint8_t {
+   /// @brief Opening or mapping the file.
+   load,
+   /// @brief Finding the build by its id, or the patch sites by signatures.
+   identify,
+   /// @brief Checking the capacities, laying out and adding the new sections.
+   prepare,
+   /// @brief Resolving the sites of one patch set into the write plan.
+   patch_set,
+   /// @brief Verifying and committing the write plan, and the header flags and checksum.
+   apply,
+   /// @brief Writing the file.
+   save,
+};
+
+constexpr uint32_t apply_phase_count = 6;
+
+/// @brief A phase of apply that finished.
+struct apply_phase_event {
+   apply_phase phase = apply_phase::load;
+   /// @brief The name of the set for patch_set phases, null for the others.
+   const char* set_name = nullptr;
+   /// @brief Wall time, leaving out time spent waiting on the io limiter.
+   double milliseconds = 0.0;
+};
+
+/// @brief Where the time went in a call to apply and how much it did.
+struct apply_metrics {
+   /// @brief Wall time of each phase, indexed by apply_phase. The patch_set entry is the sum over
+   /// every set.
+   double phase_milliseconds[apply_phase_count] = {};
+   /// @brief Wall time of the whole call, waits on the io limiter included.
+   double total_milliseconds = 0.0;
+   uint64_t bytes_read = 0;
+   uint64_t bytes_written = 0;
+   uint64_t bytes_compared = 0;
+   /// @brief Sites that already held their replacement.
+   uint32_t sites_already_patched = 0;
+   /// @brief Sites that were written.
+   uint32_t sites_patched = 0;
+   /// @brief Heap allocations made for vectors on the calling thread. The image itself and
+   /// allocations made by the C runtime aren't counted.
+   uint64_t allocations = 0;
+};
+
+/// @brief An executable loaded read-only and identified once, to patch many variants of it
+/// without loading or identifying it again for each.
+struct apply_base {
+   exe_patcher image;
+   patch_locator locator;
+   /// @brief The patch list it was identified as.
+   const exe_patch_list* list = nullptr;
+   bool located = false;
+};
+
+struct apply_options {
+   /// @brief Limits how many calls load and save at once. May be null.
+   io_limiter* io = nullptr;
+   /// @brief Filled in with the outcome. May be null.
+   apply_report* report = nullptr;
+   /// @brief Stream the file through fixed-size buffers instead of mapping it, so memory use
+   /// stays the same however large it is.
+   bool streamed = false;
+   /// @brief The capacities to derive patch values from. Null for the defaults.
+   const capacity_values* capacities = nullptr;
+   /// @brief Mark the executable large address aware and recompute its header checksum.
+   bool large_address_aware = false;
+   /// @brief Keep the original bytes of everything written in an undo journal next to the
+   /// executable, so unpatch can restore it. The journal of an earlier patch is added to.
+   bool journal = false;
+   /// @brief Save the patched executable to this path instead of replacing the file, which is
+   /// left unmodified. The journal goes next to it. Null to patch in place.
+   const char* output_path = nullptr;
+   /// @brief The file already loaded by load_apply_base. The image is patched as an overlay of
+   /// it, holding only its headers and what's written, and it isn't identified again. Requires
+   /// output_path or output_buffer. Many calls on many threads can share one base. May be null.
+   const apply_base* base = nullptr;
+   /// @brief Write the patched image here instead of to a file, used with a base. Nothing is
+   /// written unless patching succeeds. May be the bytes the base was loaded from, to patch them
+   /// in place. No journal is kept.
+   uint8_t* output_buffer = nullptr;
+   size_t output_capacity = 0;
+   /// @brief Filled in with phase timings and counters, also when apply fails. May be null.
+   apply_metrics* metrics = nullptr;
+   /// @brief Called on the calling thread as each phase finishes. May be null.
+   void (*on_phase)(void* context, const apply_phase_event& event) = nullptr;
+   /// @brief Passed to on_phase.
+   void* phase_context = nullptr;
+};
+
+[[nodiscard]] bool apply(const char* file_path, int (*print)(const char* format, ...),
+                         const apply_options& options = {}) noexcept;
+
+/// @brief Map an executable read-only and identify it, to patch variants of it with apply.
+/// @return False if it couldn't be opened or wasn't recognized.
+[[nodiscard]] bool load_apply_base(const char* file_path, apply_base& out,
+                                   int (*print)(const char* format, ...)) noexcept;
+
+[[nodiscard]] auto apply_phase_name(apply_phase phase) noexcept -> const char*;
+
+/// @brief Print a phase event as a JSON object on a line of its own.
+void print_apply_phase_json(const char* file_path, const apply_phase_event& event,
+                            int (*print)(const char* format, ...)) noexcept;
+
+/// @brief Print the outcome and metrics of a call to apply as a JSON object on a line of its own.
+void print_apply_metrics_json(const char* file_path, const apply_report& report,
+                              const apply_metrics& metrics,
+                              int (*print)(const char* format, ...)) noexcept;
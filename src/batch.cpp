@@ -0,0 +1,634 @@
+#ifdef _MSC_VER
+#pragma warning(disable : 4530)
+#endif
+
+#include "batch.hpp"
+#include "apply_patches.hpp"
+#include "capacities.hpp"
+#include "file_helpers.hpp"
+#include "json_helpers.hpp"
+#include "slim_vector.hpp"
+#include "thread_pool.hpp"
+#include "verify.hpp"
+#include "verify_cache.hpp"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+constexpr const char* batch_exe_name = "battlefront.exe";
+
+/// @brief Output of a single job, printed once the whole batch is done.
+struct job_log {
+   char* text = nullptr;
+   size_t size = 0;
+   size_t capacity = 0;
+};
+
+struct batch_job {
+   char* path = nullptr;
+   /// @brief The capacities of a variant, null for the batch's.
+   const capacity_values* capacities = nullptr;
+   job_log log;
+   apply_report report;
+   apply_metrics metrics;
+   /// @brief If apply ran and filled in metrics.
+   bool applied = false;
+   verify_report verify;
+   double milliseconds = 0.0;
+   /// @brief The file's identity when verify was filled in, if there's a cache.
+   file_identity identity;
+   bool has_identity = false;
+   /// @brief If the report came from the cache without opening the file.
+   bool cached = false;
+};
+
+struct batch_context {
+   batch_job* jobs = nullptr;
+   io_limiter* io = nullptr;
+   const batch_options* options = nullptr;
+   const verify_cache* cache = nullptr;
+   /// @brief The executable variants are patched from, null if the jobs are executables.
+   const apply_base* base = nullptr;
+   const char* base_path = nullptr;
+};
+
+// apply only takes a printf style function, so each thread points this at the log of the job it's
+// running.
+static thread_local job_log* current_log = nullptr;
+
+static int print_to_log(const char* format, ...)
+{
+   job_log* log = current_log;
+
+   if (not log) return -1;
+
+   va_list args;
+
+   va_start(args, format);
+   const int length = vsnprintf(nullptr, 0, format, args);
+   va_end(args);
+
+   if (length < 0) return length;
+
+   const size_t required = log->size + (size_t)length + 1;
+
+   if (required > log->capacity) {
+      size_t new_capacity = log->capacity ? log->capacity * 2 : 256;
+
+      while (new_capacity < required) new_capacity *= 2;
+
+      char* new_text = (char*)realloc(log->text, new_capacity);
+
+      if (not new_text) return -1;
+
+      log->text = new_text;
+      log->capacity = new_capacity;
+   }
+
+   va_start(args, format);
+   vsnprintf(log->text + log->size, log->capacity - log->size, format, args);
+   va_end(args);
+
+   log->size += (size_t)length;
+
+   return length;
+}
+
+static void run_job(void* context, size_t index) noexcept
+{
+   batch_context& batch = *static_cast<batch_context*>(context);
+   batch_job& job = batch.jobs[index];
+
+   const auto start = std::chrono::steady_clock::now();
+
+   current_log = &job.log;
+
+   if (batch.cache) {
+      job.has_identity = get_file_identity(job.path, job.identity);
+      job.cached = job.has_identity and batch.cache->find(job.identity, job.verify);
+   }
+
+   if (batch.options->verify) {
+      if (not job.cached) {
+         (void)verify(job.path, job.verify, batch.io, batch.options->capacities);
+      }
+
+      print_verify_report(job.path, job.verify,
+                          batch.options->json ? report_format::json : report_format::text,
+                          print_to_log);
+   }
+   else if (job.cached and job.verify.fully_patched() and
+            (job.verify.large_address_aware or not batch.options->large_address_aware)) {
+      job.report.result = apply_result::patched;
+      job.report.exe_name = job.verify.exe_name;
+      job.report.located = job.verify.located;
+
+      for (const patch_set_status& set : job.verify.sets) {
+         if (set.found) {
+            job.report.sets_applied += 1;
+         }
+         else {
+            job.report.sets_skipped += 1;
+         }
+      }
+
+      print_to_log("Unchanged since it was last patched, skipping.\r\n");
+   }
+   else {
+      apply_options options;
+
+      options.io = batch.io;
+      options.report = &job.report;
+      options.streamed = batch.options->streamed;
+      options.capacities = job.capacities ? job.capacities : batch.options->capacities;
+      options.large_address_aware = batch.options->large_address_aware;
+      options.journal = batch.options->journal;
+      options.metrics = &job.metrics;
+
+      if (batch.base) {
+         options.base = batch.base;
+         options.output_path = job.path;
+      }
+
+      job.cached = false;
+      job.applied = true;
+
+      (void)apply(batch.base ? batch.base_path : job.path, print_to_log, options);
+
+      // Record what the file was left as, so the next run can skip it.
+      if (batch.cache and job.report.result == apply_result::patched) {
+         job.has_identity = get_file_identity(job.path, job.identity) and
+                            verify(job.path, job.verify, batch.io, batch.options->capacities);
+      }
+      else {
+         job.has_identity = false;
+      }
+   }
+
+   current_log = nullptr;
+
+   job.milliseconds =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool equals_ignore_case(const char* left, const char* right) noexcept
+{
+   for (; *left and *right; ++left, ++right) {
+      const char l = (*left >= 'A' and *left <= 'Z') ? *left - 'A' + 'a' : *left;
+      const char r = (*right >= 'A' and *right <= 'Z') ? *right - 'A' + 'a' : *right;
+
+      if (l != r) return false;
+   }
+
+   return *left == *right;
+}
+
+static void add_path(slim_vector<char*>& paths, const char* path)
+{
+   char* copy = duplicate_string(path);
+
+   if (copy) paths.push_back(copy);
+}
+
+static void collect_exe(void* context, const char* path, const char* name)
+{
+   if (equals_ignore_case(name, batch_exe_name)) {
+      add_path(*static_cast<slim_vector<char*>*>(context), path);
+   }
+}
+
+/// @brief Call a function with every line of a list file, trimmed of surrounding whitespace.
+/// Blank lines and lines starting with # are skipped.
+/// @return False if the file couldn't be opened or any call returned false.
+static bool read_list_file(const char* list_path, bool (*on_line)(void* context, char* line),
+                           void* context, int (*print)(const char* format, ...))
+{
+   FILE* file = nullptr;
+
+#ifdef _WIN32
+   if (fopen_s(&file, list_path, "rb") != 0) file = nullptr;
+#else
+   file = fopen(list_path, "rb");
+#endif
+
+   if (not file) {
+      print("Failed to open list file %s.\r\n", list_path);
+
+      return false;
+   }
+
+   bool result = true;
+   slim_vector<char> line;
+
+   for (int c = fgetc(file);; c = fgetc(file)) {
+      if (c != EOF and c != '\n') {
+         line.push_back((char)c);
+
+         continue;
+      }
+
+      // Trim surrounding whitespace, including the \r of CRLF lines.
+      size_t begin = 0;
+      size_t end = line.size();
+
+      while (begin < end and (line[begin] == ' ' or line[begin] == '\t')) ++begin;
+      while (end > begin and
+             (line[end - 1] == ' ' or line[end - 1] == '\t' or line[end - 1] == '\r')) {
+         --end;
+      }
+
+      if (begin != end and line[begin] != '#') {
+         line.push_back('\0');
+         line[end] = '\0';
+
+         result &= on_line(context, line.data() + begin);
+      }
+
+      line.clear();
+
+      if (c == EOF) break;
+   }
+
+   fclose(file);
+
+   return result;
+}
+
+struct collect_context {
+   slim_vector<char*>* paths = nullptr;
+   int (*print)(const char* format, ...) = nullptr;
+};
+
+static bool collect_input(slim_vector<char*>& paths, const char* input, bool allow_list,
+                          int (*print)(const char* format, ...));
+
+static bool collect_line(void* context, char* line)
+{
+   collect_context& collect = *static_cast<collect_context*>(context);
+
+   return collect_input(*collect.paths, line, false, collect.print);
+}
+
+/// @brief Expand an input into executable paths.
+/// @return False if a directory or list file couldn't be read.
+static bool collect_input(slim_vector<char*>& paths, const char* input, bool allow_list,
+                          int (*print)(const char* format, ...))
+{
+   if (allow_list and input[0] == '@') {
+      collect_context context{&paths, print};
+
+      return read_list_file(input + 1, collect_line, &context, print);
+   }
+
+   if (is_directory(input)) {
+      const size_t found = paths.size();
+
+      if (not walk_directory(input, collect_exe, &paths)) {
+         print("Failed to search directory %s.\r\n", input);
+
+         return false;
+      }
+
+      if (paths.size() == found) print("No Battlefront.exe found under %s.\r\n", input);
+
+      return true;
+   }
+
+   add_path(paths, input);
+
+   return true;
+}
+
+static int compare_paths(const void* left, const void* right)
+{
+   return strcmp(*static_cast<char* const*>(left), *static_cast<char* const*>(right));
+}
+
+static auto result_name(apply_result result) noexcept -> const char*
+{
+   switch (result) {
+   case apply_result::patched:
+      return "patched";
+   case apply_result::open_failed:
+      return "open failed";
+   case apply_result::unrecognized:
+      return "unrecognized";
+   case apply_result::invalid_capacities:
+      return "bad capacity";
+   case apply_result::failed:
+   default:
+      return "failed";
+   }
+}
+
+static auto print_apply_results(const batch_job* jobs, size_t job_count,
+                                const batch_options& options,
+                                int (*print)(const char* format, ...)) -> batch_exit_code
+{
+   uint32_t patched = 0;
+   uint32_t unrecognized = 0;
+   uint32_t failed = 0;
+
+   for (size_t i = 0; i < job_count; ++i) {
+      const batch_job& job = jobs[i];
+
+      switch (job.report.result) {
+      case apply_result::patched:
+         patched += 1;
+         break;
+      case apply_result::unrecognized:
+         unrecognized += 1;
+         break;
+      default:
+         failed += 1;
+         break;
+      }
+
+      if (job.log.size != 0 and (options.verbose or job.report.result != apply_result::patched)) {
+         print("--- %s ---\r\n%s", job.path, job.log.text);
+      }
+   }
+
+   print("\r\n%-12s %10s  %-5s  %-34s %s\r\n", "Result", "Time", "Sets", "Build", "File");
+
+   for (size_t i = 0; i < job_count; ++i) {
+      const batch_job& job = jobs[i];
+      const apply_report& report = job.report;
+      char sets[16] = "-";
+      char build[64] = "-";
+
+      if (report.exe_name) {
+         snprintf(sets, sizeof(sets), "%u/%u", report.sets_applied,
+                  report.sets_applied + report.sets_skipped);
+         snprintf(build, sizeof(build), "%s%s", report.exe_name,
+                  report.located ? " (signatures)" : "");
+      }
+
+      print("%-12s %7.1f ms  %-5s  %-34s %s\r\n", result_name(report.result), job.milliseconds,
+            sets, build, job.path);
+   }
+
+   print("\r\n%zu executables: %u patched, %u unrecognized, %u failed.\r\n", job_count, patched,
+         unrecognized, failed);
+
+   return patched == job_count ? BATCH_ALL_PATCHED : BATCH_SOME_FAILED;
+}
+
+static auto print_verify_results(const batch_job* jobs, size_t job_count,
+                                 const batch_options& options,
+                                 int (*print)(const char* format, ...)) -> batch_exit_code
+{
+   uint32_t patched = 0;
+   uint32_t not_patched = 0;
+   uint32_t unrecognized = 0;
+   uint32_t open_failed = 0;
+
+   for (size_t i = 0; i < job_count; ++i) {
+      const batch_job& job = jobs[i];
+
+      if (job.log.size != 0) print("%s", job.log.text);
+
+      switch (job.verify.result) {
+      case verify_result::verified:
+         if (job.verify.fully_patched()) {
+            patched += 1;
+         }
+         else {
+            not_patched += 1;
+         }
+         break;
+      case verify_result::unrecognized:
+         unrecognized += 1;
+         break;
+      case verify_result::open_failed:
+         open_failed += 1;
+         break;
+      }
+   }
+
+   if (not options.json) {
+      print("\r\n%zu executables: %u fully patched, %u not fully patched, %u unrecognized, %u "
+            "failed to open.\r\n",
+            job_count, patched, not_patched, unrecognized, open_failed);
+   }
+
+   return patched == job_count ? BATCH_ALL_PATCHED : BATCH_SOME_FAILED;
+}
+
+/// @brief Run every job, print the results and free the jobs.
+/// @param base The executable the jobs are variants of, null if they're executables.
+static auto run_jobs(batch_job* jobs, size_t job_count, const batch_options& options,
+                     const apply_base* base, const char* base_path,
+                     int (*print)(const char* format, ...)) noexcept -> batch_exit_code
+{
+   uint32_t thread_count = options.jobs ? options.jobs : hardware_thread_count();
+
+   if (thread_count > job_count) thread_count = (uint32_t)job_count;
+
+   io_limiter io{options.io_limit};
+   verify_cache cache;
+
+   if (options.cache_path) cache.open(options.cache_path, options.capacities);
+
+   batch_context context{jobs, &io, &options, options.cache_path ? &cache : nullptr, base,
+                         base_path};
+
+   const auto start = std::chrono::steady_clock::now();
+
+   parallel_for(job_count, thread_count, run_job, &context);
+
+   const double total_milliseconds =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+   const batch_exit_code exit_code =
+      options.verify
+         ? print_verify_results(jobs, job_count, options, print)
+         : print_apply_results(jobs, job_count, options, print);
+
+   if (options.cache_path) {
+      uint32_t cached = 0;
+
+      for (size_t i = 0; i < job_count; ++i) {
+         if (jobs[i].cached) cached += 1;
+         if (jobs[i].has_identity) cache.store(jobs[i].identity, jobs[i].verify);
+      }
+
+      if (not options.json) {
+         print("%u of %zu executables unchanged since they were last checked.\r\n", cached,
+               job_count);
+      }
+
+      if (not cache.save(options.cache_path)) {
+         print("Failed to save cache %s.\r\n", options.cache_path);
+      }
+   }
+
+   if (options.metrics_path and not options.verify) {
+      bool written = open_json_lines(options.metrics_path);
+
+      for (size_t i = 0; written and i < job_count; ++i) {
+         if (not jobs[i].applied) continue;
+
+         print_apply_metrics_json(jobs[i].path, jobs[i].report, jobs[i].metrics,
+                                  print_json_lines);
+      }
+
+      written &= close_json_lines();
+
+      if (not written) print("Failed to write metrics to %s.\r\n", options.metrics_path);
+   }
+
+   if (not options.json) {
+      print("%.1f ms on %u threads.\r\n", total_milliseconds, thread_count);
+   }
+
+   for (size_t i = 0; i < job_count; ++i) {
+      free(jobs[i].path);
+      free(jobs[i].log.text);
+   }
+
+   delete[] jobs;
+
+   return exit_code;
+}
+
+auto run_batch(const char* const* inputs, size_t input_count, const batch_options& options,
+               int (*print)(const char* format, ...)) noexcept -> batch_exit_code
+{
+   slim_vector<char*> paths;
+   bool inputs_valid = true;
+
+   for (size_t i = 0; i < input_count; ++i) {
+      inputs_valid &= collect_input(paths, inputs[i], true, print);
+   }
+
+   // Sort so the table is stable from run to run and the same file is never patched by two jobs
+   // at once.
+   if (paths.size() != 0) qsort(paths.data(), paths.size(), sizeof(char*), compare_paths);
+
+   size_t unique_count = 0;
+
+   for (size_t i = 0; i < paths.size(); ++i) {
+      if (unique_count != 0 and strcmp(paths[unique_count - 1], paths[i]) == 0) {
+         free(paths[i]);
+
+         continue;
+      }
+
+      paths[unique_count++] = paths[i];
+   }
+
+   paths.truncate(unique_count);
+
+   if (paths.size() == 0) {
+      print("No executables to patch.\r\n");
+
+      return BATCH_NOTHING_TO_DO;
+   }
+
+   const size_t job_count = paths.size();
+   batch_job* jobs = new batch_job[job_count];
+
+   for (size_t i = 0; i < job_count; ++i) jobs[i].path = paths[i];
+
+   const batch_exit_code exit_code = run_jobs(jobs, job_count, options, nullptr, nullptr, print);
+
+   if (not inputs_valid) return BATCH_SOME_FAILED;
+
+   return exit_code;
+}
+
+struct variant_context {
+   slim_vector<char*>* paths = nullptr;
+   slim_vector<capacity_values>* capacities = nullptr;
+   const capacity_values* defaults = nullptr;
+   int (*print)(const char* format, ...) = nullptr;
+};
+
+/// @brief Parse a line of a variant list, capacity assignments followed by the output path.
+static bool collect_variant(void* context, char* line)
+{
+   variant_context& variants = *static_cast<variant_context*>(context);
+   capacity_values capacities = *variants.defaults;
+
+   for (;;) {
+      size_t end = 0;
+
+      while (line[end] and line[end] != ' ' and line[end] != '\t') ++end;
+
+      // The path is the rest of the line, it may have spaces in it.
+      if (not memchr(line, '=', end) or line[end] == '\0') break;
+
+      line[end] = '\0';
+
+      if (not set_capacity(capacities, line, variants.print)) return false;
+
+      line += end + 1;
+
+      while (*line == ' ' or *line == '\t') ++line;
+   }
+
+   if (strchr(line, '=')) {
+      variants.print("%s: a variant needs a file to be saved to.\r\n", line);
+
+      return false;
+   }
+
+   add_path(*variants.paths, line);
+   variants.capacities->push_back(capacities);
+
+   return true;
+}
+
+auto run_variants(const char* file_path, const char* list_path, const batch_options& options,
+                  int (*print)(const char* format, ...)) noexcept -> batch_exit_code
+{
+   const capacity_values default_capacities;
+   slim_vector<char*> paths;
+   slim_vector<capacity_values> capacities;
+   variant_context context{&paths, &capacities,
+                           options.capacities ? options.capacities : &default_capacities, print};
+
+   bool inputs_valid = read_list_file(list_path, collect_variant, &context, print);
+
+   // Two variants saved to one file would race, the executable itself is read by every variant.
+   for (size_t i = 0; inputs_valid and i < paths.size(); ++i) {
+      if (strcmp(paths[i], file_path) == 0) {
+         print("%s can't be a variant of itself.\r\n", paths[i]);
+
+         inputs_valid = false;
+      }
+
+      for (size_t j = 0; inputs_valid and j < i; ++j) {
+         if (strcmp(paths[i], paths[j]) == 0) {
+            print("%s is the file of more than one variant.\r\n", paths[i]);
+
+            inputs_valid = false;
+         }
+      }
+   }
+
+   apply_base base;
+
+   if (not inputs_valid or paths.size() == 0 or not load_apply_base(file_path, base, print)) {
+      if (inputs_valid and paths.size() == 0) print("No variants to patch.\r\n");
+
+      for (char* path : paths) free(path);
+
+      return BATCH_NOTHING_TO_DO;
+   }
+
+   const size_t job_count = paths.size();
+   batch_job* jobs = new batch_job[job_count];
+
+   for (size_t i = 0; i < job_count; ++i) {
+      jobs[i].path = paths[i];
+      jobs[i].capacities = &capacities[i];
+   }
+
+   return run_jobs(jobs, job_count, options, &base, file_path, print);
+}
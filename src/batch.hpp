@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct capacity_values;
+
+struct batch_options {
+   /// @brief The number of executables to patch at once, 0 for one per hardware thread.
+   uint32_t jobs = 0;
+   /// @brief The number of executables that may be loaded or saved at once.
+   uint32_t io_limit = 4;
+   /// @brief Print the output of every executable instead of only those that failed.
+   bool verbose = false;
+   /// @brief Check the state of every patch site instead of patching. Nothing is written.
+   bool verify = false;
+   /// @brief Print verify reports as JSON lines instead of text.
+   bool json = false;
+   /// @brief Stream executables through fixed-size buffers when patching instead of mapping them.
+   bool streamed = false;
+   /// @brief The verify_cache file to read reports from and save them to, null for none.
+   /// Executables that haven't changed since they were last verified or patched aren't opened.
+   const char* cache_path = nullptr;
+   /// @brief The capacities to patch with, or to expect when verifying. Null for the defaults.
+   const capacity_values* capacities = nullptr;
+   /// @brief Mark patched executables large address aware.
+   bool large_address_aware = false;
+   /// @brief Keep an undo journal next to every executable patched.
+   bool journal = false;
+   /// @brief A file to append the metrics of every executable patched to as JSON lines, null for
+   /// none.
+   const char* metrics_path = nullptr;
+};
+
+/// @brief In verify mode BATCH_ALL_PATCHED means every site of every executable is patched.
+enum batch_exit_code : int {
+   BATCH_ALL_PATCHED = 0,
+   BATCH_SOME_FAILED = 1,
+   BATCH_NOTHING_TO_DO = 2,
+};
+
+/// @brief Patch or verify many executables in parallel and print a summary of the results.
+/// @param inputs Executable paths, directories to search for Battlefront.exe in or @ followed by
+/// the path of a list file with one input per line.
+/// @param input_count The number of inputs.
+/// @param options The batch options.
+/// @param print The function to print output with, only ever called from the calling thread.
+/// @return The exit code summarizing the batch.
+[[nodiscard]] auto run_batch(const char* const* inputs, size_t input_count,
+                             const batch_options& options,
+                             int (*print)(const char* format, ...)) noexcept -> batch_exit_code;
+
+/// @brief Patch variants of one executable with different capacities in parallel, saving each to
+/// its own file, and print a summary of the results. The executable is mapped and identified
+/// once and left unmodified. Each variant holds only its headers and the bytes it writes, and is
+/// saved by cloning the executable and writing those over the clone.
+/// @param file_path The executable.
+/// @param list_path A file with a line per variant, name=value capacity assignments followed by
+/// the path to save the variant to. They apply on top of the batch's capacities. Blank lines and
+/// lines starting with # are ignored.
+/// @param options The batch options. verify, streamed and cache_path aren't used.
+/// @param print The function to print output with, only ever called from the calling thread.
+/// @return The exit code summarizing the variants.
+[[nodiscard]] auto run_variants(const char* file_path, const char* list_path,
+                                const batch_options& options,
+                                int (*print)(const char* format, ...)) noexcept -> batch_exit_code;
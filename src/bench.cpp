@@ -0,0 +1,581 @@
+#ifdef _MSC_VER
+#pragma warning(disable : 4530)
+#endif
+
+#include "bench.hpp"
+#include "apply_patches.hpp"
+#include "batch.hpp"
+#include "capacities.hpp"
+#include "es_layout.hpp"
+#include "exe_patcher.hpp"
+#include "file_helpers.hpp"
+#include "json_helpers.hpp"
+#include "pe_image.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+constexpr uint32_t synthetic_alignment = 0x1000;
+constexpr uint32_t synthetic_image_base = 0x400000;
+constexpr uint32_t synthetic_header_offset = 0x80;
+constexpr uint32_t max_synthetic_sections = 64;
+/// @brief The share of the image after the headers the code section gets, in percent.
+constexpr uint32_t synthetic_code_share = 80;
+/// @brief How many calls to compatible make one sample, a single call is too quick to time.
+constexpr uint32_t compatible_calls = 10000;
+
+constexpr size_t bench_megabyte = 1024 * 1024;
+
+/// @brief The list synthetic executables are identified as.
+static auto synthetic_list() noexcept -> const exe_patch_list&
+{
+   return patch_lists[0];
+}
+
+/// @brief Synthetic images map every section at its file offset.
+static auto synthetic_offset(patch_address address) noexcept -> size_t
+{
+   switch (address.space) {
+   case address_space::va:
+      return address.value - synthetic_image_base;
+   case address_space::file_offset:
+   case address_space::rva:
+   default:
+      return address.value;
+   }
+}
+
+static auto align_up(size_t value, size_t alignment) noexcept -> size_t
+{
+   return (value + alignment - 1) / alignment * alignment;
+}
+
+/// @brief xorshift32, the image only has to look like code to nothing in particular.
+static auto next_random(uint32_t& state) noexcept -> uint32_t
+{
+   state ^= state << 13;
+   state ^= state >> 17;
+   state ^= state << 5;
+
+   return state;
+}
+
+static void write_headers(uint8_t* data, size_t size, uint32_t section_count,
+                          size_t code_size) noexcept
+{
+   pe_dos_header dos_header = {};
+
+   dos_header.e_magic = pe_dos_magic;
+   dos_header.e_lfanew = synthetic_header_offset;
+
+   memcpy(data, &dos_header, sizeof(dos_header));
+
+   const uint32_t signature = pe_nt_signature;
+   pe_file_header file_header = {};
+
+   file_header.machine = 0x14c;
+   file_header.number_of_sections = (uint16_t)section_count;
+   file_header.size_of_optional_header = sizeof(pe_optional_header32);
+   file_header.characteristics = 0x10f;
+
+   pe_optional_header32 optional_header = {};
+
+   optional_header.magic = pe_optional_header32_magic;
+   optional_header.size_of_code = (uint32_t)code_size;
+   optional_header.address_of_entry_point = synthetic_alignment;
+   optional_header.base_of_code = synthetic_alignment;
+   optional_header.base_of_data = (uint32_t)(synthetic_alignment + code_size);
+   optional_header.image_base = synthetic_image_base;
+   optional_header.section_alignment = synthetic_alignment;
+   optional_header.file_alignment = synthetic_alignment;
+   optional_header.major_operating_system_version = 4;
+   optional_header.major_subsystem_version = 4;
+   optional_header.size_of_image = (uint32_t)size;
+   optional_header.size_of_headers = synthetic_alignment;
+   optional_header.subsystem = 2;
+   optional_header.size_of_stack_reserve = 0x100000;
+   optional_header.size_of_stack_commit = 0x1000;
+   optional_header.size_of_heap_reserve = 0x100000;
+   optional_header.size_of_heap_commit = 0x1000;
+   optional_header.number_of_rva_and_sizes = pe_number_of_directory_entries;
+
+   size_t offset = synthetic_header_offset;
+
+   memcpy(data + offset, &signature, sizeof(signature));
+   offset += sizeof(signature);
+   memcpy(data + offset, &file_header, sizeof(file_header));
+   offset += sizeof(file_header);
+   memcpy(data + offset, &optional_header, sizeof(optional_header));
+   offset += sizeof(optional_header);
+
+   // The code section first, the rest split evenly with the last taking what's left over.
+   const size_t data_size = size - synthetic_alignment - code_size;
+   const size_t data_section_size =
+      section_count > 1 ? data_size / (section_count - 1) / synthetic_alignment * synthetic_alignment
+                        : 0;
+   size_t section_offset = synthetic_alignment;
+
+   for (uint32_t i = 0; i < section_count; ++i) {
+      pe_section_header section = {};
+
+      if (i == 0) {
+         memcpy(section.name, ".text", 5);
+
+         section.virtual_size = (uint32_t)code_size;
+         section.characteristics = pe_scn_cnt_code | pe_scn_mem_execute | pe_scn_mem_read;
+      }
+      else {
+         char name[pe_sizeof_short_name + 1] = {};
+
+         snprintf(name, sizeof(name), ".data%u", i);
+
+         memcpy(section.name, name, pe_sizeof_short_name);
+
+         section.virtual_size = (uint32_t)(i + 1 == section_count ? size - section_offset
+                                                                  : data_section_size);
+         section.characteristics =
+            pe_scn_cnt_initialized_data | pe_scn_mem_read | pe_scn_mem_write;
+      }
+
+      section.virtual_address = (uint32_t)section_offset;
+      section.size_of_raw_data = section.virtual_size;
+      section.pointer_to_raw_data = section.virtual_address;
+
+      memcpy(data + offset, &section, sizeof(section));
+
+      offset += sizeof(section);
+      section_offset += section.virtual_size;
+   }
+}
+
+bool generate_synthetic_pe(const synthetic_pe_options& options, const char* file_path,
+                           slim_vector<patch>& patches) noexcept
+{
+   patches.clear();
+
+   const exe_patch_list& list = synthetic_list();
+   slim_vector<byte_range> sites;
+
+   const auto add_site = [&](patch_address address, size_t size) {
+      sites.push_back({synthetic_offset(address), size});
+   };
+
+   for (const patch_set& set : list.patches) {
+      for (const patch& patch : set.patches) add_site(patch.address, sizeof(uint32_t));
+      for (const code_patch& patch : set.code_patches) add_site(patch.address, patch.length());
+      for (const trampoline& patch : set.trampolines) add_site(patch.address, patch.length());
+   }
+
+   add_site({list.id_address}, sizeof(list.expected_id));
+
+   size_t sites_end = 0;
+
+   for (const byte_range& site : sites) {
+      if (site.offset + site.size > sites_end) sites_end = site.offset + site.size;
+   }
+
+   // The headers have to leave room for the two section headers prepare adds.
+   const uint32_t section_count =
+      options.section_count == 0
+         ? 1
+         : (options.section_count < max_synthetic_sections ? options.section_count
+                                                           : max_synthetic_sections);
+   const size_t size =
+      align_up(options.size > sites_end ? options.size : sites_end, synthetic_alignment);
+   const size_t code_size =
+      section_count > 1
+         ? (size - synthetic_alignment) / 100 * synthetic_code_share / synthetic_alignment *
+              synthetic_alignment
+         : size - synthetic_alignment;
+
+   slim_vector<uint8_t> image;
+
+   image.resize(size);
+
+   memset(image.data(), 0, synthetic_alignment);
+
+   uint32_t state = options.seed ? options.seed : 1;
+
+   for (size_t i = synthetic_alignment; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t)) {
+      const uint32_t value = next_random(state);
+
+      memcpy(image.data() + i, &value, sizeof(value));
+   }
+
+   write_headers(image.data(), size, section_count, code_size);
+
+   for (const patch_set& set : list.patches) {
+      for (const patch& patch : set.patches) {
+         memcpy(image.data() + synthetic_offset(patch.address), &patch.expected_value,
+                sizeof(uint32_t));
+      }
+
+      for (const code_patch& patch : set.code_patches) {
+         memcpy(image.data() + synthetic_offset(patch.address), patch.expected.data(),
+                patch.length());
+      }
+
+      for (const trampoline& patch : set.trampolines) {
+         memcpy(image.data() + synthetic_offset(patch.address), patch.expected.data(),
+                patch.length());
+      }
+   }
+
+   memcpy(image.data() + synthetic_offset({list.id_address}), &list.expected_id,
+          sizeof(list.expected_id));
+
+   // Spread the extra patches evenly through the code, stepping over the list's sites.
+   const size_t patch_count = (size_t)((uint64_t)code_size * options.patch_density / bench_megabyte);
+   const size_t stride = patch_count ? code_size / patch_count / sizeof(uint32_t) * sizeof(uint32_t)
+                                     : 0;
+
+   for (size_t i = 0; i < patch_count and stride != 0; ++i) {
+      const size_t offset = synthetic_alignment + i * stride;
+      bool overlaps = false;
+
+      for (const byte_range& site : sites) {
+         if (offset < site.offset + site.size and site.offset < offset + sizeof(uint32_t)) {
+            overlaps = true;
+         }
+      }
+
+      if (overlaps) continue;
+
+      patch patch;
+
+      memcpy(&patch.expected_value, image.data() + offset, sizeof(uint32_t));
+
+      patch.address = patch_address{(uint32_t)offset};
+      patch.replacement_value = ~patch.expected_value;
+
+      patches.push_back(patch);
+   }
+
+   FILE* file = nullptr;
+
+#ifdef _WIN32
+   if (fopen_s(&file, file_path, "wb") != 0) file = nullptr;
+#else
+   file = fopen(file_path, "wb");
+#endif
+
+   if (not file) return false;
+
+   const bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+
+   if (fclose(file) != 0 or not written) return false;
+
+   if (not options.ext_section) return true;
+
+   bool enabled[PATCH_COUNT];
+
+   for (bool& set_enabled : enabled) set_enabled = true;
+
+   const capacity_values capacities;
+   es_layout layout;
+   exe_patcher editor;
+
+   if (not plan_es_layout(list, enabled, capacities, layout)) return false;
+   if (not editor.load(file_path, load_mode::buffered)) return false;
+   if (not editor.prepare(layout, code_cave_size(list, enabled))) return false;
+
+   return editor.save(file_path);
+}
+
+/// @brief The samples of one timed step.
+struct bench_result {
+   const char* name = "";
+   slim_vector<double> milliseconds;
+   /// @brief The bytes one sample processes, for throughput. 0 if it isn't meaningful.
+   uint64_t bytes = 0;
+   /// @brief The items one sample processes, for the time per item.
+   uint64_t items = 1;
+};
+
+using bench_clock = std::chrono::steady_clock;
+
+static auto elapsed_milliseconds(bench_clock::time_point start) noexcept -> double
+{
+   return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static int print_nothing(const char*, ...)
+{
+   return 0;
+}
+
+static auto compare_doubles(const void* left, const void* right) -> int
+{
+   const double left_value = *static_cast<const double*>(left);
+   const double right_value = *static_cast<const double*>(right);
+
+   return (left_value > right_value) - (left_value < right_value);
+}
+
+static void print_result(const bench_result& result, bool json,
+                         int (*print)(const char* format, ...)) noexcept
+{
+   slim_vector<double> sorted = result.milliseconds;
+
+   if (sorted.size() == 0) return;
+
+   qsort(sorted.data(), sorted.size(), sizeof(double), compare_doubles);
+
+   double total = 0.0;
+
+   for (const double sample : sorted) total += sample;
+
+   // An even count has no middle sample, the two either side of it are averaged.
+   const size_t middle = sorted.size() / 2;
+   const double median =
+      sorted.size() % 2 != 0 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2.0;
+   const double mean = total / (double)sorted.size();
+   const double megabytes_per_second =
+      median > 0.0 ? (double)result.bytes / (double)bench_megabyte / (median / 1000.0) : 0.0;
+   const double microseconds_per_item = median * 1000.0 / (double)result.items;
+
+   if (json) {
+      print("{\"step\":");
+      print_json_string(print, result.name);
+      print(",\"samples\":%zu,\"min_ms\":%.4f,\"median_ms\":%.4f,\"mean_ms\":%.4f,"
+            "\"max_ms\":%.4f,\"items\":%llu,\"us_per_item\":%.4f,\"bytes\":%llu,"
+            "\"mb_per_s\":%.2f}\r\n",
+            sorted.size(), sorted[0], median, mean, sorted[sorted.size() - 1],
+            (unsigned long long)result.items, microseconds_per_item,
+            (unsigned long long)result.bytes, megabytes_per_second);
+
+      return;
+   }
+
+   print("  %-22s %10.3f %10.3f %10.3f", result.name, sorted[0], median, mean);
+
+   if (result.items > 1) print(" %10.3f us/item", microseconds_per_item);
+   if (result.bytes != 0) print(" %10.1f MB/s", megabytes_per_second);
+
+   print("\r\n");
+}
+
+static void make_path(char (&out)[1024], const char* directory, const char* name,
+                      uint32_t index = UINT32_MAX) noexcept
+{
+   if (index == UINT32_MAX) {
+      snprintf(out, sizeof(out), "%s/bf2memext_bench_%s.exe", directory, name);
+   }
+   else {
+      snprintf(out, sizeof(out), "%s/bf2memext_bench_%s_%u.exe", directory, name, index);
+   }
+}
+
+/// @brief Time load in a mode.
+static bool bench_load(const char* path, load_mode mode, uint32_t iterations,
+                       bench_result& result) noexcept
+{
+   for (uint32_t i = 0; i < iterations; ++i) {
+      exe_patcher editor;
+      const auto start = bench_clock::now();
+
+      if (not editor.load(path, mode)) return false;
+
+      result.milliseconds.push_back(elapsed_milliseconds(start));
+   }
+
+   return true;
+}
+
+bool run_bench(const bench_options& options, int (*print)(const char* format, ...)) noexcept
+{
+   const exe_patch_list& list = synthetic_list();
+   slim_vector<patch> patches;
+   char base_path[1024];
+   char work_path[1024];
+   char saved_path[1024];
+
+   make_path(base_path, options.directory, "base");
+   make_path(work_path, options.directory, "work");
+   make_path(saved_path, options.directory, "saved");
+
+   if (not generate_synthetic_pe(options.image, base_path, patches)) {
+      print("Failed to write a synthetic executable to %s.\r\n", base_path);
+
+      return false;
+   }
+
+   const uint32_t iterations = options.iterations ? options.iterations : 1;
+   file_identity identity;
+
+   (void)get_file_identity(base_path, identity);
+
+   bool enabled[PATCH_COUNT];
+
+   for (bool& set_enabled : enabled) set_enabled = true;
+
+   const capacity_values capacities;
+   es_layout layout;
+
+   (void)plan_es_layout(list, enabled, capacities, layout);
+
+   const uint64_t size = identity.size;
+   const uint32_t batch_files = options.batch_files ? options.batch_files : 1;
+   const uint64_t patch_count = patches.size() ? patches.size() : 1;
+
+   bench_result results[] = {
+      {"load_buffered", {}, size, 1},
+      {"load_mapped", {}, size, 1},
+      {"load_streamed", {}, size, 1},
+      {"compatible", {}, 0, compatible_calls},
+      {"prepare", {}, 0, 1},
+      {"apply_patch", {}, 0, patch_count},
+      {"save_mapped", {}, size, 1},
+      {"save_streamed", {}, size, 1},
+      {"apply", {}, size, 1},
+      {"apply_stream", {}, size, 1},
+      {"batch_1", {}, size * batch_files, batch_files},
+      {"batch", {}, size * batch_files, batch_files},
+   };
+   bool succeeded = true;
+
+   succeeded = succeeded and bench_load(base_path, load_mode::buffered, iterations, results[0]);
+   succeeded = succeeded and bench_load(base_path, load_mode::mapped, iterations, results[1]);
+   succeeded = succeeded and bench_load(base_path, load_mode::streamed, iterations, results[2]);
+
+   for (uint32_t i = 0; succeeded and i < iterations; ++i) {
+      exe_patcher editor;
+      bool compatible = true;
+
+      if (not editor.load(base_path, load_mode::mapped)) {
+         succeeded = false;
+
+         break;
+      }
+
+      const auto start = bench_clock::now();
+
+      for (uint32_t call = 0; call < compatible_calls; ++call) {
+         compatible = editor.compatible(list.id_address, list.expected_id) and compatible;
+      }
+
+      results[3].milliseconds.push_back(elapsed_milliseconds(start));
+
+      succeeded = compatible;
+   }
+
+   for (uint32_t i = 0; succeeded and i < iterations; ++i) {
+      exe_patcher editor;
+
+      if (not editor.load(base_path, load_mode::mapped)) {
+         succeeded = false;
+
+         break;
+      }
+
+      const auto start = bench_clock::now();
+
+      succeeded = editor.prepare(layout, code_cave_size(list, enabled));
+
+      results[4].milliseconds.push_back(elapsed_milliseconds(start));
+   }
+
+   // Apply the extra patches one at a time then save, the save writing only what they dirtied.
+   for (uint32_t i = 0; succeeded and i < iterations * 2; ++i) {
+      const bool streamed = i % 2 != 0;
+      exe_patcher editor;
+
+      if (not editor.load(base_path, streamed ? load_mode::streamed : load_mode::mapped)) {
+         succeeded = false;
+
+         break;
+      }
+
+      auto start = bench_clock::now();
+
+      for (const patch& patch : patches) succeeded = editor.apply(patch) and succeeded;
+
+      if (not streamed) results[5].milliseconds.push_back(elapsed_milliseconds(start));
+
+      start = bench_clock::now();
+
+      succeeded = editor.save(saved_path) and succeeded;
+
+      results[streamed ? 7 : 6].milliseconds.push_back(elapsed_milliseconds(start));
+   }
+
+   for (uint32_t i = 0; succeeded and i < iterations * 2; ++i) {
+      apply_options apply_options;
+
+      apply_options.streamed = i % 2 != 0;
+
+      if (not clone_file(base_path, work_path)) {
+         succeeded = false;
+
+         break;
+      }
+
+      const auto start = bench_clock::now();
+
+      succeeded = apply(work_path, print_nothing, apply_options);
+
+      results[apply_options.streamed ? 9 : 8].milliseconds.push_back(elapsed_milliseconds(start));
+   }
+
+   // Batches patch fresh copies, the copying isn't timed.
+   slim_vector<char*> batch_paths;
+
+   for (uint32_t i = 0; i < batch_files; ++i) {
+      char path[1024];
+
+      make_path(path, options.directory, "batch", i);
+
+      batch_paths.push_back(duplicate_string(path));
+   }
+
+   for (uint32_t i = 0; succeeded and i < iterations * 2; ++i) {
+      batch_options batch_options;
+
+      batch_options.jobs = i % 2 == 0 ? 1 : options.jobs;
+
+      for (const char* path : batch_paths) {
+         succeeded = path and clone_file(base_path, path) and succeeded;
+      }
+
+      if (not succeeded) break;
+
+      const auto start = bench_clock::now();
+
+      succeeded = run_batch(batch_paths.data(), batch_paths.size(), batch_options,
+                            print_nothing) == BATCH_ALL_PATCHED;
+
+      results[i % 2 == 0 ? 10 : 11].milliseconds.push_back(elapsed_milliseconds(start));
+   }
+
+   for (char* path : batch_paths) {
+      if (path) remove(path);
+
+      free(path);
+   }
+
+   remove(base_path);
+   remove(work_path);
+   remove(saved_path);
+
+   if (options.json) {
+      print("{\"image_bytes\":%llu,\"sections\":%u,\"extra_patches\":%zu,\"ext_section\":%s,"
+            "\"iterations\":%u,\"batch_files\":%u,\"jobs\":%u}\r\n",
+            (unsigned long long)identity.size, options.image.section_count, patches.size(),
+            options.image.ext_section ? "true" : "false", iterations, batch_files, options.jobs);
+   }
+   else {
+      print("%.1f MB image, %u sections, %zu extra patches%s, %u iterations.\r\n",
+            (double)identity.size / (double)bench_megabyte, options.image.section_count,
+            patches.size(), options.image.ext_section ? ", extension section" : "", iterations);
+      print("  %-22s %10s %10s %10s\r\n", "Step", "Min ms", "Median ms", "Mean ms");
+   }
+
+   for (const bench_result& result : results) print_result(result, options.json, print);
+
+   if (not succeeded) print("A step failed, its results are incomplete.\r\n");
+
+   return succeeded;
+}
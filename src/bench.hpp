@@ -0,0 +1,48 @@
+#pragma once
+
+#include "patch_table.hpp"
+#include "slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief The shape of a synthetic executable. Every site of the first patch list is filled with
+/// its expected bytes and its build id is written, so the image is identified as that build.
+struct synthetic_pe_options {
+   /// @brief The size of the file. Raised to what the patch list's sites need.
+   size_t size = 0;
+   /// @brief The first section is code and takes most of the image, the others split the rest.
+   uint32_t section_count = 3;
+   /// @brief Extra dword patches per MB of code, applied one at a time to time apply on its own.
+   uint32_t patch_density = 256;
+   /// @brief Prepare and save the image once after generating it, so it already carries the
+   /// extension section and the code cave section.
+   bool ext_section = false;
+   uint32_t seed = 1;
+};
+
+/// @brief Write a synthetic executable.
+/// @param patches Filled with the extra patches, none of which overlap a site of the list.
+/// @return False if the file couldn't be written or prepared.
+[[nodiscard]] bool generate_synthetic_pe(const synthetic_pe_options& options, const char* file_path,
+                                         slim_vector<patch>& patches) noexcept;
+
+struct bench_options {
+   synthetic_pe_options image;
+   /// @brief How many times each step is timed.
+   uint32_t iterations = 5;
+   /// @brief The number of threads for the batch step, 0 for one per hardware thread.
+   uint32_t jobs = 0;
+   /// @brief The number of copies patched by the batch step.
+   uint32_t batch_files = 16;
+   /// @brief Where the synthetic executables are written. They're deleted afterwards.
+   const char* directory = ".";
+   /// @brief Print a JSON object per line instead of a table.
+   bool json = false;
+};
+
+/// @brief Time each step of patching on a synthetic executable: load in each mode, compatible,
+/// prepare, apply per patch, save, the whole of apply and a batch on one thread and on many.
+/// @return False if the synthetic executable couldn't be made or a step failed.
+[[nodiscard]] bool run_bench(const bench_options& options,
+                             int (*print)(const char* format, ...)) noexcept;
@@ -0,0 +1,85 @@
+#include "budget.hpp"
+#include "es_layout.hpp"
+
+/// @brief Check if any enabled set derives a patch value from a capacity.
+static bool capacity_patched(const exe_patch_list& list, const bool (&enabled)[PATCH_COUNT],
+                             capacity_id id) noexcept
+{
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      if (not enabled[i]) continue;
+
+      for (const patch& patch : list.patches[i].patches) {
+         if (patch.formula.capacity == id) return true;
+      }
+   }
+
+   return false;
+}
+
+bool compute_budget(const exe_patcher& editor, const exe_patch_list& list,
+                    const bool (&enabled)[PATCH_COUNT], const capacity_values& capacities,
+                    bool large_address_aware, address_budget& out) noexcept
+{
+   out = {};
+
+   const pe_optional_header32 optional_header = editor.image().optional_header();
+   es_layout layout;
+
+   if (not plan_es_layout(list, enabled, capacities, layout)) return false;
+
+   const uint64_t alignment = optional_header.section_alignment ? optional_header.section_alignment
+                                                                : es_page_size;
+
+   const auto aligned = [&](uint64_t size) { return (size + alignment - 1) / alignment * alignment; };
+
+   out.items.push_back({"Image", editor.base_image_size()});
+   out.items.push_back({"Extension section", aligned(layout.size)});
+
+   if (const uint32_t cave_size = code_cave_size(list, enabled); cave_size != 0) {
+      out.items.push_back({"Code cave section", aligned(cave_size)});
+   }
+
+   for (uint32_t i = 1; i < capacity_id_count; ++i) {
+      const capacity& capacity = known_capacities[i];
+
+      if (not capacity.heap) continue;
+
+      const bool patched = capacity_patched(list, enabled, (capacity_id)i);
+
+      out.items.push_back({capacity.name, patched ? capacities.values[i] : capacity.min, not patched});
+   }
+
+   out.items.push_back({"Stack reserve", optional_header.size_of_stack_reserve});
+   out.items.push_back({"Process heap reserve", optional_header.size_of_heap_reserve});
+
+   for (const budget_item& item : out.items) out.total += item.size;
+
+   out.large_address_aware = large_address_aware or editor.large_address_aware();
+   out.ceiling = out.large_address_aware ? large_user_address_space : user_address_space;
+
+   return true;
+}
+
+static auto megabytes(uint64_t size) noexcept -> double
+{
+   return (double)size / (1024.0 * 1024.0);
+}
+
+void print_budget(const address_budget& budget, int (*print)(const char* format, ...)) noexcept
+{
+   for (const budget_item& item : budget.items) {
+      print("  %-22s %8.1f MB%s\r\n", item.name, megabytes(item.size), item.stock ? " (stock)" : "");
+   }
+
+   print("  %-22s %8.1f MB of %.0f MB%s\r\n", "Total", megabytes(budget.total),
+         megabytes(budget.ceiling), budget.large_address_aware ? " (large address aware)" : "");
+
+   if (budget.fits()) {
+      print("  %-22s %8.1f MB for DLLs, thread stacks and everything the game allocates later.\r\n",
+            "Headroom", megabytes(budget.ceiling - budget.total));
+   }
+   else {
+      print("  Over budget by %.1f MB, the game can't reserve everything it needs at startup.\r\n",
+            megabytes(budget.total - budget.ceiling));
+   }
+}
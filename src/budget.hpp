@@ -0,0 +1,47 @@
+#pragma once
+
+#include "capacities.hpp"
+#include "exe_patcher.hpp"
+#include "patch_table.hpp"
+#include "slim_vector.hpp"
+
+#include <stdint.h>
+
+/// @brief The user address space of a 32-bit process, and of one marked large address aware
+/// running on 64-bit Windows.
+constexpr uint64_t user_address_space = 0x80000000;
+constexpr uint64_t large_user_address_space = 0x100000000;
+
+struct budget_item {
+   const char* name = "";
+   uint64_t size = 0;
+   /// @brief The size is the stock game's, no applied set patches it.
+   bool stock = false;
+};
+
+/// @brief The address space a configuration reserves as soon as the game starts, against the
+/// ceiling the executable gets.
+struct address_budget {
+   slim_vector<budget_item> items;
+   uint64_t total = 0;
+   uint64_t ceiling = 0;
+   bool large_address_aware = false;
+
+   [[nodiscard]] bool fits() const noexcept
+   {
+      return total <= ceiling;
+   }
+};
+
+/// @brief Add up the image, the extension section laid out for the enabled sets and the heaps
+/// reserved at startup. Heaps no enabled set patches are counted at their stock sizes.
+/// @param large_address_aware If the executable will be marked large address aware, it's also
+/// counted as such if it already is.
+/// @return False if the extension section couldn't be laid out.
+[[nodiscard]] bool compute_budget(const exe_patcher& editor, const exe_patch_list& list,
+                                  const bool (&enabled)[PATCH_COUNT],
+                                  const capacity_values& capacities, bool large_address_aware,
+                                  address_budget& out) noexcept;
+
+/// @brief Print each item of a budget, the total and the headroom left under the ceiling.
+void print_budget(const address_budget& budget, int (*print)(const char* format, ...)) noexcept;
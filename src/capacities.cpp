@@ -0,0 +1,237 @@
+#include "capacities.hpp"
+#include "slim_vector.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+capacity_values::capacity_values() noexcept
+{
+   for (uint32_t i = 0; i < capacity_id_count; ++i) values[i] = known_capacities[i].default_value;
+}
+
+auto find_capacity(const char* name) noexcept -> capacity_id
+{
+   for (uint32_t i = 1; i < capacity_id_count; ++i) {
+      if (strcmp(known_capacities[i].name, name) == 0) return (capacity_id)i;
+   }
+
+   return capacity_id::none;
+}
+
+static bool is_blank(char c) noexcept
+{
+   return c == ' ' or c == '\t' or c == '\r';
+}
+
+bool set_capacity(capacity_values& values, const char* assignment,
+                  int (*print)(const char* format, ...)) noexcept
+{
+   const char* equals = strchr(assignment, '=');
+
+   if (not equals) {
+      print("Expected name=value, got %s.\r\n", assignment);
+
+      return false;
+   }
+
+   const char* name_begin = assignment;
+   const char* name_end = equals;
+
+   while (name_begin < name_end and is_blank(*name_begin)) ++name_begin;
+   while (name_end > name_begin and is_blank(name_end[-1])) --name_end;
+
+   char name[64] = {};
+
+   if ((size_t)(name_end - name_begin) >= sizeof(name)) {
+      print("Unknown capacity in %s.\r\n", assignment);
+
+      return false;
+   }
+
+   memcpy(name, name_begin, (size_t)(name_end - name_begin));
+
+   const capacity_id id = find_capacity(name);
+
+   if (id == capacity_id::none) {
+      print("Unknown capacity %s. Run /capacities to list them.\r\n", name);
+
+      return false;
+   }
+
+   const char* value_begin = equals + 1;
+
+   while (is_blank(*value_begin)) ++value_begin;
+
+   char* value_end = nullptr;
+   const unsigned long long value = strtoull(value_begin, &value_end, 0);
+
+   while (value_end and is_blank(*value_end)) ++value_end;
+
+   if (value_end == value_begin or not value_end or *value_end != '\0') {
+      print("Expected a number for %s, got %s.\r\n", name, value_begin);
+
+      return false;
+   }
+
+   const capacity& capacity = known_capacities[(uint32_t)id];
+
+   if (value < capacity.min or value > capacity.max) {
+      print("%s must be between %u and %u, got %llu.\r\n", name, capacity.min, capacity.max, value);
+
+      return false;
+   }
+
+   values.values[(uint32_t)id] = (uint32_t)value;
+
+   return true;
+}
+
+bool load_capacity_profile(capacity_values& values, const char* path,
+                           int (*print)(const char* format, ...)) noexcept
+{
+   FILE* file = nullptr;
+
+#ifdef _WIN32
+   if (fopen_s(&file, path, "rb") != 0) file = nullptr;
+#else
+   file = fopen(path, "rb");
+#endif
+
+   if (not file) {
+      print("Failed to open profile %s.\r\n", path);
+
+      return false;
+   }
+
+   bool result = true;
+   slim_vector<char> line;
+   uint32_t line_number = 1;
+
+   for (int c = fgetc(file);; c = fgetc(file)) {
+      if (c != EOF and c != '\n') {
+         line.push_back((char)c);
+
+         continue;
+      }
+
+      size_t begin = 0;
+
+      line.push_back('\0');
+
+      while (is_blank(line[begin])) ++begin;
+
+      if (line[begin] != '\0' and line[begin] != '#' and
+          not set_capacity(values, line.data() + begin, print)) {
+         print("  in %s on line %u.\r\n", path, line_number);
+
+         result = false;
+      }
+
+      line.clear();
+      line_number += 1;
+
+      if (c == EOF) break;
+   }
+
+   fclose(file);
+
+   return result;
+}
+
+bool patch_value(const patch& patch, const capacity_values& values, uint32_t& out) noexcept
+{
+   if (patch.formula.capacity == capacity_id::none) {
+      out = patch.replacement_value;
+
+      return true;
+   }
+
+   return evaluate_formula(patch.formula, patch.expected_value, values[patch.formula.capacity],
+                           out);
+}
+
+bool region_size(const es_region& region, const capacity_values& values, uint32_t& out) noexcept
+{
+   const uint64_t count = region.capacity == capacity_id::none ? 1 : values[region.capacity];
+   const uint64_t size = region.size * count;
+
+   if (size > UINT32_MAX) return false;
+
+   out = (uint32_t)size;
+
+   return true;
+}
+
+/// @brief The largest capacity a formula can take without overflowing its encoding.
+static auto largest_fitting(const value_formula& formula) noexcept -> uint64_t
+{
+   const uint64_t limit = formula.encoding == value_encoding::imm8 ? INT8_MAX : INT32_MAX;
+
+   if (formula.offset > limit) return 0;
+
+   return (limit - formula.offset) / formula.scale;
+}
+
+bool check_capacities(const exe_patch_list& list, const bool (&enabled)[PATCH_COUNT],
+                      const capacity_values& values,
+                      int (*print)(const char* format, ...)) noexcept
+{
+   bool result = true;
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      if (not enabled[i]) continue;
+
+      const patch_set& set = list.patches[i];
+
+      for (const patch& patch : set.patches) {
+         const value_formula& formula = patch.formula;
+         uint32_t value = 0;
+
+         if (formula.capacity != capacity_id::none and not patch_value(patch, values, value)) {
+            print("%s = %u doesn't fit the %s at 0x%x in %s, it can be at most %llu.\r\n",
+                  known_capacities[(uint32_t)formula.capacity].name, values[formula.capacity],
+                  formula.encoding == value_encoding::imm8 ? "8-bit immediate" : "32-bit immediate",
+                  patch.address.value, set.name, (unsigned long long)largest_fitting(formula));
+
+            result = false;
+         }
+
+         if (patch.region == es_region_id::none) continue;
+
+         for (const es_region& region : set.regions) {
+            if (region.id != patch.region or region.capacity == capacity_id::none) continue;
+
+            uint32_t size = 0;
+
+            if (not region_size(region, values, size)) {
+               print("%s = %u makes the %s region larger than 4 GiB.\r\n",
+                     known_capacities[(uint32_t)region.capacity].name, values[region.capacity],
+                     region.name);
+
+               result = false;
+            }
+            else if ((uint64_t)patch.replacement_value + sizeof(uint32_t) > size) {
+               print("%s = %u is too small, the patch at 0x%x in %s points 0x%x bytes into the "
+                     "%s region.\r\n",
+                     known_capacities[(uint32_t)region.capacity].name, values[region.capacity],
+                     patch.address.value, set.name, patch.replacement_value, region.name);
+
+               result = false;
+            }
+         }
+      }
+   }
+
+   return result;
+}
+
+void print_capacities(const capacity_values& values, int (*print)(const char* format, ...)) noexcept
+{
+   for (uint32_t i = 1; i < capacity_id_count; ++i) {
+      const capacity& capacity = known_capacities[i];
+
+      print("%-20s %10u  (%u to %u, default %u) %s\r\n", capacity.name, values.values[i],
+            capacity.min, capacity.max, capacity.default_value, capacity.description);
+   }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "patch_table.hpp"
+
+#include <stdint.h>
+
+/// @brief The value chosen for every capacity. Starts out with the defaults.
+struct capacity_values {
+   uint32_t values[capacity_id_count] = {};
+
+   capacity_values() noexcept;
+
+   [[nodiscard]] auto operator[](capacity_id id) const noexcept -> uint32_t
+   {
+      return values[(uint32_t)id];
+   }
+};
+
+/// @brief Find a capacity by name.
+/// @return The capacity, or none if there's no capacity with the name.
+[[nodiscard]] auto find_capacity(const char* name) noexcept -> capacity_id;
+
+/// @brief Set a capacity from an assignment of the form name=value. The value may be decimal or
+/// hexadecimal with a 0x prefix and must be within the capacity's range.
+/// @return False if the assignment isn't valid, after printing why.
+[[nodiscard]] bool set_capacity(capacity_values& values, const char* assignment,
+                                int (*print)(const char* format, ...)) noexcept;
+
+/// @brief Set capacities from a profile, a file with one name = value assignment per line.
+/// Blank lines and lines starting with # are ignored.
+/// @return False if the file couldn't be read or any line isn't valid, after printing why.
+[[nodiscard]] bool load_capacity_profile(capacity_values& values, const char* path,
+                                         int (*print)(const char* format, ...)) noexcept;
+
+/// @brief Get the value a patch writes for the chosen capacities. For patches pointing into the
+/// extension section it's still the offset into their region.
+/// @return False if the value doesn't fit the patch's encoding.
+[[nodiscard]] bool patch_value(const patch& patch, const capacity_values& values,
+                               uint32_t& out) noexcept;
+
+/// @brief Get the size of a region for the chosen capacities.
+/// @return False if the size doesn't fit in 32 bits.
+[[nodiscard]] bool region_size(const es_region& region, const capacity_values& values,
+                               uint32_t& out) noexcept;
+
+/// @brief Check that every value a list's enabled sets derive from the capacities fits its
+/// encoding and that every offset into a region sized by a capacity is still inside it.
+/// @return False if anything doesn't fit, after printing each site that doesn't.
+[[nodiscard]] bool check_capacities(const exe_patch_list& list, const bool (&enabled)[PATCH_COUNT],
+                                    const capacity_values& values,
+                                    int (*print)(const char* format, ...)) noexcept;
+
+/// @brief Print every capacity with its chosen value, range and description.
+void print_capacities(const capacity_values& values, int (*print)(const char* format, ...)) noexcept;
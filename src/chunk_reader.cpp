@@ -0,0 +1,110 @@
+#ifdef _MSC_VER
+#pragma warning(disable : 4530)
+#endif
+
+#include "chunk_reader.hpp"
+
+chunk_reader::chunk_reader(FILE* file, size_t size) noexcept : _file{file}, _size{size}
+{
+   for (buffer& buffer : _buffers) buffer.data = new uint8_t[stream_chunk_size];
+
+   _thread = std::thread{&chunk_reader::read_all, this};
+}
+
+chunk_reader::~chunk_reader()
+{
+   {
+      std::lock_guard lock{_mutex};
+
+      _stopping = true;
+   }
+
+   _changed.notify_all();
+   _thread.join();
+
+   for (buffer& buffer : _buffers) delete[] buffer.data;
+}
+
+bool chunk_reader::next(file_chunk& out) noexcept
+{
+   buffer& buffer = _buffers[_next_buffer];
+
+   std::unique_lock lock{_mutex};
+
+   _changed.wait(lock, [&] { return buffer.full or _done; });
+
+   // The reader fills the buffers in turn, so if this one isn't full nothing else is coming.
+   if (not buffer.full) return false;
+
+   out = {buffer.data, buffer.offset, buffer.size};
+
+   return true;
+}
+
+void chunk_reader::release() noexcept
+{
+   {
+      std::lock_guard lock{_mutex};
+
+      _buffers[_next_buffer].full = false;
+   }
+
+   _next_buffer = (_next_buffer + 1) % 2;
+
+   _changed.notify_all();
+}
+
+bool chunk_reader::failed() noexcept
+{
+   std::lock_guard lock{_mutex};
+
+   return _failed;
+}
+
+void chunk_reader::read_all() noexcept
+{
+   size_t offset = 0;
+   bool failed = false;
+
+   for (uint32_t index = 0; offset < _size; index = (index + 1) % 2) {
+      buffer& buffer = _buffers[index];
+
+      {
+         std::unique_lock lock{_mutex};
+
+         _changed.wait(lock, [&] { return not buffer.full or _stopping; });
+
+         if (_stopping) break;
+      }
+
+      // The buffer belongs to this thread until it's marked full.
+      const size_t size = _size - offset < stream_chunk_size ? _size - offset : stream_chunk_size;
+
+      if (fread(buffer.data, sizeof(uint8_t), size, _file) != size) {
+         failed = true;
+
+         break;
+      }
+
+      {
+         std::lock_guard lock{_mutex};
+
+         buffer.offset = offset;
+         buffer.size = size;
+         buffer.full = true;
+      }
+
+      _changed.notify_all();
+
+      offset += size;
+   }
+
+   {
+      std::lock_guard lock{_mutex};
+
+      _done = true;
+      _failed = failed;
+   }
+
+   _changed.notify_all();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4530)
+#endif
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// @brief The size of each of a chunk_reader's buffers.
+constexpr size_t stream_chunk_size = 1024 * 1024;
+
+/// @brief A chunk of a file, valid until it is handed back to the reader.
+struct file_chunk {
+   uint8_t* data = nullptr;
+   size_t offset = 0;
+   size_t size = 0;
+};
+
+/// @brief Reads a file front to back in fixed-size chunks on a background thread. There are two
+/// buffers, so the next chunk is read while the caller works on the current one and peak memory
+/// stays at two chunks however large the file is.
+struct chunk_reader {
+   /// @brief Start reading.
+   /// @param file The file, read from its start. Must stay open until the reader is destroyed.
+   /// @param size The number of bytes to read.
+   chunk_reader(FILE* file, size_t size) noexcept;
+
+   /// @brief Stop reading and wait for the background thread, even if chunks are left.
+   ~chunk_reader();
+
+   chunk_reader(const chunk_reader&) = delete;
+   auto operator=(const chunk_reader&) -> chunk_reader& = delete;
+
+   /// @brief Wait for the next chunk. The previous chunk must have been handed back with release.
+   /// @return False once the whole file has been read or if reading failed, see failed().
+   [[nodiscard]] bool next(file_chunk& out) noexcept;
+
+   /// @brief Hand the chunk returned by the last call to next back to be refilled.
+   void release() noexcept;
+
+   /// @brief Check if a read failed or the file ended early.
+   [[nodiscard]] bool failed() noexcept;
+
+private:
+   struct buffer {
+      uint8_t* data = nullptr;
+      size_t offset = 0;
+      size_t size = 0;
+      bool full = false;
+   };
+
+   FILE* _file = nullptr;
+   size_t _size = 0;
+
+   buffer _buffers[2];
+   uint32_t _next_buffer = 0;
+
+   std::mutex _mutex;
+   std::condition_variable _changed;
+   bool _done = false;
+   bool _failed = false;
+   bool _stopping = false;
+
+   std::thread _thread;
+
+   void read_all() noexcept;
+};
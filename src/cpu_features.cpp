@@ -0,0 +1,103 @@
+#include "cpu_features.hpp"
+
+#if BF2_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include <stdint.h>
+
+struct cpu_feature_flags {
+   bool avx2 = false;
+   bool sse42 = false;
+};
+
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t (&registers)[4]) noexcept
+{
+#ifdef _MSC_VER
+   int values[4] = {};
+
+   __cpuidex(values, (int)leaf, (int)subleaf);
+
+   for (int i = 0; i < 4; ++i) registers[i] = (uint32_t)values[i];
+#else
+   __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static auto read_xcr0() noexcept -> uint64_t
+{
+#ifdef _MSC_VER
+   return _xgetbv(0);
+#else
+   uint32_t eax = 0;
+   uint32_t edx = 0;
+
+   __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+   return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static auto detect_features() noexcept -> cpu_feature_flags
+{
+   cpu_feature_flags flags;
+   uint32_t registers[4] = {};
+
+   cpuid(0, 0, registers);
+
+   const uint32_t max_leaf = registers[0];
+
+   if (max_leaf < 1) return flags;
+
+   cpuid(1, 0, registers);
+
+   flags.sse42 = (registers[2] & (1u << 20)) != 0;
+
+   const bool osxsave = (registers[2] & (1u << 27)) != 0;
+   const bool avx = (registers[2] & (1u << 28)) != 0;
+
+   if (max_leaf < 7 or not osxsave or not avx) return flags;
+
+   // The OS must save the YMM registers for AVX to be usable.
+   if ((read_xcr0() & 0x6) != 0x6) return flags;
+
+   cpuid(7, 0, registers);
+
+   flags.avx2 = (registers[1] & (1u << 5)) != 0;
+
+   return flags;
+}
+
+static auto features() noexcept -> const cpu_feature_flags&
+{
+   static const cpu_feature_flags flags = detect_features();
+
+   return flags;
+}
+
+bool cpu_has_avx2() noexcept
+{
+   return features().avx2;
+}
+
+bool cpu_has_sse42() noexcept
+{
+   return features().sse42;
+}
+
+#else
+
+bool cpu_has_avx2() noexcept
+{
+   return false;
+}
+
+bool cpu_has_sse42() noexcept
+{
+   return false;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#if defined(_M_IX86) or defined(_M_X64) or defined(__i386__) or defined(__x86_64__)
+#define BF2_X86 1
+#else
+#define BF2_X86 0
+#endif
+
+// GCC and Clang need intrinsics to be enabled per function when the whole translation unit isn't
+// built for the instruction set, MSVC allows them everywhere.
+#if BF2_X86 and (defined(__GNUC__) or defined(__clang__))
+#define BF2_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BF2_TARGET(isa)
+#endif
+
+/// @brief Check if the CPU and OS support AVX2.
+[[nodiscard]] bool cpu_has_avx2() noexcept;
+
+/// @brief Check if the CPU supports SSE4.2 (and with it the CRC32 instruction).
+[[nodiscard]] bool cpu_has_sse42() noexcept;
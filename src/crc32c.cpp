@@ -0,0 +1,123 @@
+#include "crc32c.hpp"
+#include "cpu_features.hpp"
+
+#include <string.h>
+
+#if BF2_X86
+#include <immintrin.h>
+#endif
+
+// The reflected Castagnoli polynomial.
+constexpr uint32_t crc32c_polynomial = 0x82f63b78;
+
+struct crc32c_tables {
+   uint32_t entries[8][256] = {};
+};
+
+/// @brief Build the slicing-by-8 tables. entries[0] is the usual byte table, entries[n] advances
+/// a byte's contribution by n more bytes.
+consteval auto make_crc32c_tables() -> crc32c_tables
+{
+   crc32c_tables tables;
+
+   for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+
+      for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (crc & 1 ? crc32c_polynomial : 0);
+
+      tables.entries[0][i] = crc;
+   }
+
+   for (uint32_t i = 0; i < 256; ++i) {
+      for (int slice = 1; slice < 8; ++slice) {
+         const uint32_t previous = tables.entries[slice - 1][i];
+
+         tables.entries[slice][i] = (previous >> 8) ^ tables.entries[0][previous & 0xff];
+      }
+   }
+
+   return tables;
+}
+
+static constexpr crc32c_tables tables = make_crc32c_tables();
+
+static_assert(tables.entries[0][1] == 0xf26b8303, "CRC-32C table is wrong.");
+
+static auto crc32c_software(uint32_t crc, const uint8_t* data, size_t size) noexcept -> uint32_t
+{
+   const auto& t = tables.entries;
+
+   for (; size >= 8; data += 8, size -= 8) {
+      uint32_t low = 0;
+      uint32_t high = 0;
+
+      memcpy(&low, data, sizeof(low));
+      memcpy(&high, data + 4, sizeof(high));
+
+      low ^= crc;
+
+      crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^
+            t[4][low >> 24] ^ t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^
+            t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+   }
+
+   for (; size != 0; ++data, --size) crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+
+   return crc;
+}
+
+#if BF2_X86
+
+BF2_TARGET("sse4.2")
+static auto crc32c_sse42(uint32_t crc, const uint8_t* data, size_t size) noexcept -> uint32_t
+{
+#if defined(_M_X64) or defined(__x86_64__)
+   uint64_t wide_crc = crc;
+
+   for (; size >= 8; data += 8, size -= 8) {
+      uint64_t value = 0;
+
+      memcpy(&value, data, sizeof(value));
+
+      wide_crc = _mm_crc32_u64(wide_crc, value);
+   }
+
+   crc = (uint32_t)wide_crc;
+#else
+   for (; size >= 4; data += 4, size -= 4) {
+      uint32_t value = 0;
+
+      memcpy(&value, data, sizeof(value));
+
+      crc = _mm_crc32_u32(crc, value);
+   }
+#endif
+
+   for (; size != 0; ++data, --size) crc = _mm_crc32_u8(crc, *data);
+
+   return crc;
+}
+
+#endif
+
+auto crc32c(uint32_t crc, const void* data, size_t size) noexcept -> uint32_t
+{
+   const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+   crc = ~crc;
+
+#if BF2_X86
+   if (cpu_has_sse42()) return ~crc32c_sse42(crc, bytes, size);
+#endif
+
+   return ~crc32c_software(crc, bytes, size);
+}
+
+auto crc32c_zeros(uint32_t crc, size_t size) noexcept -> uint32_t
+{
+   static const uint8_t zeros[64] = {};
+
+   for (; size > sizeof(zeros); size -= sizeof(zeros)) crc = crc32c(crc, zeros, sizeof(zeros));
+
+   return crc32c(crc, zeros, size);
+}
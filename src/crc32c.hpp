@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Extend a CRC-32C (Castagnoli) checksum with more data. Uses the SSE4.2 CRC32
+/// instruction where the CPU has it and a slicing-by-8 table otherwise, both give the same result.
+/// @param crc The checksum of the data so far, 0 to start.
+/// @param data The data.
+/// @param size The size of the data.
+/// @return The checksum of the data so far followed by data.
+[[nodiscard]] auto crc32c(uint32_t crc, const void* data, size_t size) noexcept -> uint32_t;
+
+/// @brief Extend a CRC-32C checksum with size zero bytes.
+[[nodiscard]] auto crc32c_zeros(uint32_t crc, size_t size) noexcept -> uint32_t;
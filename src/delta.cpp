@@ -0,0 +1,507 @@
+#include "delta.hpp"
+#include "chunk_reader.hpp"
+#include "crc32c.hpp"
+#include "file_helpers.hpp"
+#include "slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The file is the header, then every run sorted by offset with its bytes right after it, so
+// applying it reads the delta front to back alongside the file. Past the end of the source file
+// the result is zeros apart from the runs.
+
+static const char delta_magic[8] = {'B', 'F', '2', 'D', 'E', 'L', 'T', 'A'};
+constexpr uint32_t delta_version = 1;
+
+struct delta_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t run_count;
+   uint64_t source_size;
+   uint64_t result_size;
+   /// @brief CRC-32C of the whole file the delta applies to.
+   uint32_t source_crc;
+   /// @brief CRC-32C of the whole result.
+   uint32_t result_crc;
+   /// @brief CRC-32C of everything after the header.
+   uint32_t body_crc;
+   /// @brief CRC-32C of the header before it.
+   uint32_t crc;
+};
+
+/// @brief A range of the result that differs from the source. PE images are under 4 GB, so 32
+/// bits is enough.
+struct delta_run {
+   uint32_t offset;
+   uint32_t size;
+};
+
+static_assert(sizeof(delta_header) == 48);
+static_assert(sizeof(delta_run) == 8);
+
+static auto header_crc(const delta_header& header) noexcept -> uint32_t
+{
+   return crc32c(0, &header, offsetof(delta_header, crc));
+}
+
+/// @brief Add a range that differs to the runs. A gap to the last run no larger than a run's
+/// header is cheaper to carry over than a new run, so it joins the last run.
+static void add_run(slim_vector<delta_run>& runs, size_t offset, size_t size)
+{
+   if (runs.size() != 0) {
+      delta_run& last = runs[runs.size() - 1];
+
+      if (offset - (last.offset + last.size) <= sizeof(delta_run)) {
+         last.size = (uint32_t)(offset + size - last.offset);
+
+         return;
+      }
+   }
+
+   runs.push_back({(uint32_t)offset, (uint32_t)size});
+}
+
+/// @brief Add the ranges where patched differs from source to the runs.
+/// @param source The source's bytes, null where the source has ended and the result is compared
+/// against zeros.
+static void find_runs(const uint8_t* source, const uint8_t* patched, size_t offset, size_t size,
+                      slim_vector<delta_run>& runs)
+{
+   for (size_t i = 0; i < size;) {
+      if (patched[i] == (source ? source[i] : 0)) {
+         i += 1;
+
+         continue;
+      }
+
+      const size_t start = i;
+
+      while (i < size and patched[i] != (source ? source[i] : 0)) i += 1;
+
+      add_run(runs, offset + start, i - start);
+   }
+}
+
+/// @brief Compare a file and its patched copy front to back, collecting the runs that differ and
+/// the CRCs of both.
+static bool diff_files(FILE* source, size_t source_size, FILE* patched, size_t result_size,
+                       slim_vector<delta_run>& runs, uint32_t& source_crc, uint32_t& result_crc)
+{
+   source_crc = 0;
+   result_crc = 0;
+
+   // Both readers chunk from the start of their file, so their chunks line up.
+   chunk_reader source_reader{source, source_size};
+   chunk_reader patched_reader{patched, result_size};
+   file_chunk source_chunk;
+   file_chunk patched_chunk;
+   bool source_left = true;
+
+   while (patched_reader.next(patched_chunk)) {
+      size_t compared = 0;
+
+      if (source_left and source_reader.next(source_chunk)) {
+         compared = source_chunk.size < patched_chunk.size ? source_chunk.size : patched_chunk.size;
+
+         find_runs(source_chunk.data, patched_chunk.data, patched_chunk.offset, compared, runs);
+
+         source_crc = crc32c(source_crc, source_chunk.data, source_chunk.size);
+
+         source_reader.release();
+      }
+      else {
+         source_left = false;
+      }
+
+      find_runs(nullptr, patched_chunk.data + compared, patched_chunk.offset + compared,
+                patched_chunk.size - compared, runs);
+
+      result_crc = crc32c(result_crc, patched_chunk.data, patched_chunk.size);
+
+      patched_reader.release();
+   }
+
+   while (source_left and source_reader.next(source_chunk)) {
+      source_crc = crc32c(source_crc, source_chunk.data, source_chunk.size);
+
+      source_reader.release();
+   }
+
+   return not source_reader.failed() and not patched_reader.failed();
+}
+
+bool export_delta(const char* file_path, const char* delta_path,
+                  int (*print)(const char* format, ...), const apply_options& options) noexcept
+{
+   if (not print) print = printf;
+
+   char* patched_path = aquire_temp_file(delta_path, "BF2Delta");
+
+   if (not patched_path) {
+      print("Failed to create a temporary file next to %s.\r\n", delta_path);
+
+      return false;
+   }
+
+   apply_options patch_options = options;
+
+   patch_options.journal = false;
+   patch_options.output_path = patched_path;
+
+   FILE* source = nullptr;
+   FILE* patched = nullptr;
+   size_t source_size = 0;
+   size_t result_size = 0;
+   slim_vector<delta_run> runs;
+   slim_vector<uint8_t> data;
+   delta_header header = {};
+   size_t run_bytes = 0;
+   bool result = false;
+
+   if (not apply(file_path, print, patch_options)) goto cleanup;
+
+   source = open_file(file_path, "rb");
+   patched = open_file(patched_path, "rb");
+
+   if (not source or not patched or not get_file_size(source, source_size) or
+       not get_file_size(patched, result_size)) {
+      print("Failed to read %s after patching it.\r\n", file_path);
+
+      goto cleanup;
+   }
+
+   if (result_size > UINT32_MAX) {
+      print("%s is too large for a delta.\r\n", file_path);
+
+      goto cleanup;
+   }
+
+   if (not diff_files(source, source_size, patched, result_size, runs, header.source_crc,
+                      header.result_crc)) {
+      print("Failed to read %s after patching it.\r\n", file_path);
+
+      goto cleanup;
+   }
+
+   data.resize(sizeof(delta_header));
+
+   for (const delta_run& run : runs) {
+      data.append(reinterpret_cast<const uint8_t*>(&run), sizeof(run));
+
+      const size_t bytes_offset = data.size();
+
+      data.resize(bytes_offset + run.size);
+
+      if (not seek_file(patched, run.offset) or
+          fread(data.data() + bytes_offset, sizeof(uint8_t), run.size, patched) != run.size) {
+         print("Failed to read %s after patching it.\r\n", file_path);
+
+         goto cleanup;
+      }
+
+      run_bytes += run.size;
+   }
+
+   memcpy(header.magic, delta_magic, sizeof(delta_magic));
+   header.version = delta_version;
+   header.run_count = (uint32_t)runs.size();
+   header.source_size = source_size;
+   header.result_size = result_size;
+   header.body_crc =
+      crc32c(0, data.data() + sizeof(delta_header), data.size() - sizeof(delta_header));
+   header.crc = header_crc(header);
+
+   memcpy(data.data(), &header, sizeof(delta_header));
+
+   if (not save_file(delta_path, "BF2Delta", data.data(), data.size())) {
+      print("Failed to save %s.\r\n", delta_path);
+
+      goto cleanup;
+   }
+
+   print("Exported %zu runs holding %zu bytes to %s, %zu bytes in all.\r\n", runs.size(),
+         run_bytes, delta_path, data.size());
+
+   result = true;
+
+cleanup:
+   if (source) fclose(source);
+   if (patched) fclose(patched);
+   remove(patched_path);
+   free(patched_path);
+
+   return result;
+}
+
+/// @brief Reads the runs of a delta in order as the file they apply to streams past them, so only
+/// the bytes of the run under the current chunk are ever held.
+struct run_reader {
+   FILE* file = nullptr;
+   uint32_t runs_left = 0;
+   size_t result_size = 0;
+   /// @brief CRC-32C of everything read so far.
+   uint32_t crc = 0;
+   bool failed = false;
+
+   /// @brief Lay the runs over a range of the result. Ranges must come in order and leave no
+   /// gaps.
+   void overlay(size_t offset, uint8_t* bytes, size_t size) noexcept
+   {
+      while (not failed) {
+         if (not _in_run) {
+            if (runs_left == 0) return;
+
+            if (fread(&_run, sizeof(delta_run), 1, file) != 1) {
+               failed = true;
+
+               return;
+            }
+
+            crc = crc32c(crc, &_run, sizeof(delta_run));
+
+            // Sorted, not overlapping, not empty and inside the result.
+            if (_run.offset < _previous_end or _run.size == 0 or _run.offset > result_size or
+                _run.size > result_size - _run.offset) {
+               failed = true;
+
+               return;
+            }
+
+            _previous_end = (size_t)_run.offset + _run.size;
+            _run_done = 0;
+            _in_run = true;
+            runs_left -= 1;
+         }
+
+         const size_t start = (size_t)_run.offset + _run_done;
+
+         if (start >= offset + size) return;
+
+         const size_t left = _run.size - _run_done;
+         const size_t count = left < offset + size - start ? left : offset + size - start;
+
+         if (fread(bytes + (start - offset), sizeof(uint8_t), count, file) != count) {
+            failed = true;
+
+            return;
+         }
+
+         crc = crc32c(crc, bytes + (start - offset), count);
+
+         _run_done += (uint32_t)count;
+
+         if (_run_done == _run.size) _in_run = false;
+      }
+   }
+
+   /// @brief Check every run was read, the delta ends after the last one and its CRC matches.
+   [[nodiscard]] bool finished(uint32_t body_crc) noexcept
+   {
+      return not failed and runs_left == 0 and not _in_run and fgetc(file) == EOF and
+             crc == body_crc;
+   }
+
+private:
+   delta_run _run = {};
+   uint32_t _run_done = 0;
+   bool _in_run = false;
+   size_t _previous_end = 0;
+};
+
+/// @brief Compute the CRC-32C of a whole file.
+static bool file_crc(FILE* file, size_t size, uint32_t& out) noexcept
+{
+   out = 0;
+
+   chunk_reader reader{file, size};
+   file_chunk chunk;
+
+   while (reader.next(chunk)) {
+      out = crc32c(out, chunk.data, chunk.size);
+
+      reader.release();
+   }
+
+   return not reader.failed();
+}
+
+bool apply_delta(const char* delta_path, const char* file_path, const char* output_path,
+                 int (*print)(const char* format, ...)) noexcept
+{
+   if (not print) print = printf;
+   if (not output_path) output_path = file_path;
+
+   FILE* delta = open_file(delta_path, "rb");
+   FILE* source = nullptr;
+   FILE* output = nullptr;
+   char* temp_file_name = nullptr;
+   delta_header header = {};
+   size_t source_size = 0;
+   size_t result_size = 0;
+   uint32_t source_crc = 0;
+   uint32_t result_crc = 0;
+   run_reader runs;
+   slim_vector<uint8_t> tail;
+   bool result = false;
+
+   if (not delta) {
+      print("Failed to open %s.\r\n", delta_path);
+
+      goto cleanup;
+   }
+
+   if (fread(&header, sizeof(delta_header), 1, delta) != 1 or
+       memcmp(header.magic, delta_magic, sizeof(delta_magic)) != 0 or
+       header.version != delta_version or header.crc != header_crc(header) or
+       header.result_size > UINT32_MAX or header.source_size > SIZE_MAX) {
+      print("%s isn't a delta or is damaged.\r\n", delta_path);
+
+      goto cleanup;
+   }
+
+   result_size = (size_t)header.result_size;
+
+   source = open_file(file_path, "rb");
+
+   if (not source or not get_file_size(source, source_size)) {
+      print("Failed to open %s.\r\n", file_path);
+
+      goto cleanup;
+   }
+
+   if (source_size != header.source_size) {
+      if (source_size == result_size and file_crc(source, source_size, source_crc) and
+          source_crc == header.result_crc) {
+         print("%s already has %s applied, nothing to do.\r\n", file_path, delta_path);
+
+         result = strcmp(output_path, file_path) == 0 or clone_file(file_path, output_path);
+
+         goto cleanup;
+      }
+
+      print("%s isn't the file %s was exported from.\r\n", file_path, delta_path);
+
+      goto cleanup;
+   }
+
+   temp_file_name = aquire_temp_file(output_path, "BF2Delta");
+
+   if (not temp_file_name or not (output = open_file(temp_file_name, "wb"))) {
+      print("Failed to create a temporary file next to %s.\r\n", output_path);
+
+      goto cleanup;
+   }
+
+   runs.file = delta;
+   runs.runs_left = header.run_count;
+   runs.result_size = result_size;
+
+   {
+      // Each chunk is patched and written while the reader fills the other buffer.
+      chunk_reader reader{source, source_size};
+      file_chunk chunk;
+      bool written = true;
+
+      while (written and reader.next(chunk)) {
+         source_crc = crc32c(source_crc, chunk.data, chunk.size);
+
+         if (chunk.offset < result_size) {
+            const size_t size =
+               chunk.size < result_size - chunk.offset ? chunk.size : result_size - chunk.offset;
+
+            runs.overlay(chunk.offset, chunk.data, size);
+
+            result_crc = crc32c(result_crc, chunk.data, size);
+            written = fwrite(chunk.data, sizeof(uint8_t), size, output) == size;
+         }
+
+         reader.release();
+      }
+
+      if (not written or reader.failed()) {
+         print("Failed to read %s or write %s.\r\n", file_path, output_path);
+
+         goto cleanup;
+      }
+   }
+
+   for (size_t offset = source_size; offset < result_size;) {
+      const size_t size =
+         stream_chunk_size < result_size - offset ? stream_chunk_size : result_size - offset;
+
+      tail.resize(size);
+
+      memset(tail.data(), 0, size);
+
+      runs.overlay(offset, tail.data(), size);
+
+      result_crc = crc32c(result_crc, tail.data(), size);
+
+      if (fwrite(tail.data(), sizeof(uint8_t), size, output) != size) {
+         print("Failed to write %s.\r\n", output_path);
+
+         goto cleanup;
+      }
+
+      offset += size;
+   }
+
+   if (source_crc != header.source_crc) {
+      if (source_size == result_size and source_crc == header.result_crc) {
+         print("%s already has %s applied, nothing to do.\r\n", file_path, delta_path);
+
+         result = strcmp(output_path, file_path) == 0 or clone_file(file_path, output_path);
+      }
+      else {
+         print("%s isn't the file %s was exported from.\r\n", file_path, delta_path);
+      }
+
+      goto cleanup;
+   }
+
+   if (not runs.finished(header.body_crc) or result_crc != header.result_crc) {
+      print("%s is damaged.\r\n", delta_path);
+
+      goto cleanup;
+   }
+
+   if (fclose(output) != 0) {
+      output = nullptr;
+
+      print("Failed to write %s.\r\n", output_path);
+
+      goto cleanup;
+   }
+
+   output = nullptr;
+
+   copy_file_mode(file_path, temp_file_name);
+
+   // Windows refuses to replace a file that is still open.
+   fclose(source);
+   source = nullptr;
+
+   if (not move_file(temp_file_name, output_path)) {
+      print("Failed to save %s.\r\n", output_path);
+
+      goto cleanup;
+   }
+
+   print("Applied %s to %s, %u runs.\r\n", delta_path, output_path, header.run_count);
+
+   result = true;
+
+cleanup:
+   if (delta) fclose(delta);
+   if (source) fclose(source);
+   if (output) fclose(output);
+   if (temp_file_name) {
+      remove(temp_file_name);
+      free(temp_file_name);
+   }
+
+   return result;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "apply_patches.hpp"
+
+/// @brief Patch a copy of an executable and save what patching changed as a delta, the byte runs
+/// that differ and everything added to the end of the file. The executable is left unmodified.
+/// @param file_path The executable to patch.
+/// @param delta_path Where to write the delta, replacing any file there.
+/// @param options How to patch. The journal and output path are ignored.
+/// @return False if the executable couldn't be patched or the delta couldn't be written.
+[[nodiscard]] bool export_delta(const char* file_path, const char* delta_path,
+                                int (*print)(const char* format, ...),
+                                const apply_options& options = {}) noexcept;
+
+/// @brief Apply a delta written by export_delta. The file is read front to back once with the
+/// delta read alongside it, so memory use stays at a couple of chunks however large either is.
+/// Nothing is identified or looked up in the patch tables, the file only has to be the exact file
+/// the delta was exported from.
+/// @param delta_path The delta.
+/// @param file_path The file to apply it to.
+/// @param output_path Where to write the result, null to replace the file. Nothing is written
+/// unless the file, the delta and the result all check out.
+/// @return False if the file isn't the one the delta was exported from, the delta is damaged or
+/// the result couldn't be written.
+[[nodiscard]] bool apply_delta(const char* delta_path, const char* file_path,
+                               const char* output_path,
+                               int (*print)(const char* format, ...)) noexcept;
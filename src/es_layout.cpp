@@ -0,0 +1,156 @@
+#include "es_layout.hpp"
+
+#include <stdlib.h>
+
+// Where versions before plan_es_layout put each region, indexed by es_region_id, and the size of
+// the section they always reserved.
+constexpr uint32_t legacy_region_offsets[es_region_id_count] = {0, 0, 0x110000, 0x41d400};
+constexpr uint32_t legacy_es_size = 0x41e400;
+
+/// @brief The alignment a region is placed at. Hot regions get whole cache lines, or whole
+/// pages once they span one.
+static auto placement_alignment(const es_region& region, uint32_t size) noexcept -> uint32_t
+{
+   uint32_t alignment = region.alignment;
+
+   if (region.hotness == es_hotness::hot) {
+      const uint32_t granule = size >= es_page_size ? es_page_size : es_cache_line_size;
+
+      if (alignment < granule) alignment = granule;
+   }
+
+   return alignment;
+}
+
+/// @brief Order placements hot first, then by alignment, largest first, then by id so the
+/// layout doesn't depend on the order sets are listed in.
+static int compare_placements(const void* left, const void* right)
+{
+   const es_placement& left_placement = *static_cast<const es_placement*>(left);
+   const es_placement& right_placement = *static_cast<const es_placement*>(right);
+
+   if (left_placement.region->hotness != right_placement.region->hotness) {
+      return left_placement.region->hotness == es_hotness::hot ? -1 : 1;
+   }
+
+   if (left_placement.alignment != right_placement.alignment) {
+      return left_placement.alignment > right_placement.alignment ? -1 : 1;
+   }
+
+   return ((uint32_t)left_placement.region->id > (uint32_t)right_placement.region->id) -
+          ((uint32_t)left_placement.region->id < (uint32_t)right_placement.region->id);
+}
+
+bool es_layout::find(es_region_id id, uint32_t& offset) const noexcept
+{
+   for (const es_placement& placement : placements) {
+      if (placement.region->id == id) {
+         offset = placement.offset;
+
+         return true;
+      }
+   }
+
+   return false;
+}
+
+auto es_layout::reserved_size() const noexcept -> uint32_t
+{
+   return (uint32_t)(((uint64_t)size + es_page_size - 1) / es_page_size * es_page_size);
+}
+
+bool plan_es_layout(const exe_patch_list& list, const bool (&enabled)[PATCH_COUNT],
+                    const capacity_values& capacities, es_layout& out) noexcept
+{
+   out = {};
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      if (not enabled[i]) continue;
+
+      for (const es_region& region : list.patches[i].regions) {
+         uint32_t size = 0;
+
+         if (not region_size(region, capacities, size)) {
+            out = {};
+
+            return false;
+         }
+
+         out.placements.push_back({&region, 0, size, placement_alignment(region, size)});
+      }
+   }
+
+   if (out.placements.size() == 0) return true;
+
+   qsort(out.placements.data(), out.placements.size(), sizeof(es_placement), compare_placements);
+
+   uint64_t offset = 0;
+
+   for (size_t i = 0; i < out.placements.size(); ++i) {
+      es_placement& placement = out.placements[i];
+      const uint64_t mask = placement.alignment - 1;
+      const uint64_t start = (offset + mask) & ~mask;
+
+      out.padding += (uint32_t)(start - offset);
+      out.used += placement.size;
+
+      placement.offset = (uint32_t)start;
+      offset = start + placement.size;
+
+      // The section's virtual size is rounded up to a page, which has to fit too.
+      if (offset > UINT32_MAX - es_page_size) {
+         out = {};
+
+         return false;
+      }
+   }
+
+   out.size = (uint32_t)offset;
+
+   return true;
+}
+
+void plan_legacy_es_layout(const exe_patch_list& list, es_layout& out) noexcept
+{
+   out = {};
+
+   const capacity_values default_capacities;
+
+   for (const patch_set& set : list.patches) {
+      for (const es_region& region : set.regions) {
+         uint32_t size = 0;
+
+         (void)region_size(region, default_capacities, size);
+
+         out.placements.push_back(
+            {&region, legacy_region_offsets[(uint32_t)region.id], size, region.alignment});
+
+         out.used += size;
+      }
+   }
+
+   out.size = legacy_es_size;
+}
+
+void print_es_layout(const es_layout& layout, int (*print)(const char* format, ...)) noexcept
+{
+   if (layout.placements.size() == 0) {
+      print("Extension section: not needed by the patch sets being applied.\r\n");
+
+      return;
+   }
+
+   for (const es_placement& placement : layout.placements) {
+      print("  0x%08x %-20s 0x%08x bytes, %s, aligned to 0x%x\r\n", placement.offset,
+            placement.region->name, placement.size,
+            placement.region->hotness == es_hotness::hot ? "hot" : "cold", placement.alignment);
+   }
+
+   const uint32_t reserved = layout.reserved_size();
+   const uint32_t tail = reserved - layout.size;
+
+   print("Extension section: 0x%x bytes reserved, 0x%x used (%.1f%%), 0x%x alignment padding, "
+         "0x%x page tail.\r\n",
+         reserved, layout.used, (double)layout.used * 100.0 / (double)reserved, layout.padding,
+         tail);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "capacities.hpp"
+#include "patch_table.hpp"
+#include "slim_vector.hpp"
+
+#include <stdint.h>
+
+constexpr uint32_t es_cache_line_size = 64;
+constexpr uint32_t es_page_size = 0x1000;
+
+struct es_placement {
+   const es_region* region = nullptr;
+   /// @brief The offset of the region from the start of the section.
+   uint32_t offset = 0;
+   /// @brief The size of the region for the chosen capacities.
+   uint32_t size = 0;
+   /// @brief The alignment the region was placed at, at least the one it asked for.
+   uint32_t alignment = 1;
+};
+
+/// @brief Where the regions of the applied patch sets go in the extension section.
+struct es_layout {
+   /// @brief The placed regions in address order.
+   slim_vector<es_placement> placements;
+   /// @brief The end of the last region, 0 if no region was placed.
+   uint32_t size = 0;
+   /// @brief The bytes of every region together.
+   uint32_t used = 0;
+   /// @brief The bytes skipped to align regions.
+   uint32_t padding = 0;
+
+   /// @brief Get the offset of a region from the start of the section.
+   /// @return False if the region wasn't placed.
+   [[nodiscard]] bool find(es_region_id id, uint32_t& offset) const noexcept;
+
+   /// @brief The size of the section once rounded up to whole pages.
+   [[nodiscard]] auto reserved_size() const noexcept -> uint32_t;
+};
+
+/// @brief Lay out the regions of a list's enabled sets. Hot regions come first, aligned to a
+/// cache line or to a page if they span one, so they share no line with anything else. Cold
+/// regions follow packed at their own alignment. Within each group regions with the larger
+/// alignment go first to keep padding down.
+/// @param enabled Which of the list's sets are going to be applied.
+/// @param capacities Sizes regions that hold a capacity's worth of elements.
+/// @return False if the regions don't fit in 32 bits.
+[[nodiscard]] bool plan_es_layout(const exe_patch_list& list, const bool (&enabled)[PATCH_COUNT],
+                                  const capacity_values& capacities, es_layout& out) noexcept;
+
+/// @brief Lay out a list's regions where versions before plan_es_layout put them, whichever sets
+/// were applied: DLC missions, the matrix pool and the hi rez area back to back, sized for the
+/// default capacities. Only used to recognize and move executables patched by those versions.
+void plan_legacy_es_layout(const exe_patch_list& list, es_layout& out) noexcept;
+
+/// @brief Print each region of a layout and how much of the section is padding.
+void print_es_layout(const es_layout& layout, int (*print)(const char* format, ...)) noexcept;
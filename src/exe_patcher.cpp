@@ -1,13 +1,15 @@
 #include "exe_patcher.hpp"
+#include "chunk_reader.hpp"
+#include "crc32c.hpp"
 #include "file_helpers.hpp"
+#include "pe_image.hpp"
+#include "undo_journal.hpp"
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
-
 static bool memeq(const void* left, size_t left_size, const void* right, size_t right_size)
 {
    if (left_size != right_size) return false;
@@ -21,41 +23,90 @@ static auto align_up(uint32_t i, uint32_t alignment) -> uint32_t
    return (i + alignment - 1) / alignment * alignment;
 }
 
-static const char ext_section_name[IMAGE_SIZEOF_SHORT_NAME] = ".bf2ext";
+static const char ext_section_name[pe_sizeof_short_name] = ".bf2ext";
+// Eight characters fill the name field, which then has no terminator.
+static const char code_section_name[pe_sizeof_short_name] = {'.', 'b', 'f', '2', 'c', 'o', 'd', 'e'};
+
+constexpr uint32_t ext_section_characteristics =
+   pe_scn_cnt_uninitialized_data | pe_scn_mem_read | pe_scn_mem_write;
+constexpr uint32_t code_section_characteristics =
+   pe_scn_cnt_code | pe_scn_mem_execute | pe_scn_mem_read;
+
+// A streamed image starts by reading this much to find SizeOfHeaders, then reads up to that much
+// if the headers are larger. Anything claiming more than max_stream_header_size isn't kept.
+constexpr size_t stream_header_probe_size = 0x1000;
+constexpr size_t max_stream_header_size = 0x10000;
 
 exe_patcher::~exe_patcher()
 {
-   if (_data) delete[] _data;
+   release();
 }
 
-bool exe_patcher::load(const char* file_path)
+bool exe_patcher::load(const char* file_path, load_mode mode)
 {
-   if (_data) {
-      delete[] _data;
+   release();
+
+   if (mode == load_mode::read_only) {
+      if (not map_file_read_only(file_path, _mapping)) return false;
+
+      _data = _mapping.data;
+      _size = _mapping.size;
+      _resident_size = _size;
+      _base_size = _size;
+      _read_only = true;
+      // Kept for overlays, which save by cloning the file.
+      _source_path = duplicate_string(file_path);
+
+      if (not _source_path) {
+         release();
+
+         return false;
+      }
+
+      index_image();
 
-      _data = nullptr;
+      return true;
    }
 
-   FILE* file = fopen(file_path, "rb");
+   if (mode == load_mode::mapped) {
+      if (not map_file_copy_on_write(file_path, _mapping)) return false;
 
-   if (not file) return false;
+      _data = _mapping.data;
+      _size = _mapping.size;
+      _resident_size = _size;
+      _base_size = _size;
+      _source_path = duplicate_string(file_path);
 
-   bool result = false;
-   ptrdiff_t file_size = 0;
+      if (not _source_path) {
+         release();
+
+         return false;
+      }
+
+      index_image();
 
-   if (fseek(file, 0, SEEK_END) != 0) goto cleanup;
+      return true;
+   }
+
+   if (mode == load_mode::streamed) return load_streamed(file_path);
+
+   FILE* file = fopen(file_path, "rb");
 
-   file_size = ftell(file);
+   if (not file) return false;
 
-   if (file_size < 0) goto cleanup;
+   bool result = false;
 
-   _size = (size_t)file_size;
-   _data = new uint8_t[file_size];
+   if (not get_file_size(file, _size)) goto cleanup;
 
-   rewind(file);
+   _resident_size = _size;
+   _base_size = _size;
+   _data = new uint8_t[_size];
 
    if (fread(_data, sizeof(uint8_t), _size, file) != _size) goto cleanup;
 
+   count_read(_size);
+   index_image();
+
    result = true;
 
 cleanup:
@@ -64,10 +115,158 @@ cleanup:
    return result;
 }
 
+bool exe_patcher::load_streamed(const char* file_path)
+{
+   _stream_file = fopen(file_path, "rb");
+   _source_path = duplicate_string(file_path);
+
+   if (not _stream_file or not _source_path or not get_file_size(_stream_file, _size)) {
+      release();
+
+      return false;
+   }
+
+   _base_size = _size;
+   _resident_size = _size < stream_header_probe_size ? _size : stream_header_probe_size;
+   _data = new uint8_t[_resident_size];
+
+   if (fread(_data, sizeof(uint8_t), _resident_size, _stream_file) != _resident_size) {
+      release();
+
+      return false;
+   }
+
+   count_read(_resident_size);
+
+   // prepare() needs the section table and the free space after it up to SizeOfHeaders.
+   if (pe_image probe; probe.parse(_data, _resident_size)) {
+      const size_t headers_size = probe.optional_header().size_of_headers;
+
+      if (headers_size > _resident_size and headers_size <= max_stream_header_size and
+          headers_size <= _size) {
+         delete[] _data;
+
+         _resident_size = headers_size;
+         _data = new uint8_t[_resident_size];
+
+         if (not seek_file(_stream_file, 0) or
+             fread(_data, sizeof(uint8_t), _resident_size, _stream_file) != _resident_size) {
+            release();
+
+            return false;
+         }
+
+         count_read(_resident_size);
+      }
+   }
+
+   index_image();
+
+   return true;
+}
+
+bool exe_patcher::load_memory(const uint8_t* data, size_t size)
+{
+   release();
+
+   if (not data) return false;
+
+   _base_data = data;
+   _size = size;
+   _base_size = size;
+   _resident_size = _size < stream_header_probe_size ? _size : stream_header_probe_size;
+
+   // Copied up to SizeOfHeaders like a streamed image, prepare() needs the space after the
+   // section table.
+   if (pe_image probe; probe.parse(data, _resident_size)) {
+      const size_t headers_size = probe.optional_header().size_of_headers;
+
+      if (headers_size > _resident_size and headers_size <= max_stream_header_size and
+          headers_size <= _size) {
+         _resident_size = headers_size;
+      }
+   }
+
+   _data = new uint8_t[_resident_size];
+
+   memcpy(_data, _base_data, _resident_size);
+
+   count_read(_resident_size);
+   index_image();
+
+   return true;
+}
+
+bool exe_patcher::load_overlay(const exe_patcher& base)
+{
+   // Overlays of an overlay read the same bytes, so only the bytes in memory and unmodified are
+   // needed.
+   const uint8_t* base_data = base.resident() ? base._data : base._base_data;
+
+   if (not base_data or base._size != base._base_size or base._dirty_ranges.size() != 0) {
+      release();
+
+      return false;
+   }
+
+   if (not load_memory(base_data, base._size)) return false;
+
+   if (base._source_path) {
+      _source_path = duplicate_string(base._source_path);
+
+      if (not _source_path) {
+         release();
+
+         return false;
+      }
+   }
+
+   return true;
+}
+
 bool exe_patcher::save(const char* file_path)
 {
-   if (not _data) return false;
+   if (not _data or _read_only) return false;
+
+   if (_base_data) return _source_path and save_overlay(file_path);
+
+   if (_stream_file) return save_streamed(file_path);
+
+   if (_mapping.data) return save_dirty_ranges(file_path);
+
+   return save_full(file_path);
+}
+
+bool exe_patcher::save(uint8_t* out, size_t capacity)
+{
+   if (not _data or not _base_data or capacity < _size) return false;
+
+   // Patching in place, the base's bytes are already there.
+   if (out != _base_data) memcpy(out, _base_data, _base_size);
+
+   memcpy(out, _data, _resident_size);
+
+   count_written(_resident_size);
+
+   for (const pending_write& write : _pending_writes) {
+      // An empty write has no bytes to copy from, the buffer may not even be allocated.
+      if (write.size == 0) continue;
+
+      memcpy(out + write.offset, _pending_bytes.data() + write.bytes_offset, write.size);
 
+      count_written(write.size);
+   }
+
+   // Nothing appended has no buffer behind it to copy from.
+   if (_appended.size() != 0) memcpy(out + _base_size, _appended.data(), _appended.size());
+
+   count_written(_appended.size());
+
+   return true;
+}
+
+bool exe_patcher::save_full(const char* file_path)
+{
    char* temp_file_name = aquire_temp_file(file_path, "BF2Patch");
 
    if (not temp_file_name) return false;
@@ -77,12 +276,23 @@ bool exe_patcher::save(const char* file_path)
 
    if (not file) goto cleanup;
 
-   if (fwrite(_data, sizeof(uint8_t), _size, file) != _size) goto cleanup;
+   if (fwrite(_data, sizeof(uint8_t), _base_size, file) != _base_size) goto cleanup;
+
+   // Nothing appended has no buffer behind it to write from.
+   if (_appended.size() != 0 and
+       fwrite(_appended.data(), sizeof(uint8_t), _appended.size(), file) != _appended.size()) {
+      goto cleanup;
+   }
+
+   count_written(_base_size + _appended.size());
 
    fclose(file);
 
    file = nullptr;
 
+   // Buffered images don't keep their source, but they're saved over it.
+   copy_file_mode(_source_path ? _source_path : file_path, temp_file_name);
+
    if (not move_file(temp_file_name, file_path)) goto cleanup;
 
    result = true;
@@ -97,173 +307,1314 @@ cleanup:
    return result;
 }
 
-bool exe_patcher::compatible(uint32_t id_address, uint64_t expected_id)
+bool exe_patcher::save_dirty_ranges(const char* file_path)
 {
-   // Bounds and overflow Checks
-   if (id_address + sizeof(uint64_t) >= _size) return false;
-   if (id_address + sizeof(uint64_t) < id_address) return false;
+   const bool replacing_source = strcmp(file_path, _source_path) == 0;
 
-   uint64_t exe_id = 0;
+   coalesce_dirty_ranges();
 
-   memcpy(&exe_id, _data + id_address, sizeof(uint64_t));
+   // Nothing to write, the file on disk already matches the image.
+   if (replacing_source and _dirty_ranges.size() == 0 and _appended.size() == 0) return true;
 
-   return exe_id == expected_id;
+   char* temp_file_name = aquire_temp_file(file_path, "BF2Patch");
+
+   if (not temp_file_name) return false;
+
+   FILE* file = nullptr;
+   bool result = false;
+
+   if (not clone_file(_source_path, temp_file_name)) goto cleanup;
+
+   file = fopen(temp_file_name, "r+b");
+
+   if (not file) goto cleanup;
+
+   for (const byte_range& range : _dirty_ranges) {
+      if (not seek_file(file, range.offset)) goto cleanup;
+      if (fwrite(&_data[range.offset], sizeof(uint8_t), range.size, file) != range.size) {
+         goto cleanup;
+      }
+
+      count_written(range.size);
+   }
+
+   if (_appended.size() != 0) {
+      if (not seek_file(file, _base_size)) goto cleanup;
+      if (fwrite(_appended.data(), sizeof(uint8_t), _appended.size(), file) != _appended.size()) {
+         goto cleanup;
+      }
+
+      count_written(_appended.size());
+   }
+
+   if (fclose(file) != 0) {
+      file = nullptr;
+
+      goto cleanup;
+   }
+
+   file = nullptr;
+
+   // Windows refuses to replace a file that is still mapped.
+   if (replacing_source) release();
+
+   if (not move_file(temp_file_name, file_path)) goto cleanup;
+
+   result = true;
+
+cleanup:
+   if (temp_file_name) {
+      remove(temp_file_name);
+      free(temp_file_name);
+   }
+   if (file) fclose(file);
+
+   return result;
 }
 
-bool exe_patcher::prepare(uint32_t ext_section_size)
+bool exe_patcher::save_streamed(const char* file_path)
 {
-   if (not check_range(0, sizeof(IMAGE_DOS_HEADER))) return false;
+   const bool replacing_source = strcmp(file_path, _source_path) == 0;
+
+   // Nothing to write, the file on disk already matches the image.
+   if (replacing_source and _dirty_ranges.size() == 0 and _appended.size() == 0) return true;
+
+   char* temp_file_name = aquire_temp_file(file_path, "BF2Patch");
 
-   IMAGE_DOS_HEADER* dos_header = (IMAGE_DOS_HEADER*)&_data[0x0];
+   if (not temp_file_name) return false;
 
-   if (dos_header->e_magic != 'ZM') return false;
+   FILE* file = fopen(temp_file_name, "wb");
+   bool result = false;
 
-   if (not check_range(dos_header->e_lfanew, sizeof(IMAGE_NT_HEADERS32))) return false;
+   if (not file) goto cleanup;
+   if (not seek_file(_stream_file, 0)) goto cleanup;
 
-   IMAGE_NT_HEADERS32* nt_headers = (IMAGE_NT_HEADERS32*)&_data[dos_header->e_lfanew];
+   {
+      // Each chunk is patched and written while the reader fills the other buffer.
+      chunk_reader reader{_stream_file, _base_size};
+      file_chunk chunk;
+      bool written = true;
 
-   if (nt_headers->Signature != 'EP') return false;
+      while (written and reader.next(chunk)) {
+         overlay_writes(chunk.offset, chunk.data, chunk.size);
 
-   IMAGE_FILE_HEADER* file_header = &nt_headers->FileHeader;
-   IMAGE_OPTIONAL_HEADER32* optional_header = &nt_headers->OptionalHeader;
+         written = fwrite(chunk.data, sizeof(uint8_t), chunk.size, file) == chunk.size;
 
-   if (optional_header->Magic != IMAGE_NT_OPTIONAL_HDR32_MAGIC) return false;
+         count_read(chunk.size);
+         count_written(chunk.size);
 
-   const size_t section_headers_offset =
-      dos_header->e_lfanew + (sizeof(IMAGE_NT_HEADERS32) - sizeof(IMAGE_OPTIONAL_HEADER32)) +
-      file_header->SizeOfOptionalHeader;
-   const size_t section_headers_start_size = file_header->NumberOfSections * sizeof(IMAGE_SECTION_HEADER);
+         reader.release();
+      }
 
-   if (not check_range(section_headers_offset, section_headers_start_size)) return false;
+      if (not written or reader.failed()) goto cleanup;
+   }
 
-   // Simplify some error handling by checking this here.
-   if (file_header->NumberOfSections == 0) return false;
+   if (_appended.size() != 0 and
+       fwrite(_appended.data(), sizeof(uint8_t), _appended.size(), file) != _appended.size()) {
+      goto cleanup;
+   }
 
-   IMAGE_SECTION_HEADER* section_headers = (IMAGE_SECTION_HEADER*)&_data[section_headers_offset];
+   count_written(_appended.size());
 
-   for (uint32_t i = 0; i < file_header->NumberOfSections; ++i) {
-      // Early out for having already added the section previously.
-      if (memeq(&section_headers[i].Name, sizeof(section_headers[i].Name), &ext_section_name,
-                sizeof(ext_section_name))) {
-         if (section_headers[i].Characteristics !=
-             (IMAGE_SCN_CNT_UNINITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE)) {
-            return false;
-         }
+   if (fclose(file) != 0) {
+      file = nullptr;
+
+      goto cleanup;
+   }
 
-         if (i != file_header->NumberOfSections - 1) return false;
+   file = nullptr;
 
-         _ext_section_va = optional_header->ImageBase + section_headers[i].VirtualAddress;
+   copy_file_mode(_source_path, temp_file_name);
 
-         if (section_headers[i].Misc.VirtualSize < ext_section_size) {
-            optional_header->SizeOfUninitializedData -= section_headers[i].Misc.VirtualSize;
-            optional_header->SizeOfImage -= section_headers[i].Misc.VirtualSize;
+   // Windows refuses to replace a file that is still open.
+   if (replacing_source) release();
 
-            section_headers[i].Misc.VirtualSize =
-               align_up(ext_section_size, optional_header->SectionAlignment);
+   if (not move_file(temp_file_name, file_path)) goto cleanup;
 
-            optional_header->SizeOfUninitializedData += section_headers[i].Misc.VirtualSize;
-            optional_header->SizeOfImage += section_headers[i].Misc.VirtualSize;
-         }
+   result = true;
 
-         return true;
+cleanup:
+   if (temp_file_name) {
+      remove(temp_file_name);
+      free(temp_file_name);
+   }
+   if (file) fclose(file);
+
+   return result;
+}
+
+bool exe_patcher::save_overlay(const char* file_path)
+{
+   char* temp_file_name = aquire_temp_file(file_path, "BF2Patch");
+
+   if (not temp_file_name) return false;
+
+   FILE* file = nullptr;
+   bool result = false;
+
+   // The base's bytes come from its file without passing through the process, as when saving a
+   // mapped image.
+   if (not clone_file(_source_path, temp_file_name)) goto cleanup;
+
+   file = fopen(temp_file_name, "r+b");
+
+   if (not file) goto cleanup;
+
+   if (fwrite(_data, sizeof(uint8_t), _resident_size, file) != _resident_size) goto cleanup;
+
+   count_written(_resident_size);
+
+   // Laid over in the order they were made, later writes win like they do in overlay_writes.
+   for (const pending_write& write : _pending_writes) {
+      if (not seek_file(file, write.offset)) goto cleanup;
+      if (fwrite(_pending_bytes.data() + write.bytes_offset, sizeof(uint8_t), write.size, file) !=
+          write.size) {
+         goto cleanup;
       }
+
+      count_written(write.size);
    }
 
-   const size_t section_headers_patched_size = section_headers_start_size + sizeof(IMAGE_SECTION_HEADER);
-   const size_t section_headers_patched_end = section_headers_offset + section_headers_patched_size;
+   if (_appended.size() != 0) {
+      if (not seek_file(file, _base_size)) goto cleanup;
+      if (fwrite(_appended.data(), sizeof(uint8_t), _appended.size(), file) != _appended.size()) {
+         goto cleanup;
+      }
 
-   if (not check_range(section_headers_offset, section_headers_patched_size)) return false;
-   if (section_headers_patched_end > optional_header->SizeOfHeaders) return false;
+      count_written(_appended.size());
+   }
 
-   IMAGE_SECTION_HEADER* existing_last_section =
-      (IMAGE_SECTION_HEADER*)&section_headers[file_header->NumberOfSections - 1];
-   IMAGE_SECTION_HEADER* new_section =
-      (IMAGE_SECTION_HEADER*)&section_headers[file_header->NumberOfSections];
+   if (fclose(file) != 0) {
+      file = nullptr;
 
-   memset(new_section, 0, sizeof(IMAGE_SECTION_HEADER));
-   memcpy(new_section->Name, ext_section_name, sizeof(ext_section_name));
+      goto cleanup;
+   }
 
-   new_section->Misc.VirtualSize = align_up(ext_section_size, optional_header->SectionAlignment);
-   new_section->VirtualAddress =
-      align_up(existing_last_section->VirtualAddress + existing_last_section->Misc.VirtualSize,
-               optional_header->SectionAlignment);
-   new_section->SizeOfRawData = 0;
-   new_section->PointerToRawData = 0;
-   new_section->PointerToRelocations = 0;
-   new_section->PointerToLinenumbers = 0;
-   new_section->NumberOfRelocations = 0;
-   new_section->NumberOfLinenumbers = 0;
-   new_section->Characteristics =
-      IMAGE_SCN_CNT_UNINITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+   file = nullptr;
 
-   file_header->NumberOfSections += 1;
-   optional_header->SizeOfImage += new_section->Misc.VirtualSize;
-   optional_header->SizeOfUninitializedData += new_section->Misc.VirtualSize;
+   if (not move_file(temp_file_name, file_path)) goto cleanup;
 
-   _ext_section_va = optional_header->ImageBase + new_section->VirtualAddress;
+   result = true;
 
-   return true;
+cleanup:
+   if (temp_file_name) {
+      remove(temp_file_name);
+      free(temp_file_name);
+   }
+   if (file) fclose(file);
+
+   return result;
 }
 
-bool exe_patcher::apply(const patch& patch)
+bool exe_patcher::compatible(uint32_t id_address, uint64_t expected_id) const
 {
-   if (not _data) return false;
+   // Bounds and overflow Checks
+   if (id_address + sizeof(uint64_t) >= _size) return false;
+   if (id_address + sizeof(uint64_t) < id_address) return false;
 
-   const uint32_t offset = patch.address;
+   uint64_t exe_id = 0;
 
-   if (not check_range(offset, sizeof(uint32_t))) return false;
+   if (not read(id_address, &exe_id, sizeof(uint64_t))) return false;
 
-   uint32_t replacement_value = patch.replacement_value;
+   return exe_id == expected_id;
+}
 
-   if (patch.value_is_ext_section_relative_address) replacement_value += _ext_section_va;
+bool exe_patcher::prepare(const es_layout& layout, uint32_t code_size)
+{
+   if (not _image.valid() or _read_only) return false;
 
-   const bool already_patched =
-      memeq(&_data[offset], sizeof(uint32_t), &replacement_value, sizeof(replacement_value));
+   _ext_layout = layout;
+   _code_used = 0;
 
-   if (already_patched) return true;
+   // Simplify some error handling by checking this here.
+   if (_image.file_header().number_of_sections == 0) return false;
 
-   const bool expected_value =
-      memeq(&_data[offset], sizeof(uint32_t), &patch.expected_value, sizeof(patch.expected_value));
+   const int32_t ext_index = _image.find_section(ext_section_name);
 
-   if (not expected_value) return false;
+   if (ext_index >= 0 and not is_ext_section(ext_index)) return false;
 
-   memcpy(&_data[offset], &replacement_value, sizeof(replacement_value));
+   // The extension section is kept last so later runs can grow it. The code section goes in front
+   // of it, unless the extension section is from an earlier run and is already there.
+   if (ext_index < 0 and not prepare_code_section(code_size)) return false;
+   if (not prepare_ext_section(layout.size)) return false;
+   if (ext_index >= 0 and not prepare_code_section(code_size)) return false;
 
    return true;
 }
 
-bool exe_patcher::apply(const code_patch& patch)
+bool exe_patcher::prepare_ext_section(uint32_t ext_section_size)
 {
-   if (not _data) return false;
-   if (not patch.expected_bytes or not patch.replacement_bytes) return false;
-   if (patch.length == 0) return false;
+   pe_file_header file_header = _image.file_header();
+   pe_optional_header32 optional_header = _image.optional_header();
 
-   const uint32_t offset = patch.address;
+   if (const int32_t index = _image.find_section(ext_section_name); index >= 0) {
+      pe_section_header section = _image.section(index);
 
-   if (not check_range(offset, patch.length)) return false;
+      _ext_section_va = optional_header.image_base + section.virtual_address;
 
-   const bool already_patched =
-      memcmp(&_data[offset], patch.replacement_bytes, patch.length) == 0;
+      if (section.virtual_size < ext_section_size) {
+         // Growing it would run into the code section added after it.
+         if (index != (int32_t)_image.section_count() - 1) return false;
 
-   if (already_patched) return true;
+         optional_header.size_of_uninitialized_data -= section.virtual_size;
+         optional_header.size_of_image -= section.virtual_size;
 
-   const bool expected =
-      memcmp(&_data[offset], patch.expected_bytes, patch.length) == 0;
+         section.virtual_size = align_up(ext_section_size, optional_header.section_alignment);
 
-   if (not expected) return false;
+         optional_header.size_of_uninitialized_data += section.virtual_size;
+         optional_header.size_of_image += section.virtual_size;
 
-   memcpy(&_data[offset], patch.replacement_bytes, patch.length);
+         write(_image.section_header_offset(index), &section, sizeof(section));
+         write_optional_header(optional_header);
+      }
 
-   return true;
+      return true;
+   }
+
+   // No applied set has a region, so there's nothing to reserve.
+   if (ext_section_size == 0) return true;
+
+   if (not _image.can_add_section()) return false;
+
+   const pe_section_header existing_last_section =
+      _image.section(file_header.number_of_sections - 1);
+   pe_section_header new_section = {};
+
+   memcpy(new_section.name, ext_section_name, sizeof(ext_section_name));
+
+   new_section.virtual_size = align_up(ext_section_size, optional_header.section_alignment);
+   new_section.virtual_address =
+      align_up(existing_last_section.virtual_address + existing_last_section.virtual_size,
+               optional_header.section_alignment);
+   new_section.size_of_raw_data = 0;
+   new_section.pointer_to_raw_data = 0;
+   new_section.pointer_to_relocations = 0;
+   new_section.pointer_to_linenumbers = 0;
+   new_section.number_of_relocations = 0;
+   new_section.number_of_linenumbers = 0;
+   new_section.characteristics = ext_section_characteristics;
+
+   file_header.number_of_sections += 1;
+   optional_header.size_of_image += new_section.virtual_size;
+   optional_header.size_of_uninitialized_data += new_section.virtual_size;
+
+   write(_image.section_header_offset(file_header.number_of_sections - 1), &new_section,
+         sizeof(new_section));
+   write(_image.file_header_offset(), &file_header, sizeof(file_header));
+   write_optional_header(optional_header);
+
+   _ext_section_va = optional_header.image_base + new_section.virtual_address;
+
+   // Refresh the view so it sees the new section count.
+   index_image();
+
+   return _image.valid();
 }
 
-bool exe_patcher::check_range(size_t offset, size_t size) const noexcept
+bool exe_patcher::prepare_code_section(uint32_t code_size)
 {
-   // Bounds check
-   if (offset + size >= _size) return false;
+   pe_file_header file_header = _image.file_header();
+   pe_optional_header32 optional_header = _image.optional_header();
 
-   // Overflow check
-   if (offset + size < offset) return false;
+   if (const int32_t index = _image.find_section(code_section_name); index >= 0) {
+      if (not is_code_section(index)) return false;
+
+      const pe_section_header section = _image.section(index);
+
+      // Its raw data may be followed by other data in the file, so it's never moved or grown.
+      if (section.size_of_raw_data < code_size) return false;
+
+      _code_section_va = optional_header.image_base + section.virtual_address;
+      _code_section_offset = section.pointer_to_raw_data;
+      _code_section_size = section.size_of_raw_data;
+
+      return true;
+   }
+
+   if (code_size == 0) return true;
+
+   if (not _image.can_add_section()) return false;
+   if (optional_header.file_alignment == 0) return false;
+
+   const pe_section_header existing_last_section =
+      _image.section(file_header.number_of_sections - 1);
+   pe_section_header new_section = {};
+
+   memcpy(new_section.name, code_section_name, sizeof(code_section_name));
+
+   new_section.virtual_size = align_up(code_size, optional_header.section_alignment);
+   new_section.virtual_address =
+      align_up(existing_last_section.virtual_address + existing_last_section.virtual_size,
+               optional_header.section_alignment);
+   new_section.size_of_raw_data = align_up(code_size, optional_header.file_alignment);
+   new_section.pointer_to_raw_data = align_up((uint32_t)_size, optional_header.file_alignment);
+   new_section.characteristics = code_section_characteristics;
+
+   file_header.number_of_sections += 1;
+   optional_header.size_of_image += new_section.virtual_size;
+   optional_header.size_of_code += new_section.size_of_raw_data;
+
+   // The raw data goes on the end of the file, after anything already appended.
+   const size_t appended_size =
+      new_section.pointer_to_raw_data + new_section.size_of_raw_data - _base_size;
+   const size_t previous_size = _appended.size();
+
+   _appended.resize(appended_size);
+
+   memset(_appended.data() + previous_size, 0, appended_size - previous_size);
+
+   _size = _base_size + _appended.size();
+
+   write(_image.section_header_offset(file_header.number_of_sections - 1), &new_section,
+         sizeof(new_section));
+   write(_image.file_header_offset(), &file_header, sizeof(file_header));
+   write_optional_header(optional_header);
+
+   _code_section_va = optional_header.image_base + new_section.virtual_address;
+   _code_section_offset = new_section.pointer_to_raw_data;
+   _code_section_size = new_section.size_of_raw_data;
+
+   index_image();
+
+   return _image.valid();
+}
+
+bool exe_patcher::find_ext_section(const es_layout& layout) noexcept
+{
+   if (not _image.valid()) return false;
+
+   _ext_layout = layout;
+
+   const int32_t index = _image.find_section(ext_section_name);
+
+   if (index < 0 or not is_ext_section(index)) return false;
+
+   _ext_section_va = _image.optional_header().image_base + _image.section(index).virtual_address;
 
    return true;
-}
\ No newline at end of file
+}
+
+bool exe_patcher::large_address_aware() const noexcept
+{
+   if (not _image.valid()) return false;
+
+   return (_image.file_header().characteristics & pe_file_large_address_aware) != 0;
+}
+
+bool exe_patcher::set_large_address_aware()
+{
+   if (not _image.valid() or _read_only) return false;
+
+   pe_file_header file_header = _image.file_header();
+
+   file_header.characteristics |= pe_file_large_address_aware;
+
+   write(_image.file_header_offset(), &file_header, sizeof(file_header));
+
+   return true;
+}
+
+bool exe_patcher::read_header_tail(void* out, uint32_t size) const noexcept
+{
+   size_t offset = 0;
+
+   return header_tail_offset(size, offset) and read(offset, out, size);
+}
+
+bool exe_patcher::write_header_tail(const void* bytes, uint32_t size)
+{
+   size_t offset = 0;
+
+   if (_read_only or not header_tail_offset(size, offset)) return false;
+
+   write(offset, bytes, size);
+
+   return true;
+}
+
+bool exe_patcher::header_tail_offset(uint32_t size, size_t& out_offset) const noexcept
+{
+   if (not _image.valid()) return false;
+
+   const size_t headers_size = _image.optional_header().size_of_headers;
+
+   // Streamed images keep the headers resident, reading them never touches the file.
+   if (headers_size > _resident_size or headers_size < size) return false;
+
+   const size_t offset = headers_size - size;
+
+   if (_image.section_header_offset(_image.section_count()) > offset) return false;
+
+   for (uint32_t i = 0; i < _image.section_count(); ++i) {
+      const pe_section_header section = _image.section(i);
+
+      if (section.size_of_raw_data != 0 and section.pointer_to_raw_data < headers_size) {
+         return false;
+      }
+   }
+
+   out_offset = offset;
+
+   return true;
+}
+
+bool exe_patcher::update_checksum()
+{
+   if (not _image.valid() or _read_only) return false;
+
+   const size_t checksum_offset =
+      _image.optional_header_offset() + offsetof(pe_optional_header32, check_sum);
+
+   slim_vector<uint8_t> window;
+   uint32_t sum = 0;
+
+   // The sum of every 16-bit word with the carries folded back in, the checksum field counting
+   // as zero, plus the size of the file. Chunks are even sized so words never straddle them.
+   for (size_t position = 0; position < _size; position += stream_chunk_size) {
+      const size_t chunk_size =
+         _size - position < stream_chunk_size ? _size - position : stream_chunk_size;
+      const uint8_t* bytes = view(position, chunk_size, window);
+
+      if (not bytes) return false;
+
+      for (size_t i = 0; i < chunk_size; i += 2) {
+         const size_t offset = position + i;
+         const bool low_masked = offset - checksum_offset < sizeof(uint32_t);
+         const bool high_masked = offset + 1 - checksum_offset < sizeof(uint32_t);
+         const uint32_t low = low_masked ? 0 : bytes[i];
+         const uint32_t high = high_masked or i + 1 == chunk_size ? 0 : bytes[i + 1];
+
+         sum += low | high << 8;
+         sum = (sum & 0xffff) + (sum >> 16);
+      }
+   }
+
+   const uint32_t checksum = ((sum & 0xffff) + (sum >> 16)) + (uint32_t)_size;
+
+   write(checksum_offset, &checksum, sizeof(checksum));
+
+   return true;
+}
+
+auto exe_patcher::base_image_size() const noexcept -> uint32_t
+{
+   if (not _image.valid()) return 0;
+
+   const uint32_t section_alignment = _image.optional_header().section_alignment;
+   uint32_t size = _image.optional_header().size_of_image;
+
+   const auto leave_out = [&](int32_t index) {
+      const uint32_t section_size = align_up(_image.section(index).virtual_size, section_alignment);
+
+      if (section_size < size) size -= section_size;
+   };
+
+   if (const int32_t index = _image.find_section(ext_section_name);
+       index >= 0 and is_ext_section(index)) {
+      leave_out(index);
+   }
+
+   if (const int32_t index = _image.find_section(code_section_name);
+       index >= 0 and is_code_section(index)) {
+      leave_out(index);
+   }
+
+   return size;
+}
+
+void exe_patcher::scan_code(const signature_scanner& scanner, signature_match* matches) const noexcept
+{
+   if (not _image.valid()) return;
+
+   slim_vector<uint8_t> window;
+
+   if (not resident()) window.resize(stream_chunk_size + max_signature_length);
+
+   for (uint32_t i = 0; i < _image.section_count(); ++i) {
+      const pe_section_header section = _image.section(i);
+
+      if (not(section.characteristics & (pe_scn_cnt_code | pe_scn_mem_execute))) continue;
+
+      size_t offset = 0;
+      size_t size = section.size_of_raw_data;
+
+      if (section.virtual_size != 0 and section.virtual_size < size) size = section.virtual_size;
+      if (not _sections.rva_to_offset(section.virtual_address, (uint32_t)size, offset)) continue;
+
+      if (resident()) {
+         count_read(size);
+         scanner.scan(_data + offset, size, offset, matches);
+
+         continue;
+      }
+
+      // Windows overlap by a signature so matches across their edges are still found, the match
+      // limit stops those in the overlap being counted twice.
+      for (size_t position = 0; position < size; position += stream_chunk_size) {
+         const size_t scan_size =
+            size - position < stream_chunk_size ? size - position : stream_chunk_size;
+         const size_t read_size = size - position < scan_size + max_signature_length
+                                     ? size - position
+                                     : scan_size + max_signature_length;
+
+         if (not read(offset + position, window.data(), read_size)) return;
+
+         scanner.scan(window.data(), read_size, offset + position, matches, scan_size);
+      }
+   }
+}
+
+bool exe_patcher::hash_sections(const byte_range* masked, size_t masked_count,
+                                uint32_t& out) const noexcept
+{
+   out = 0;
+
+   if (not _image.valid()) return false;
+
+   slim_vector<uint8_t> window;
+   uint32_t crc = 0;
+
+   const auto hash_range = [&](size_t offset, size_t size) {
+      for (size_t position = 0; position < size; position += stream_chunk_size) {
+         const size_t chunk_size =
+            size - position < stream_chunk_size ? size - position : stream_chunk_size;
+         const uint8_t* bytes = view(offset + position, chunk_size, window);
+
+         if (not bytes) return false;
+
+         crc = crc32c(crc, bytes, chunk_size);
+      }
+
+      return true;
+   };
+
+   for (uint32_t i = 0; i < _image.section_count(); ++i) {
+      const pe_section_header section = _image.section(i);
+
+      if (memcmp(section.name, ext_section_name, sizeof(ext_section_name)) == 0) continue;
+      if (memcmp(section.name, code_section_name, sizeof(code_section_name)) == 0) continue;
+      if (section.pointer_to_raw_data >= _size) continue;
+
+      size_t offset = section.pointer_to_raw_data;
+      const size_t end = offset + (section.size_of_raw_data < _size - offset
+                                      ? section.size_of_raw_data
+                                      : _size - offset);
+
+      for (size_t m = 0; m < masked_count and offset < end; ++m) {
+         const size_t mask_end = masked[m].offset + masked[m].size;
+
+         if (mask_end <= offset) continue;
+         if (masked[m].offset >= end) break;
+
+         const size_t zeros_start = masked[m].offset > offset ? masked[m].offset : offset;
+         const size_t zeros_end = mask_end < end ? mask_end : end;
+
+         if (not hash_range(offset, zeros_start - offset)) return false;
+
+         crc = crc32c_zeros(crc, zeros_end - zeros_start);
+         offset = zeros_end;
+      }
+
+      if (not hash_range(offset, end - offset)) return false;
+   }
+
+   out = crc;
+
+   return true;
+}
+
+auto exe_patcher::classify(const patch& patch) const noexcept -> patch_state
+{
+   if (not _data) return patch_state::foreign;
+
+   size_t offset = 0;
+   uint32_t current = 0;
+
+   if (not resolve(patch.address, sizeof(uint32_t), offset)) return patch_state::foreign;
+   if (not check_range(offset, sizeof(uint32_t))) return patch_state::foreign;
+   if (not read(offset, &current, sizeof(uint32_t))) return patch_state::foreign;
+
+   count_compared(sizeof(uint32_t));
+
+   uint32_t replacement_value = 0;
+
+   // Without the section the replacement isn't known, but the original still is.
+   if (not this->replacement_value(patch, replacement_value)) {
+      return memeq(&current, sizeof(uint32_t), &patch.expected_value, sizeof(patch.expected_value))
+                ? patch_state::original
+                : patch_state::foreign;
+   }
+
+   if (memeq(&current, sizeof(uint32_t), &replacement_value, sizeof(replacement_value))) {
+      return patch_state::patched;
+   }
+
+   if (memeq(&current, sizeof(uint32_t), &patch.expected_value, sizeof(patch.expected_value))) {
+      return patch_state::original;
+   }
+
+   return patch_state::foreign;
+}
+
+auto exe_patcher::classify(const code_patch& patch) const noexcept -> patch_state
+{
+   if (not _data or patch.length() == 0) return patch_state::foreign;
+
+   size_t offset = 0;
+
+   if (not resolve(patch.address, patch.length(), offset)) return patch_state::foreign;
+   if (not check_range(offset, patch.length())) return patch_state::foreign;
+
+   slim_vector<uint8_t> scratch;
+   const uint8_t* current = view(offset, patch.length(), scratch);
+
+   if (not current) return patch_state::foreign;
+
+   count_compared(patch.length());
+
+   // Without the extension section the replacement isn't known, but the original still is.
+   if (slim_vector<uint8_t> replacement; assemble(patch.ops, patch.length(), replacement) and
+                                         memcmp(current, replacement.data(), patch.length()) == 0) {
+      return patch_state::patched;
+   }
+
+   if (memcmp(current, patch.expected.data(), patch.length()) == 0) {
+      return patch_state::original;
+   }
+
+   return patch_state::foreign;
+}
+
+bool exe_patcher::apply(const patch& patch)
+{
+   if (_read_only) return false;
+
+   const patch_state state = classify(patch);
+
+   if (state == patch_state::patched) return true;
+   if (state == patch_state::foreign) return false;
+
+   size_t offset = 0;
+
+   if (not resolve(patch.address, sizeof(uint32_t), offset)) return false;
+
+   uint32_t replacement_value = 0;
+
+   if (not this->replacement_value(patch, replacement_value)) return false;
+
+   write(offset, &replacement_value, sizeof(replacement_value));
+
+   return true;
+}
+
+bool exe_patcher::apply(const code_patch& patch)
+{
+   if (_read_only) return false;
+
+   const patch_state state = classify(patch);
+
+   if (state == patch_state::patched) return true;
+   if (state == patch_state::foreign) return false;
+
+   size_t offset = 0;
+
+   slim_vector<uint8_t> replacement;
+
+   if (not resolve(patch.address, patch.length(), offset)) return false;
+   if (not assemble(patch.ops, patch.length(), replacement)) return false;
+
+   write(offset, replacement.data(), patch.length());
+
+   return true;
+}
+
+bool exe_patcher::plan(const patch& patch, uint32_t tag, write_plan& plan) const
+{
+   if (not _data) return false;
+
+   size_t offset = 0;
+
+   if (not resolve(patch.address, sizeof(uint32_t), offset)) return false;
+   if (not check_range(offset, sizeof(uint32_t))) return false;
+
+   uint32_t replacement_value = 0;
+
+   if (not this->replacement_value(patch, replacement_value)) return false;
+
+   plan.add(offset, &patch.expected_value, &replacement_value, sizeof(uint32_t), tag);
+
+   return true;
+}
+
+bool exe_patcher::plan(const code_patch& patch, uint32_t tag, write_plan& plan) const
+{
+   if (not _data or patch.length() == 0) return false;
+
+   size_t offset = 0;
+   slim_vector<uint8_t> replacement;
+
+   if (not resolve(patch.address, patch.length(), offset)) return false;
+   if (not check_range(offset, patch.length())) return false;
+   if (not assemble(patch.ops, patch.length(), replacement)) return false;
+
+   plan.add(offset, patch.expected.data(), replacement.data(), patch.length(), tag);
+
+   return true;
+}
+
+auto exe_patcher::classify(const trampoline& trampoline) const noexcept -> patch_state
+{
+   if (not _data or trampoline.length() < trampoline_jump_size) return patch_state::foreign;
+
+   size_t offset = 0;
+
+   if (not resolve(trampoline.address, trampoline.length(), offset)) return patch_state::foreign;
+   if (not check_range(offset, trampoline.length())) return patch_state::foreign;
+
+   slim_vector<uint8_t> scratch;
+   const uint8_t* current = view(offset, trampoline.length(), scratch);
+
+   if (not current) return patch_state::foreign;
+
+   count_compared(trampoline.length());
+
+   if (memcmp(current, trampoline.expected.data(), trampoline.length()) == 0) {
+      return patch_state::original;
+   }
+
+   uint32_t site_va = 0;
+   int32_t displacement = 0;
+
+   if (current[0] != x86_jmp_rel32 or not offset_to_va(offset, site_va)) {
+      return patch_state::foreign;
+   }
+
+   memcpy(&displacement, current + 1, sizeof(displacement));
+
+   for (uint32_t i = trampoline_jump_size; i < trampoline.length(); ++i) {
+      if (current[i] != x86_nop) return patch_state::foreign;
+   }
+
+   // The jump has to land on a copy of the routine in the code section that jumps back.
+   const uint32_t routine_va = site_va + trampoline_jump_size + (uint32_t)displacement;
+   const int32_t index = _image.find_section(code_section_name);
+
+   if (index < 0 or not is_code_section(index)) return patch_state::foreign;
+
+   slim_vector<uint8_t> expected_routine;
+
+   if (not assemble(trampoline.routine, 0, expected_routine)) return patch_state::foreign;
+
+   const uint32_t routine_rva = routine_va - _sections.image_base();
+   const uint32_t routine_size = (uint32_t)expected_routine.size();
+   const pe_section_header section = _image.section(index);
+   size_t routine_offset = 0;
+
+   if (routine_rva < section.virtual_address or
+       not _sections.rva_to_offset(routine_rva, routine_size + trampoline_jump_size,
+                                   routine_offset)) {
+      return patch_state::foreign;
+   }
+
+   const uint8_t* routine = view(routine_offset, routine_size + trampoline_jump_size, scratch);
+
+   if (not routine) return patch_state::foreign;
+
+   count_compared(routine_size);
+
+   if (memcmp(routine, expected_routine.data(), routine_size) != 0) return patch_state::foreign;
+
+   const uint8_t* jump_back = routine + routine_size;
+   const uint32_t jump_back_va = routine_va + routine_size;
+
+   memcpy(&displacement, jump_back + 1, sizeof(displacement));
+
+   if (jump_back[0] != x86_jmp_rel32 or
+       jump_back_va + trampoline_jump_size + (uint32_t)displacement !=
+          site_va + trampoline.length()) {
+      return patch_state::foreign;
+   }
+
+   return patch_state::patched;
+}
+
+bool exe_patcher::plan(const trampoline& trampoline, uint32_t tag, write_plan& plan)
+{
+   if (not _data or trampoline.length() < trampoline_jump_size) return false;
+
+   size_t site_offset = 0;
+   uint32_t site_va = 0;
+
+   if (not resolve(trampoline.address, trampoline.length(), site_offset)) return false;
+   if (not check_range(site_offset, trampoline.length())) return false;
+   if (not offset_to_va(site_offset, site_va)) return false;
+
+   slim_vector<uint8_t> routine;
+
+   if (not assemble(trampoline.routine, 0, routine)) return false;
+
+   const uint32_t routine_size = (uint32_t)routine.size();
+   uint32_t routine_va = 0;
+   size_t routine_offset = 0;
+
+   if (not allocate_cave(trampoline.cave_size(), routine_va, routine_offset)) return false;
+
+   // Jump relative to the end of the jmp instruction.
+   const auto jump = [](uint8_t* at, uint32_t from_va, uint32_t to_va) {
+      const uint32_t displacement = to_va - (from_va + trampoline_jump_size);
+
+      at[0] = x86_jmp_rel32;
+
+      memcpy(at + 1, &displacement, sizeof(displacement));
+   };
+
+   slim_vector<uint8_t> bytes;
+
+   // The site's replacement, then the routine's expected bytes (the zeroed section), then the
+   // routine with its jump back.
+   bytes.resize(trampoline.length() + (routine_size + trampoline_jump_size) * 2);
+
+   uint8_t* site = bytes.data();
+   uint8_t* cave_expected = site + trampoline.length();
+   uint8_t* cave = cave_expected + routine_size + trampoline_jump_size;
+
+   jump(site, site_va, routine_va);
+   memset(site + trampoline_jump_size, x86_nop, trampoline.length() - trampoline_jump_size);
+   memset(cave_expected, 0, routine_size + trampoline_jump_size);
+   memcpy(cave, routine.data(), routine_size);
+   jump(cave + routine_size, routine_va + routine_size, site_va + trampoline.length());
+
+   plan.add(site_offset, trampoline.expected.data(), site, trampoline.length(), tag);
+   plan.add(routine_offset, cave_expected, cave, routine_size + trampoline_jump_size, tag);
+
+   return true;
+}
+
+bool exe_patcher::allocate_cave(uint32_t size, uint32_t& out_va, size_t& out_offset) noexcept
+{
+   if (_code_section_va == 0) return false;
+
+   const uint32_t start = align_up(_code_used, cave_alignment);
+
+   if (start > _code_section_size or size > _code_section_size - start) return false;
+
+   out_va = _code_section_va + start;
+   out_offset = _code_section_offset + start;
+   _code_used = start + size;
+
+   return true;
+}
+
+bool exe_patcher::apply(write_plan& plan, uint32_t& failed_tag, plan_outcome* outcome)
+{
+   failed_tag = UINT32_MAX;
+
+   if (not _data or _read_only) return false;
+   if (not plan.build(_size)) return false;
+
+   slim_vector<uint8_t> scratch;
+   slim_vector<uint32_t> unpatched_runs;
+   plan_outcome counts;
+
+   // Verify everything before committing anything so a failure leaves the image untouched.
+   for (uint32_t i = 0; i < plan.runs().size(); ++i) {
+      const write_run& run = plan.runs()[i];
+      const uint8_t* current = view(run.offset, run.size, scratch);
+
+      if (not current) {
+         failed_tag = plan.sites()[run.first_site].tag;
+
+         return false;
+      }
+
+      plan.fill_gaps(run, current);
+
+      const uint8_t* mask = plan.run_mask(run);
+
+      count_compared(run.size);
+
+      if (masked_equal(current, plan.run_replacement(run), mask, run.size)) {
+         counts.sites_already_patched += run.site_count;
+
+         continue;
+      }
+
+      unpatched_runs.push_back(i);
+
+      count_compared(run.size);
+
+      if (masked_equal(current, plan.run_expected(run), mask, run.size)) {
+         counts.sites_patched += run.site_count;
+
+         continue;
+      }
+
+      // Partly patched runs are fine as long as each site is either original or patched.
+      for (uint32_t j = run.first_site; j < run.first_site + run.site_count; ++j) {
+         const write_site& site = plan.sites()[j];
+         const uint8_t* site_current = current + (site.offset - run.offset);
+
+         count_compared(site.size);
+
+         if (memcmp(site_current, plan.site_replacement(site), site.size) == 0) {
+            counts.sites_already_patched += 1;
+
+            continue;
+         }
+
+         count_compared(site.size);
+
+         if (memcmp(site_current, plan.site_expected(site), site.size) == 0) {
+            counts.sites_patched += 1;
+
+            continue;
+         }
+
+         failed_tag = site.tag;
+
+         return false;
+      }
+   }
+
+   for (const uint32_t i : unpatched_runs) {
+      const write_run& run = plan.runs()[i];
+
+      write(run.offset, plan.run_replacement(run), run.size);
+   }
+
+   if (outcome) *outcome = counts;
+
+   return true;
+}
+
+bool exe_patcher::resolve(patch_address address, uint32_t size, size_t& out_offset) const noexcept
+{
+   switch (address.space) {
+   case address_space::file_offset:
+      out_offset = address.value;
+
+      return true;
+   case address_space::rva:
+      return _sections.rva_to_offset(address.value, size, out_offset);
+   case address_space::va:
+      return _sections.va_to_offset(address.value, size, out_offset);
+   }
+
+   return false;
+}
+
+bool exe_patcher::check_range(size_t offset, size_t size) const noexcept
+{
+   // Bounds check
+   if (offset + size >= _size) return false;
+
+   // Overflow check
+   if (offset + size < offset) return false;
+
+   return true;
+}
+
+bool exe_patcher::is_ext_section(int32_t index) const noexcept
+{
+   const pe_section_header section = _image.section(index);
+
+   if (section.characteristics != ext_section_characteristics) return false;
+
+   const int32_t last = (int32_t)_image.section_count() - 1;
+
+   // Only the code section may come after it, added by a run after the one that added it.
+   return index == last or (index == last - 1 and is_code_section(last));
+}
+
+bool exe_patcher::is_code_section(int32_t index) const noexcept
+{
+   const pe_section_header section = _image.section(index);
+
+   return memcmp(section.name, code_section_name, sizeof(code_section_name)) == 0 and
+          section.characteristics == code_section_characteristics;
+}
+
+bool exe_patcher::assemble(slim_span<patch_op> ops, uint32_t length,
+                           slim_vector<uint8_t>& out) const noexcept
+{
+   op_layout layout;
+
+   if (not layout_ops(ops, length, layout)) return false;
+
+   const auto resolve_abs32 = [&](es_region_id region, uint32_t offset, uint32_t& address) {
+      uint32_t region_offset = 0;
+
+      if (_ext_section_va == 0 or not _ext_layout.find(region, region_offset)) return false;
+
+      address = _ext_section_va + region_offset + offset;
+
+      return true;
+   };
+
+   out.resize(layout.size);
+
+   return assemble_ops(ops, layout, resolve_abs32, out.data());
+}
+
+bool exe_patcher::offset_to_va(size_t offset, uint32_t& out_va) const noexcept
+{
+   uint32_t rva = 0;
+
+   if (not _sections.offset_to_rva(offset, rva)) return false;
+
+   out_va = _sections.image_base() + rva;
+
+   return true;
+}
+
+bool exe_patcher::replacement_value(const patch& patch, uint32_t& out) const noexcept
+{
+   out = patch.replacement_value;
+
+   if (patch.region == es_region_id::none) return true;
+   if (_ext_section_va == 0) return false;
+
+   uint32_t region_offset = 0;
+
+   if (not _ext_layout.find(patch.region, region_offset)) return false;
+
+   out += _ext_section_va + region_offset;
+
+   return true;
+}
+
+void exe_patcher::write(size_t offset, const void* bytes, size_t size) noexcept
+{
+   // Bytes past the end of the original file are truncated away by unpatching, nothing to keep.
+   if (_journal and offset < _journal->original_size()) {
+      const size_t kept_size = _journal->original_size() - offset < size
+                                  ? _journal->original_size() - offset
+                                  : size;
+      slim_vector<uint8_t> scratch;
+
+      if (const uint8_t* current = view(offset, kept_size, scratch); current) {
+         _journal->record(offset, current, kept_size);
+      }
+   }
+
+   // Appended bytes are always saved whole, so they aren't tracked as dirty.
+   if (offset + size > _base_size) {
+      const size_t appended_start = offset > _base_size ? offset : _base_size;
+      const size_t skipped = appended_start - offset;
+
+      memcpy(_appended.data() + (appended_start - _base_size),
+             static_cast<const uint8_t*>(bytes) + skipped, size - skipped);
+
+      size = skipped;
+
+      if (size == 0) return;
+   }
+
+   if (offset + size <= _resident_size) {
+      memcpy(&_data[offset], bytes, size);
+   }
+   else {
+      _pending_writes.push_back({offset, size, _pending_bytes.size()});
+      _pending_bytes.append(static_cast<const uint8_t*>(bytes), size);
+   }
+
+   _dirty_ranges.push_back({offset, size});
+}
+
+bool exe_patcher::read(size_t offset, void* out, size_t size) const noexcept
+{
+   if (offset > _size or size > _size - offset) return false;
+
+   count_read(size);
+
+   if (offset + size > _base_size) {
+      const size_t appended_start = offset > _base_size ? offset : _base_size;
+      const size_t skipped = appended_start - offset;
+
+      memcpy(static_cast<uint8_t*>(out) + skipped, _appended.data() + (appended_start - _base_size),
+             size - skipped);
+
+      size = skipped;
+
+      if (size == 0) return true;
+   }
+
+   if (resident()) {
+      memcpy(out, &_data[offset], size);
+
+      return true;
+   }
+
+   if (_base_data) {
+      memcpy(out, &_base_data[offset], size);
+      overlay_writes(offset, static_cast<uint8_t*>(out), size);
+
+      return true;
+   }
+
+   if (not seek_file(_stream_file, offset)) return false;
+   if (fread(out, sizeof(uint8_t), size, _stream_file) != size) return false;
+
+   overlay_writes(offset, static_cast<uint8_t*>(out), size);
+
+   return true;
+}
+
+auto exe_patcher::view(size_t offset, size_t size, slim_vector<uint8_t>& scratch) const noexcept
+   -> const uint8_t*
+{
+   if (offset > _size or size > _size - offset) return nullptr;
+
+   if (resident() and offset + size <= _base_size) {
+      count_read(size);
+
+      return &_data[offset];
+   }
+
+   // Most of an overlay is still the base's bytes, only ranges with writes in them are copied.
+   if (_base_data and offset >= _resident_size and offset + size <= _base_size) {
+      bool written = false;
+
+      for (const pending_write& write : _pending_writes) {
+         written |= write.offset < offset + size and offset < write.offset + write.size;
+      }
+
+      if (not written) {
+         count_read(size);
+
+         return &_base_data[offset];
+      }
+   }
+
+   scratch.resize(size);
+
+   return read(offset, scratch.data(), size) ? scratch.data() : nullptr;
+}
+
+auto exe_patcher::counters() const noexcept -> io_counters
+{
+   return {_bytes_read.load(std::memory_order_relaxed),
+           _bytes_written.load(std::memory_order_relaxed),
+           _bytes_compared.load(std::memory_order_relaxed)};
+}
+
+void exe_patcher::count_read(size_t size) const noexcept
+{
+   _bytes_read.fetch_add(size, std::memory_order_relaxed);
+}
+
+void exe_patcher::count_written(size_t size) noexcept
+{
+   _bytes_written.fetch_add(size, std::memory_order_relaxed);
+}
+
+void exe_patcher::count_compared(size_t size) const noexcept
+{
+   _bytes_compared.fetch_add(size, std::memory_order_relaxed);
+}
+
+void exe_patcher::overlay_writes(size_t offset, uint8_t* bytes, size_t size) const noexcept
+{
+   const auto overlay = [&](size_t source_offset, const uint8_t* source, size_t source_size) {
+      const size_t start = source_offset > offset ? source_offset : offset;
+      const size_t end = source_offset + source_size < offset + size ? source_offset + source_size
+                                                                      : offset + size;
+
+      if (start < end) {
+         memcpy(bytes + (start - offset), source + (start - source_offset), end - start);
+      }
+   };
+
+   overlay(0, _data, _resident_size);
+
+   // Pending writes are few, one per run, and are laid over in the order they were made.
+   for (const pending_write& write : _pending_writes) {
+      overlay(write.offset, _pending_bytes.data() + write.bytes_offset, write.size);
+   }
+}
+
+void exe_patcher::index_image() noexcept
+{
+   _sections.clear();
+
+   // Not every file handed to us is a PE image, prepare() reports that if it matters.
+   if (not _image.parse(_data, _resident_size)) return;
+
+   // A malformed section table leaves the map empty so only raw file offsets resolve.
+   (void)_sections.build(_image, _size);
+}
+
+void exe_patcher::release() noexcept
+{
+   if (_mapping.data) {
+      unmap_file(_mapping);
+   }
+   else if (_data) {
+      delete[] _data;
+   }
+
+   if (_stream_file) fclose(_stream_file);
+   if (_source_path) free(_source_path);
+
+   _data = nullptr;
+   _size = 0;
+   _resident_size = 0;
+   _base_size = 0;
+   _stream_file = nullptr;
+   _source_path = nullptr;
+   _base_data = nullptr;
+   _read_only = false;
+   _ext_section_va = 0;
+   _ext_layout = {};
+   _code_section_va = 0;
+   _code_section_offset = 0;
+   _code_section_size = 0;
+   _code_used = 0;
+   _image = {};
+   _sections.clear();
+   _dirty_ranges.clear();
+   _pending_writes.clear();
+   _pending_bytes.clear();
+   _appended.clear();
+}
+
+void exe_patcher::coalesce_dirty_ranges() noexcept
+{
+   if (_dirty_ranges.size() == 0) return;
+
+   qsort(_dirty_ranges.data(), _dirty_ranges.size(), sizeof(byte_range),
+         [](const void* left, const void* right) -> int {
+            const size_t left_offset = static_cast<const byte_range*>(left)->offset;
+            const size_t right_offset = static_cast<const byte_range*>(right)->offset;
+
+            return (left_offset > right_offset) - (left_offset < right_offset);
+         });
+
+   size_t merged = 0;
+
+   for (size_t i = 1; i < _dirty_ranges.size(); ++i) {
+      byte_range& last = _dirty_ranges[merged];
+      const byte_range& next = _dirty_ranges[i];
+
+      if (next.offset <= last.offset + last.size) {
+         const size_t end = next.offset + next.size;
+
+         if (end > last.offset + last.size) last.size = end - last.offset;
+      }
+      else {
+         _dirty_ranges[++merged] = next;
+      }
+   }
+
+   _dirty_ranges.truncate(merged + 1);
+}
+
+void exe_patcher::write_optional_header(const pe_optional_header32& header) noexcept
+{
+   // Only write back the part of the optional header that is actually present.
+   const size_t size = _image.file_header().size_of_optional_header < sizeof(header)
+                          ? _image.file_header().size_of_optional_header
+                          : sizeof(header);
+
+   write(_image.optional_header_offset(), &header, size);
+}
@@ -1,29 +1,340 @@
 #pragma once
 
+#include "es_layout.hpp"
+#include "file_helpers.hpp"
 #include "patch_table.hpp"
+#include "pe_image.hpp"
+#include "section_map.hpp"
+#include "sig_scanner.hpp"
+#include "slim_vector.hpp"
+#include "write_plan.hpp"
 
 #include <stdint.h>
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4530)
+#endif
+
+#include <atomic>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+struct undo_journal;
+
+enum class load_mode {
+   /// @brief Read the whole file into memory and write the whole image back on save.
+   buffered,
+   /// @brief Map the file copy-on-write. Save clones the file and writes only the dirty ranges.
+   mapped,
+   /// @brief Map the file read-only. Nothing can be applied or saved.
+   read_only,
+   /// @brief Keep only the headers in memory and read everything else through the file. Writes
+   /// past the headers are held until save, which streams the file through a pair of fixed-size
+   /// buffers into a new copy. Memory use doesn't grow with the size of the file.
+   streamed,
+};
+
+/// @brief The state of a patch site in an image.
+enum class patch_state : uint8_t {
+   /// @brief The site holds the bytes the patch expects to replace.
+   original,
+   /// @brief The site holds the patch's replacement.
+   patched,
+   /// @brief The site holds something else, or couldn't be resolved.
+   foreign,
+};
+
+struct byte_range {
+   size_t offset = 0;
+   size_t size = 0;
+};
+
+/// @brief How much of an image a patcher has moved and checked, for metrics.
+struct io_counters {
+   /// @brief Bytes of the image read, from the file or through the mapping.
+   uint64_t bytes_read = 0;
+   /// @brief Bytes written to files by save. The copy save makes of a mapped file's unchanged
+   /// bytes isn't counted, the file system does it.
+   uint64_t bytes_written = 0;
+   /// @brief Bytes of patch sites compared against their expected or replacement bytes.
+   uint64_t bytes_compared = 0;
+};
+
+/// @brief What apply(write_plan&) found at the sites of a plan it committed.
+struct plan_outcome {
+   /// @brief Sites that already held their replacement and were left alone.
+   uint32_t sites_already_patched = 0;
+   /// @brief Sites that held their expected bytes and were written.
+   uint32_t sites_patched = 0;
+};
+
+/// @brief A write past the headers of a streamed image, waiting to be laid over the file on save.
+struct pending_write {
+   size_t offset = 0;
+   size_t size = 0;
+   /// @brief Where the written bytes are in the patcher's pending bytes.
+   size_t bytes_offset = 0;
+};
 
 struct exe_patcher {
    ~exe_patcher();
 
-   [[nodiscard]] bool load(const char* file_path);
+   [[nodiscard]] bool load(const char* file_path, load_mode mode = load_mode::buffered);
+
+   /// @brief Start an image over the bytes of another patcher without copying them, to patch
+   /// many variants of one image from a single load. Only the headers are copied, writes past
+   /// them are held until save as for streamed images, and save clones the base's file and
+   /// writes the headers and the held writes over it.
+   /// @param base A patcher loaded fully in memory, or with load_memory, and not written to. It
+   /// must stay loaded while the overlay is used, any number of overlays on any threads can
+   /// share it. Overlays of a base loaded with load_memory can only be saved to memory.
+   [[nodiscard]] bool load_overlay(const exe_patcher& base);
+
+   /// @brief Start an image over bytes owned by the caller, like load_overlay. Nothing is read or
+   /// written through files, and the bytes are never written to until save.
+   /// @param data The image. It must stay valid and unchanged while the patcher is used.
+   [[nodiscard]] bool load_memory(const uint8_t* data, size_t size);
 
+   /// @brief Save the image. When the image was mapped and file_path is the file it was mapped
+   /// from the mapping is released before replacing the file and the patcher must be reloaded
+   /// to be used again.
    [[nodiscard]] bool save(const char* file_path);
 
-   [[nodiscard]] bool compatible(uint32_t id_address, uint64_t expected_id);
+   /// @brief Write the image as it would be saved into memory. Only for overlays and images
+   /// loaded with load_memory.
+   /// @param out Where to write the image, size() bytes. May be the bytes given to load_memory
+   /// to patch them in place, otherwise it must not overlap them.
+   /// @return False if capacity is less than size().
+   [[nodiscard]] bool save(uint8_t* out, size_t capacity);
+
+   [[nodiscard]] bool compatible(uint32_t id_address, uint64_t expected_id) const;
+
+   /// @brief Add the extension section, or grow the one added by an earlier prepare, so it fits
+   /// a layout. Patches pointing into the section's regions are resolved through the layout.
+   /// @param code_size The space trampolines need in the code cave section. The section is added
+   /// to the end of the file if it isn't there, one added by an earlier prepare can't grow.
+   [[nodiscard]] bool prepare(const es_layout& layout, uint32_t code_size = 0);
+
+   /// @brief Find the extension section added by an earlier prepare without adding one, so
+   /// patches pointing into it can be classified against a layout.
+   /// @return False if the image has no valid extension section.
+   [[nodiscard]] bool find_ext_section(const es_layout& layout) noexcept;
+
+   /// @brief Check if the image is marked large address aware.
+   [[nodiscard]] bool large_address_aware() const noexcept;
+
+   /// @brief Mark the image large address aware, so 64-bit Windows gives it 4 GB of address space
+   /// instead of 2 GB.
+   [[nodiscard]] bool set_large_address_aware();
+
+   /// @brief Read bytes from the end of the header space, after the section table and before the
+   /// first section. Linkers leave the space zeroed and the loader never looks at it.
+   /// @return False if the section table or a section's raw data leaves no room.
+   [[nodiscard]] bool read_header_tail(void* out, uint32_t size) const noexcept;
+
+   /// @brief Write bytes to the end of the header space. Sections added afterwards may overwrite
+   /// them.
+   /// @return False if the section table or a section's raw data leaves no room.
+   [[nodiscard]] bool write_header_tail(const void* bytes, uint32_t size);
+
+   /// @brief Recompute the header checksum over the image as it will be saved. Must come after
+   /// every other write. Streamed images are read through once more to do it.
+   [[nodiscard]] bool update_checksum();
+
+   /// @brief The size of the image in memory, leaving out the sections added by prepare.
+   [[nodiscard]] auto base_image_size() const noexcept -> uint32_t;
+
+   /// @brief The size of the file as it will be saved.
+   [[nodiscard]] auto size() const noexcept -> size_t
+   {
+      return _size;
+   }
+
+   /// @brief Keep the bytes every write from now on replaces in a journal, as far as they're in
+   /// the journal's original file. Null to stop.
+   void set_journal(undo_journal* journal) noexcept
+   {
+      _journal = journal;
+   }
+
+   [[nodiscard]] auto image() const noexcept -> const pe_image&
+   {
+      return _image;
+   }
+
+   /// @brief Translate a patch address into a file offset. RVAs and VAs are translated through
+   /// the image's section table, addresses in gaps or zero filled data are rejected.
+   [[nodiscard]] bool resolve(patch_address address, uint32_t size, size_t& out_offset) const noexcept;
+
+   /// @brief Read bytes of the image as it would be saved, pending writes included.
+   [[nodiscard]] bool read(size_t offset, void* out, size_t size) const noexcept;
+
+   /// @brief Scan the executable sections of the image. Match offsets are file offsets. Streamed
+   /// images are read through in chunks.
+   void scan_code(const signature_scanner& scanner, signature_match* matches) const noexcept;
+
+   /// @brief Compute the CRC-32C of the raw data of every section, apart from sections added by
+   /// the patcher. Masked ranges are hashed as zeros, so masking the patch sites gives a hash
+   /// patching doesn't change.
+   /// @param masked Ranges to hash as zeros, sorted by offset.
+   /// @param masked_count The number of masked ranges.
+   /// @param out The hash.
+   /// @return False if the image isn't a PE image or couldn't be read.
+   [[nodiscard]] bool hash_sections(const byte_range* masked, size_t masked_count,
+                                    uint32_t& out) const noexcept;
+
+   /// @brief Check what a patch site holds. Patches pointing into the extension section are only
+   /// recognized as patched after prepare or find_ext_section.
+   [[nodiscard]] auto classify(const patch& patch) const noexcept -> patch_state;
 
-   [[nodiscard]] bool prepare(uint32_t ext_section_size);
+   [[nodiscard]] auto classify(const code_patch& patch) const noexcept -> patch_state;
 
    [[nodiscard]] bool apply(const patch& patch);
 
    [[nodiscard]] bool apply(const code_patch& patch);
 
+   /// @brief Resolve a patch and add it to a write plan.
+   /// @param tag Reported back by apply(write_plan&) if the patch fails to verify.
+   [[nodiscard]] bool plan(const patch& patch, uint32_t tag, write_plan& plan) const;
+
+   [[nodiscard]] bool plan(const code_patch& patch, uint32_t tag, write_plan& plan) const;
+
+   /// @brief Check what a trampoline site holds. It's patched if it jumps to a copy of the routine
+   /// in the code cave section that jumps back, wherever in the section that is.
+   [[nodiscard]] auto classify(const trampoline& trampoline) const noexcept -> patch_state;
+
+   /// @brief Allocate the trampoline's routine in the code cave section and add the routine and
+   /// the jump to it to a write plan. Allocations are made in order from the start of the
+   /// section, so planning the same trampolines after every prepare lands them where they were.
+   [[nodiscard]] bool plan(const trampoline& trampoline, uint32_t tag, write_plan& plan);
+
+   /// @brief Reserve space in the code cave section added by prepare.
+   /// @param out_va The address of the space, aligned to cave_alignment.
+   /// @param out_offset The file offset of the space.
+   /// @return False if the section is missing or full.
+   [[nodiscard]] bool allocate_cave(uint32_t size, uint32_t& out_va, size_t& out_offset) noexcept;
+
+   /// @brief Build a write plan against the image, verify every run and then commit them. Runs
+   /// that are already patched are left alone. Nothing is written if any site holds neither its
+   /// expected nor its replacement bytes.
+   /// @param failed_tag The tag of the site that failed to verify, UINT32_MAX if the plan itself
+   /// was invalid.
+   /// @param outcome Filled in with how many sites were already patched if the plan was
+   /// committed. May be null.
+   [[nodiscard]] bool apply(write_plan& plan, uint32_t& failed_tag,
+                            plan_outcome* outcome = nullptr);
+
+   /// @brief The bytes read, written and compared since the patcher was made. Safe to call while
+   /// other threads use the patcher's const functions.
+   [[nodiscard]] auto counters() const noexcept -> io_counters;
+
 private:
    uint8_t* _data = nullptr;
    size_t _size = 0;
+   /// @brief How much of the image _data holds. Only less than _size for streamed images and
+   /// overlays, where it's the headers.
+   size_t _resident_size = 0;
+   /// @brief The size of the file as it was loaded. Bytes past it were added by prepare and are
+   /// held in _appended in every load mode.
+   size_t _base_size = 0;
+   slim_vector<uint8_t> _appended;
+
+   mapped_file _mapping;
+   FILE* _stream_file = nullptr;
+   slim_vector<pending_write> _pending_writes;
+   slim_vector<uint8_t> _pending_bytes;
+   char* _source_path = nullptr;
+   slim_vector<byte_range> _dirty_ranges;
+   /// @brief The base's bytes for overlays, which read everything past the headers from it.
+   const uint8_t* _base_data = nullptr;
+
+   pe_image _image;
+   section_map _sections;
 
    uint32_t _ext_section_va = 0;
+   es_layout _ext_layout;
+   uint32_t _code_section_va = 0;
+   size_t _code_section_offset = 0;
+   uint32_t _code_section_size = 0;
+   uint32_t _code_used = 0;
+   bool _read_only = false;
+   undo_journal* _journal = nullptr;
+
+   // Const functions read the image from many threads at once, in port for one.
+   mutable std::atomic<uint64_t> _bytes_read{0};
+   mutable std::atomic<uint64_t> _bytes_written{0};
+   mutable std::atomic<uint64_t> _bytes_compared{0};
+
+   void count_read(size_t size) const noexcept;
+
+   void count_written(size_t size) noexcept;
+
+   void count_compared(size_t size) const noexcept;
+
+   void release() noexcept;
+
+   [[nodiscard]] bool load_streamed(const char* file_path);
+
+   /// @brief Get a pointer to a range of the image, read into scratch for streamed images and
+   /// overlays.
+   /// @return Null if the range couldn't be read.
+   [[nodiscard]] auto view(size_t offset, size_t size, slim_vector<uint8_t>& scratch) const noexcept
+      -> const uint8_t*;
+
+   /// @brief Lay the resident headers and every pending write over bytes read from the file.
+   void overlay_writes(size_t offset, uint8_t* bytes, size_t size) const noexcept;
+
+   /// @brief Find where size bytes at the end of the header space start.
+   [[nodiscard]] bool header_tail_offset(uint32_t size, size_t& out_offset) const noexcept;
+
+   [[nodiscard]] bool is_ext_section(int32_t index) const noexcept;
+
+   [[nodiscard]] bool is_code_section(int32_t index) const noexcept;
+
+   [[nodiscard]] bool prepare_ext_section(uint32_t size);
+
+   [[nodiscard]] bool prepare_code_section(uint32_t size);
+
+   /// @brief Assemble an op stream, resolving addresses in the extension section through the
+   /// layout given to prepare or find_ext_section.
+   /// @param length The size of the site the stream replaces, 0 for a trampoline's routine.
+   /// @return False if the stream is malformed or points into a region that wasn't placed.
+   [[nodiscard]] bool assemble(slim_span<patch_op> ops, uint32_t length,
+                               slim_vector<uint8_t>& out) const noexcept;
+
+   /// @brief Translate a file offset into the address the image loads it at.
+   [[nodiscard]] bool offset_to_va(size_t offset, uint32_t& out_va) const noexcept;
+
+   /// @brief Get the value a patch writes, with the address of its region added if it points
+   /// into the extension section.
+   /// @return False if the patch's region isn't in the section.
+   [[nodiscard]] bool replacement_value(const patch& patch, uint32_t& out) const noexcept;
+
+   void index_image() noexcept;
+
+   [[nodiscard]] bool save_full(const char* file_path);
+
+   [[nodiscard]] bool save_dirty_ranges(const char* file_path);
+
+   [[nodiscard]] bool save_streamed(const char* file_path);
+
+   [[nodiscard]] bool save_overlay(const char* file_path);
+
+   /// @brief Check if the whole image is in _data, instead of only the headers.
+   [[nodiscard]] bool resident() const noexcept
+   {
+      return not _stream_file and not _base_data;
+   }
+
+   void coalesce_dirty_ranges() noexcept;
 
    [[nodiscard]] bool check_range(size_t offset, size_t size) const noexcept;
+
+   void write(size_t offset, const void* bytes, size_t size) noexcept;
+
+   void write_optional_header(const pe_optional_header32& header) noexcept;
 };
@@ -1,14 +1,140 @@
+#ifdef _MSC_VER
 #pragma warning(disable : 4530)
+#endif
+
+#include "file_helpers.hpp"
 
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <fcntl.h>
 #include <io.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#endif
+
+[[nodiscard]] char* duplicate_string(const char* string)
+{
+   const size_t size = strlen(string) + 1;
+   char* copy = (char*)malloc(size);
+
+   if (copy) memcpy(copy, string, size);
+
+   return copy;
+}
+
+FILE* open_file(const char* path, const char* mode)
+{
+   FILE* file = nullptr;
+
+#ifdef _WIN32
+   if (fopen_s(&file, path, mode) != 0) file = nullptr;
+#else
+   file = fopen(path, mode);
+#endif
+
+   return file;
+}
+
+bool seek_file(FILE* file, size_t offset)
+{
+#ifdef _WIN32
+   return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+   return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+bool get_file_size(FILE* file, size_t& out_size)
+{
+#ifdef _WIN32
+   if (_fseeki64(file, 0, SEEK_END) != 0) return false;
+
+   const long long size = _ftelli64(file);
+#else
+   if (fseeko(file, 0, SEEK_END) != 0) return false;
+
+   const off_t size = ftello(file);
+#endif
+
+   if (size < 0) return false;
+
+   out_size = (size_t)size;
+
+   return seek_file(file, 0);
+}
+
+bool save_file(const char* path, const char* prefix, const void* data, size_t size)
+{
+   char* temp_file_name = aquire_temp_file(path, prefix);
+
+   if (not temp_file_name) return false;
+
+   FILE* file = open_file(temp_file_name, "wb");
+   bool result = false;
+
+   if (not file) goto cleanup;
+
+   if (size != 0 and fwrite(data, sizeof(uint8_t), size, file) != size) goto cleanup;
+
+   if (fclose(file) != 0) {
+      file = nullptr;
+
+      goto cleanup;
+   }
+
+   file = nullptr;
+
+   if (not move_file(temp_file_name, path)) goto cleanup;
+
+   result = true;
+
+cleanup:
+   if (file) fclose(file);
+   remove(temp_file_name);
+   free(temp_file_name);
+
+   return result;
+}
+
+/// @brief Join a directory and a name with separator.
+/// @return The joined path. Must be passed to free if not null.
+static char* join_path(const char* directory, const char* name, char separator)
+{
+   const size_t directory_size = strlen(directory);
+   const bool has_separator =
+      directory_size != 0 and (directory[directory_size - 1] == '/' or
+                               directory[directory_size - 1] == '\\');
+   const size_t size = directory_size + 1 + strlen(name) + 1;
+   char* path = (char*)malloc(size);
+
+   if (not path) return nullptr;
+
+   if (has_separator) {
+      snprintf(path, size, "%s%s", directory, name);
+   }
+   else {
+      snprintf(path, size, "%s%c%s", directory, separator, name);
+   }
+
+   return path;
+}
+
+#ifdef _WIN32
 
 [[nodiscard]] char* aquire_temp_file(const char* base_file_path, const char* prefix)
 {
@@ -54,6 +180,161 @@
    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED) != 0;
 }
 
+static bool map_file(const char* file_path, bool copy_on_write, mapped_file& out)
+{
+   out = {};
+
+   HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+   if (file == INVALID_HANDLE_VALUE) return false;
+
+   LARGE_INTEGER file_size = {};
+   HANDLE mapping = nullptr;
+   void* view = nullptr;
+
+   if (not GetFileSizeEx(file, &file_size) or file_size.QuadPart == 0) goto cleanup;
+   if ((uint64_t)file_size.QuadPart > SIZE_MAX) goto cleanup;
+
+   mapping = CreateFileMappingA(file, nullptr, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0,
+                                0, nullptr);
+
+   if (not mapping) goto cleanup;
+
+   view = MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+
+   if (not view) goto cleanup;
+
+   out.data = static_cast<uint8_t*>(view);
+   out.size = (size_t)file_size.QuadPart;
+
+cleanup:
+   // The view keeps the mapping and file alive.
+   if (mapping) CloseHandle(mapping);
+   CloseHandle(file);
+
+   return out.data != nullptr;
+}
+
+[[nodiscard]] bool map_file_copy_on_write(const char* file_path, mapped_file& out)
+{
+   return map_file(file_path, true, out);
+}
+
+[[nodiscard]] bool map_file_read_only(const char* file_path, mapped_file& out)
+{
+   return map_file(file_path, false, out);
+}
+
+void unmap_file(mapped_file& file)
+{
+   if (file.data) UnmapViewOfFile(file.data);
+
+   file = {};
+}
+
+[[nodiscard]] bool clone_file(const char* from, const char* to)
+{
+   // CopyFile uses block cloning on file systems that support it.
+   return CopyFileA(from, to, false) != 0;
+}
+
+void copy_file_mode(const char*, const char*)
+{
+   // Windows files have no permission bits, temporary files get the same ACLs as any other.
+}
+
+[[nodiscard]] bool resize_file(const char* path, uint64_t size)
+{
+   HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                             nullptr);
+
+   if (file == INVALID_HANDLE_VALUE) return false;
+
+   LARGE_INTEGER end = {};
+
+   end.QuadPart = (LONGLONG)size;
+
+   const bool result =
+      SetFilePointerEx(file, end, nullptr, FILE_BEGIN) != 0 and SetEndOfFile(file) != 0;
+
+   CloseHandle(file);
+
+   return result;
+}
+
+[[nodiscard]] bool get_file_identity(const char* path, file_identity& out)
+{
+   out = {};
+
+   // No access rights are needed to query the file's information, so this never reads it.
+   HANDLE file = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+   if (file == INVALID_HANDLE_VALUE) return false;
+
+   BY_HANDLE_FILE_INFORMATION info = {};
+   const bool result = GetFileInformationByHandle(file, &info) != 0;
+
+   CloseHandle(file);
+
+   if (not result) return false;
+
+   out.device = info.dwVolumeSerialNumber;
+   out.inode = (uint64_t)info.nFileIndexHigh << 32 | info.nFileIndexLow;
+   out.size = (uint64_t)info.nFileSizeHigh << 32 | info.nFileSizeLow;
+   out.modified =
+      (uint64_t)info.ftLastWriteTime.dwHighDateTime << 32 | info.ftLastWriteTime.dwLowDateTime;
+
+   return true;
+}
+
+[[nodiscard]] bool is_directory(const char* path)
+{
+   const DWORD attributes = GetFileAttributesA(path);
+
+   return attributes != INVALID_FILE_ATTRIBUTES and (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+[[nodiscard]] bool walk_directory(const char* directory,
+                                  void (*callback)(void* context, const char* path,
+                                                   const char* name),
+                                  void* context)
+{
+   char* pattern = join_path(directory, "*", '\\');
+
+   if (not pattern) return false;
+
+   WIN32_FIND_DATAA entry = {};
+   HANDLE find = FindFirstFileA(pattern, &entry);
+
+   free(pattern);
+
+   if (find == INVALID_HANDLE_VALUE) return false;
+
+   do {
+      if (strcmp(entry.cFileName, ".") == 0 or strcmp(entry.cFileName, "..") == 0) continue;
+      if (entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) continue;
+
+      char* path = join_path(directory, entry.cFileName, '\\');
+
+      if (not path) continue;
+
+      if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+         (void)walk_directory(path, callback, context);
+      }
+      else {
+         callback(context, path, entry.cFileName);
+      }
+
+      free(path);
+   } while (FindNextFileA(find, &entry));
+
+   FindClose(find);
+
+   return true;
+}
+
 void init_cstdio()
 {
    if (not AttachConsole(ATTACH_PARENT_PROCESS)) return;
@@ -62,4 +343,239 @@ void init_cstdio()
    freopen_s(&file, "CONIN$", "r", stdin);
    freopen_s(&file, "CONOUT$", "w", stdout);
    freopen_s(&file, "CONOUT$", "w", stderr);
-}
\ No newline at end of file
+}
+
+#else
+
+[[nodiscard]] char* aquire_temp_file(const char* base_file_path, const char* prefix)
+{
+   const char* slash = strrchr(base_file_path, '/');
+   const size_t directory_size = slash ? (size_t)(slash - base_file_path) : 1;
+   const char* directory = slash ? base_file_path : ".";
+
+   // directory + '/' + prefix + "XXXXXX" + '\0'
+   const size_t template_size = directory_size + 1 + strlen(prefix) + 6 + 1;
+   char* temp_file_name = (char*)malloc(template_size);
+
+   if (not temp_file_name) return nullptr;
+
+   snprintf(temp_file_name, template_size, "%.*s/%sXXXXXX", (int)directory_size, directory, prefix);
+
+   const int fd = mkstemp(temp_file_name);
+
+   if (fd == -1) {
+      free(temp_file_name);
+
+      return nullptr;
+   }
+
+   close(fd);
+
+   return temp_file_name;
+}
+
+[[nodiscard]] bool move_file(const char* from, const char* to)
+{
+   // rename is atomic when both paths are on the same file system, which they are as the
+   // temporary file is created next to the destination.
+   return rename(from, to) == 0;
+}
+
+static bool map_file(const char* file_path, bool copy_on_write, mapped_file& out)
+{
+   out = {};
+
+   const int fd = open(file_path, O_RDONLY);
+
+   if (fd == -1) return false;
+
+   struct stat info = {};
+   void* view = MAP_FAILED;
+
+   if (fstat(fd, &info) != 0 or info.st_size <= 0) goto cleanup;
+
+   view = mmap(nullptr, (size_t)info.st_size, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ,
+               MAP_PRIVATE, fd, 0);
+
+   if (view == MAP_FAILED) goto cleanup;
+
+   out.data = static_cast<uint8_t*>(view);
+   out.size = (size_t)info.st_size;
+
+cleanup:
+   // The mapping keeps its own reference to the file.
+   close(fd);
+
+   return out.data != nullptr;
+}
+
+[[nodiscard]] bool map_file_copy_on_write(const char* file_path, mapped_file& out)
+{
+   return map_file(file_path, true, out);
+}
+
+[[nodiscard]] bool map_file_read_only(const char* file_path, mapped_file& out)
+{
+   return map_file(file_path, false, out);
+}
+
+void unmap_file(mapped_file& file)
+{
+   if (file.data) munmap(file.data, file.size);
+
+   file = {};
+}
+
+[[nodiscard]] bool clone_file(const char* from, const char* to)
+{
+   const int source = open(from, O_RDONLY);
+
+   if (source == -1) return false;
+
+   const int destination = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+   if (destination == -1) {
+      close(source);
+
+      return false;
+   }
+
+   bool result = false;
+   struct stat info = {};
+   off_t remaining = 0;
+   char buffer[65536];
+
+   if (fstat(source, &info) != 0) goto cleanup;
+
+   // Match the original permissions, the clone replaces the original when patching.
+   (void)fchmod(destination, info.st_mode & 07777);
+
+   remaining = info.st_size;
+
+#ifdef __linux__
+   // Share the extents outright on file systems with reflinks (btrfs, XFS, bcachefs, ...).
+   if (ioctl(destination, FICLONE, source) == 0) {
+      result = true;
+
+      goto cleanup;
+   }
+
+   // Otherwise let the kernel do the copy, server side for network file systems that allow it.
+   while (remaining > 0) {
+      const ssize_t copied = copy_file_range(source, nullptr, destination, nullptr, (size_t)remaining, 0);
+
+      if (copied <= 0) break;
+
+      remaining -= copied;
+   }
+
+   if (remaining == 0) {
+      result = true;
+
+      goto cleanup;
+   }
+#endif
+
+   // Plain copy of whatever copy_file_range didn't get through.
+   if (lseek(source, info.st_size - remaining, SEEK_SET) == -1) goto cleanup;
+   if (lseek(destination, info.st_size - remaining, SEEK_SET) == -1) goto cleanup;
+
+   while (remaining > 0) {
+      const ssize_t read_size = read(source, buffer, sizeof(buffer));
+
+      if (read_size <= 0) goto cleanup;
+      if (write(destination, buffer, (size_t)read_size) != read_size) goto cleanup;
+
+      remaining -= read_size;
+   }
+
+   result = true;
+
+cleanup:
+   close(source);
+   if (close(destination) != 0) result = false;
+
+   return result;
+}
+
+void copy_file_mode(const char* from, const char* to)
+{
+   struct stat info = {};
+
+   if (not from or stat(from, &info) != 0) return;
+
+   (void)chmod(to, info.st_mode & 07777);
+}
+
+[[nodiscard]] bool resize_file(const char* path, uint64_t size)
+{
+   return truncate(path, (off_t)size) == 0;
+}
+
+[[nodiscard]] bool get_file_identity(const char* path, file_identity& out)
+{
+   out = {};
+
+   struct stat info = {};
+
+   if (stat(path, &info) != 0) return false;
+
+   out.device = (uint64_t)info.st_dev;
+   out.inode = (uint64_t)info.st_ino;
+   out.size = (uint64_t)info.st_size;
+
+#ifdef __APPLE__
+   out.modified = (uint64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+   out.modified = (uint64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+
+   return true;
+}
+
+[[nodiscard]] bool is_directory(const char* path)
+{
+   struct stat info = {};
+
+   return stat(path, &info) == 0 and S_ISDIR(info.st_mode);
+}
+
+[[nodiscard]] bool walk_directory(const char* directory,
+                                  void (*callback)(void* context, const char* path,
+                                                   const char* name),
+                                  void* context)
+{
+   DIR* dir = opendir(directory);
+
+   if (not dir) return false;
+
+   while (const dirent* entry = readdir(dir)) {
+      if (strcmp(entry->d_name, ".") == 0 or strcmp(entry->d_name, "..") == 0) continue;
+
+      char* path = join_path(directory, entry->d_name, '/');
+
+      if (not path) continue;
+
+      // lstat so links to directories aren't followed, they can form cycles.
+      struct stat info = {};
+
+      if (lstat(path, &info) == 0) {
+         if (S_ISDIR(info.st_mode)) {
+            (void)walk_directory(path, callback, context);
+         }
+         else if (S_ISREG(info.st_mode)) {
+            callback(context, path, entry->d_name);
+         }
+      }
+
+      free(path);
+   }
+
+   closedir(dir);
+
+   return true;
+}
+
+void init_cstdio() {}
+
+#endif
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
 /// @brief Aquire a temporary file using a base file path.
 /// @param base_file_path The base file path.
 /// @return The temporary file path. Must be passed to free if not null.
@@ -11,5 +15,96 @@
 /// @return If moving the file succeeded or not.
 [[nodiscard]] bool move_file(const char* from, const char* to);
 
-/// @brief Call AttachConsole and initialize the CRT's stdio.
+/// @brief Portable fopen.
+/// @return The file, or null if it couldn't be opened.
+[[nodiscard]] FILE* open_file(const char* path, const char* mode);
+
+/// @brief Seek to an offset from the start of a file. Offsets past 2 GB work on every platform,
+/// unlike with fseek.
+[[nodiscard]] bool seek_file(FILE* file, size_t offset);
+
+/// @brief Get the size of a file and seek back to its start.
+[[nodiscard]] bool get_file_size(FILE* file, size_t& out_size);
+
+/// @brief Write a file through a temporary file moved over it, so the file at the path is either
+/// the old one or the whole new one.
+/// @param prefix The prefix of the temporary file's name, see aquire_temp_file.
+/// @return If writing the file succeeded or not. The temporary file is removed either way.
+[[nodiscard]] bool save_file(const char* path, const char* prefix, const void* data, size_t size);
+
+/// @brief A file mapped into memory as a private copy-on-write view. Writes to data never reach
+/// the file, only the pages that are written to are copied.
+struct mapped_file {
+   uint8_t* data = nullptr;
+   size_t size = 0;
+};
+
+/// @brief Map a file as a private copy-on-write view.
+/// @param file_path The file to map.
+/// @param out The mapping. Must be passed to unmap_file when no longer needed.
+/// @return If mapping the file succeeded or not.
+[[nodiscard]] bool map_file_copy_on_write(const char* file_path, mapped_file& out);
+
+/// @brief Map a file as a read-only view. Writing to data faults.
+/// @param file_path The file to map.
+/// @param out The mapping. Must be passed to unmap_file when no longer needed.
+/// @return If mapping the file succeeded or not.
+[[nodiscard]] bool map_file_read_only(const char* file_path, mapped_file& out);
+
+/// @brief Unmap a file mapped by map_file_copy_on_write or map_file_read_only. Resets the mapping.
+void unmap_file(mapped_file& file);
+
+/// @brief Copy a file, replacing any already existing file at the destination. Uses a reflink or
+/// an in-kernel copy where the platform and file system support it.
+/// @param from The file to copy.
+/// @param to The path to copy the file to.
+/// @return If copying the file succeeded or not.
+[[nodiscard]] bool clone_file(const char* from, const char* to);
+
+/// @brief Give a file the permissions of another, so a temporary file written in full keeps the
+/// executable bits of the file it replaces. mkstemp creates files readable by the owner only.
+/// Does nothing on Windows or if from doesn't exist.
+void copy_file_mode(const char* from, const char* to);
+
+/// @brief Truncate or extend a file in place. Bytes added by extending it are zero.
+/// @param path The file to resize.
+/// @param size The new size of the file.
+/// @return If resizing the file succeeded or not.
+[[nodiscard]] bool resize_file(const char* path, uint64_t size);
+
+/// @brief What identifies a version of a file without reading it. Any write or replacement of
+/// the file changes it.
+struct file_identity {
+   /// @brief The device, or on Windows the volume serial number.
+   uint64_t device = 0;
+   /// @brief The inode, or on Windows the file index.
+   uint64_t inode = 0;
+   uint64_t size = 0;
+   /// @brief The last modification time, in the platform's units.
+   uint64_t modified = 0;
+};
+
+/// @brief Get the identity of a file from its metadata. The file's contents aren't read.
+/// @return False if the file doesn't exist or isn't accessible.
+[[nodiscard]] bool get_file_identity(const char* path, file_identity& out);
+
+/// @brief Check if a path names a directory.
+[[nodiscard]] bool is_directory(const char* path);
+
+/// @brief Recursively visit every regular file under a directory. Symbolic links and junctions
+/// to directories are not followed.
+/// @param directory The directory to walk.
+/// @param callback Called with the full path and the file name of each file.
+/// @param context Passed through to callback.
+/// @return False if the directory couldn't be opened.
+[[nodiscard]] bool walk_directory(const char* directory,
+                                  void (*callback)(void* context, const char* path,
+                                                   const char* name),
+                                  void* context);
+
+/// @brief Portable strdup.
+/// @return The copy. Must be passed to free if not null.
+[[nodiscard]] char* duplicate_string(const char* string);
+
+/// @brief Call AttachConsole and initialize the CRT's stdio. Does nothing outside of Windows.
 void init_cstdio();
\ No newline at end of file
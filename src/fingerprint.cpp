@@ -0,0 +1,45 @@
+#include "fingerprint.hpp"
+#include "patch_table.hpp"
+#include "slim_vector.hpp"
+
+#include <stdlib.h>
+
+bool fingerprint_exe(const exe_patcher& editor, uint32_t& out) noexcept
+{
+   out = 0;
+
+   // Every list's sites are masked, not just the ones of the build being fingerprinted, as the
+   // build isn't known yet. Sites of other builds only hide a few extra bytes.
+   slim_vector<byte_range> masked;
+
+   const auto mask = [&](patch_address address, uint32_t size) {
+      size_t offset = 0;
+
+      if (editor.resolve(address, size, offset)) masked.push_back({offset, size});
+   };
+
+   for (const exe_patch_list& list : patch_lists) {
+      for (const patch_set& set : list.patches) {
+         for (const patch& patch : set.patches) mask(patch.address, sizeof(uint32_t));
+         for (const code_patch& patch : set.code_patches) mask(patch.address, patch.length());
+         for (const trampoline& patch : set.trampolines) mask(patch.address, patch.length());
+      }
+   }
+
+   qsort(masked.data(), masked.size(), sizeof(byte_range),
+         [](const void* left, const void* right) -> int {
+            const size_t left_offset = static_cast<const byte_range*>(left)->offset;
+            const size_t right_offset = static_cast<const byte_range*>(right)->offset;
+
+            return (left_offset > right_offset) - (left_offset < right_offset);
+         });
+
+   uint32_t hash = 0;
+
+   if (not editor.hash_sections(masked.data(), masked.size(), hash)) return false;
+
+   // 0 means no fingerprint in the patch lists.
+   out = hash != 0 ? hash : 1;
+
+   return true;
+}
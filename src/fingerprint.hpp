@@ -0,0 +1,13 @@
+#pragma once
+
+#include "exe_patcher.hpp"
+
+#include <stdint.h>
+
+/// @brief Fingerprint an executable. The fingerprint is the CRC-32C of its section data with the
+/// sites of every patch in every list hashed as zeros, so a build has the same fingerprint before
+/// and after patching while builds differing anywhere else get different ones.
+/// @param editor The loaded executable.
+/// @param out The fingerprint, never 0 on success.
+/// @return False if the executable isn't a PE image or couldn't be read.
+[[nodiscard]] bool fingerprint_exe(const exe_patcher& editor, uint32_t& out) noexcept;
@@ -270,7 +270,11 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM l
          char* file = PickFile(hWnd);
 
          if (file) {
-            if (apply(file, PrintToTextBox)) {
+            apply_options options;
+
+            options.journal = true;
+
+            if (apply(file, PrintToTextBox, options)) {
                MessageBoxW(hwndMain, L"Executable patched successfully. You can now close this tool.",
                            L"Success", MB_OK);
             }
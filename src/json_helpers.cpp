@@ -0,0 +1,89 @@
+#include "json_helpers.hpp"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// print functions take no context, so the open file is kept here.
+static FILE* json_lines_file = nullptr;
+
+void print_json_string(int (*print)(const char* format, ...), const char* string)
+{
+   print("\"");
+
+   const char* run = string;
+
+   for (const char* c = string;; ++c) {
+      const unsigned char character = (unsigned char)*c;
+      const bool escape = character == '"' or character == '\\' or
+                          (character < 0x20 and character != '\0');
+
+      if (not escape and character != '\0') continue;
+
+      // Print the unescaped run before this character in one go.
+      if (c != run) print("%.*s", (int)(c - run), run);
+
+      if (character == '\0') break;
+
+      switch (character) {
+      case '"':
+         print("\\\"");
+         break;
+      case '\\':
+         print("\\\\");
+         break;
+      case '\n':
+         print("\\n");
+         break;
+      case '\r':
+         print("\\r");
+         break;
+      case '\t':
+         print("\\t");
+         break;
+      default:
+         print("\\u%04x", character);
+         break;
+      }
+
+      run = c + 1;
+   }
+
+   print("\"");
+}
+
+bool open_json_lines(const char* file_path)
+{
+   if (json_lines_file) (void)close_json_lines();
+
+#ifdef _WIN32
+   if (fopen_s(&json_lines_file, file_path, "ab") != 0) json_lines_file = nullptr;
+#else
+   json_lines_file = fopen(file_path, "ab");
+#endif
+
+   return json_lines_file != nullptr;
+}
+
+int print_json_lines(const char* format, ...)
+{
+   if (not json_lines_file) return -1;
+
+   va_list args;
+
+   va_start(args, format);
+   const int length = vfprintf(json_lines_file, format, args);
+   va_end(args);
+
+   return length;
+}
+
+bool close_json_lines()
+{
+   if (not json_lines_file) return true;
+
+   const bool result = fclose(json_lines_file) == 0;
+
+   json_lines_file = nullptr;
+
+   return result;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+/// @brief Print a string as a quoted JSON string, escaping quotes, backslashes and control
+/// characters. Paths on Windows are full of backslashes.
+void print_json_string(int (*print)(const char* format, ...), const char* string);
+
+/// @brief Open a file to append JSON lines to through print_json_lines. One file can be open at a
+/// time and only one thread may print to it.
+/// @return False if the file couldn't be opened.
+[[nodiscard]] bool open_json_lines(const char* file_path);
+
+/// @brief A printf style function printing to the file opened by open_json_lines. Does nothing if
+/// no file is open.
+int print_json_lines(const char* format, ...);
+
+/// @brief Close the file opened by open_json_lines.
+/// @return False if the file couldn't be written.
+bool close_json_lines();
@@ -0,0 +1,169 @@
+#include "library_api.hpp"
+#include "apply_patches.hpp"
+#include "capacities.hpp"
+
+#include <string.h>
+
+static_assert(capacity_id_count > 1);
+
+// apply reports through a printf style function. The library's results are structured, so the
+// text is dropped. Nothing is shared between calls.
+static int print_nothing(const char*, ...)
+{
+   return 0;
+}
+
+static auto status_of(apply_result result) noexcept -> bf2_status
+{
+   switch (result) {
+   case apply_result::patched:
+      return BF2_PATCHED;
+   case apply_result::unrecognized:
+      return BF2_UNRECOGNIZED;
+   case apply_result::invalid_capacities:
+      return BF2_INVALID_CAPACITIES;
+   case apply_result::output_too_small:
+      return BF2_OUTPUT_TOO_SMALL;
+   case apply_result::open_failed:
+   case apply_result::failed:
+   default:
+      return BF2_FAILED;
+   }
+}
+
+/// @brief Apply the settings to the capacities, checking each against its range.
+static bool set_capacities(capacity_values& capacities, const bf2_patch_options& options) noexcept
+{
+   if (options.setting_count != 0 and not options.settings) return false;
+
+   for (size_t i = 0; i < options.setting_count; ++i) {
+      const bf2_capacity_setting& setting = options.settings[i];
+
+      if (not setting.name) return false;
+
+      const capacity_id id = find_capacity(setting.name);
+
+      if (id == capacity_id::none) return false;
+
+      const capacity& known = known_capacities[(uint32_t)id];
+
+      if (setting.value < known.min or setting.value > known.max) return false;
+
+      capacities.values[(uint32_t)id] = setting.value;
+   }
+
+   return true;
+}
+
+bf2_status bf2_patch_image(const uint8_t* image, size_t image_size, uint8_t* output,
+                           size_t output_capacity, const bf2_patch_options* options,
+                           bf2_patch_result* result)
+{
+   bf2_patch_result unused_result;
+   bf2_patch_result& out = result ? *result : unused_result;
+   const bf2_patch_options default_options = {};
+   const bf2_patch_options& patch_options = options ? *options : default_options;
+
+   memset(&out, 0, sizeof(out));
+
+   out.status = BF2_INVALID_ARGUMENT;
+
+   if (not image or not output) return out.status;
+
+   // Writing the output while the image is still being read only works if they're the same
+   // bytes.
+   if (output != image and output < image + image_size and image < output + output_capacity) {
+      return out.status;
+   }
+
+   capacity_values capacities;
+
+   if (not set_capacities(capacities, patch_options)) {
+      out.status = BF2_INVALID_CAPACITIES;
+
+      return out.status;
+   }
+
+   apply_base base;
+
+   if (not base.image.load_memory(image, image_size)) {
+      out.status = BF2_FAILED;
+
+      return out.status;
+   }
+
+   base.list = identify_exe(base.image, base.locator, base.located);
+
+   apply_options apply_options;
+   apply_report report;
+   apply_metrics metrics;
+
+   apply_options.base = &base;
+   apply_options.output_buffer = output;
+   apply_options.output_capacity = output_capacity;
+   apply_options.capacities = &capacities;
+   apply_options.large_address_aware = patch_options.large_address_aware != 0;
+   apply_options.report = &report;
+   apply_options.metrics = &metrics;
+
+   const bool patched = apply("image", print_nothing, apply_options);
+
+   out.status = status_of(report.result);
+   out.build = report.exe_name;
+   out.located = report.located;
+   out.sets_applied = report.sets_applied;
+   out.sets_skipped = report.sets_skipped;
+   out.sites_patched = metrics.sites_patched;
+   out.sites_already_patched = metrics.sites_already_patched;
+   out.output_size = report.output_size;
+
+   // apply stops before planning anything when the image already holds the configuration.
+   if (patched and metrics.sites_patched == 0 and metrics.sites_already_patched == 0) {
+      out.status = BF2_ALREADY_PATCHED;
+   }
+
+   return out.status;
+}
+
+const char* bf2_status_name(bf2_status status)
+{
+   switch (status) {
+   case BF2_PATCHED:
+      return "patched";
+   case BF2_ALREADY_PATCHED:
+      return "already_patched";
+   case BF2_UNRECOGNIZED:
+      return "unrecognized";
+   case BF2_INVALID_CAPACITIES:
+      return "invalid_capacities";
+   case BF2_OUTPUT_TOO_SMALL:
+      return "output_too_small";
+   case BF2_INVALID_ARGUMENT:
+      return "invalid_argument";
+   case BF2_FAILED:
+      return "failed";
+   }
+
+   return "unknown";
+}
+
+uint32_t bf2_capacity_count(void)
+{
+   // capacity_id::none isn't a capacity.
+   return capacity_id_count - 1;
+}
+
+int bf2_get_capacity(uint32_t index, bf2_capacity_info* out)
+{
+   if (not out or index >= bf2_capacity_count()) return 0;
+
+   const capacity& known = known_capacities[index + 1];
+
+   out->name = known.name;
+   out->description = known.description;
+   out->default_value = known.default_value;
+   out->min = known.min;
+   out->max = known.max;
+
+   return 1;
+}
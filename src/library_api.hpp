@@ -0,0 +1,125 @@
+#pragma once
+
+// The patcher as a library, for launchers and servers that patch executables in memory. Every
+// function is reentrant and thread-safe: nothing is kept between calls, nothing is printed and no
+// files are touched. The interface is plain C so it can be loaded from any language.
+//
+// Link the static library, or define BF2_SHARED and link the DLL's import library.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(BF2_EXPORTS)
+#if defined(_WIN32)
+#define BF2_API __declspec(dllexport)
+#else
+#define BF2_API __attribute__((visibility("default")))
+#endif
+#elif defined(BF2_SHARED) && defined(_WIN32)
+#define BF2_API __declspec(dllimport)
+#else
+#define BF2_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief The version of the interface. Bumped when a struct or function changes.
+#define BF2_API_VERSION 1
+
+typedef enum bf2_status {
+   /// @brief The image was patched and written to the output.
+   BF2_PATCHED = 0,
+   /// @brief The image already held the requested patches and capacities. It was copied to the
+   /// output unchanged.
+   BF2_ALREADY_PATCHED = 1,
+   /// @brief The image isn't a build the patcher knows. Nothing was written.
+   BF2_UNRECOGNIZED = 2,
+   /// @brief A capacity has an unknown name or a value out of its range, or the values don't fit
+   /// the build's instructions or address space. Nothing was written.
+   BF2_INVALID_CAPACITIES = 3,
+   /// @brief The output can't hold the patched image. Nothing was written, the result's
+   /// output_size is the size needed.
+   BF2_OUTPUT_TOO_SMALL = 4,
+   /// @brief A pointer was null or the output overlaps the image without being the image.
+   BF2_INVALID_ARGUMENT = 5,
+   /// @brief A patch site holds something unexpected, or the image is malformed. Nothing was
+   /// written.
+   BF2_FAILED = 6,
+} bf2_status;
+
+/// @brief A capacity to patch with other than its default.
+typedef struct bf2_capacity_setting {
+   /// @brief The capacity's name, as listed by bf2_get_capacity.
+   const char* name;
+   uint32_t value;
+} bf2_capacity_setting;
+
+/// @brief How to patch. Zero-initialized options patch with the defaults.
+typedef struct bf2_patch_options {
+   /// @brief Capacities to change from their defaults. May be null if setting_count is 0.
+   const bf2_capacity_setting* settings;
+   size_t setting_count;
+   /// @brief Non-zero to mark the image large address aware and recompute its header checksum.
+   int large_address_aware;
+} bf2_patch_options;
+
+/// @brief What a call to bf2_patch_image did.
+typedef struct bf2_patch_result {
+   bf2_status status;
+   /// @brief The name of the build the image was identified as, null if it wasn't. Points into
+   /// the patch tables and stays valid.
+   const char* build;
+   /// @brief Non-zero if the patch sites were found using signatures instead of a known build's
+   /// id.
+   int located;
+   uint32_t sets_applied;
+   uint32_t sets_skipped;
+   /// @brief Patch sites written.
+   uint32_t sites_patched;
+   /// @brief Patch sites that already held their replacement.
+   uint32_t sites_already_patched;
+   /// @brief The size of the patched image, once it's known. Patching adds sections to the end
+   /// of an image, so it's larger than the input the first time.
+   size_t output_size;
+} bf2_patch_result;
+
+/// @brief Describes a capacity.
+typedef struct bf2_capacity_info {
+   const char* name;
+   const char* description;
+   uint32_t default_value;
+   uint32_t min;
+   uint32_t max;
+} bf2_capacity_info;
+
+/// @brief Patch an executable image held in memory.
+/// @param image The image, for example a buffer filled from a download or a mapped file. Only
+/// read, unless output is the image.
+/// @param image_size The size of the image.
+/// @param output Where to write the patched image. May be image to patch it in place, the
+/// buffer then needs room for what patching adds past image_size. Otherwise it must not overlap
+/// the image.
+/// @param output_capacity The size of output.
+/// @param options How to patch. May be null for the defaults.
+/// @param result Filled in with what happened. May be null.
+/// @return The status, also in result.
+BF2_API bf2_status bf2_patch_image(const uint8_t* image, size_t image_size, uint8_t* output,
+                                   size_t output_capacity, const bf2_patch_options* options,
+                                   bf2_patch_result* result);
+
+/// @brief Get the name of a status, such as "patched".
+BF2_API const char* bf2_status_name(bf2_status status);
+
+/// @brief Get the number of capacities, for bf2_get_capacity.
+BF2_API uint32_t bf2_capacity_count(void);
+
+/// @brief Describe a capacity.
+/// @param index From 0 to bf2_capacity_count() - 1.
+/// @return Zero if the index is out of range.
+BF2_API int bf2_get_capacity(uint32_t index, bf2_capacity_info* out);
+
+#ifdef __cplusplus
+}
+#endif
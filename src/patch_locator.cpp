@@ -0,0 +1,237 @@
+#include "patch_locator.hpp"
+#include "applied_config.hpp"
+#include "capacities.hpp"
+#include "fingerprint.hpp"
+
+#include <string.h>
+
+/// @brief Overlay the bytes a list's patches write onto a signature, giving the signature of an
+/// already patched build.
+static void overlay_patches(const exe_patch_list& list, const capacity_values& capacities,
+                            patch_address address, uint8_t* bytes, uint8_t* mask,
+                            uint32_t length) noexcept
+{
+   const auto overlay = [&](patch_address patch_address, const uint8_t* replacement,
+                            uint32_t replacement_length, bool wildcard) {
+      if (patch_address.space != address.space) return;
+
+      for (uint32_t i = 0; i < replacement_length; ++i) {
+         const int64_t position = (int64_t)patch_address.value + i - address.value;
+
+         if (position < 0 or position >= length) continue;
+
+         bytes[position] = wildcard ? 0 : replacement[i];
+         mask[position] = wildcard ? 0 : 0xff;
+      }
+   };
+
+   for (const patch_set& set : list.patches) {
+      for (const patch& patch : set.patches) {
+         uint32_t value = patch.replacement_value;
+         uint8_t replacement[sizeof(uint32_t)];
+
+         // Addresses in the extension section depend on where it ends up.
+         const bool known = patch.region == es_region_id::none and
+                            (patch.formula.capacity == capacity_id::none or
+                             patch_value(patch, capacities, value));
+
+         memcpy(replacement, &value, sizeof(replacement));
+
+         overlay(patch.address, replacement, sizeof(replacement), not known);
+      }
+
+      for (const code_patch& patch : set.code_patches) {
+         op_layout layout;
+         slim_vector<uint8_t> replacement;
+
+         // Addresses in the extension section depend on where it ends up.
+         const auto resolve_abs32 = [](es_region_id, uint32_t, uint32_t&) { return false; };
+
+         replacement.resize(patch.length());
+
+         const bool known = layout_ops(patch.ops, patch.length(), layout) and
+                            assemble_ops(patch.ops, layout, resolve_abs32, replacement.data());
+
+         overlay(patch.address, known ? replacement.data() : patch.expected.data(),
+                 patch.length(), not known);
+      }
+
+      // The jump depends on where the routine ends up in the code cave section.
+      for (const trampoline& patch : set.trampolines) {
+         overlay(patch.address, patch.expected.data(), patch.length(), true);
+      }
+   }
+}
+
+bool compile_signatures(const exe_patch_list& list, const capacity_values& capacities,
+                        list_signatures& out) noexcept
+{
+   out.scanner = {};
+   out.reference_index.clear();
+   out.references.clear();
+
+   for (const patch_set& set : list.patches) {
+      for (const patch_signature& signature : set.signatures) {
+         uint8_t bytes[max_signature_length];
+         uint8_t mask[max_signature_length];
+         uint32_t length = 0;
+
+         if (not parse_signature(signature.pattern, bytes, mask, length)) return false;
+         if (not out.scanner.add(bytes, mask, length)) return false;
+
+         out.reference_index.push_back((uint32_t)out.references.size());
+
+         uint8_t patched_bytes[max_signature_length];
+         uint8_t patched_mask[max_signature_length];
+
+         memcpy(patched_bytes, bytes, length);
+         memcpy(patched_mask, mask, length);
+
+         overlay_patches(list, capacities, signature.address, patched_bytes, patched_mask, length);
+
+         if (memcmp(patched_bytes, bytes, length) != 0 or memcmp(patched_mask, mask, length) != 0) {
+            // A patched form that can't be anchored would leave patched builds unlocatable.
+            if (not out.scanner.add(patched_bytes, patched_mask, length)) return false;
+
+            out.reference_index.push_back((uint32_t)out.references.size());
+         }
+
+         out.references.push_back(signature.address);
+      }
+   }
+
+   return true;
+}
+
+bool patch_locator::scan(const exe_patcher& editor, const exe_patch_list& list)
+{
+   _anchors.clear();
+
+   // Builds patched by this tool record the capacities they were patched with. Builds patched by
+   // earlier releases have the defaults.
+   applied_config config;
+   const capacity_values default_capacities;
+   const bool recorded =
+      read_applied_config(editor, config) and &patch_lists[config.list_index] == &list;
+
+   // Each signature is scanned for as it is in an unpatched build and as it is after patching,
+   // so that patched builds can be located again. Both entries point at the same reference.
+   list_signatures signatures;
+
+   if (not compile_signatures(list, recorded ? config.capacities : default_capacities,
+                              signatures)) {
+      return false;
+   }
+
+   const signature_scanner& scanner = signatures.scanner;
+
+   if (scanner.size() == 0) return false;
+
+   slim_vector<signature_match> matches;
+   slim_vector<signature_match> reference_matches;
+
+   for (size_t i = 0; i < scanner.size(); ++i) matches.push_back({});
+   for (size_t i = 0; i < signatures.references.size(); ++i) reference_matches.push_back({});
+
+   editor.scan_code(scanner, matches.data());
+
+   for (size_t i = 0; i < matches.size(); ++i) {
+      signature_match& reference_match = reference_matches[signatures.reference_index[i]];
+
+      if (matches[i].count != 0 and reference_match.count == 0) {
+         reference_match.offset = matches[i].offset;
+      }
+
+      reference_match.count += matches[i].count;
+   }
+
+   // Ambiguous signatures are useless as anchors, patches near them fall back to another
+   // signature in reach or aren't located at all.
+   for (size_t i = 0; i < signatures.references.size(); ++i) {
+      if (reference_matches[i].count == 1) {
+         _anchors.push_back({signatures.references[i], reference_matches[i].offset});
+      }
+   }
+
+   return _anchors.size() != 0;
+}
+
+bool patch_locator::locate(patch_address address, patch_address& out) const noexcept
+{
+   const anchor* nearest = nullptr;
+   uint32_t nearest_distance = UINT32_MAX;
+
+   for (const anchor& candidate : _anchors) {
+      if (candidate.reference.space != address.space) continue;
+
+      const uint32_t distance = address.value > candidate.reference.value
+                                   ? address.value - candidate.reference.value
+                                   : candidate.reference.value - address.value;
+
+      if (distance < nearest_distance) {
+         nearest = &candidate;
+         nearest_distance = distance;
+      }
+   }
+
+   if (not nearest or nearest_distance > max_signature_reach) return false;
+
+   const int64_t offset =
+      (int64_t)nearest->offset + ((int64_t)address.value - (int64_t)nearest->reference.value);
+
+   if (offset < 0 or offset > UINT32_MAX) return false;
+
+   out = patch_address{(uint32_t)offset};
+
+   return true;
+}
+
+bool patch_locator::can_locate(const patch_set& set) const noexcept
+{
+   patch_address located;
+
+   for (const patch& patch : set.patches) {
+      if (not locate(patch.address, located)) return false;
+   }
+
+   for (const code_patch& patch : set.code_patches) {
+      if (not locate(patch.address, located)) return false;
+   }
+
+   for (const trampoline& patch : set.trampolines) {
+      if (not locate(patch.address, located)) return false;
+   }
+
+   return true;
+}
+
+auto identify_exe(const exe_patcher& editor, patch_locator& locator, bool& located) noexcept
+   -> const exe_patch_list*
+{
+   located = false;
+
+   // Hashing reads every section, skip it until there's a fingerprint to find.
+   if (uint32_t fingerprint = 0;
+       fingerprinted_list_count != 0 and fingerprint_exe(editor, fingerprint)) {
+      if (const exe_patch_list* list = find_patch_list(fingerprint)) return list;
+   }
+
+   // Builds with a fingerprint are only recognized by it, their id may be shared by near
+   // identical builds the list doesn't apply to.
+   for (const exe_patch_list& list : patch_lists) {
+      if (list.fingerprint != 0) continue;
+
+      if (editor.compatible(list.id_address, list.expected_id)) return &list;
+   }
+
+   // Unknown build, try to find the patch sites of a known one by their signatures.
+   for (const exe_patch_list& list : patch_lists) {
+      if (locator.scan(editor, list)) {
+         located = true;
+
+         return &list;
+      }
+   }
+
+   return nullptr;
+}
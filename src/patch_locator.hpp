@@ -0,0 +1,64 @@
+#pragma once
+
+#include "exe_patcher.hpp"
+#include "patch_table.hpp"
+#include "sig_scanner.hpp"
+#include "slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct capacity_values;
+
+/// @brief How far from its nearest signature a patch site may be and still be located.
+constexpr uint32_t max_signature_reach = 0x2000;
+
+/// @brief A list's signatures compiled into one scanner, each as it is in an unpatched build and,
+/// if patching changes it, as it is after patching.
+struct list_signatures {
+   signature_scanner scanner;
+   /// @brief The signature in references each of the scanner's patterns was compiled from.
+   slim_vector<uint32_t> reference_index;
+   /// @brief Where each of the list's signatures is in the build the list was written against.
+   slim_vector<patch_address> references;
+};
+
+/// @brief Compile a list's signatures. The patched form of a signature holds the values patching
+/// writes for the capacities, only sites pointing into the extension section are wildcards.
+/// @return False if a signature is malformed or either form has no pair of adjacent fixed bytes
+/// to anchor on.
+[[nodiscard]] bool compile_signatures(const exe_patch_list& list, const capacity_values& capacities,
+                                      list_signatures& out) noexcept;
+
+/// @brief Finds the patch sites of a patch list in a build that has no list of its own, using the
+/// list's signatures. A patch is assumed to have moved by the same amount as the nearest
+/// signature, so signatures should sit in the same function as the patches they anchor. The
+/// expected values of patches are still checked when applying so a bad guess fails safely.
+struct patch_locator {
+   /// @brief Scan the image's code for every signature in the list in a single pass.
+   /// @return False if no signature was found exactly once.
+   [[nodiscard]] bool scan(const exe_patcher& editor, const exe_patch_list& list);
+
+   /// @brief Translate an address from the list's build into a file offset in the scanned image.
+   [[nodiscard]] bool locate(patch_address address, patch_address& out) const noexcept;
+
+   /// @brief Check if every patch and code patch in a set can be located.
+   [[nodiscard]] bool can_locate(const patch_set& set) const noexcept;
+
+private:
+   struct anchor {
+      patch_address reference;
+      size_t offset = 0;
+   };
+
+   slim_vector<anchor> _anchors;
+};
+
+/// @brief Find the patch list for an executable, by its fingerprint or build id or failing that by
+/// signatures.
+/// @param editor The loaded executable.
+/// @param locator Scanned with the list's signatures when the executable isn't a known build.
+/// @param located Set if the list was found through signatures and locator must be used.
+/// @return The list, or null if the executable wasn't recognized.
+[[nodiscard]] auto identify_exe(const exe_patcher& editor, patch_locator& locator,
+                                bool& located) noexcept -> const exe_patch_list*;
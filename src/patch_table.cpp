@@ -1,23 +1,58 @@
 #include "patch_table.hpp"
+#include "crc32c.hpp"
+
+#include <string.h>
+
+constexpr uint32_t DLC_mission_size = 0x110;
+constexpr uint32_t DLC_mission_patch_limit = 0x1000;
+constexpr uint32_t matrixPool_size = 0x30d400;
+constexpr uint32_t hiRezPatchArea = 0x1000;
+constexpr uint32_t soldierAnimator_object_size = 0x2020;
+constexpr uint32_t soldierAnimator_header_size = 0x10;
+
+// Capacities, indexed by capacity_id. The defaults are the values the patches were written with.
+// The FLRenderer::Init buffers are numbered in the order their sizes appear in the function. The
+// DLC mission count is kept right after the stock game's 50 missions, so the region needs room for
+// at least one more.
+
+static constexpr capacity capacity_table[capacity_id_count] = {
+   capacity{},
+   capacity{"dlc_missions", "DLC missions that can be installed", DLC_mission_patch_limit, 0x33,
+            0x10000},
+   capacity{"matrix_pool", "Size of the render matrix pool", matrixPool_size, 0x0bf6, 0x4000000},
+   capacity{"hirez_units", "Units animated at high resolution", 0x64, 0x0a, 1000},
+   capacity{"lod_class_max_cost", "Cap on RedLODManager class costs", 0x7c, 0x50, 1000},
+   capacity{"fl_init_1", "FLRenderer::Init buffer, 1000 in the stock game", 0x2710, 0x3e8, 0x1000000},
+   capacity{"fl_init_2", "FLRenderer::Init buffer, 100 in the stock game", 0x3e8, 0x64, 0x1000000},
+   capacity{"fl_init_3", "FLRenderer::Init buffer, 10000 in the stock game", 0x130b0, 0x2710,
+            0x1000000},
+   capacity{"fl_init_4", "FLRenderer::Init buffer, 100000 in the stock game", 0xf4240, 0x186a0,
+            0x1000000},
+   capacity{"fl_init_5", "FLRenderer::Init buffer, 1000 in the stock game", 0x2710, 0x3e8, 0x1000000},
+   capacity{"fl_init_6", "FLRenderer::Init buffer, 50000 in the stock game", 0x30d40, 0xc350,
+            0x1000000},
+   capacity{"red_heap_main", "Bytes in the main RedMemory heap", 0x8000000, 0x4000000, 0x60000000,
+            true},
+   capacity{"red_heap_debug", "Bytes in the debug RedMemory heap", 0x400000, 0x200000, 0x10000000,
+            true},
+   capacity{"app_heap", "Bytes in the App Heap", 0x1400000, 0xf40000, 0x10000000, true},
+};
 
-const static uint32_t DLC_mission_size = 0x110;
-const static uint32_t DLC_mission_patch_limit = 0x1000;
-const static uint32_t matrixPool_size = 0x30d400;
-const static uint32_t hiRezPatchArea = 0x1000;
-
-enum es_layout : uint32_t {
-   ES_DLC_START = 0,
-   ES_DLC_END = ES_DLC_START + (DLC_mission_size * DLC_mission_patch_limit),
-
-   //ES_END = ES_DLC_END,
+// Extension section regions, laid out at patch time by plan_es_layout.
 
-   ES_MATRIX_START = ES_DLC_END,
-   ES_MATRIX_END = ES_MATRIX_START + matrixPool_size,
+constexpr es_region dlc_mission_regions[] = {
+   es_region{es_region_id::dlc_missions, "DLC Missions", DLC_mission_size, 16, es_hotness::cold,
+             capacity_id::dlc_missions},
+};
 
-   ES_HIREZ_START = ES_MATRIX_END,
-   ES_HIREZ_END = ES_HIREZ_START + hiRezPatchArea,
+// The pool is indexed by RedRenderer::AllocMatrixInCache for every primitive drawn.
+constexpr es_region matrix_pool_regions[] = {
+   es_region{es_region_id::matrix_pool, "Matrix Pool", 1, 16, es_hotness::hot,
+             capacity_id::matrix_pool},
+};
 
-   ES_END = ES_HIREZ_END,
+constexpr es_region hirez_regions[] = {
+   es_region{es_region_id::hirez_area, "Hi Rez Patch Area", hiRezPatchArea, 16, es_hotness::cold},
 };
 
 // SoldierAnimatorClass::_PostLoad dynamic loop patch
@@ -25,7 +60,7 @@ enum es_layout : uint32_t {
 // that reads the object count from the array header at [EDX-0x10].
 // Original: 437 bytes of unrolled per-object init code
 // Replacement: 64-byte loop + 373 bytes NOP fill
-static const uint8_t soldierAnimator_loop_expected[] = {
+constexpr uint8_t soldierAnimator_loop_expected[] = {
    0x8b, 0x13, 0x8b, 0x7b, 0x14, 0x8d, 0x43, 0x04, 0x8d, 0x8a, 0xa0, 0x00, 0x00, 0x00, 0x47, 0x89,
    0x78, 0x10, 0x89, 0x51, 0x0c, 0x89, 0x01, 0x89, 0x41, 0x04, 0x8b, 0x50, 0x08, 0x89, 0x51, 0x08,
    0x89, 0x48, 0x08, 0x8b, 0x51, 0x08, 0x89, 0x4a, 0x04, 0x8b, 0x0b, 0x8b, 0x70, 0x10, 0x8d, 0x91,
@@ -56,365 +91,797 @@ static const uint8_t soldierAnimator_loop_expected[] = {
    0x41, 0x08, 0x89, 0x48, 0x04,
 };
 
-static const uint8_t soldierAnimator_loop_replacement[] = {
-   // Dynamic loop: reads count from [EDX-0x10], iterates with IMUL for offset calc
-   0x8b, 0x13, 0x8b, 0x4a, 0xf0, 0x33, 0xf6, 0x8d, 0x43, 0x04, 0x3b, 0xf1, 0x0f, 0x8d, 0xa3, 0x01,
-   0x00, 0x00, 0x8b, 0x13, 0x51, 0x8b, 0xce, 0x69, 0xc9, 0x20, 0x20, 0x00, 0x00, 0x03, 0xca, 0x8d,
-   0xb9, 0xa0, 0x00, 0x00, 0x00, 0xff, 0x43, 0x14, 0x89, 0x4f, 0x0c, 0x89, 0x07, 0x89, 0x47, 0x04,
-   0x8b, 0x50, 0x08, 0x89, 0x57, 0x08, 0x89, 0x78, 0x08, 0x89, 0x7a, 0x04, 0x59, 0x46, 0xeb, 0xca,
-   // NOP fill for remaining unused space
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
-   0x90, 0x90, 0x90, 0x90, 0x90,
+// Dynamic loop: reads the count from the array header at [EDX-0x10] and works out each object's
+// address with IMUL instead of the unrolled code's 10 fixed offsets.
+constexpr uint8_t soldierAnimator_loop_label = 0;
+
+constexpr uint8_t soldierAnimator_loop_setup[] = {
+   0x8b, 0x13,                         // mov edx, [ebx]
+   0x8b, 0x4a, 0xf0,                   // mov ecx, [edx-0x10]
+   0x33, 0xf6,                         // xor esi, esi
+   0x8d, 0x43, 0x04,                   // lea eax, [ebx+0x4]
+};
+
+constexpr uint8_t soldierAnimator_loop_test[] = {
+   0x3b, 0xf1,                         // cmp esi, ecx
+   0x0f, 0x8d,                         // jge end
+};
+
+constexpr uint8_t soldierAnimator_loop_body[] = {
+   0x8b, 0x13,                         // mov edx, [ebx]
+   0x51,                               // push ecx
+   0x8b, 0xce,                         // mov ecx, esi
+   0x69, 0xc9, 0x20, 0x20, 0x00, 0x00, // imul ecx, ecx, 0x2020
+   0x03, 0xca,                         // add ecx, edx
+   0x8d, 0xb9, 0xa0, 0x00, 0x00, 0x00, // lea edi, [ecx+0xa0]
+   0xff, 0x43, 0x14,                   // inc dword ptr [ebx+0x14]
+   0x89, 0x4f, 0x0c,                   // mov [edi+0xc], ecx
+   0x89, 0x07,                         // mov [edi], eax
+   0x89, 0x47, 0x04,                   // mov [edi+0x4], eax
+   0x8b, 0x50, 0x08,                   // mov edx, [eax+0x8]
+   0x89, 0x57, 0x08,                   // mov [edi+0x8], edx
+   0x89, 0x78, 0x08,                   // mov [eax+0x8], edi
+   0x89, 0x7a, 0x04,                   // mov [edx+0x4], edi
+   0x59,                               // pop ecx
+   0x46,                               // inc esi
+   0xeb,                               // jmp loop
+};
+
+constexpr patch_op soldierAnimator_loop_replacement[] = {
+   op_bytes(soldierAnimator_loop_setup),
+   op_label(soldierAnimator_loop_label),
+   op_bytes(soldierAnimator_loop_test),
+   op_rel32(end_label),
+   op_bytes(soldierAnimator_loop_body),
+   op_rel8(soldierAnimator_loop_label),
+   op_fill(x86_nop),
 };
 
 // Function names matched from BF1 Mac executable. Could be wrong in cases.
 
+// Signatures are built from bytes known from the patches themselves, with wildcards over anything
+// else. They let builds without a list of their own be patched (see patch_locator). The Matrix
+// Pool Fix has none, every byte known around its sites is an absolute address that moves between
+// builds.
+
 // clang-format off
 
-const exe_patch_list patch_lists[EXE_COUNT] = {
+// Battlefront SWBFspy
+
+constexpr patch spy_red_memory_patches[] = {
+   scaled_patch(0x1ec651, 0x4000000, capacity_id::red_heap_main), // Startup_RedInitHeap (main)
+   scaled_patch(0x1ec65c, 0x4000000, capacity_id::red_heap_main), // Startup_RedInitHeap
+   scaled_patch(0x1ec66d, 0x200000, capacity_id::red_heap_debug), // Startup_RedInitHeap (debug)
+   scaled_patch(0x9dace, 0xf40000, capacity_id::app_heap), // Increase App Heap from 15.5 to 31 MB
+};
+
+constexpr patch_signature spy_red_memory_signatures[] = {
+   // The App Heap patch is found through the AddDownloadableContent signature.
+   patch_signature{"00 00 00 04 ?? ?? ?? ?? ?? ?? ?? 00 00 00 04 ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? 00 00 20 00", 0x1ec651}, // Startup_RedInitHeap
+};
+
+// SoundParameterized Layer Limit Extension
+   //patch{0x3e170c, 0xa0, 0x2000},
+
+constexpr patch spy_dlc_patches[] = {
+   //patch{0x9d52f, 0x32, DLC_mission_patch_limit, true},                    // AddDownloadableContent
+   //disable the limit... wait for Dave to crash game.
+   patch{0x9d52d, 0x0f32f883, 0x90909090},// AddDownloadableContent
+   patch{0x9d531, 0x8c8d, 0x90909090},// AddDownloadableContent
+   patch{0x9d535, 0x4c8d5300, 0x4c8d5390},// AddDownloadableContent
+
+   //move out to new location in memory
+   patch{0x9d550, 0x734328, 0, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0x9d573, 0x73432c, 0x73432c - 0x734328, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0x9d579, 0x734330, 0x734330 - 0x734328, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0x9d57e, 0x737848, 0x737848 - 0x734328, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0x9d5a2, 0x734433, 0x734433 - 0x734328, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0x9d5ae, 0x734434, 0x734434 - 0x734328, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0x9d40c, 0x734328, 0, es_region_id::dlc_missions}, // SetCurrentMap
+   patch{0x9d44c, 0x73432c, 0x73432c - 0x734328, es_region_id::dlc_missions}, // SetCurrentMission
+   patch{0x9d490, 0x734330, 0x734330 - 0x734328, es_region_id::dlc_missions}, // GetContentDirectory
+   patch{0x9d4d2, 0x73432c, 0x73432c - 0x734328, es_region_id::dlc_missions}, // IsMissionDownloaded
+   patch{0x9d37a, 0x737848, 0x737848 - 0x734328, es_region_id::dlc_missions}, // AddMissionCommon?
+};
+
+constexpr patch_signature spy_dlc_signatures[] = {
+   patch_signature{"83 F8 32 0F 8D ?? ?? ?? ?? 53 8D 4C", 0x9d52d}, // AddDownloadableContent
+};
+
+constexpr patch spy_spawn_patches[] = {
+   //Allow 10 units
+   patch{0x1a94b2, 0x0f05ff83, 0x0f0Aff83}, // SlotWindow Loop (SpawnDisplay::Initialize)
+   patch{0x1a9985, 0x7c05ff83, 0x7c0Aff83}, // Unit Selection Loop (SpawnDisplay::UpdateInput)
+
+   //resize heap
+   patch{0x1a7e47, 0x2340, 0x2740}, //SpawnDisplay::Create
+
+   //patch Team Switcher
+   patch{0x1a91c1, 0x0590, 0x2350}, //SpawnDisplay::Initialize
+   patch{0x1a97fb, 0x0580, 0x2340}, //SpawnDisplay::UpdateInput
+   patch{0x1a9856, 0x0590, 0x2350}, //SpawnDisplay::UpdateInput
+   patch{0x1a987b, 0x0594, 0x2354}, //SpawnDisplay::UpdateInput
+
+   //patch hiding the team switcher when not in IA - 1/8/25
+   patch{0x1a8d7c, 0x0588, 0x2348}, //SpawnDisplay::Show
+   patch{0x1a8d85, 0x0580, 0x2340}, //SpawnDisplay::Show
+   patch{0x1a8d8e, 0x0590, 0x2350}, //SpawnDisplay::Show
+   patch{0x1a8d97, 0x058c, 0x234c}, //SpawnDisplay::Show
+   patch{0x1a8da0, 0x0584, 0x2344}, //SpawnDisplay::Show
+   patch{0x1a8da9, 0x0594, 0x2354}, //SpawnDisplay::Show
+
+   //patch extra slots not deleting
+   patch(0x1a86bb, 0x7d05f983, 0x7d0af983), //SpawnDisplay::SetupSlots
+   patch(0x1a86c1, 0x05, 0x0a), //SpawnDisplay::SetupSlots
+   patch(0x1a86f3, 0x7c050000, 0x7c0a0000), //SpawnDisplay::SetupSlots
+
+   //patch extra slots not reapplying if different amounts of units were present - 1/12/2025
+   patch(0x1a8690, 0x0914468b, 0x0928468b), //SpawnDisplay::SetupSlots
+   patch(0x1a8696, 0x093c468b, 0x0950468b), //SpawnDisplay::SetupSlots
+
+   //patch text not all appearing, move to end of heap
+   patch(0x1a8008, 0x0530, 0x2500), //SpawnDisplay::UpdateObjectText
+   patch(0x1a8646, 0x0530, 0x2500), //SpawnDisplay::SetupSlots
+   patch(0x1a870B, 0x0530, 0x2500), //SpawnDisplay::SetupSlots
+   patch(0x1a863e, 0xfffffad0, 0xffffdb00), //SpawnDisplay::SetupSlots //woah a negative
+   patch(0x1a9333, 0x0530, 0x2500), //SpawnDisplay::Initialize
+   patch(0x1a9569, 0x0530, 0x2500), //SpawnDisplay::Initialize
+   patch(0x1a98c2, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
+   patch(0x1a9919, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
+   patch(0x1a9A3D, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
+   patch(0x1a9A19, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
+   //30 05 00 00
+
+   patch(0x1a85a4, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo //initially 0x2514
+   patch(0x1a85ae, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
+   patch(0x1a85c5, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
+   patch(0x1a86c8, 0x0544, 0x2528), //SpawnDisplay::SetupSlots
+   patch(0x1a871d, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
+   patch(0x1a98d4, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
+   patch(0x1a9925, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
+   patch(0x1a9a2b, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
+   patch(0x1a9a4a, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
+   //44 05 00 00
+
+   //patch a sub-pointer that was assigning class names
+   patch(0x1a936b, 0xeb146b89, 0xeb286b89), //SpawnDisplay::Initialize **This is to move the class slot names out of the firing range
+   patch(0x1a86d3, 0x21ec488b, 0x21d8488b), //SpawnDisplay::SetupSlots **This one is for not accidentally wiping out the unit names if less than 10 units
+
+   //Hotspot Behavior
+   patch(0x1a9499, 0xe83c6b89, 0xe8506b89), //SpawnDisplay::Initialize
+   patch(0x1a9937, 0x056c, 0x2550), //SpawnDisplay::UpdateInput
+
+};
+
+constexpr patch_signature spy_spawn_signatures[] = {
+   patch_signature{"8B 46 14 09 ?? ?? 8B 46 3C 09", 0x1a8690}, //SpawnDisplay::SetupSlots
+   patch_signature{"88 05 00 00 ?? ?? ?? ?? ?? 80 05 00 00 ?? ?? ?? ?? ?? 90 05 00 00 ?? ?? ?? ?? ?? 8C 05 00 00 ?? ?? ?? ?? ?? 84 05 00 00 ?? ?? ?? ?? ?? 94 05 00 00", 0x1a8d7c}, //SpawnDisplay::Show
+   patch_signature{"30 05 00 00 ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? 44 05 00 00 ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? 30 05 00 00 ?? ?? ?? ?? ?? ?? ?? ?? ?? 44 05 00 00", 0x1a9a19}, //SpawnDisplay::UpdateInput
+};
+
+constexpr patch spy_matrix_patches[] = {
+  //move matrix pool to new location in memory, increase size, should fix sliding
+   patch{0x2c55e + 0x1, 0x01d0d1b0, 0, es_region_id::matrix_pool}, //RedRenderer::AllocMatrixInCache
+   patch{0x2cf23 + 0x1, 0x01d0d1b0, 0, es_region_id::matrix_pool}, //RedRenderer::pcRenderPrimitive
+   patch{0x353f2 + 0x1, 0x01d0d1b0, 0, es_region_id::matrix_pool}, //???
+   patch{0x50f71 + 0x2, 0x01d0d1b0, 0, es_region_id::matrix_pool}, //???
+   scaled_patch(0x2c563 + 0x2, 0x0bf6, capacity_id::matrix_pool), //RedRenderer::AllocMatrixInCache
+   scaled_patch(0x50f77 + 0x2, 0x0bf6, capacity_id::matrix_pool), //???
+   scaled_patch(0x353f7 + 0x2, 0x0bf6, capacity_id::matrix_pool), //???
+   scaled_patch(0x5109b + 0x2, 0x0bf6, capacity_id::matrix_pool), //???
+   scaled_patch(0x356d3 + 0x2, 0x0bf6, capacity_id::matrix_pool), //???
+   scaled_patch(0x355c9 + 0x1, 0x0bf6, capacity_id::matrix_pool), //???
+   scaled_patch(0x35536 + 0x2, 0x0bf6, capacity_id::matrix_pool), //???
+};
+
+constexpr patch spy_hirez_patches[] = {
+   //increase allowable hi-rez units from 10 to 100
+   scaled_patch(0x133bf0, 0x014150, capacity_id::hirez_units, soldierAnimator_object_size, soldierAnimator_header_size), //SoldierAnimatorClass::_PostLoad
+   scaled_patch(0x133c55, 0x014140, capacity_id::hirez_units, soldierAnimator_object_size), //SoldierAnimatorClass::_PostLoad
+   scaled_patch(0x132706, 0x014140, capacity_id::hirez_units, soldierAnimator_object_size), //SoldierAnimatorClass::Destroy
+   imm8_patch(0x133c17, 0x10708d0a, capacity_id::hirez_units, 0), //SoldierAnimatorClass::_PostLoad
+   scaled_patch(0x133c21 + 0x2, 0x0a, capacity_id::hirez_units), //SoldierAnimatorClass::_PostLoad
+   scaled_patch(0x3859b + 0x1, 0x2710, capacity_id::fl_init_3), //FLRenderer::Init -->>>ISSUE
+   //patch{0x3859b + 0x1, 0x2710, 0x27100}, //FLRenderer::Init -->>>ISSUE
+   scaled_patch(0x385cc + 0x1, 0x186a0, capacity_id::fl_init_4), //FLRenderer::Init
+   scaled_patch(0x385e5 + 0x1, 0x3e8, capacity_id::fl_init_5), //FLRenderer::Init
+   scaled_patch(0x3862f + 0x1, 0xc350, capacity_id::fl_init_6), //FLRenderer::Init
+   scaled_patch(0x38593 + 0x1, 0x64, capacity_id::fl_init_2), //FLRenderer::Init
+   imm8_patch(0x63bf8, 0x50fb8345, capacity_id::lod_class_max_cost, 3), //RedLODManager::SetClassMaxCost
+   scaled_patch(0x63bfe + 0x1, 0x50, capacity_id::lod_class_max_cost), //RedLODManager::SetClassMaxCost
+   scaled_patch(0x3858f, 0x03e8, capacity_id::fl_init_1), //FLRenderer::Init
+
+   //5b7265 and 8
+
+};
+
+constexpr code_patch spy_hirez_code_patches[] = {
+   //Replace hardcoded 10-object unrolled init with dynamic loop
+   code_patch{0x133c5b, soldierAnimator_loop_expected, soldierAnimator_loop_replacement},
+};
+
+constexpr patch_signature spy_hirez_signatures[] = {
+   patch_signature{"8B 13 8B 7B 14 8D 43 04 8D 8A A0 00 00 00 47 89 78 10 89 51 0C 89 01 89", 0x133c5b}, //SoldierAnimatorClass::_PostLoad
+   patch_signature{"E8 03 00 00 ?? 64 00 00 00 ?? ?? ?? ?? 10 27 00 00", 0x3858f}, //FLRenderer::Init
+   patch_signature{"45 83 FB 50 ?? ?? ?? 50 00 00 00", 0x63bf8}, //RedLODManager::SetClassMaxCost
+};
+
+// Battlefront SPTest
+
+// RedMemory Heap Extensions
+   //patch{0x2165b1, 0x4000000, 0x10000000}, // malloc call arg
+   //patch{0x2165c7, 0x4000000, 0x10000000}, // malloc'd block end pointer
+
+// SoundParameterized Layer Limit Extension
+   //patch{0x3e170c, 0xa0, 0x2000},
+
+constexpr patch sptest_dlc_patches[] = {
+   //patch{0x9d52f, 0x32, DLC_mission_patch_limit, true},                    // AddDownloadableContent
+   //patch{0x9d52f, 0x32, 0x64, true},                    // AddDownloadableContent
+   patch{0xd8a8, 0x67aef8, 0, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0xd8ca, 0x67aefc, 0x67aefc - 0x67aef8, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0xd8d0, 0x67af00, 0x67af00 - 0x67aef8, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0xd8d5, 0x67e418, 0x67e418 - 0x67aef8, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0xd8f5, 0x67b003, 0x67b003 - 0x67aef8, es_region_id::dlc_missions}, // AddDownloadableContent
+  patch{0xd900, 0x67b004, 0x67b004 - 0x67aef8, es_region_id::dlc_missions}, // AddDownloadableContent
+   patch{0xd7af, 0x67aef8, 0, es_region_id::dlc_missions}, // SetCurrentMap
+   patch{0xd7e4, 0x67aefc, 0x67aefc - 0x67aef8, es_region_id::dlc_missions}, // SetCurrentMission
+   patch{0xd822, 0x67af00, 0x67af00 - 0x67aef8, es_region_id::dlc_missions}, // GetContentDirectory
+  patch{0xd746, 0x67e418, 0x67e418 - 0x67aef8, es_region_id::dlc_missions}, // AddMissionCommon?
+};
+
+// Spawn Screen Fix, not ported yet
+/*constexpr patch sptest_spawn_patches[] = {
+   patch{0x1a94b4, 0x05, 0x0a}, // SlotWindow Loop
+   patch{0x1a9987, 0x05, 0x0a}, // Unit Selection Loop
+   //patch{0x, 0x734328, 0, es_region_id::dlc_missions}
+   //patch{0x1a9987, 0x05, 0x0a}, // Unit Selection Loop
+   //patch{0x1a9987, 0x05, 0x0a}, // Unit Selection Loop
+   //patch{0x1a9987, 0x05, 0x0a}, // Unit Selection Loop
+
+                        //Allow 10 units
+   patch{0x1a94b2, 0x0f05ff83, 0x0f0Aff83}, // SlotWindow Loop (SpawnDisplay::Initialize)
+   patch{0x1a9985, 0x7c05ff83, 0x7c0Aff83}, // Unit Selection Loop (SpawnDisplay::UpdateInput)
+
+   //resize heap
+   patch{0x1a7e47, 0x2340, 0x2740}, //SpawnDisplay::Create
+
+   //patch Team Switcher
+   patch{0x1a91c1, 0x0590, 0x2350}, //SpawnDisplay::Initialize
+   patch{0x1a97fb, 0x0580, 0x2340}, //SpawnDisplay::UpdateInput
+   patch{0x1a9856, 0x0590, 0x2350}, //SpawnDisplay::UpdateInput
+   patch{0x1a987b, 0x0594, 0x2354}, //SpawnDisplay::UpdateInput
+
+   //patch hiding the team switcher when not in IA - 1/8/25
+   patch{0x1a8d7c, 0x0588, 0x2348}, //SpawnDisplay::Show
+   patch{0x1a8d85, 0x0580, 0x2340}, //SpawnDisplay::Show
+   patch{0x1a8d8e, 0x0590, 0x2350}, //SpawnDisplay::Show
+   patch{0x1a8d97, 0x058c, 0x234c}, //SpawnDisplay::Show
+   patch{0x1a8da0, 0x0584, 0x2344}, //SpawnDisplay::Show
+   patch{0x1a8da9, 0x0594, 0x2354}, //SpawnDisplay::Show
+
+   //patch extra slots not deleting
+   patch(0x1a86bb, 0x7d05f983, 0x7d0af983), //SpawnDisplay::SetupSlots
+   patch(0x1a86c1, 0x05, 0x0a), //SpawnDisplay::SetupSlots
+   patch(0x1a86f3, 0x7c050000, 0x7c0a0000), //SpawnDisplay::SetupSlots
+
+   //patch extra slots not reapplying if different amounts of units were present - 1/12/2025
+   patch(0x1a8690, 0x0914468b, 0x0928468b), //SpawnDisplay::SetupSlots
+   patch(0x1a8696, 0x093c468b, 0x0950468b), //SpawnDisplay::SetupSlots
+
+   //patch text not all appearing, move to end of heap
+   patch(0x1a8008, 0x0530, 0x2500), //SpawnDisplay::UpdateObjectText
+   patch(0x1a8646, 0x0530, 0x2500), //SpawnDisplay::SetupSlots
+   patch(0x1a870B, 0x0530, 0x2500), //SpawnDisplay::SetupSlots
+   patch(0x1a863e, 0xfffffad0, 0xffffdb00), //SpawnDisplay::SetupSlots //woah a negative
+   patch(0x1, 0x0530, 0x2500), //SpawnDisplay::Initialize
+   patch(0x1a9569, 0x0530, 0x2500), //SpawnDisplay::Initialize
+   patch(0xd7df3, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
+   patch(0xd7e13, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
+   patch(0xd7ce8, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
+   patch(0xd7d08, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
+   //30 05 00 00
+
+   patch(0x1a85a4, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo //initially 0x2514
+   patch(0x1a85ae, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
+   patch(0x1a85c5, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
+   patch(0x1a86c8, 0x0544, 0x2528), //SpawnDisplay::SetupSlots
+   patch(0x1a871d, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
+   patch(0xd7e00, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
+   patch(0xd7e1e, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
+   patch(0xd7cf5, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
+   patch(0xd7d12, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
+   patch(0x1a9925, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
+   //44 05 00 00
+
+   //patch a sub-pointer that was assigning class names
+   patch(0x1a936b, 0xeb146b89, 0xeb286b89), //SpawnDisplay::Initialize **This is to move the class slot names out of the firing range
+   patch(0x1a86d3, 0x21ec488b, 0x21d8488b), //SpawnDisplay::SetupSlots **This one is for not accidentally wiping out the unit names if less than 10 units
+
+   //Hotspot Behavior
+   patch(0x1a9499, 0xe83c6b89, 0xe8506b89), //SpawnDisplay::Initialize
+   patch(0x1a9937, 0x056c, 0x2550), //SpawnDisplay::UpdateInput
+};*/
+
+// Matrix Pool Fix
+  /* patch{0x18251f + 0x2, 0x01c71100, 0, es_region_id::matrix_pool}, //RedRenderer::AllocMatrixInCache
+   patch{0x182593 + 0x2, 0x01c71100, 0, es_region_id::matrix_pool}, //RedRenderer::pcRenderPrimitive
+   patch{0x186b7d + 0x1, 0x01c71100, 0, es_region_id::matrix_pool}, //???
+   patch{0x186b84 + 0x1, 0x01ca0e80, 0, es_region_id::matrix_pool}, //???
+   patch{0x182599 + 0x2, 0x0bf6, matrixPool_size}, //RedRenderer::AllocMatrixInCache
+   patch{0x182525 + 0x2, 0x0bf6, matrixPool_size}, //???*/
+  /* patch{0x353f7 + 0x2, 0x0bf6, matrixPool_size}, //???
+   patch{0x5109b + 0x2, 0x0bf6, matrixPool_size}, //???
+   patch{0x356d3 + 0x2, 0x0bf6, matrixPool_size}, //???
+   patch{0x355c9 + 0x1, 0x0bf6, matrixPool_size}, //???
+   patch{0x35536 + 0x2, 0x0bf6, matrixPool_size}, //???*/
+
+constexpr patch sptest_hirez_patches[] = {
+   //increase allowable hi-rez units from 10 to 100
+   scaled_patch(0x7e12f, 0x014150, capacity_id::hirez_units, soldierAnimator_object_size, soldierAnimator_header_size), //SoldierAnimatorClass::_PostLoad
+   scaled_patch(0x7e165, 0x014140, capacity_id::hirez_units, soldierAnimator_object_size), //SoldierAnimatorClass::_PostLoad
+  // patch{0x132706, 0x014140, 0xc8c80}, //SoldierAnimatorClass::~SoldierAnimatorClass
+   imm8_patch(0x7e143, 0x5b68590a, capacity_id::hirez_units, 0), //SoldierAnimatorClass::_PostLoad
+   //patch{0x133c21 + 0x2, 0x0a, 0x64}, //SoldierAnimatorClass::_PostLoad
+   // These two don't follow the fl_init capacities, SPTest pushes the second as an imm8.
+   patch{0x192d1f + 0x1, 0x2710, 0x271000}, //FLRenderer::Init
+   patch{0x192d24 + 0x1, 0x24e85364, 0x24e8537f}, //FLRenderer::Init
+};
+
+static constexpr exe_patch_list patch_list_table[EXE_COUNT] = {
    exe_patch_list{
       .name = "Battlefront SWBFspy",
+      .fingerprint = 0,
       .id_address = 0x29c978,
       .expected_id = 0x746163696c707041,
       .patches =
          {
             patch_set{
                .name = "RedMemory Heap Extensions",
-               .patches =
-                  {
-                     patch{0x1ec651, 0x4000000, 0x8000000}, // Startup_RedInitHeap (main)
-                     patch{0x1ec65c, 0x4000000, 0x8000000}, // Startup_RedInitHeap
-                     patch{0x1ec66d, 0x200000, 0x400000}, // Startup_RedInitHeap (debug)
-                     patch{0x9dace, 0xf40000, 0x1400000}, // Increase App Heap from 15.5 to 31 MB
-                  },
+               .patches = spy_red_memory_patches,
+               .signatures = spy_red_memory_signatures,
             },
 
             patch_set{
                .name = "SoundParameterized Layer Limit Extension",
-               .patches =
-                  {
-                     //patch{0x3e170c, 0xa0, 0x2000},
-                  },
             },
 
             patch_set{
                .name = "DLC Mission Limit Extension",
-               .patches =
-                  {
-                     //patch{0x9d52f, 0x32, DLC_mission_patch_limit, true},                    // AddDownloadableContent
-                     //disable the limit... wait for Dave to crash game.
-                     patch{0x9d52d, 0x0f32f883, 0x90909090},// AddDownloadableContent
-                     patch{0x9d531, 0x8c8d, 0x90909090},// AddDownloadableContent
-                     patch{0x9d535, 0x4c8d5300, 0x4c8d5390},// AddDownloadableContent
-
-                     //move out to new location in memory
-                     patch{0x9d550, 0x734328, ES_DLC_START, true},                           // AddDownloadableContent
-                     patch{0x9d573, 0x73432c, (0x73432c - 0x734328) + ES_DLC_START, true},   // AddDownloadableContent
-                     patch{0x9d579, 0x734330, (0x734330 - 0x734328) + ES_DLC_START, true}, // AddDownloadableContent
-                     patch{0x9d57e, 0x737848, (0x737848 - 0x734328) + ES_DLC_START, true}, // AddDownloadableContent
-                     patch{0x9d5a2, 0x734433, (0x734433 - 0x734328) + ES_DLC_START, true}, // AddDownloadableContent
-                     patch{0x9d5ae, 0x734434, (0x734434 - 0x734328) + ES_DLC_START, true}, // AddDownloadableContent
-                     patch{0x9d40c, 0x734328, ES_DLC_START, true},                           // SetCurrentMap
-                     patch{0x9d44c, 0x73432c, (0x73432c - 0x734328) + ES_DLC_START, true}, // SetCurrentMission
-                     patch{0x9d490, 0x734330, (0x734330 - 0x734328) + ES_DLC_START, true}, // GetContentDirectory
-                     patch{0x9d4d2, 0x73432c, (0x73432c - 0x734328) + ES_DLC_START, true}, // IsMissionDownloaded
-                     patch{0x9d37a, 0x737848, (0x737848 - 0x734328) + ES_DLC_START, true}, // AddMissionCommon? 
-                  },
+               .patches = spy_dlc_patches,
+               .signatures = spy_dlc_signatures,
+               .regions = dlc_mission_regions,
             },
 
             patch_set{
                .name = "Spawn Screen Fix",
-               .patches =
-                  {
-                     //Allow 10 units
-                     patch{0x1a94b2, 0x0f05ff83, 0x0f0Aff83}, // SlotWindow Loop (SpawnDisplay::Initialize)
-                     patch{0x1a9985, 0x7c05ff83, 0x7c0Aff83}, // Unit Selection Loop (SpawnDisplay::UpdateInput)
-
-                     //resize heap
-                     patch{0x1a7e47, 0x2340, 0x2740}, //SpawnDisplay::Create
-
-                     //patch Team Switcher
-                     patch{0x1a91c1, 0x0590, 0x2350}, //SpawnDisplay::Initialize
-                     patch{0x1a97fb, 0x0580, 0x2340}, //SpawnDisplay::UpdateInput
-                     patch{0x1a9856, 0x0590, 0x2350}, //SpawnDisplay::UpdateInput
-                     patch{0x1a987b, 0x0594, 0x2354}, //SpawnDisplay::UpdateInput
-
-                     //patch hiding the team switcher when not in IA - 1/8/25
-                     patch{0x1a8d7c, 0x0588, 0x2348}, //SpawnDisplay::Show
-                     patch{0x1a8d85, 0x0580, 0x2340}, //SpawnDisplay::Show
-                     patch{0x1a8d8e, 0x0590, 0x2350}, //SpawnDisplay::Show
-                     patch{0x1a8d97, 0x058c, 0x234c}, //SpawnDisplay::Show
-                     patch{0x1a8da0, 0x0584, 0x2344}, //SpawnDisplay::Show
-                     patch{0x1a8da9, 0x0594, 0x2354}, //SpawnDisplay::Show
-
-                     //patch extra slots not deleting
-                     patch(0x1a86bb, 0x7d05f983, 0x7d0af983), //SpawnDisplay::SetupSlots
-                     patch(0x1a86c1, 0x05, 0x0a), //SpawnDisplay::SetupSlots
-                     patch(0x1a86f3, 0x7c050000, 0x7c0a0000), //SpawnDisplay::SetupSlots
-
-                     //patch extra slots not reapplying if different amounts of units were present - 1/12/2025
-                     patch(0x1a8690, 0x0914468b, 0x0928468b), //SpawnDisplay::SetupSlots
-                     patch(0x1a8696, 0x093c468b, 0x0950468b), //SpawnDisplay::SetupSlots
-
-                     //patch text not all appearing, move to end of heap
-                     patch(0x1a8008, 0x0530, 0x2500), //SpawnDisplay::UpdateObjectText
-                     patch(0x1a8646, 0x0530, 0x2500), //SpawnDisplay::SetupSlots 
-                     patch(0x1a870B, 0x0530, 0x2500), //SpawnDisplay::SetupSlots
-                     patch(0x1a863e, 0xfffffad0, 0xffffdb00), //SpawnDisplay::SetupSlots //woah a negative
-                     patch(0x1a9333, 0x0530, 0x2500), //SpawnDisplay::Initialize
-                     patch(0x1a9569, 0x0530, 0x2500), //SpawnDisplay::Initialize
-                     patch(0x1a98c2, 0x0530, 0x2500), //SpawnDisplay::UpdateInput 
-                     patch(0x1a9919, 0x0530, 0x2500), //SpawnDisplay::UpdateInput 
-                     patch(0x1a9A3D, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
-                     patch(0x1a9A19, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
-                     //30 05 00 00 
-
-                     patch(0x1a85a4, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo //initially 0x2514
-                     patch(0x1a85ae, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
-                     patch(0x1a85c5, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
-                     patch(0x1a86c8, 0x0544, 0x2528), //SpawnDisplay::SetupSlots
-                     patch(0x1a871d, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
-                     patch(0x1a98d4, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     patch(0x1a9925, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     patch(0x1a9a2b, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     patch(0x1a9a4a, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     patch(0x1a9925, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     //44 05 00 00
-
-                     //patch a sub-pointer that was assigning class names
-                     patch(0x1a936b, 0xeb146b89, 0xeb286b89), //SpawnDisplay::Initialize **This is to move the class slot names out of the firing range
-                     patch(0x1a86d3, 0x21ec488b, 0x21d8488b), //SpawnDisplay::SetupSlots **This one is for not accidentally wiping out the unit names if less than 10 units
-
-                     //Hotspot Behavior
-                     patch(0x1a9499, 0xe83c6b89, 0xe8506b89), //SpawnDisplay::Initialize
-                     patch(0x1a9937, 0x056c, 0x2550), //SpawnDisplay::UpdateInput
-
-                  },
+               .patches = spy_spawn_patches,
+               .signatures = spy_spawn_signatures,
             },
 
             patch_set{
                .name = "Matrix Pool Fix",
-               .patches =
-                  {
-                    //move matrix pool to new location in memory, increase size, should fix sliding
-                     patch{0x2c55e + 0x1, 0x01d0d1b0, ES_MATRIX_START, true}, //RedRenderer::AllocMatrixInCache
-                     patch{0x2cf23 + 0x1, 0x01d0d1b0, ES_MATRIX_START, true}, //RedRenderer::pcRenderPrimitive
-                     patch{0x353f2 + 0x1, 0x01d0d1b0, ES_MATRIX_START, true}, //???
-                     patch{0x50f71 + 0x2, 0x01d0d1b0, ES_MATRIX_START, true}, //???
-                     patch{0x2c563 + 0x2, 0x0bf6, matrixPool_size}, //RedRenderer::AllocMatrixInCache
-                     patch{0x50f77 + 0x2, 0x0bf6, matrixPool_size}, //???
-                     patch{0x353f7 + 0x2, 0x0bf6, matrixPool_size}, //???
-                     patch{0x5109b + 0x2, 0x0bf6, matrixPool_size}, //???
-                     patch{0x356d3 + 0x2, 0x0bf6, matrixPool_size}, //???
-                     patch{0x355c9 + 0x1, 0x0bf6, matrixPool_size}, //???
-                     patch{0x35536 + 0x2, 0x0bf6, matrixPool_size}, //???
-                  },
+               .patches = spy_matrix_patches,
+               .regions = matrix_pool_regions,
             },
 
             patch_set{
                .name = "Hi Rez Unit Fix",
-               .patches =
-                  {
-                     //increase allowable hi-rez units from 10 to 100
-                     patch{0x133bf0, 0x014150, 0xc8c90}, //SoldierAnimatorClass::_PostLoad
-                     patch{0x133c55, 0x014140, 0xc8c80}, //SoldierAnimatorClass::_PostLoad
-                     patch{0x132706, 0x014140, 0xc8c80}, //SoldierAnimatorClass::Destroy
-                     patch{0x133c17, 0x10708d0a, 0x10708d64}, //SoldierAnimatorClass::_PostLoad
-                     patch{0x133c21 + 0x2, 0x0a, 0x64}, //SoldierAnimatorClass::_PostLoad
-                     patch{0x3859b + 0x1, 0x2710, 0x130B0}, //FLRenderer::Init -->>>ISSUE
-                     //patch{0x3859b + 0x1, 0x2710, 0x27100}, //FLRenderer::Init -->>>ISSUE
-                     patch{0x385cc + 0x1, 0x186a0, 0xF4240}, //FLRenderer::Init
-                     patch{0x385e5 + 0x1, 0x3e8, 0x2710}, //FLRenderer::Init
-                     patch{0x3862f + 0x1, 0xc350, 0x30D40}, //FLRenderer::Init
-                     patch{0x38593 + 0x1, 0x64, 0x3e8}, //FLRenderer::Init
-                     patch{0x63bf8, 0x50fb8345, 0x7cfb8345}, //RedLODManager::SetClassMaxCost
-                     patch{0x63bfe + 0x1, 0x50, 0x7c}, //RedLODManager::SetClassMaxCost
-                     patch{0x3858f, 0x03e8, 0x2710}, //FLRenderer::Init
-
-                     //5b7265 and 8
-
-                  },
-               .code_patches =
-                  {
-                     //Replace hardcoded 10-object unrolled init with dynamic loop
-                     code_patch{0x133c5b, soldierAnimator_loop_expected,
-                                soldierAnimator_loop_replacement, sizeof(soldierAnimator_loop_expected)},
-                  },
+               .patches = spy_hirez_patches,
+               .code_patches = spy_hirez_code_patches,
+               .signatures = spy_hirez_signatures,
+               .regions = hirez_regions,
             },
          },
    },
 
    exe_patch_list{
       .name = "Battlefront SPTest",
+      .fingerprint = 0,
       .id_address = 0x202164,
       .expected_id = 0x746163696c707041,
       .patches =
          {
             patch_set{
                .name = "RedMemory Heap Extensions",
-               .patches =
-                  {
-                     //patch{0x2165b1, 0x4000000, 0x10000000}, // malloc call arg
-                     //patch{0x2165c7, 0x4000000, 0x10000000}, // malloc'd block end pointer
-                  },
             },
 
             patch_set{
                .name = "SoundParameterized Layer Limit Extension",
-               .patches =
-                  {
-                     //patch{0x3e170c, 0xa0, 0x2000},
-                  },
             },
 
             patch_set{
                .name = "DLC Mission Limit Extension",
-               .patches =
-                  {
-                     //patch{0x9d52f, 0x32, DLC_mission_patch_limit, true},                    // AddDownloadableContent
-                     //patch{0x9d52f, 0x32, 0x64, true},                    // AddDownloadableContent
-                     patch{0xd8a8, 0x67aef8, ES_DLC_START, true},                           // AddDownloadableContent
-                     patch{0xd8ca, 0x67aefc, (0x67aefc - 0x67aef8) + ES_DLC_START, true},   // AddDownloadableContent
-                     patch{0xd8d0, 0x67af00, (0x67af00 - 0x67aef8) + ES_DLC_START, true}, // AddDownloadableContent
-                     patch{0xd8d5, 0x67e418, (0x67e418 - 0x67aef8) + ES_DLC_START, true}, // AddDownloadableContent
-                     patch{0xd8f5, 0x67b003, (0x67b003 - 0x67aef8) + ES_DLC_START, true}, // AddDownloadableContent
-                    patch{0xd900, 0x67b004, (0x67b004 - 0x67aef8) + ES_DLC_START, true}, // AddDownloadableContent
-                     patch{0xd7af, 0x67aef8, ES_DLC_START, true},                           // SetCurrentMap
-                     patch{0xd7e4, 0x67aefc, (0x67aefc - 0x67aef8) + ES_DLC_START, true}, // SetCurrentMission
-                     patch{0xd822, 0x67af00, (0x67af00 - 0x67aef8) + ES_DLC_START, true}, // GetContentDirectory
-                    patch{0xd746, 0x67e418, (0x67e418 - 0x67aef8) + ES_DLC_START, true}, // AddMissionCommon?
-                  },
+               .patches = sptest_dlc_patches,
+               .regions = dlc_mission_regions,
             },
 
             patch_set{
-              /* .name = "Spawn Screen Fix",
-               .patches =
-                  {
-                     patch{0x1a94b4, 0x05, 0x0a}, // SlotWindow Loop
-                     patch{0x1a9987, 0x05, 0x0a}, // Unit Selection Loop
-                     //patch{0x, 0x734328, ES_DLC_START, true}
-                     //patch{0x1a9987, 0x05, 0x0a}, // Unit Selection Loop
-                     //patch{0x1a9987, 0x05, 0x0a}, // Unit Selection Loop
-                     //patch{0x1a9987, 0x05, 0x0a}, // Unit Selection Loop
-
-                                          //Allow 10 units
-                     patch{0x1a94b2, 0x0f05ff83, 0x0f0Aff83}, // SlotWindow Loop (SpawnDisplay::Initialize)
-                     patch{0x1a9985, 0x7c05ff83, 0x7c0Aff83}, // Unit Selection Loop (SpawnDisplay::UpdateInput)
-
-                     //resize heap
-                     patch{0x1a7e47, 0x2340, 0x2740}, //SpawnDisplay::Create
-
-                     //patch Team Switcher
-                     patch{0x1a91c1, 0x0590, 0x2350}, //SpawnDisplay::Initialize
-                     patch{0x1a97fb, 0x0580, 0x2340}, //SpawnDisplay::UpdateInput
-                     patch{0x1a9856, 0x0590, 0x2350}, //SpawnDisplay::UpdateInput
-                     patch{0x1a987b, 0x0594, 0x2354}, //SpawnDisplay::UpdateInput
-
-                     //patch hiding the team switcher when not in IA - 1/8/25
-                     patch{0x1a8d7c, 0x0588, 0x2348}, //SpawnDisplay::Show
-                     patch{0x1a8d85, 0x0580, 0x2340}, //SpawnDisplay::Show
-                     patch{0x1a8d8e, 0x0590, 0x2350}, //SpawnDisplay::Show
-                     patch{0x1a8d97, 0x058c, 0x234c}, //SpawnDisplay::Show
-                     patch{0x1a8da0, 0x0584, 0x2344}, //SpawnDisplay::Show
-                     patch{0x1a8da9, 0x0594, 0x2354}, //SpawnDisplay::Show
-
-                     //patch extra slots not deleting
-                     patch(0x1a86bb, 0x7d05f983, 0x7d0af983), //SpawnDisplay::SetupSlots
-                     patch(0x1a86c1, 0x05, 0x0a), //SpawnDisplay::SetupSlots
-                     patch(0x1a86f3, 0x7c050000, 0x7c0a0000), //SpawnDisplay::SetupSlots
-
-                     //patch extra slots not reapplying if different amounts of units were present - 1/12/2025
-                     patch(0x1a8690, 0x0914468b, 0x0928468b), //SpawnDisplay::SetupSlots
-                     patch(0x1a8696, 0x093c468b, 0x0950468b), //SpawnDisplay::SetupSlots
-
-                     //patch text not all appearing, move to end of heap
-                     patch(0x1a8008, 0x0530, 0x2500), //SpawnDisplay::UpdateObjectText
-                     patch(0x1a8646, 0x0530, 0x2500), //SpawnDisplay::SetupSlots 
-                     patch(0x1a870B, 0x0530, 0x2500), //SpawnDisplay::SetupSlots
-                     patch(0x1a863e, 0xfffffad0, 0xffffdb00), //SpawnDisplay::SetupSlots //woah a negative
-                     patch(0x1, 0x0530, 0x2500), //SpawnDisplay::Initialize
-                     patch(0x1a9569, 0x0530, 0x2500), //SpawnDisplay::Initialize
-                     patch(0xd7df3, 0x0530, 0x2500), //SpawnDisplay::UpdateInput 
-                     patch(0xd7e13, 0x0530, 0x2500), //SpawnDisplay::UpdateInput 
-                     patch(0xd7ce8, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
-                     patch(0xd7d08, 0x0530, 0x2500), //SpawnDisplay::UpdateInput
-                     //30 05 00 00 
-
-                     patch(0x1a85a4, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo //initially 0x2514
-                     patch(0x1a85ae, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
-                     patch(0x1a85c5, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
-                     patch(0x1a86c8, 0x0544, 0x2528), //SpawnDisplay::SetupSlots
-                     patch(0x1a871d, 0x0544, 0x2528), //SpawnDisplay::SetSlotInfo
-                     patch(0xd7e00, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     patch(0xd7e1e, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     patch(0xd7cf5, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     patch(0xd7d12, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     patch(0x1a9925, 0x0544, 0x2528), //SpawnDisplay::UpdateInput
-                     //44 05 00 00
-
-                     //patch a sub-pointer that was assigning class names
-                     patch(0x1a936b, 0xeb146b89, 0xeb286b89), //SpawnDisplay::Initialize **This is to move the class slot names out of the firing range
-                     patch(0x1a86d3, 0x21ec488b, 0x21d8488b), //SpawnDisplay::SetupSlots **This one is for not accidentally wiping out the unit names if less than 10 units
-
-                     //Hotspot Behavior
-                     patch(0x1a9499, 0xe83c6b89, 0xe8506b89), //SpawnDisplay::Initialize
-                     patch(0x1a9937, 0x056c, 0x2550), //SpawnDisplay::UpdateInput
-
-                  },*/
+               /* .name = "Spawn Screen Fix",
+               .patches = sptest_spawn_patches, */
             },
+
             patch_set{
                .name = "Matrix Pool Fix",
-               .patches =
-                  {
-                    //move matrix pool to new location in memory, increase size, should fix sliding
-                    /* patch{0x18251f + 0x2, 0x01c71100, ES_MATRIX_START, true}, //RedRenderer::AllocMatrixInCache
-                     patch{0x182593 + 0x2, 0x01c71100, ES_MATRIX_START, true}, //RedRenderer::pcRenderPrimitive
-                     patch{0x186b7d + 0x1, 0x01c71100, ES_MATRIX_START, true}, //???
-                     patch{0x186b84 + 0x1, 0x01ca0e80, ES_MATRIX_START, true}, //???
-                     patch{0x182599 + 0x2, 0x0bf6, matrixPool_size}, //RedRenderer::AllocMatrixInCache
-                     patch{0x182525 + 0x2, 0x0bf6, matrixPool_size}, //???*/
-                    /* patch{0x353f7 + 0x2, 0x0bf6, matrixPool_size}, //???
-                     patch{0x5109b + 0x2, 0x0bf6, matrixPool_size}, //???
-                     patch{0x356d3 + 0x2, 0x0bf6, matrixPool_size}, //???
-                     patch{0x355c9 + 0x1, 0x0bf6, matrixPool_size}, //???
-                     patch{0x35536 + 0x2, 0x0bf6, matrixPool_size}, //???*/
-                  },
             },
 
             patch_set{
                .name = "Hi Rez Unit Fix",
-               .patches =
-                  {
-                     //increase allowable hi-rez units from 10 to 100
-                     patch{0x7e12f, 0x014150, 0xc8c90}, //SoldierAnimatorClass::_PostLoad
-                     patch{0x7e165, 0x014140, 0xc8c80}, //SoldierAnimatorClass::_PostLoad
-                    // patch{0x132706, 0x014140, 0xc8c80}, //SoldierAnimatorClass::~SoldierAnimatorClass
-                     patch{0x7e143, 0x5b68590a, 0x5b685964}, //SoldierAnimatorClass::_PostLoad
-                     //patch{0x133c21 + 0x2, 0x0a, 0x64}, //SoldierAnimatorClass::_PostLoad
-                     patch{0x192d1f + 0x1, 0x2710, 0x271000}, //FLRenderer::Init
-                     patch{0x192d24 + 0x1, 0x24e85364, 0x24e8537f}, //FLRenderer::Init
-                  },
+               .patches = sptest_hirez_patches,
+               .regions = hirez_regions,
             },
          },
    },
 };
 
-extern const uint32_t ext_section_size = ES_END;
\ No newline at end of file
+// clang-format on
+
+/// @brief The bytes a patch or code patch covers.
+struct site_range {
+   patch_address address;
+   uint32_t size = 0;
+};
+
+template<typename Callback>
+constexpr bool for_each_site(const exe_patch_list& list, Callback&& callback)
+{
+   for (const patch_set& set : list.patches) {
+      for (const patch& patch : set.patches) {
+         if (not callback(site_range{patch.address, sizeof(uint32_t)})) return false;
+      }
+
+      for (const code_patch& patch : set.code_patches) {
+         if (not callback(site_range{patch.address, patch.length()})) return false;
+      }
+
+      for (const trampoline& patch : set.trampolines) {
+         if (not callback(site_range{patch.address, patch.length()})) return false;
+      }
+   }
+
+   return true;
+}
+
+constexpr bool ranges_overlap(site_range left, site_range right)
+{
+   // Sites in different address spaces can't be compared without an image.
+   if (left.address.space != right.address.space) return false;
+
+   return left.address.value < right.address.value + right.size and
+          right.address.value < left.address.value + left.size;
+}
+
+/// @brief Check that no two sites in any list overlap, across all of a list's sets. Patches in a
+/// list are applied to the same image so an overlap means one patch breaks another's expected
+/// value, or the same patch is listed twice.
+consteval bool sites_are_disjoint(const exe_patch_list (&lists)[EXE_COUNT])
+{
+   for (const exe_patch_list& list : lists) {
+      const bool disjoint = for_each_site(list, [&](site_range site) {
+         uint32_t overlaps = 0;
+
+         for_each_site(list, [&](site_range other) {
+            if (ranges_overlap(site, other)) overlaps += 1;
+
+            return true;
+         });
+
+         // Every site overlaps itself.
+         return overlaps == 1;
+      });
+
+      if (not disjoint) return false;
+   }
+
+   return true;
+}
+
+/// @brief Check that every region is sane and declared once per list, and that every patch
+/// pointing into the extension section points into a region of its own set. A patch pointing
+/// into another set's region would be left dangling when that set isn't applied. Regions
+/// sized by a capacity are checked at its default, check_capacities checks the chosen value.
+consteval bool ext_section_values_in_regions(const exe_patch_list (&lists)[EXE_COUNT])
+{
+   for (const exe_patch_list& list : lists) {
+      bool declared[es_region_id_count] = {};
+
+      for (const patch_set& set : list.patches) {
+         for (const es_region& region : set.regions) {
+            if (region.id == es_region_id::none or declared[(uint32_t)region.id]) return false;
+            if (region.size == 0 or region.alignment == 0) return false;
+            if ((region.alignment & (region.alignment - 1)) != 0) return false;
+
+            declared[(uint32_t)region.id] = true;
+         }
+
+         for (const patch& patch : set.patches) {
+            if (patch.region == es_region_id::none) continue;
+
+            bool inside = false;
+
+            for (const es_region& region : set.regions) {
+               const uint64_t count =
+                  region.capacity == capacity_id::none
+                     ? 1
+                     : capacity_table[(uint32_t)region.capacity].default_value;
+
+               if (region.id == patch.region and patch.replacement_value < region.size * count) {
+                  inside = true;
+               }
+            }
+
+            if (not inside) return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+/// @brief Check that every capacity's default is in its range and that every value derived from
+/// the defaults fits its encoding, so patching with no capacities set can't fail on them.
+consteval bool formulas_fit_defaults(const exe_patch_list (&lists)[EXE_COUNT])
+{
+   for (uint32_t i = 1; i < capacity_id_count; ++i) {
+      const capacity& capacity = capacity_table[i];
+
+      if (capacity.min > capacity.default_value or capacity.default_value > capacity.max) {
+         return false;
+      }
+   }
+
+   if (capacity_table[0].max != 0) return false;
+
+   for (const exe_patch_list& list : lists) {
+      for (const patch_set& set : list.patches) {
+         for (const patch& patch : set.patches) {
+            const value_formula& formula = patch.formula;
+
+            if (formula.capacity == capacity_id::none) continue;
+            if (patch.region != es_region_id::none) return false;
+
+            uint32_t value = 0;
+
+            if (not evaluate_formula(formula, patch.expected_value,
+                                     capacity_table[(uint32_t)formula.capacity].default_value,
+                                     value)) {
+               return false;
+            }
+         }
+
+         for (const es_region& region : set.regions) {
+            if (region.capacity == capacity_id::none) continue;
+
+            const uint64_t size =
+               (uint64_t)region.size * capacity_table[(uint32_t)region.capacity].max;
+
+            if (size > UINT32_MAX / 2) return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+/// @brief Check that every code patch's ops assemble to exactly the bytes it replaces, that every
+/// trampoline's routine assembles, that 8-bit jumps reach their labels and that addresses only
+/// point into regions of the op's own set.
+consteval bool code_ops_assemble(const exe_patch_list (&lists)[EXE_COUNT])
+{
+   for (const exe_patch_list& list : lists) {
+      for (const patch_set& set : list.patches) {
+         const auto resolve_abs32 = [&](es_region_id id, uint32_t offset, uint32_t& out) {
+            out = 0;
+
+            for (const es_region& region : set.regions) {
+               if (region.id == id and offset < region.size) return true;
+            }
+
+            return false;
+         };
+
+         op_layout layout;
+
+         for (const code_patch& patch : set.code_patches) {
+            if (patch.length() == 0) return false;
+            if (not layout_ops(patch.ops, patch.length(), layout)) return false;
+            if (not assemble_ops(patch.ops, layout, resolve_abs32, nullptr)) return false;
+         }
+
+         for (const trampoline& trampoline : set.trampolines) {
+            if (not layout_ops(trampoline.routine, 0, layout)) return false;
+            if (not assemble_ops(trampoline.routine, layout, resolve_abs32, nullptr)) return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+/// @brief Check that no two lists share a fingerprint, either would be found for it.
+consteval bool fingerprints_are_unique(const exe_patch_list (&lists)[EXE_COUNT])
+{
+   for (uint32_t i = 0; i < EXE_COUNT; ++i) {
+      for (uint32_t j = i + 1; j < EXE_COUNT; ++j) {
+         if (lists[i].fingerprint != 0 and lists[i].fingerprint == lists[j].fingerprint) {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+static_assert(sites_are_disjoint(patch_list_table), "Patch sites within a patch list overlap.");
+static_assert(ext_section_values_in_regions(patch_list_table),
+              "Extension section patch or region out of range.");
+static_assert(fingerprints_are_unique(patch_list_table), "Patch lists share a fingerprint.");
+static_assert(code_ops_assemble(patch_list_table),
+              "A code patch's ops don't assemble to the size of the code it replaces.");
+static_assert(formulas_fit_defaults(patch_list_table),
+              "Capacity default out of range or derived value doesn't fit its encoding.");
+
+/// @brief At least twice as many slots as lists, rounded up to a power of two, so probe
+/// sequences stay short.
+consteval auto fingerprint_slot_count() -> uint32_t
+{
+   uint32_t count = 4;
+
+   while (count < EXE_COUNT * 2) count *= 2;
+
+   return count;
+}
+
+/// @brief Open addressed table of list indices keyed on fingerprint. CRC-32C is already well
+/// mixed so the low bits pick the slot and collisions probe linearly.
+struct fingerprint_index {
+   static constexpr uint32_t slot_count = fingerprint_slot_count();
+
+   /// @brief The index of the list in the slot plus one, 0 for an empty slot.
+   uint8_t slots[slot_count] = {};
+};
+
+static_assert(EXE_COUNT < UINT8_MAX, "fingerprint_index slots can't hold every list index.");
+
+consteval auto make_fingerprint_index(const exe_patch_list (&lists)[EXE_COUNT])
+   -> fingerprint_index
+{
+   fingerprint_index index;
+
+   for (uint32_t i = 0; i < EXE_COUNT; ++i) {
+      if (lists[i].fingerprint == 0) continue;
+
+      uint32_t slot = lists[i].fingerprint % fingerprint_index::slot_count;
+
+      while (index.slots[slot] != 0) slot = (slot + 1) % fingerprint_index::slot_count;
+
+      index.slots[slot] = (uint8_t)(i + 1);
+   }
+
+   return index;
+}
+
+consteval auto count_fingerprinted_lists(const exe_patch_list (&lists)[EXE_COUNT]) -> uint32_t
+{
+   uint32_t count = 0;
+
+   for (const exe_patch_list& list : lists) {
+      if (list.fingerprint != 0) count += 1;
+   }
+
+   return count;
+}
+
+static constexpr fingerprint_index patch_list_index = make_fingerprint_index(patch_list_table);
+
+auto find_patch_list(uint32_t fingerprint) noexcept -> const exe_patch_list*
+{
+   if (fingerprint == 0) return nullptr;
+
+   uint32_t slot = fingerprint % fingerprint_index::slot_count;
+
+   // The table is never full, so an empty slot always ends the probe.
+   while (const uint8_t entry = patch_list_index.slots[slot]) {
+      if (patch_list_table[entry - 1].fingerprint == fingerprint) {
+         return &patch_list_table[entry - 1];
+      }
+
+      slot = (slot + 1) % fingerprint_index::slot_count;
+   }
+
+   return nullptr;
+}
+
+auto code_cave_size(const exe_patch_list& list, const bool (&enabled)[PATCH_COUNT]) noexcept
+   -> uint32_t
+{
+   uint32_t size = 0;
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      if (not enabled[i]) continue;
+
+      for (const trampoline& trampoline : list.patches[i].trampolines) {
+         size += trampoline.cave_size();
+      }
+   }
+
+   return size;
+}
+
+auto patch_table_hash() noexcept -> uint32_t
+{
+   uint32_t crc = 0;
+
+   const auto hash = [&](const void* data, size_t size) { crc = crc32c(crc, data, size); };
+   const auto hash_string = [&](const char* string) { hash(string, strlen(string) + 1); };
+   const auto hash_address = [&](patch_address address) {
+      hash(&address.value, sizeof(address.value));
+      hash(&address.space, sizeof(address.space));
+   };
+   const auto hash_ops = [&](slim_span<patch_op> ops) {
+      for (const patch_op& op : ops) {
+         hash(&op.kind, sizeof(op.kind));
+         hash(&op.value, sizeof(op.value));
+         hash(&op.region, sizeof(op.region));
+         hash(&op.count, sizeof(op.count));
+         hash(op.bytes.data(), op.bytes.size());
+      }
+   };
+
+   for (const exe_patch_list& list : patch_lists) {
+      hash_string(list.name);
+      hash(&list.fingerprint, sizeof(list.fingerprint));
+      hash(&list.id_address, sizeof(list.id_address));
+      hash(&list.expected_id, sizeof(list.expected_id));
+
+      for (const patch_set& set : list.patches) {
+         hash_string(set.name);
+
+         for (const patch& patch : set.patches) {
+            hash_address(patch.address);
+            hash(&patch.expected_value, sizeof(patch.expected_value));
+            hash(&patch.replacement_value, sizeof(patch.replacement_value));
+            hash(&patch.region, sizeof(patch.region));
+            hash(&patch.formula.capacity, sizeof(patch.formula.capacity));
+            hash(&patch.formula.scale, sizeof(patch.formula.scale));
+            hash(&patch.formula.offset, sizeof(patch.formula.offset));
+            hash(&patch.formula.encoding, sizeof(patch.formula.encoding));
+            hash(&patch.formula.byte, sizeof(patch.formula.byte));
+         }
+
+         for (const code_patch& patch : set.code_patches) {
+            hash_address(patch.address);
+            hash(patch.expected.data(), patch.length());
+            hash_ops(patch.ops);
+         }
+
+         for (const trampoline& patch : set.trampolines) {
+            hash_address(patch.address);
+            hash(patch.expected.data(), patch.length());
+            hash_ops(patch.routine);
+         }
+
+         for (const patch_signature& signature : set.signatures) {
+            hash_string(signature.pattern);
+            hash_address(signature.address);
+         }
+
+         // Changing a region moves the layout, and with it the values patched in.
+         for (const es_region& region : set.regions) {
+            hash(&region.id, sizeof(region.id));
+            hash(&region.size, sizeof(region.size));
+            hash(&region.alignment, sizeof(region.alignment));
+            hash(&region.hotness, sizeof(region.hotness));
+            hash(&region.capacity, sizeof(region.capacity));
+         }
+      }
+   }
+
+   return crc;
+}
+
+const exe_patch_list (&patch_lists)[EXE_COUNT] = patch_list_table;
+
+const capacity (&known_capacities)[capacity_id_count] = capacity_table;
+
+extern const uint32_t fingerprinted_list_count = count_fingerprinted_lists(patch_list_table);
@@ -1,39 +1,488 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
-#include "slim_vector.hpp"
+#include "slim_span.hpp"
 
 #define PATCH_COUNT 6
 #define EXE_COUNT 2
 
+/// @brief How a patch address is interpreted.
+enum class address_space : uint8_t {
+   /// @brief A raw offset into the file.
+   file_offset,
+   /// @brief An address relative to ImageBase, as found in the PE headers.
+   rva,
+   /// @brief An absolute virtual address, as shown by a disassembler.
+   va,
+};
+
+struct patch_address {
+   uint32_t value = 0;
+   address_space space = address_space::file_offset;
+
+   constexpr patch_address() = default;
+
+   constexpr patch_address(uint32_t file_offset) noexcept : value{file_offset} {}
+
+   constexpr patch_address(uint32_t value, address_space space) noexcept
+      : value{value}, space{space}
+   {
+   }
+};
+
+/// @brief A patch address given as a virtual address, translated through the section table.
+constexpr auto va(uint32_t address) noexcept -> patch_address
+{
+   return {address, address_space::va};
+}
+
+/// @brief A patch address given as a relative virtual address, translated through the section table.
+constexpr auto rva(uint32_t address) noexcept -> patch_address
+{
+   return {address, address_space::rva};
+}
+
+/// @brief The limits patch values are derived from. See known_capacities for what each one is.
+enum class capacity_id : uint8_t {
+   none,
+   dlc_missions,
+   matrix_pool,
+   hirez_units,
+   lod_class_max_cost,
+   fl_init_1,
+   fl_init_2,
+   fl_init_3,
+   fl_init_4,
+   fl_init_5,
+   fl_init_6,
+   red_heap_main,
+   red_heap_debug,
+   app_heap,
+};
+
+constexpr uint32_t capacity_id_count = 14;
+
+/// @brief A limit that can be chosen per deployment with /set or a profile.
+struct capacity {
+   const char* name = "";
+   const char* description = "";
+   uint32_t default_value = 0;
+   /// @brief The lowest value the patches work with, usually the stock game's.
+   uint32_t min = 0;
+   uint32_t max = 0;
+   /// @brief The capacity is the size in bytes of a heap the game reserves at startup, counted
+   /// by the address space budget.
+   bool heap = false;
+};
+
+/// @brief How a derived value is encoded in the patched instruction.
+enum class value_encoding : uint8_t {
+   /// @brief A 32 bit immediate. Kept below 2^31 as the game compares them signed.
+   imm32,
+   /// @brief A sign extended 8 bit immediate held in one byte of the patched dword.
+   imm8,
+};
+
+/// @brief A patch value derived from a capacity, capacity * scale + offset.
+struct value_formula {
+   capacity_id capacity = capacity_id::none;
+   uint32_t scale = 1;
+   uint32_t offset = 0;
+   value_encoding encoding = value_encoding::imm32;
+   /// @brief Which byte of the dword holds an imm8. The other bytes keep their expected values.
+   uint8_t byte = 0;
+};
+
+/// @brief Evaluate a formula for a capacity value.
+/// @param expected_value The dword the patch expects, for the bytes around an imm8.
+/// @return False if the value doesn't fit the encoding.
+constexpr bool evaluate_formula(const value_formula& formula, uint32_t expected_value,
+                                uint32_t capacity_value, uint32_t& out) noexcept
+{
+   const uint64_t value = (uint64_t)capacity_value * formula.scale + formula.offset;
+
+   if (formula.encoding == value_encoding::imm8) {
+      if (value > INT8_MAX or formula.byte >= sizeof(uint32_t)) return false;
+
+      const uint32_t shift = formula.byte * 8u;
+
+      out = (expected_value & ~(0xffu << shift)) | ((uint32_t)value << shift);
+
+      return true;
+   }
+
+   if (value > INT32_MAX) return false;
+
+   out = (uint32_t)value;
+
+   return true;
+}
+
+/// @brief The regions of the extension section patch sets can ask for.
+enum class es_region_id : uint8_t { none, dlc_missions, matrix_pool, hirez_area };
+
+constexpr uint32_t es_region_id_count = 4;
+
+/// @brief Hot regions are touched every frame and are placed first, on their own cache lines or
+/// pages. Cold regions are packed together after them.
+enum class es_hotness : uint8_t { cold, hot };
+
+/// @brief A region of the extension section a patch set needs, placed by plan_es_layout.
+struct es_region {
+   es_region_id id = es_region_id::none;
+   const char* name = "";
+   uint32_t size = 0;
+   /// @brief The alignment the data itself needs, a power of two.
+   uint32_t alignment = 1;
+   es_hotness hotness = es_hotness::cold;
+   /// @brief If not none size is the size of one element and the region holds as many as the
+   /// capacity is set to.
+   capacity_id capacity = capacity_id::none;
+};
+
 struct patch {
-   uint32_t address = 0;
+   patch_address address;
    uint32_t expected_value = 0;
    uint32_t replacement_value = 0;
-   bool value_is_ext_section_relative_address = false;
+   /// @brief If not none the replacement value is an offset into this region and the address
+   /// of the region is written instead. The region must be declared by the patch's own set.
+   es_region_id region = es_region_id::none;
+   /// @brief If its capacity isn't none the replacement value is derived from it instead.
+   value_formula formula = {};
+};
+
+/// @brief A patch writing capacity * scale + offset as a 32 bit immediate.
+constexpr auto scaled_patch(patch_address address, uint32_t expected_value, capacity_id capacity,
+                            uint32_t scale = 1, uint32_t offset = 0) noexcept -> patch
+{
+   return {address, expected_value, 0, es_region_id::none,
+           {capacity, scale, offset, value_encoding::imm32}};
+}
+
+/// @brief A patch writing a capacity as the imm8 in one byte of the dword at address.
+constexpr auto imm8_patch(patch_address address, uint32_t expected_value, capacity_id capacity,
+                          uint8_t byte) noexcept -> patch
+{
+   return {address, expected_value, 0, es_region_id::none,
+           {capacity, 1, 0, value_encoding::imm8, byte}};
+}
+
+constexpr uint8_t x86_jmp_rel32 = 0xe9;
+constexpr uint8_t x86_nop = 0x90;
+
+enum class patch_op_kind : uint8_t {
+   /// @brief Copy a run of bytes.
+   bytes,
+   /// @brief Repeat a byte, a number of times or up to the end of the site.
+   fill,
+   /// @brief Mark a position jumps can target. Emits nothing.
+   label,
+   /// @brief The 8-bit displacement from the end of the field to a label.
+   rel8,
+   /// @brief The 32-bit displacement from the end of the field to a label.
+   rel32,
+   /// @brief The address of an offset into an extension section region.
+   abs32,
 };
 
+/// @brief The label at the end of an op stream, defined without an op marking it.
+constexpr uint8_t end_label = 0xff;
+constexpr uint32_t label_count = 256;
+
+/// @brief A fill count that fills the rest of the site.
+constexpr uint32_t fill_to_end = UINT32_MAX;
+
+/// @brief One operation of the streams code is assembled from when it's patched. Displacements
+/// and addresses are worked out from the stream itself, so moving code or resizing a region
+/// can't leave a stale one behind.
+struct patch_op {
+   patch_op_kind kind = patch_op_kind::bytes;
+   /// @brief The byte a fill repeats, or the label an op marks or targets.
+   uint8_t value = 0;
+   es_region_id region = es_region_id::none;
+   /// @brief The number of bytes a fill repeats, or the offset into an abs32's region.
+   uint32_t count = 0;
+   slim_span<uint8_t> bytes;
+};
+
+template<size_t size>
+constexpr auto op_bytes(const uint8_t (&bytes)[size]) noexcept -> patch_op
+{
+   return {patch_op_kind::bytes, 0, es_region_id::none, 0, bytes};
+}
+
+constexpr auto op_fill(uint8_t byte, uint32_t count = fill_to_end) noexcept -> patch_op
+{
+   return {patch_op_kind::fill, byte, es_region_id::none, count, {}};
+}
+
+constexpr auto op_label(uint8_t label) noexcept -> patch_op
+{
+   return {patch_op_kind::label, label, es_region_id::none, 0, {}};
+}
+
+constexpr auto op_rel8(uint8_t label) noexcept -> patch_op
+{
+   return {patch_op_kind::rel8, label, es_region_id::none, 0, {}};
+}
+
+constexpr auto op_rel32(uint8_t label) noexcept -> patch_op
+{
+   return {patch_op_kind::rel32, label, es_region_id::none, 0, {}};
+}
+
+constexpr auto op_abs32(es_region_id region, uint32_t offset = 0) noexcept -> patch_op
+{
+   return {patch_op_kind::abs32, 0, region, offset, {}};
+}
+
+/// @brief Where the labels of an op stream are and how many bytes it assembles to.
+struct op_layout {
+   uint32_t labels[label_count] = {};
+   uint32_t size = 0;
+};
+
+constexpr uint32_t undefined_label = UINT32_MAX;
+
+/// @brief Lay out an op stream.
+/// @param length The size of the site the stream replaces, or 0 if it has none. Only streams
+/// with a site can fill to its end, and they must assemble to exactly its size.
+/// @return False if the stream is malformed: a label defined twice or targeted but not defined,
+/// a fill to the end without a site or a size that doesn't match the site.
+constexpr bool layout_ops(slim_span<patch_op> ops, uint32_t length, op_layout& out) noexcept
+{
+   for (uint32_t& label : out.labels) label = undefined_label;
+
+   uint64_t position = 0;
+
+   for (const patch_op& op : ops) {
+      switch (op.kind) {
+      case patch_op_kind::bytes:
+         position += op.bytes.size();
+         break;
+      case patch_op_kind::fill:
+         if (op.count != fill_to_end) {
+            position += op.count;
+         }
+         else if (length == 0 or position > length) {
+            return false;
+         }
+         else {
+            position = length;
+         }
+         break;
+      case patch_op_kind::label:
+         if (op.value == end_label or out.labels[op.value] != undefined_label) return false;
+
+         out.labels[op.value] = (uint32_t)position;
+         break;
+      case patch_op_kind::rel8:
+         position += 1;
+         break;
+      case patch_op_kind::rel32:
+      case patch_op_kind::abs32:
+         position += sizeof(uint32_t);
+         break;
+      }
+
+      if (position > UINT32_MAX) return false;
+   }
+
+   if (length != 0 and position != length) return false;
+
+   out.size = (uint32_t)position;
+   out.labels[end_label] = out.size;
+
+   for (const patch_op& op : ops) {
+      if ((op.kind == patch_op_kind::rel8 or op.kind == patch_op_kind::rel32) and
+          out.labels[op.value] == undefined_label) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/// @brief Assemble an op stream.
+/// @param layout The stream's layout from layout_ops.
+/// @param resolve_abs32 Called as resolve_abs32(region, offset, uint32_t& out) for each abs32,
+/// returns false if the address isn't known.
+/// @param out layout.size bytes to assemble into, or null to only check the stream.
+/// @return False if an address couldn't be resolved or a label is out of an 8-bit jump's reach.
+template<typename Resolve>
+constexpr bool assemble_ops(slim_span<patch_op> ops, const op_layout& layout,
+                            Resolve&& resolve_abs32, uint8_t* out) noexcept
+{
+   uint32_t position = 0;
+
+   const auto emit = [&](uint32_t value, uint32_t size) {
+      for (uint32_t i = 0; i < size; ++i) {
+         if (out) out[position] = (uint8_t)(value >> (i * 8));
+
+         position += 1;
+      }
+   };
+
+   for (const patch_op& op : ops) {
+      switch (op.kind) {
+      case patch_op_kind::bytes:
+         for (const uint8_t byte : op.bytes) emit(byte, 1);
+         break;
+      case patch_op_kind::fill:
+         for (uint32_t end = op.count == fill_to_end ? layout.size : position + op.count;
+              position < end;) {
+            emit(op.value, 1);
+         }
+         break;
+      case patch_op_kind::label:
+         break;
+      case patch_op_kind::rel8: {
+         const int64_t displacement = (int64_t)layout.labels[op.value] - (position + 1);
+
+         if (displacement < INT8_MIN or displacement > INT8_MAX) return false;
+
+         emit((uint32_t)displacement, 1);
+      } break;
+      case patch_op_kind::rel32: {
+         // Labels and positions are 32-bit, so the displacement wraps as the jump's own does.
+         static_assert(sizeof(layout.labels[0]) == sizeof(uint32_t));
+
+         emit((uint32_t)(layout.labels[op.value] - (position + (uint32_t)sizeof(uint32_t))),
+              (uint32_t)sizeof(uint32_t));
+      } break;
+      case patch_op_kind::abs32: {
+         uint32_t address = 0;
+
+         if (not resolve_abs32(op.region, op.count, address)) return false;
+
+         emit(address, (uint32_t)sizeof(uint32_t));
+      } break;
+      }
+   }
+
+   return true;
+}
+
 struct code_patch {
-   uint32_t address = 0;
-   const uint8_t* expected_bytes = nullptr;
-   const uint8_t* replacement_bytes = nullptr;
-   uint32_t length = 0;
+   patch_address address;
+   /// @brief The code the patch replaces.
+   slim_span<uint8_t> expected;
+   /// @brief The replacement, assembling to exactly as many bytes as are expected.
+   slim_span<patch_op> ops;
+
+   constexpr code_patch() = default;
+
+   template<size_t expected_size, size_t ops_size>
+   constexpr code_patch(patch_address address, const uint8_t (&expected)[expected_size],
+                        const patch_op (&ops)[ops_size]) noexcept
+      : address{address}, expected{expected}, ops{ops}
+   {
+   }
+
+   [[nodiscard]] constexpr auto length() const noexcept -> uint32_t
+   {
+      return (uint32_t)expected.size();
+   }
+};
+
+/// @brief The size of the jmp rel32 a trampoline writes at its site and after its routine.
+constexpr uint32_t trampoline_jump_size = 5;
+
+/// @brief Routines in the code cave section start on this boundary.
+constexpr uint32_t cave_alignment = 16;
+
+/// @brief Moves the code at a site into a routine in the code cave section. The site is replaced
+/// with a jmp rel32 to the routine, padded with NOPs, and the routine ends with a jmp rel32 back to
+/// the first instruction after the site. Routines larger than the site they replace don't have to
+/// fit in place. Jumps within the routine are assembled from its ops, jumps out of it are not
+/// supported.
+struct trampoline {
+   patch_address address;
+   /// @brief The instructions the jump replaces. At least trampoline_jump_size bytes and whole
+   /// instructions, nothing may jump into the middle of them.
+   slim_span<uint8_t> expected;
+   /// @brief The routine. It has no site of its own so it can't fill to its end.
+   slim_span<patch_op> routine;
+
+   constexpr trampoline() = default;
+
+   template<size_t expected_size, size_t routine_size>
+   constexpr trampoline(patch_address address, const uint8_t (&expected)[expected_size],
+                        const patch_op (&routine)[routine_size]) noexcept
+      : address{address}, expected{expected}, routine{routine}
+   {
+      static_assert(expected_size >= trampoline_jump_size,
+                    "trampoline sites must have room for a jmp rel32.");
+   }
+
+   [[nodiscard]] constexpr auto length() const noexcept -> uint32_t
+   {
+      return (uint32_t)expected.size();
+   }
+
+   /// @brief The size the routine assembles to, 0 if it's malformed.
+   [[nodiscard]] constexpr auto routine_size() const noexcept -> uint32_t
+   {
+      op_layout layout;
+
+      return layout_ops(routine, 0, layout) ? layout.size : 0;
+   }
+
+   /// @brief The space the routine and its jump back take in the code cave section.
+   [[nodiscard]] constexpr auto cave_size() const noexcept -> uint32_t
+   {
+      const uint32_t size = routine_size() + trampoline_jump_size;
+
+      return (size + cave_alignment - 1) / cave_alignment * cave_alignment;
+   }
+};
+
+/// @brief A byte pattern (see signature_scanner) used to find patch sites in builds that have no
+/// patch list of their own. Patches are located relative to the nearest signature in their list.
+struct patch_signature {
+   const char* pattern = "";
+   /// @brief Where the first byte of the pattern is in the build the list was written against.
+   patch_address address;
 };
 
 struct patch_set {
    const char* name = "";
-   slim_vector<patch> patches;
-   slim_vector<code_patch> code_patches;
+   slim_span<patch> patches = {};
+   slim_span<code_patch> code_patches = {};
+   /// @brief Code moved into the code cave section. The section is only added if an applied set
+   /// has trampolines.
+   slim_span<trampoline> trampolines = {};
+   slim_span<patch_signature> signatures = {};
+   /// @brief The extension section regions the set's patches point into. Nothing is reserved for
+   /// sets that aren't applied.
+   slim_span<es_region> regions = {};
 };
 
 struct exe_patch_list {
    const char* name = "";
+   /// @brief The build's fingerprint, see fingerprint_exe. Builds are looked up by it first. 0 if
+   /// it hasn't been recorded yet, the build is then recognized by the id below instead.
+   uint32_t fingerprint = 0;
    uint32_t id_address = 0;
    uint64_t expected_id = 0;
 
    const patch_set patches[PATCH_COUNT];
 };
 
-extern const exe_patch_list patch_lists[EXE_COUNT];
-extern const uint32_t ext_section_size;
+extern const exe_patch_list (&patch_lists)[EXE_COUNT];
+extern const capacity (&known_capacities)[capacity_id_count];
+extern const uint32_t fingerprinted_list_count;
+
+/// @brief The space the trampolines of a list's enabled sets take in the code cave section.
+[[nodiscard]] auto code_cave_size(const exe_patch_list& list,
+                                  const bool (&enabled)[PATCH_COUNT]) noexcept -> uint32_t;
+
+/// @brief Hash everything in the patch tables that decides what patching writes. Anything
+/// recorded against a table with a different hash is outdated.
+[[nodiscard]] auto patch_table_hash() noexcept -> uint32_t;
+
+/// @brief Find the patch list for a fingerprint through a hash index built at compile time.
+/// @return The list, or null if no list has the fingerprint.
+[[nodiscard]] auto find_patch_list(uint32_t fingerprint) noexcept -> const exe_patch_list*;
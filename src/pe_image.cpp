@@ -0,0 +1,171 @@
+#include "pe_image.hpp"
+
+#include <string.h>
+
+static_assert(offsetof(pe_dos_header, e_lfanew) == 0x3c);
+static_assert(offsetof(pe_optional_header32, data_directory) == 96);
+
+constexpr size_t nt_signature_size = sizeof(uint32_t);
+constexpr size_t optional_header_directories_offset = offsetof(pe_optional_header32, data_directory);
+
+static bool in_bounds(size_t offset, size_t size, size_t buffer_size) noexcept
+{
+   // Overflow check
+   if (offset + size < offset) return false;
+
+   return offset + size <= buffer_size;
+}
+
+bool pe_image::parse(const uint8_t* data, size_t size) noexcept
+{
+   *this = {};
+
+   if (not data) return false;
+   if (not in_bounds(0, sizeof(pe_dos_header), size)) return false;
+
+   pe_dos_header dos_header;
+
+   memcpy(&dos_header, data, sizeof(pe_dos_header));
+
+   if (dos_header.e_magic != pe_dos_magic) return false;
+
+   const size_t nt_headers_offset = dos_header.e_lfanew;
+   const size_t headers_size = nt_signature_size + sizeof(pe_file_header) + sizeof(pe_optional_header32);
+
+   if (not in_bounds(nt_headers_offset, headers_size, size)) return false;
+
+   uint32_t signature = 0;
+   pe_file_header file_header;
+   uint16_t optional_magic = 0;
+
+   memcpy(&signature, data + nt_headers_offset, sizeof(signature));
+   memcpy(&file_header, data + nt_headers_offset + nt_signature_size, sizeof(pe_file_header));
+   memcpy(&optional_magic, data + nt_headers_offset + nt_signature_size + sizeof(pe_file_header),
+          sizeof(optional_magic));
+
+   if (signature != pe_nt_signature) return false;
+   if (optional_magic != pe_optional_header32_magic) return false;
+   if (file_header.size_of_optional_header < optional_header_directories_offset) return false;
+
+   const size_t section_headers_offset = nt_headers_offset + nt_signature_size +
+                                         sizeof(pe_file_header) + file_header.size_of_optional_header;
+   const size_t section_headers_size = file_header.number_of_sections * sizeof(pe_section_header);
+
+   if (not in_bounds(section_headers_offset, section_headers_size, size)) return false;
+
+   _data = data;
+   _size = size;
+   _nt_headers_offset = nt_headers_offset;
+   _section_headers_offset = section_headers_offset;
+   _section_count = file_header.number_of_sections;
+
+   return true;
+}
+
+bool pe_image::valid() const noexcept
+{
+   return _data != nullptr;
+}
+
+auto pe_image::file_header() const noexcept -> pe_file_header
+{
+   pe_file_header header = {};
+
+   (void)read(file_header_offset(), &header, sizeof(header));
+
+   return header;
+}
+
+auto pe_image::optional_header() const noexcept -> pe_optional_header32
+{
+   pe_optional_header32 header = {};
+   const pe_file_header file_header = this->file_header();
+
+   // Optional headers are allowed to be truncated, only copy what is present. The rest stays
+   // zeroed which matches NumberOfRvaAndSizes.
+   const size_t size = file_header.size_of_optional_header < sizeof(header)
+                          ? file_header.size_of_optional_header
+                          : sizeof(header);
+
+   (void)read(optional_header_offset(), &header, size);
+
+   return header;
+}
+
+auto pe_image::section_count() const noexcept -> uint32_t
+{
+   return _section_count;
+}
+
+auto pe_image::section(uint32_t index) const noexcept -> pe_section_header
+{
+   pe_section_header header = {};
+
+   if (index < _section_count) {
+      (void)read(section_header_offset(index), &header, sizeof(header));
+   }
+
+   return header;
+}
+
+bool pe_image::data_directory(uint32_t index, pe_data_directory& out) const noexcept
+{
+   out = {};
+
+   if (index >= pe_number_of_directory_entries) return false;
+
+   const pe_optional_header32 header = optional_header();
+
+   if (index >= header.number_of_rva_and_sizes) return false;
+
+   out = header.data_directory[index];
+
+   return out.virtual_address != 0 and out.size != 0;
+}
+
+auto pe_image::find_section(const char (&name)[pe_sizeof_short_name]) const noexcept -> int32_t
+{
+   for (uint32_t i = 0; i < _section_count; ++i) {
+      const pe_section_header header = section(i);
+
+      if (memcmp(header.name, name, pe_sizeof_short_name) == 0) return (int32_t)i;
+   }
+
+   return -1;
+}
+
+bool pe_image::can_add_section() const noexcept
+{
+   if (not valid()) return false;
+
+   const size_t end = section_header_offset(_section_count) + sizeof(pe_section_header);
+
+   if (end > _size) return false;
+
+   return end <= optional_header().size_of_headers;
+}
+
+auto pe_image::file_header_offset() const noexcept -> size_t
+{
+   return _nt_headers_offset + nt_signature_size;
+}
+
+auto pe_image::optional_header_offset() const noexcept -> size_t
+{
+   return _nt_headers_offset + nt_signature_size + sizeof(pe_file_header);
+}
+
+auto pe_image::section_header_offset(uint32_t index) const noexcept -> size_t
+{
+   return _section_headers_offset + index * sizeof(pe_section_header);
+}
+
+bool pe_image::read(size_t offset, void* out, size_t size) const noexcept
+{
+   if (not _data) return false;
+   if (not in_bounds(offset, size, _size)) return false;
+
+   memcpy(out, _data + offset, size);
+
+   return true;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// On-disk PE32 structures. These mirror the layouts from winnt.h so the patching core doesn't
+// need Windows headers. Every field is naturally aligned so no packing is required.
+
+constexpr uint16_t pe_dos_magic = 0x5a4d;     // MZ
+constexpr uint32_t pe_nt_signature = 0x4550;  // PE\0\0
+constexpr uint16_t pe_optional_header32_magic = 0x10b;
+
+constexpr uint32_t pe_sizeof_short_name = 8;
+constexpr uint32_t pe_number_of_directory_entries = 16;
+
+constexpr uint16_t pe_file_large_address_aware = 0x0020;
+
+constexpr uint32_t pe_scn_cnt_code = 0x00000020;
+constexpr uint32_t pe_scn_cnt_initialized_data = 0x00000040;
+constexpr uint32_t pe_scn_cnt_uninitialized_data = 0x00000080;
+constexpr uint32_t pe_scn_mem_execute = 0x20000000;
+constexpr uint32_t pe_scn_mem_read = 0x40000000;
+constexpr uint32_t pe_scn_mem_write = 0x80000000;
+
+enum pe_directory : uint32_t {
+   PE_DIRECTORY_EXPORT = 0,
+   PE_DIRECTORY_IMPORT = 1,
+   PE_DIRECTORY_RESOURCE = 2,
+   PE_DIRECTORY_EXCEPTION = 3,
+   PE_DIRECTORY_SECURITY = 4,
+   PE_DIRECTORY_BASERELOC = 5,
+   PE_DIRECTORY_DEBUG = 6,
+};
+
+struct pe_dos_header {
+   uint16_t e_magic;
+   uint16_t e_cblp;
+   uint16_t e_cp;
+   uint16_t e_crlc;
+   uint16_t e_cparhdr;
+   uint16_t e_minalloc;
+   uint16_t e_maxalloc;
+   uint16_t e_ss;
+   uint16_t e_sp;
+   uint16_t e_csum;
+   uint16_t e_ip;
+   uint16_t e_cs;
+   uint16_t e_lfarlc;
+   uint16_t e_ovno;
+   uint16_t e_res[4];
+   uint16_t e_oemid;
+   uint16_t e_oeminfo;
+   uint16_t e_res2[10];
+   uint32_t e_lfanew;
+};
+
+struct pe_file_header {
+   uint16_t machine;
+   uint16_t number_of_sections;
+   uint32_t time_date_stamp;
+   uint32_t pointer_to_symbol_table;
+   uint32_t number_of_symbols;
+   uint16_t size_of_optional_header;
+   uint16_t characteristics;
+};
+
+struct pe_data_directory {
+   uint32_t virtual_address;
+   uint32_t size;
+};
+
+struct pe_optional_header32 {
+   uint16_t magic;
+   uint8_t major_linker_version;
+   uint8_t minor_linker_version;
+   uint32_t size_of_code;
+   uint32_t size_of_initialized_data;
+   uint32_t size_of_uninitialized_data;
+   uint32_t address_of_entry_point;
+   uint32_t base_of_code;
+   uint32_t base_of_data;
+   uint32_t image_base;
+   uint32_t section_alignment;
+   uint32_t file_alignment;
+   uint16_t major_operating_system_version;
+   uint16_t minor_operating_system_version;
+   uint16_t major_image_version;
+   uint16_t minor_image_version;
+   uint16_t major_subsystem_version;
+   uint16_t minor_subsystem_version;
+   uint32_t win32_version_value;
+   uint32_t size_of_image;
+   uint32_t size_of_headers;
+   uint32_t check_sum;
+   uint16_t subsystem;
+   uint16_t dll_characteristics;
+   uint32_t size_of_stack_reserve;
+   uint32_t size_of_stack_commit;
+   uint32_t size_of_heap_reserve;
+   uint32_t size_of_heap_commit;
+   uint32_t loader_flags;
+   uint32_t number_of_rva_and_sizes;
+   pe_data_directory data_directory[pe_number_of_directory_entries];
+};
+
+struct pe_section_header {
+   char name[pe_sizeof_short_name];
+   uint32_t virtual_size;
+   uint32_t virtual_address;
+   uint32_t size_of_raw_data;
+   uint32_t pointer_to_raw_data;
+   uint32_t pointer_to_relocations;
+   uint32_t pointer_to_linenumbers;
+   uint16_t number_of_relocations;
+   uint16_t number_of_linenumbers;
+   uint32_t characteristics;
+};
+
+static_assert(sizeof(pe_dos_header) == 64);
+static_assert(sizeof(pe_file_header) == 20);
+static_assert(sizeof(pe_optional_header32) == 224);
+static_assert(sizeof(pe_section_header) == 40);
+
+/// @brief Zero-copy, bounds checked view of a PE32 image held in memory. The view stores offsets
+/// only, headers are read out by value so callers never hold pointers into the buffer.
+struct pe_image {
+   /// @brief Validate the DOS, NT and optional headers and the section table.
+   /// @param data The image. Must outlive the view.
+   /// @param size The size of the image.
+   /// @return If the buffer holds a well formed PE32 header.
+   [[nodiscard]] bool parse(const uint8_t* data, size_t size) noexcept;
+
+   [[nodiscard]] bool valid() const noexcept;
+
+   [[nodiscard]] auto file_header() const noexcept -> pe_file_header;
+
+   [[nodiscard]] auto optional_header() const noexcept -> pe_optional_header32;
+
+   [[nodiscard]] auto section_count() const noexcept -> uint32_t;
+
+   /// @brief Read a section header. index must be less than section_count().
+   [[nodiscard]] auto section(uint32_t index) const noexcept -> pe_section_header;
+
+   /// @brief Read a data directory.
+   /// @return False if the directory isn't present in the optional header or is empty.
+   [[nodiscard]] bool data_directory(uint32_t index, pe_data_directory& out) const noexcept;
+
+   /// @brief Find a section by name.
+   /// @return The index of the section or -1 if it isn't present.
+   [[nodiscard]] auto find_section(const char (&name)[pe_sizeof_short_name]) const noexcept -> int32_t;
+
+   /// @brief Check if another section header fits between the section table and SizeOfHeaders.
+   [[nodiscard]] bool can_add_section() const noexcept;
+
+   [[nodiscard]] auto file_header_offset() const noexcept -> size_t;
+
+   [[nodiscard]] auto optional_header_offset() const noexcept -> size_t;
+
+   /// @brief The file offset of a section header slot. index may equal section_count() to get
+   /// the offset of the next free slot.
+   [[nodiscard]] auto section_header_offset(uint32_t index) const noexcept -> size_t;
+
+   /// @brief Copy bytes out of the image.
+   /// @return False if the range is out of bounds.
+   [[nodiscard]] bool read(size_t offset, void* out, size_t size) const noexcept;
+
+private:
+   const uint8_t* _data = nullptr;
+   size_t _size = 0;
+
+   size_t _nt_headers_offset = 0;
+   size_t _section_headers_offset = 0;
+   uint32_t _section_count = 0;
+};
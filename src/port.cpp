@@ -0,0 +1,697 @@
+#include "port.hpp"
+#include "sig_scanner.hpp"
+#include "thread_pool.hpp"
+#include "xrefs.hpp"
+
+#include <ctype.h>
+#include <string.h>
+
+constexpr uint32_t port_index_bits = 20;
+constexpr uint32_t port_hash_multiplier = 0x01000193;
+
+/// @brief Sequences of the context are taken this far apart.
+constexpr uint32_t port_gram_step = 4;
+
+/// @brief Sequences found in more places than this, common prologues and the like, don't vote.
+constexpr uint32_t max_gram_matches = 8;
+
+constexpr uint8_t x86_call_rel32 = 0xe8;
+constexpr uint8_t x86_two_byte_opcode = 0x0f;
+constexpr uint8_t x86_jcc_rel32 = 0x80;
+
+/// @brief An executable section's raw data within a code_copy.
+struct code_range {
+   size_t offset = 0;
+   size_t position = 0;
+   size_t size = 0;
+};
+
+/// @brief The executable sections of an image copied out side by side, as they are and with the
+/// operands that change between builds zeroed.
+struct code_copy {
+   slim_vector<uint8_t> bytes;
+   slim_vector<uint8_t> normalized;
+   slim_vector<code_range> ranges;
+
+   [[nodiscard]] auto find_range(size_t position) const noexcept -> const code_range*
+   {
+      for (const code_range& range : ranges) {
+         if (position - range.position < range.size) return &range;
+      }
+
+      return nullptr;
+   }
+
+   [[nodiscard]] bool to_position(size_t offset, size_t& out) const noexcept
+   {
+      for (const code_range& range : ranges) {
+         if (offset - range.offset < range.size) {
+            out = range.position + (offset - range.offset);
+
+            return true;
+         }
+      }
+
+      return false;
+   }
+};
+
+/// @brief Every informative sequence of a code_copy's normalized bytes, bucketed by hash.
+struct gram_index {
+   slim_vector<uint32_t> bucket_starts;
+   slim_vector<uint32_t> positions;
+};
+
+static auto load_dword(const uint8_t* data) noexcept -> uint32_t
+{
+   uint32_t value = 0;
+
+   memcpy(&value, data, sizeof(value));
+
+   return value;
+}
+
+/// @brief Copy out the executable sections and zero relocated operands and relative
+/// displacements. Without base relocations any dword pointing into the image is taken as
+/// relocated.
+static bool load_code(const exe_patcher& editor, code_copy& out) noexcept
+{
+   const pe_image& image = editor.image();
+
+   if (not image.valid()) return false;
+
+   for (uint32_t i = 0; i < image.section_count(); ++i) {
+      const pe_section_header section = image.section(i);
+
+      if ((section.characteristics & (pe_scn_cnt_code | pe_scn_mem_execute)) == 0) continue;
+
+      size_t size = section.size_of_raw_data;
+
+      if (section.virtual_size != 0 and section.virtual_size < size) size = section.virtual_size;
+
+      code_range range;
+
+      range.position = out.bytes.size();
+      range.size = size;
+
+      if (size == 0) continue;
+      if (not editor.resolve({section.virtual_address, address_space::rva}, (uint32_t)size,
+                             range.offset)) {
+         continue;
+      }
+
+      out.bytes.resize(range.position + size);
+
+      if (not editor.read(range.offset, out.bytes.data() + range.position, size)) return false;
+
+      out.ranges.push_back(range);
+   }
+
+   out.normalized = out.bytes;
+
+   const pe_optional_header32 header = image.optional_header();
+   slim_vector<uint32_t> relocations;
+   const bool relocated = read_relocations(editor, relocations);
+
+   for (const uint32_t rva : relocations) {
+      size_t offset = 0;
+      size_t position = 0;
+
+      if (not editor.resolve({rva, address_space::rva}, sizeof(uint32_t), offset)) continue;
+      if (not out.to_position(offset, position)) continue;
+      if (position + sizeof(uint32_t) > out.normalized.size()) continue;
+
+      memset(out.normalized.data() + position, 0, sizeof(uint32_t));
+   }
+
+   for (const code_range& range : out.ranges) {
+      const uint8_t* bytes = out.bytes.data() + range.position;
+      uint8_t* normalized = out.normalized.data() + range.position;
+
+      for (size_t i = 0; i + sizeof(uint32_t) <= range.size; ++i) {
+         const size_t remaining = range.size - i;
+
+         if ((bytes[i] == x86_call_rel32 or bytes[i] == x86_jmp_rel32) and remaining >= 5) {
+            memset(normalized + i + 1, 0, sizeof(uint32_t));
+         }
+
+         if (bytes[i] == x86_two_byte_opcode and remaining >= 6 and
+             (bytes[i + 1] & 0xf0) == x86_jcc_rel32) {
+            memset(normalized + i + 2, 0, sizeof(uint32_t));
+         }
+
+         if (not relocated and load_dword(bytes + i) - header.image_base < header.size_of_image) {
+            memset(normalized + i, 0, sizeof(uint32_t));
+         }
+      }
+   }
+
+   return true;
+}
+
+/// @brief Runs of a single byte, padding and masked operands, match everywhere and say nothing.
+static bool informative(const uint8_t* gram) noexcept
+{
+   return memcmp(gram, gram + 1, port_gram_length - 1) != 0;
+}
+
+static auto gram_hash(const uint8_t* gram) noexcept -> uint32_t
+{
+   uint32_t hash = 0;
+
+   for (uint32_t i = 0; i < port_gram_length; ++i) hash = hash * port_hash_multiplier + gram[i];
+
+   return hash;
+}
+
+/// @brief The polynomial hash's high bits barely depend on the last bytes, mix them in first.
+static auto bucket_of(uint32_t hash) noexcept -> uint32_t
+{
+   return (hash * 0x9e3779b1u) >> (32 - port_index_bits);
+}
+
+static void build_index(const code_copy& code, gram_index& out) noexcept
+{
+   const size_t bucket_count = (size_t)1 << port_index_bits;
+   const uint8_t* data = code.normalized.data();
+
+   slim_vector<uint32_t> buckets;
+
+   buckets.resize(code.normalized.size());
+
+   memset(buckets.data(), 0xff, buckets.size() * sizeof(uint32_t));
+
+   out.bucket_starts.resize(bucket_count + 1);
+
+   memset(out.bucket_starts.data(), 0, out.bucket_starts.size() * sizeof(uint32_t));
+
+   uint32_t outgoing_factor = 1;
+
+   for (uint32_t i = 1; i < port_gram_length; ++i) outgoing_factor *= port_hash_multiplier;
+
+   // Sequences don't span sections, the bytes between them aren't loaded next to each other.
+   for (const code_range& range : code.ranges) {
+      if (range.size < port_gram_length) continue;
+
+      const size_t end = range.position + range.size - port_gram_length;
+      uint32_t hash = gram_hash(data + range.position);
+
+      for (size_t position = range.position;; ++position) {
+         if (informative(data + position)) {
+            buckets[position] = bucket_of(hash);
+            out.bucket_starts[buckets[position] + 1] += 1;
+         }
+
+         if (position == end) break;
+
+         hash = (hash - data[position] * outgoing_factor) * port_hash_multiplier +
+                data[position + port_gram_length];
+      }
+   }
+
+   for (size_t i = 0; i < bucket_count; ++i) out.bucket_starts[i + 1] += out.bucket_starts[i];
+
+   slim_vector<uint32_t> cursors = out.bucket_starts;
+
+   out.positions.resize(out.bucket_starts[bucket_count]);
+
+   for (size_t position = 0; position < buckets.size(); ++position) {
+      if (buckets[position] == UINT32_MAX) continue;
+
+      out.positions[cursors[buckets[position]]++] = (uint32_t)position;
+   }
+}
+
+struct port_vote {
+   int64_t delta = 0;
+   uint32_t count = 0;
+};
+
+struct port_context {
+   const exe_patcher* source = nullptr;
+   const exe_patch_list* list = nullptr;
+   const code_copy* source_code = nullptr;
+   const code_copy* target_code = nullptr;
+   const gram_index* index = nullptr;
+   uint32_t image_base = 0;
+   uint32_t image_size = 0;
+
+   slim_vector<ported_site> sites[PATCH_COUNT];
+};
+
+/// @brief Find a site of the source in the target by the sequences of its context.
+/// @param target_position The site's position in the target's code_copy, valid if found.
+static void port_site(const port_context& context, patch_address address, uint32_t size,
+                      ported_site& site, size_t& target_position) noexcept
+{
+   const code_copy& source = *context.source_code;
+   const code_copy& target = *context.target_code;
+   const gram_index& index = *context.index;
+   size_t source_offset = 0;
+   size_t position = 0;
+
+   if (not context.source->resolve(address, size, source_offset)) return;
+   if (not source.to_position(source_offset, position)) return;
+
+   const code_range* range = source.find_range(position);
+
+   if (position + size > range->position + range->size) return;
+
+   const size_t window_begin =
+      position - (position - range->position < port_context_size ? position - range->position
+                                                                 : port_context_size);
+   const size_t window_end = range->position + range->size - (position + size) < port_context_size
+                                ? range->position + range->size
+                                : position + size + port_context_size;
+
+   slim_vector<port_vote> votes;
+
+   for (size_t gram = window_begin; gram + port_gram_length <= window_end;
+        gram += port_gram_step) {
+      const uint8_t* bytes = source.normalized.data() + gram;
+
+      if (not informative(bytes)) continue;
+
+      const uint32_t bucket = bucket_of(gram_hash(bytes));
+      uint32_t matches[max_gram_matches + 1];
+      uint32_t match_count = 0;
+
+      for (uint32_t i = index.bucket_starts[bucket]; i < index.bucket_starts[bucket + 1]; ++i) {
+         const uint32_t candidate = index.positions[i];
+
+         if (memcmp(target.normalized.data() + candidate, bytes, port_gram_length) != 0) continue;
+
+         matches[match_count++] = candidate;
+
+         if (match_count > max_gram_matches) break;
+      }
+
+      if (match_count > max_gram_matches) continue;
+
+      for (uint32_t i = 0; i < match_count; ++i) {
+         const int64_t delta = (int64_t)matches[i] - (int64_t)gram;
+         bool counted = false;
+
+         for (size_t j = 0; j < votes.size(); ++j) {
+            if (votes[j].delta != delta) continue;
+
+            votes[j].count += 1;
+            counted = true;
+
+            break;
+         }
+
+         if (not counted) votes.push_back({delta, 1});
+      }
+   }
+
+   port_vote best;
+   port_vote runner_up;
+
+   for (const port_vote& vote : votes) {
+      if (vote.count > best.count) {
+         runner_up = best;
+         best = vote;
+      }
+      else if (vote.count > runner_up.count) {
+         runner_up = vote;
+      }
+   }
+
+   if (best.count < min_port_votes) return;
+
+   const int64_t moved = (int64_t)position + best.delta;
+   const code_range* target_range = moved >= 0 ? target.find_range((size_t)moved) : nullptr;
+
+   if (not target_range or (size_t)moved + size > target_range->position + target_range->size) {
+      return;
+   }
+
+   uint32_t matched = 0;
+
+   for (size_t i = window_begin; i < window_end; ++i) {
+      const int64_t other = (int64_t)i + best.delta;
+
+      if (other < 0 or (size_t)other >= target.normalized.size()) continue;
+      if (source.normalized[i] == target.normalized[(size_t)other]) matched += 1;
+   }
+
+   const uint32_t percent = (uint32_t)(matched * 100ull / (window_end - window_begin));
+
+   site.found = true;
+   site.offset = target_range->offset + ((size_t)moved - target_range->position);
+   site.confidence = percent * (best.count - runner_up.count) / best.count;
+   site.ambiguous = runner_up.count * 2 >= best.count;
+
+   target_position = (size_t)moved;
+}
+
+static void port_set(void* context_pointer, size_t set_index) noexcept
+{
+   port_context& context = *static_cast<port_context*>(context_pointer);
+   const patch_set& set = context.list->patches[set_index];
+   const code_copy& target = *context.target_code;
+   slim_vector<ported_site>& sites = context.sites[set_index];
+
+   const auto port = [&](port_site_kind kind, uint32_t index, patch_address address,
+                         uint32_t size, size_t& position) -> ported_site& {
+      ported_site site;
+
+      site.set = (uint32_t)set_index;
+      site.kind = kind;
+      site.index = index;
+
+      port_site(context, address, size, site, position);
+
+      sites.push_back(site);
+
+      return sites[sites.size() - 1];
+   };
+
+   for (uint32_t i = 0; i < set.patches.size(); ++i) {
+      const patch& patch = set.patches[i];
+      size_t position = 0;
+      ported_site& site = port(port_site_kind::patch, i, patch.address, sizeof(uint32_t), position);
+
+      if (not site.found) continue;
+
+      site.target_value = load_dword(target.bytes.data() + position);
+
+      // The operand is an address the target has at its own place, any address in its image
+      // will do as the patch replaces it.
+      site.expected_matches =
+         site.target_value == patch.expected_value or
+         (patch.region != es_region_id::none and
+          site.target_value - context.image_base < context.image_size);
+   }
+
+   for (uint32_t i = 0; i < set.code_patches.size(); ++i) {
+      const code_patch& patch = set.code_patches[i];
+      size_t position = 0;
+      ported_site& site =
+         port(port_site_kind::code_patch, i, patch.address, patch.length(), position);
+
+      if (not site.found) continue;
+
+      site.expected_matches =
+         memcmp(target.bytes.data() + position, patch.expected.data(), patch.length()) == 0;
+   }
+
+   for (uint32_t i = 0; i < set.trampolines.size(); ++i) {
+      const trampoline& patch = set.trampolines[i];
+      size_t position = 0;
+      ported_site& site =
+         port(port_site_kind::trampoline, i, patch.address, patch.length(), position);
+
+      if (not site.found) continue;
+
+      site.expected_matches =
+         memcmp(target.bytes.data() + position, patch.expected.data(), patch.length()) == 0;
+   }
+
+   for (uint32_t i = 0; i < set.signatures.size(); ++i) {
+      uint8_t bytes[max_signature_length];
+      uint8_t mask[max_signature_length];
+      uint32_t length = 0;
+
+      if (not parse_signature(set.signatures[i].pattern, bytes, mask, length)) continue;
+
+      size_t position = 0;
+      ported_site& site =
+         port(port_site_kind::signature, i, set.signatures[i].address, length, position);
+
+      if (not site.found) continue;
+
+      site.expected_matches = true;
+
+      for (uint32_t j = 0; j < length; ++j) {
+         if ((target.bytes[position + j] & mask[j]) != (bytes[j] & mask[j])) {
+            site.expected_matches = false;
+         }
+      }
+   }
+}
+
+/// @brief Find the first copy of a build id in the target's sections.
+static bool find_build_id(const exe_patcher& editor, uint64_t id, size_t& out) noexcept
+{
+   const pe_image& image = editor.image();
+   slim_vector<uint8_t> data;
+
+   for (uint32_t i = 0; i < image.section_count(); ++i) {
+      const pe_section_header section = image.section(i);
+
+      if (section.size_of_raw_data < sizeof(id)) continue;
+
+      data.resize(section.size_of_raw_data);
+
+      if (not editor.read(section.pointer_to_raw_data, data.data(), data.size())) continue;
+
+      for (size_t position = 0; position + sizeof(id) <= data.size(); ++position) {
+         if (memcmp(data.data() + position, &id, sizeof(id)) == 0) {
+            out = section.pointer_to_raw_data + position;
+
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+bool port_patch_list(const exe_patcher& source, const exe_patch_list& list,
+                     const exe_patcher& target, uint32_t thread_count, port_result& out) noexcept
+{
+   out = {};
+   out.list = &list;
+
+   code_copy source_code;
+   code_copy target_code;
+   gram_index index;
+
+   if (not load_code(source, source_code) or not load_code(target, target_code)) return false;
+
+   build_index(target_code, index);
+
+   port_context context;
+
+   context.source = &source;
+   context.list = &list;
+   context.source_code = &source_code;
+   context.target_code = &target_code;
+   context.index = &index;
+   context.image_base = target.image().optional_header().image_base;
+   context.image_size = target.image().optional_header().size_of_image;
+
+   parallel_for(PATCH_COUNT, thread_count, port_set, &context);
+
+   for (const slim_vector<ported_site>& sites : context.sites) {
+      for (const ported_site& site : sites) {
+         out.sites.push_back(site);
+
+         if (site.found) out.found_count += 1;
+      }
+   }
+
+   out.id_found = find_build_id(target, list.expected_id, out.id_offset);
+
+   return true;
+}
+
+/// @brief Turn a set name into a lower case identifier, "DLC Mission Limit Extension" becomes
+/// "dlc_mission_limit_extension".
+static void make_identifier(const char* name, char (&out)[64]) noexcept
+{
+   size_t length = 0;
+   bool separate = false;
+
+   for (; *name and length + 2 < sizeof(out); ++name) {
+      const unsigned char c = (unsigned char)*name;
+
+      if (not isalnum(c)) {
+         separate = length != 0;
+
+         continue;
+      }
+
+      if (separate) out[length++] = '_';
+
+      out[length++] = (char)tolower(c);
+      separate = false;
+   }
+
+   out[length] = '\0';
+}
+
+/// @brief Print the confidence and what didn't match, after an entry.
+static void print_site_comment(const ported_site& site, patch_address source_address,
+                               int (*print)(const char* format, ...)) noexcept
+{
+   if (not site.found) {
+      print(" // not found\r\n");
+
+      return;
+   }
+
+   print(" // was 0x%x, confidence %u%%%s%s\r\n", source_address.value, site.confidence,
+         site.ambiguous ? ", ambiguous" : "", site.expected_matches ? "" : ", expected differs");
+}
+
+static void print_ported_patch(const patch& patch, const ported_site& site,
+                               int (*print)(const char* format, ...)) noexcept
+{
+   const size_t address = site.found ? site.offset : patch.address.value;
+   const uint32_t expected =
+      site.found and patch.region != es_region_id::none ? site.target_value : patch.expected_value;
+
+   print(site.found ? "   " : "   //");
+
+   if (patch.formula.capacity != capacity_id::none) {
+      const char* capacity = known_capacities[(uint32_t)patch.formula.capacity].name;
+
+      if (patch.formula.encoding == value_encoding::imm8) {
+         print("imm8_patch(0x%zx, 0x%x, capacity_id::%s, %u),", address, expected, capacity,
+               patch.formula.byte);
+      }
+      else if (patch.formula.offset != 0) {
+         print("scaled_patch(0x%zx, 0x%x, capacity_id::%s, 0x%x, 0x%x),", address, expected,
+               capacity, patch.formula.scale, patch.formula.offset);
+      }
+      else if (patch.formula.scale != 1) {
+         print("scaled_patch(0x%zx, 0x%x, capacity_id::%s, 0x%x),", address, expected, capacity,
+               patch.formula.scale);
+      }
+      else {
+         print("scaled_patch(0x%zx, 0x%x, capacity_id::%s),", address, expected, capacity);
+      }
+   }
+   else if (patch.region != es_region_id::none) {
+      print("patch{0x%zx, 0x%x, 0x%x, es_region_id::%s},", address, expected,
+            patch.replacement_value, region_identifier(patch.region));
+   }
+   else {
+      print("patch{0x%zx, 0x%x, 0x%x},", address, expected, patch.replacement_value);
+   }
+
+   print_site_comment(site, patch.address, print);
+}
+
+void print_ported_list(const port_result& result, const char* target_name,
+                       int (*print)(const char* format, ...)) noexcept
+{
+   const exe_patch_list& list = *result.list;
+
+   print("// %s ported to %s, %u of %zu sites found.\r\n", list.name, target_name,
+         result.found_count, result.sites.size());
+   print("// Check every site against a disassembly before adding the list.\r\n\r\n");
+
+   bool has_patches[PATCH_COUNT] = {};
+   bool has_signatures[PATCH_COUNT] = {};
+
+   for (uint32_t set_index = 0; set_index < PATCH_COUNT; ++set_index) {
+      const patch_set& set = list.patches[set_index];
+      char identifier[64];
+
+      if (set.patches.size() == 0 and set.code_patches.size() == 0 and
+          set.trampolines.size() == 0 and set.signatures.size() == 0) {
+         continue;
+      }
+
+      make_identifier(set.name, identifier);
+
+      print("// %s\r\n", set.name);
+
+      for (const ported_site& site : result.sites) {
+         if (site.set != set_index) continue;
+
+         if (site.kind == port_site_kind::code_patch) {
+            print("// code_patch 0x%x moves to 0x%zx, reuse its expected bytes and ops.",
+                  set.code_patches[site.index].address.value, site.offset);
+            print_site_comment(site, set.code_patches[site.index].address, print);
+         }
+         else if (site.kind == port_site_kind::trampoline) {
+            print("// trampoline 0x%x moves to 0x%zx, reuse its expected bytes and routine.",
+                  set.trampolines[site.index].address.value, site.offset);
+            print_site_comment(site, set.trampolines[site.index].address, print);
+         }
+      }
+
+      if (set.patches.size() != 0) {
+         has_patches[set_index] = true;
+
+         print("constexpr patch ported_%s_patches[] = {\r\n", identifier);
+
+         for (const ported_site& site : result.sites) {
+            if (site.set != set_index or site.kind != port_site_kind::patch) continue;
+
+            print_ported_patch(set.patches[site.index], site, print);
+         }
+
+         print("};\r\n");
+      }
+
+      if (set.signatures.size() != 0) {
+         has_signatures[set_index] = true;
+
+         print("constexpr patch_signature ported_%s_signatures[] = {\r\n", identifier);
+
+         for (const ported_site& site : result.sites) {
+            if (site.set != set_index or site.kind != port_site_kind::signature) continue;
+
+            const patch_signature& signature = set.signatures[site.index];
+
+            print("   %spatch_signature{\"%s\", 0x%zx},", site.found ? "" : "//",
+                  signature.pattern, site.found ? site.offset : (size_t)signature.address.value);
+            print_site_comment(site, signature.address, print);
+         }
+
+         print("};\r\n");
+      }
+
+      print("\r\n");
+   }
+
+   print("exe_patch_list{\r\n");
+   print("   .name = \"%s\",\r\n", target_name);
+   print("   .fingerprint = 0, // Fill in with /fingerprint once the list is in the table.\r\n");
+
+   if (result.id_found) {
+      print("   .id_address = 0x%zx,\r\n", result.id_offset);
+   }
+   else {
+      print("   .id_address = 0, // The build id wasn't found.\r\n");
+   }
+
+   print("   .expected_id = 0x%llx,\r\n", (unsigned long long)list.expected_id);
+   print("   .patches =\r\n      {\r\n");
+
+   for (uint32_t set_index = 0; set_index < PATCH_COUNT; ++set_index) {
+      const patch_set& set = list.patches[set_index];
+      char identifier[64];
+
+      make_identifier(set.name, identifier);
+
+      print("         patch_set{\r\n");
+      print("            .name = \"%s\",\r\n", set.name);
+
+      if (has_patches[set_index]) {
+         print("            .patches = ported_%s_patches,\r\n", identifier);
+      }
+
+      if (has_signatures[set_index]) {
+         print("            .signatures = ported_%s_signatures,\r\n", identifier);
+      }
+
+      if (set.code_patches.size() != 0 or set.trampolines.size() != 0 or
+          set.regions.size() != 0) {
+         print("            // Reuse the code patches, trampolines and regions of the source "
+               "set.\r\n");
+      }
+
+      print("         },\r\n");
+
+      if (set_index + 1 != PATCH_COUNT) print("\r\n");
+   }
+
+   print("      },\r\n},\r\n");
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "exe_patcher.hpp"
+#include "patch_table.hpp"
+#include "slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief The length of the byte sequences the target's code is indexed by.
+constexpr uint32_t port_gram_length = 16;
+
+/// @brief How many bytes before and after a site are matched against the target.
+constexpr uint32_t port_context_size = 64;
+
+/// @brief A site needs at least this many matching sequences of its context at the same distance
+/// to be found.
+constexpr uint32_t min_port_votes = 2;
+
+enum class port_site_kind : uint8_t { patch, code_patch, trampoline, signature };
+
+/// @brief Where a site of the source list ended up in the target.
+struct ported_site {
+   uint32_t set = 0;
+   port_site_kind kind = port_site_kind::patch;
+   /// @brief The index of the site in its span of the set.
+   uint32_t index = 0;
+   /// @brief The file offset of the site in the target, valid if found.
+   size_t offset = 0;
+   /// @brief The dword at the site in the target, for patches.
+   uint32_t target_value = 0;
+   /// @brief From 0 to 100, how much of the context matched scaled down by how close the runner
+   /// up was.
+   uint32_t confidence = 0;
+   bool found = false;
+   /// @brief The target holds what the site expects. For patches of addresses into a region it's
+   /// enough for the dword to point into the target image.
+   bool expected_matches = false;
+   /// @brief Another place in the target matched nearly as well.
+   bool ambiguous = false;
+};
+
+struct port_result {
+   const exe_patch_list* list = nullptr;
+   /// @brief Every site of every set, by set and then kind in the order of the set's spans.
+   slim_vector<ported_site> sites;
+   uint32_t found_count = 0;
+   /// @brief The file offset of the list's build id in the target, if it was found.
+   size_t id_offset = 0;
+   bool id_found = false;
+};
+
+/// @brief Find the sites of a patch list in another build by the code around them. The target's
+/// code is indexed once by a rolling hash of every port_gram_length bytes, then sequences from
+/// the context of each site vote for how far it moved. Relocated operands, absolute addresses
+/// and the displacements of relative jumps and calls are masked on both sides, they differ
+/// between builds even when the code doesn't. Sets are ported in parallel.
+/// @param source The build the list was written against.
+/// @param list The source's patch list.
+/// @param target The build to port the list to.
+/// @param thread_count The number of threads, 0 for one per hardware thread.
+/// @return False if either image couldn't be read.
+[[nodiscard]] bool port_patch_list(const exe_patcher& source, const exe_patch_list& list,
+                                   const exe_patcher& target, uint32_t thread_count,
+                                   port_result& out) noexcept;
+
+/// @brief Print a ported list as patch table source, ready to be reviewed and pasted in. Sites
+/// that weren't found are printed commented out at their source addresses.
+void print_ported_list(const port_result& result, const char* target_name,
+                       int (*print)(const char* format, ...)) noexcept;
@@ -0,0 +1,123 @@
+#include "section_map.hpp"
+
+#include <stdlib.h>
+
+bool section_map::build(const pe_image& image, size_t file_size) noexcept
+{
+   clear();
+
+   if (not image.valid()) return false;
+
+   const pe_optional_header32 optional_header = image.optional_header();
+
+   _image_base = optional_header.image_base;
+
+   // The headers are mapped flat at the start of the image.
+   if (optional_header.size_of_headers != 0) {
+      const uint32_t headers_size = optional_header.size_of_headers < file_size
+                                       ? optional_header.size_of_headers
+                                       : (uint32_t)file_size;
+
+      _intervals.push_back({0, headers_size, 0});
+   }
+
+   for (uint32_t i = 0; i < image.section_count(); ++i) {
+      const pe_section_header section = image.section(i);
+
+      if (section.size_of_raw_data == 0) continue;
+
+      // Raw data is padded to FileAlignment, anything past VirtualSize isn't mapped.
+      uint32_t mapped_size = section.size_of_raw_data;
+
+      if (section.virtual_size != 0 and section.virtual_size < mapped_size) {
+         mapped_size = section.virtual_size;
+      }
+
+      if ((size_t)section.pointer_to_raw_data + mapped_size > file_size) return false;
+      if (section.virtual_address + mapped_size < section.virtual_address) return false;
+
+      _intervals.push_back(
+         {section.virtual_address, section.virtual_address + mapped_size, section.pointer_to_raw_data});
+   }
+
+   qsort(_intervals.data(), _intervals.size(), sizeof(section_interval),
+         [](const void* left, const void* right) -> int {
+            const uint32_t left_rva = static_cast<const section_interval*>(left)->rva_start;
+            const uint32_t right_rva = static_cast<const section_interval*>(right)->rva_start;
+
+            return (left_rva > right_rva) - (left_rva < right_rva);
+         });
+
+   for (size_t i = 1; i < _intervals.size(); ++i) {
+      if (_intervals[i].rva_start < _intervals[i - 1].rva_end) {
+         clear();
+
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void section_map::clear() noexcept
+{
+   _intervals.clear();
+   _image_base = 0;
+}
+
+bool section_map::rva_to_offset(uint32_t rva, uint32_t size, size_t& out_offset) const noexcept
+{
+   // Find the last interval starting at or before rva.
+   size_t low = 0;
+   size_t high = _intervals.size();
+
+   while (low < high) {
+      const size_t middle = low + (high - low) / 2;
+
+      if (_intervals[middle].rva_start <= rva) {
+         low = middle + 1;
+      }
+      else {
+         high = middle;
+      }
+   }
+
+   if (low == 0) return false;
+
+   const section_interval& interval = _intervals[low - 1];
+
+   if (rva + size < rva) return false;
+   if (rva + size > interval.rva_end) return false;
+
+   out_offset = (size_t)interval.file_offset + (rva - interval.rva_start);
+
+   return true;
+}
+
+bool section_map::va_to_offset(uint32_t va, uint32_t size, size_t& out_offset) const noexcept
+{
+   if (va < _image_base) return false;
+
+   return rva_to_offset(va - _image_base, size, out_offset);
+}
+
+bool section_map::offset_to_rva(size_t offset, uint32_t& out_rva) const noexcept
+{
+   // Intervals are sorted by RVA not file offset, but there are only a handful.
+   for (const section_interval& interval : _intervals) {
+      const size_t size = interval.rva_end - interval.rva_start;
+
+      if (offset >= interval.file_offset and offset < interval.file_offset + size) {
+         out_rva = interval.rva_start + (uint32_t)(offset - interval.file_offset);
+
+         return true;
+      }
+   }
+
+   return false;
+}
+
+auto section_map::image_base() const noexcept -> uint32_t
+{
+   return _image_base;
+}
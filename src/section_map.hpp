@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pe_image.hpp"
+#include "slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief A run of the image that is backed by file data.
+struct section_interval {
+   uint32_t rva_start = 0;
+   uint32_t rva_end = 0;
+   uint32_t file_offset = 0;
+};
+
+/// @brief Sorted RVA interval table for translating addresses into file offsets. Only bytes that
+/// are actually present in the file are covered, gaps between sections and the zero filled tail
+/// of a section (VirtualSize past SizeOfRawData) don't translate.
+struct section_map {
+   /// @brief Build the table from an image's section headers.
+   /// @return False if the sections overlap or reference data outside the file.
+   [[nodiscard]] bool build(const pe_image& image, size_t file_size) noexcept;
+
+   void clear() noexcept;
+
+   /// @brief Translate an RVA range into a file offset. The whole range must fall within a single
+   /// interval.
+   [[nodiscard]] bool rva_to_offset(uint32_t rva, uint32_t size, size_t& out_offset) const noexcept;
+
+   /// @brief Translate a VA range into a file offset.
+   [[nodiscard]] bool va_to_offset(uint32_t va, uint32_t size, size_t& out_offset) const noexcept;
+
+   /// @brief Translate a file offset back into an RVA.
+   [[nodiscard]] bool offset_to_rva(size_t offset, uint32_t& out_rva) const noexcept;
+
+   [[nodiscard]] auto image_base() const noexcept -> uint32_t;
+
+private:
+   slim_vector<section_interval> _intervals;
+   uint32_t _image_base = 0;
+};
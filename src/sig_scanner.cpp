@@ -0,0 +1,369 @@
+#include "sig_scanner.hpp"
+#include "cpu_features.hpp"
+
+#include <string.h>
+
+#if BF2_X86
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// More anchors than this go through the scalar pair bitmap, past this point the per-block
+// compares cost more than the table lookup. AVX2 compares twice the bytes per instruction so it
+// stays ahead for twice as many anchors.
+constexpr size_t max_avx2_anchors = 32;
+constexpr size_t max_sse2_anchors = 16;
+
+static auto count_trailing_zeros(uint32_t value) noexcept -> uint32_t
+{
+#ifdef _MSC_VER
+   unsigned long index = 0;
+
+   _BitScanForward(&index, value);
+
+   return index;
+#else
+   return (uint32_t)__builtin_ctz(value);
+#endif
+}
+
+static auto hex_digit(char c) noexcept -> int
+{
+   if (c >= '0' and c <= '9') return c - '0';
+   if (c >= 'a' and c <= 'f') return c - 'a' + 10;
+   if (c >= 'A' and c <= 'F') return c - 'A' + 10;
+
+   return -1;
+}
+
+/// @brief Rough cost of anchoring on a byte in x86 code, higher is more common.
+static auto byte_commonness(uint8_t byte) noexcept -> int
+{
+   switch (byte) {
+   case 0x00:
+   case 0xff:
+   case 0xcc:
+   case 0x90:
+      return 4;
+   case 0x8b:
+   case 0x89:
+   case 0x83:
+   case 0x0f:
+   case 0xe8:
+   case 0x8d:
+   case 0x24:
+   case 0x44:
+   case 0x45:
+   case 0x04:
+   case 0x01:
+      return 2;
+   default:
+      return 1;
+   }
+}
+
+bool parse_signature(const char* pattern, uint8_t (&bytes)[max_signature_length],
+                     uint8_t (&mask)[max_signature_length], uint32_t& length) noexcept
+{
+   length = 0;
+
+   for (const char* c = pattern; *c;) {
+      if (*c == ' ') {
+         ++c;
+
+         continue;
+      }
+
+      if (length == max_signature_length) return false;
+
+      if (c[0] == '?') {
+         c += (c[1] == '?') ? 2 : 1;
+
+         bytes[length] = 0;
+         mask[length] = 0;
+         length += 1;
+
+         continue;
+      }
+
+      const int high = hex_digit(c[0]);
+      const int low = high >= 0 ? hex_digit(c[1]) : -1;
+
+      if (low < 0) return false;
+
+      bytes[length] = (uint8_t)(high << 4 | low);
+      mask[length] = 0xff;
+      length += 1;
+
+      c += 2;
+   }
+
+   return true;
+}
+
+bool signature_scanner::add(const char* pattern)
+{
+   uint8_t bytes[max_signature_length];
+   uint8_t mask[max_signature_length];
+   uint32_t length = 0;
+
+   if (not parse_signature(pattern, bytes, mask, length)) return false;
+
+   return add(bytes, mask, length);
+}
+
+bool signature_scanner::add(const uint8_t* bytes, const uint8_t* mask, uint32_t length)
+{
+   if (length > max_signature_length) return false;
+
+   compiled_signature signature;
+
+   signature.length = length;
+
+   for (uint32_t i = 0; i < length; ++i) {
+      signature.bytes[i] = bytes[i] & mask[i];
+      signature.mask[i] = mask[i];
+   }
+
+   // Anchor on the least common pair of adjacent fixed bytes.
+   int best_cost = INT32_MAX;
+
+   for (uint32_t i = 0; i + 1 < signature.length; ++i) {
+      if (not signature.mask[i] or not signature.mask[i + 1]) continue;
+
+      const int cost = byte_commonness(signature.bytes[i]) + byte_commonness(signature.bytes[i + 1]);
+
+      if (cost < best_cost) {
+         best_cost = cost;
+         signature.anchor_offset = i;
+      }
+   }
+
+   if (best_cost == INT32_MAX) return false;
+
+   const uint8_t first = signature.bytes[signature.anchor_offset];
+   const uint8_t second = signature.bytes[signature.anchor_offset + 1];
+   const uint32_t signature_index = (uint32_t)_signatures.size();
+
+   // Patterns sharing an anchor are chained off the same entry.
+   uint32_t anchor_index = UINT32_MAX;
+
+   for (uint32_t i = 0; i < _anchors.size(); ++i) {
+      if (_anchors[i].first == first and _anchors[i].second == second) anchor_index = i;
+   }
+
+   if (anchor_index == UINT32_MAX) {
+      anchor_index = (uint32_t)_anchors.size();
+
+      _anchors.push_back({first, second, UINT32_MAX});
+   }
+
+   signature.next_with_anchor = _anchors[anchor_index].first_signature;
+   _anchors[anchor_index].first_signature = signature_index;
+
+   _signatures.push_back(signature);
+
+   const uint32_t pair = (uint32_t)first << 8 | second;
+
+   _anchor_bits[pair / 64] |= 1ull << (pair % 64);
+
+   return true;
+}
+
+auto signature_scanner::size() const noexcept -> size_t
+{
+   return _signatures.size();
+}
+
+void signature_scanner::scan(const uint8_t* data, size_t size, size_t base_offset,
+                             signature_match* matches, size_t match_limit) const noexcept
+{
+   if (_anchors.size() == 0 or size < 2) return;
+
+   size_t scanned = 0;
+
+   switch (vector_width()) {
+   case 32:
+      scanned = scan_avx2(data, size, base_offset, matches, match_limit);
+      break;
+   case 16:
+      scanned = scan_sse2(data, size, base_offset, matches, match_limit);
+      break;
+   default:
+      break;
+   }
+
+   scan_scalar(data, size, scanned, base_offset, matches, match_limit);
+}
+
+auto signature_scanner::vector_width() const noexcept -> uint32_t
+{
+#if BF2_X86
+   if (_anchors.size() <= max_avx2_anchors and cpu_has_avx2()) return 32;
+   if (_anchors.size() <= max_sse2_anchors) return 16;
+#endif
+
+   return 1;
+}
+
+void signature_scanner::check_anchor(const uint8_t* data, size_t size, size_t position,
+                                     uint32_t anchor_index, size_t base_offset,
+                                     signature_match* matches, size_t match_limit) const noexcept
+{
+   for (uint32_t i = _anchors[anchor_index].first_signature; i != UINT32_MAX;) {
+      const compiled_signature& signature = _signatures[i];
+
+      if (position >= signature.anchor_offset) {
+         const size_t start = position - signature.anchor_offset;
+
+         if (start < match_limit and start + signature.length <= size) {
+            bool equal = true;
+
+            for (uint32_t j = 0; j < signature.length; ++j) {
+               if ((data[start + j] & signature.mask[j]) != signature.bytes[j]) {
+                  equal = false;
+
+                  break;
+               }
+            }
+
+            if (equal) {
+               if (matches[i].count == 0) matches[i].offset = base_offset + start;
+
+               matches[i].count += 1;
+            }
+         }
+      }
+
+      i = signature.next_with_anchor;
+   }
+}
+
+void signature_scanner::scan_scalar(const uint8_t* data, size_t size, size_t start,
+                                    size_t base_offset, signature_match* matches,
+                                    size_t match_limit) const noexcept
+{
+   for (size_t position = start; position + 1 < size; ++position) {
+      const uint32_t pair = (uint32_t)data[position] << 8 | data[position + 1];
+
+      if (not(_anchor_bits[pair / 64] & (1ull << (pair % 64)))) continue;
+
+      for (uint32_t i = 0; i < _anchors.size(); ++i) {
+         if (_anchors[i].first == data[position] and _anchors[i].second == data[position + 1]) {
+            check_anchor(data, size, position, i, base_offset, matches, match_limit);
+         }
+      }
+   }
+}
+
+#if BF2_X86
+
+BF2_TARGET("sse2")
+auto signature_scanner::scan_sse2(const uint8_t* data, size_t size, size_t base_offset,
+                                  signature_match* matches, size_t match_limit) const noexcept
+   -> size_t
+{
+   __m128i firsts[max_sse2_anchors];
+   __m128i seconds[max_sse2_anchors];
+   const size_t anchor_count = _anchors.size();
+
+   for (size_t i = 0; i < anchor_count; ++i) {
+      firsts[i] = _mm_set1_epi8((char)_anchors[i].first);
+      seconds[i] = _mm_set1_epi8((char)_anchors[i].second);
+   }
+
+   size_t position = 0;
+
+   // The block at position also reads the byte after it for the second half of each pair.
+   for (; position + 16 + 1 <= size; position += 16) {
+      const __m128i block = _mm_loadu_si128((const __m128i*)(data + position));
+      const __m128i next_block = _mm_loadu_si128((const __m128i*)(data + position + 1));
+
+      __m128i hits = _mm_setzero_si128();
+
+      for (size_t i = 0; i < anchor_count; ++i) {
+         hits = _mm_or_si128(hits, _mm_and_si128(_mm_cmpeq_epi8(block, firsts[i]),
+                                                 _mm_cmpeq_epi8(next_block, seconds[i])));
+      }
+
+      uint32_t mask = (uint32_t)_mm_movemask_epi8(hits);
+
+      while (mask) {
+         const size_t hit = position + count_trailing_zeros(mask);
+
+         for (uint32_t i = 0; i < anchor_count; ++i) {
+            if (_anchors[i].first == data[hit] and _anchors[i].second == data[hit + 1]) {
+               check_anchor(data, size, hit, i, base_offset, matches, match_limit);
+            }
+         }
+
+         mask &= mask - 1;
+      }
+   }
+
+   return position;
+}
+
+BF2_TARGET("avx2")
+auto signature_scanner::scan_avx2(const uint8_t* data, size_t size, size_t base_offset,
+                                  signature_match* matches, size_t match_limit) const noexcept
+   -> size_t
+{
+   __m256i firsts[max_avx2_anchors];
+   __m256i seconds[max_avx2_anchors];
+   const size_t anchor_count = _anchors.size();
+
+   for (size_t i = 0; i < anchor_count; ++i) {
+      firsts[i] = _mm256_set1_epi8((char)_anchors[i].first);
+      seconds[i] = _mm256_set1_epi8((char)_anchors[i].second);
+   }
+
+   size_t position = 0;
+
+   for (; position + 32 + 1 <= size; position += 32) {
+      const __m256i block = _mm256_loadu_si256((const __m256i*)(data + position));
+      const __m256i next_block = _mm256_loadu_si256((const __m256i*)(data + position + 1));
+
+      __m256i hits = _mm256_setzero_si256();
+
+      for (size_t i = 0; i < anchor_count; ++i) {
+         hits = _mm256_or_si256(hits, _mm256_and_si256(_mm256_cmpeq_epi8(block, firsts[i]),
+                                                       _mm256_cmpeq_epi8(next_block, seconds[i])));
+      }
+
+      uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits);
+
+      while (mask) {
+         const size_t hit = position + count_trailing_zeros(mask);
+
+         for (uint32_t i = 0; i < anchor_count; ++i) {
+            if (_anchors[i].first == data[hit] and _anchors[i].second == data[hit + 1]) {
+               check_anchor(data, size, hit, i, base_offset, matches, match_limit);
+            }
+         }
+
+         mask &= mask - 1;
+      }
+   }
+
+   return position;
+}
+
+#else
+
+auto signature_scanner::scan_sse2(const uint8_t*, size_t, size_t, signature_match*,
+                                  size_t) const noexcept -> size_t
+{
+   return 0;
+}
+
+auto signature_scanner::scan_avx2(const uint8_t*, size_t, size_t, signature_match*,
+                                  size_t) const noexcept -> size_t
+{
+   return 0;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint32_t max_signature_length = 64;
+
+/// @brief The result of scanning for a single signature.
+struct signature_match {
+   uint32_t count = 0;
+   /// @brief The offset of the first match, valid when count is not zero.
+   size_t offset = 0;
+};
+
+/// @brief Parse a pattern into bytes and a mask, wildcards have a zero mask.
+/// @return False if the pattern is malformed or longer than max_signature_length.
+[[nodiscard]] bool parse_signature(const char* pattern, uint8_t (&bytes)[max_signature_length],
+                                   uint8_t (&mask)[max_signature_length], uint32_t& length) noexcept;
+
+/// @brief Multi-pattern byte signature scanner. Patterns are written as hex bytes separated by
+/// spaces with ?? as a wildcard, e.g. "83 F8 32 0F 8D ?? ?? ?? ?? 53". Every pattern is keyed on
+/// its least common pair of adjacent fixed bytes and all pairs are filtered together with SSE2 or
+/// AVX2, so the data is only walked once no matter how many patterns there are.
+struct signature_scanner {
+   /// @brief Compile and add a pattern. Patterns are numbered in the order they're added.
+   /// @return False if the pattern is malformed, longer than max_signature_length or has no pair
+   /// of adjacent fixed bytes to anchor on.
+   [[nodiscard]] bool add(const char* pattern);
+
+   /// @brief Add an already parsed pattern. Bytes with a zero mask are wildcards.
+   [[nodiscard]] bool add(const uint8_t* bytes, const uint8_t* mask, uint32_t length);
+
+   [[nodiscard]] auto size() const noexcept -> size_t;
+
+   /// @brief The bytes scan filters at once for the patterns added so far: 32 with AVX2, 16 with
+   /// SSE2, or 1 when there are too many anchors and every position goes through the pair bitmap.
+   [[nodiscard]] auto vector_width() const noexcept -> uint32_t;
+
+   /// @brief Scan a buffer, accumulating into matches.
+   /// @param data The buffer to scan.
+   /// @param size The size of the buffer.
+   /// @param base_offset Added to match offsets, lets sections be scanned separately.
+   /// @param matches One entry per pattern.
+   /// @param match_limit Matches starting at or past this position in the buffer are ignored.
+   /// Lets a large region be scanned in overlapping windows without counting a match twice.
+   void scan(const uint8_t* data, size_t size, size_t base_offset, signature_match* matches,
+             size_t match_limit = SIZE_MAX) const noexcept;
+
+private:
+   struct compiled_signature {
+      uint8_t bytes[max_signature_length] = {};
+      uint8_t mask[max_signature_length] = {};
+      uint32_t length = 0;
+      uint32_t anchor_offset = 0;
+      uint32_t next_with_anchor = UINT32_MAX;
+   };
+
+   struct anchor {
+      uint8_t first = 0;
+      uint8_t second = 0;
+      uint32_t first_signature = UINT32_MAX;
+   };
+
+   slim_vector<compiled_signature> _signatures;
+   slim_vector<anchor> _anchors;
+
+   // One bit per possible byte pair, used by the scalar path.
+   uint64_t _anchor_bits[65536 / 64] = {};
+
+   void check_anchor(const uint8_t* data, size_t size, size_t position, uint32_t anchor_index,
+                     size_t base_offset, signature_match* matches,
+                     size_t match_limit) const noexcept;
+
+   void scan_scalar(const uint8_t* data, size_t size, size_t start, size_t base_offset,
+                    signature_match* matches, size_t match_limit) const noexcept;
+
+   [[nodiscard]] auto scan_sse2(const uint8_t* data, size_t size, size_t base_offset,
+                                signature_match* matches, size_t match_limit) const noexcept
+      -> size_t;
+
+   [[nodiscard]] auto scan_avx2(const uint8_t* data, size_t size, size_t base_offset,
+                                signature_match* matches, size_t match_limit) const noexcept
+      -> size_t;
+};
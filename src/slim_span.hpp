@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+
+/// @brief A non-owning view of a constant array. Unlike slim_vector it can be built in constant
+/// expressions, so tables made of spans over static arrays need no initialization at startup.
+template<typename T>
+struct slim_span {
+   constexpr slim_span() = default;
+
+   template<size_t array_size>
+   constexpr slim_span(const T (&array)[array_size]) noexcept : _data{array}, _size{array_size}
+   {
+   }
+
+   constexpr slim_span(const T* data, size_t size) noexcept : _data{data}, _size{size} {}
+
+   [[nodiscard]] constexpr auto data() const noexcept -> const T*
+   {
+      return _data;
+   }
+
+   [[nodiscard]] constexpr auto size() const noexcept -> size_t
+   {
+      return _size;
+   }
+
+   [[nodiscard]] constexpr auto operator[](size_t i) const noexcept -> const T&
+   {
+      if (i >= _size) abort();
+
+      return _data[i];
+   }
+
+   [[nodiscard]] constexpr auto begin() const noexcept -> const T*
+   {
+      return _data;
+   }
+
+   [[nodiscard]] constexpr auto end() const noexcept -> const T*
+   {
+      return _data + _size;
+   }
+
+private:
+   const T* _data = nullptr;
+   size_t _size = 0;
+};
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <initializer_list>
 
+/// @brief Storage allocations made by slim_vectors on this thread, for metrics.
+inline thread_local uint64_t slim_vector_allocations = 0;
+
 template<typename T>
 struct slim_vector {
    slim_vector() = default;
@@ -11,7 +15,9 @@ struct slim_vector {
    slim_vector(std::initializer_list<T> objects)
    {
       _size = objects.size();
+      _capacity = _size;
       _data = new T[_size];
+      slim_vector_allocations += 1;
 
       if (not _data) abort();
 
@@ -26,7 +32,9 @@ struct slim_vector {
    slim_vector(const slim_vector& other)
    {
       _size = other._size;
+      _capacity = _size;
       _data = new T[_size];
+      slim_vector_allocations += 1;
 
       if (not _data) abort();
 
@@ -35,10 +43,18 @@ struct slim_vector {
 
    auto operator=(const slim_vector& other) -> slim_vector&
    {
+      if (this == &other) return *this;
+
       if (_data) delete[] _data;
 
       _size = other._size;
+      _capacity = _size;
+      _data = nullptr;
+
+      if (_size == 0) return *this;
+
       _data = new T[_size];
+      slim_vector_allocations += 1;
 
       if (not _data) abort();
 
@@ -47,11 +63,74 @@ struct slim_vector {
       return *this;
    }
 
+   /// @brief Append an object, growing the storage geometrically.
+   void push_back(const T& object)
+   {
+      if (_size == _capacity) reserve(_size + 1);
+
+      _data[_size++] = object;
+   }
+
+   /// @brief Append a range of objects.
+   void append(const T* objects, size_t count)
+   {
+      reserve(_size + count);
+
+      for (size_t i = 0; i < count; ++i) _data[_size++] = objects[i];
+   }
+
+   /// @brief Make room for at least capacity objects without changing the object count.
+   void reserve(size_t capacity)
+   {
+      if (capacity <= _capacity) return;
+
+      size_t new_capacity = _capacity ? _capacity : 8;
+
+      while (new_capacity < capacity) new_capacity *= 2;
+
+      T* new_data = new T[new_capacity];
+      slim_vector_allocations += 1;
+
+      if (not new_data) abort();
+
+      for (size_t i = 0; i < _size; ++i) new_data[i] = _data[i];
+
+      if (_data) delete[] _data;
+
+      _data = new_data;
+      _capacity = new_capacity;
+   }
+
+   /// @brief Set the object count. Objects added by growing keep whatever the storage held.
+   void resize(size_t size)
+   {
+      reserve(size);
+
+      _size = size;
+   }
+
+   /// @brief Drop all objects, keeping the storage for reuse.
+   void clear() noexcept
+   {
+      _size = 0;
+   }
+
+   /// @brief Shrink the object count. Used after compacting in place.
+   void truncate(size_t size) noexcept
+   {
+      if (size < _size) _size = size;
+   }
+
    [[nodiscard]] auto data() const noexcept -> const T*
    {
       return _data;
    }
 
+   [[nodiscard]] auto data() noexcept -> T*
+   {
+      return _data;
+   }
+
    [[nodiscard]] auto size() const noexcept -> size_t
    {
       return _size;
@@ -64,6 +143,13 @@ struct slim_vector {
       return _data[i];
    }
 
+   [[nodiscard]] auto operator[](size_t i) noexcept -> T&
+   {
+      if (not _data or i >= _size) abort();
+
+      return _data[i];
+   }
+
    [[nodiscard]] auto begin() const noexcept -> const T*
    {
       return _data;
@@ -89,4 +175,5 @@ struct slim_vector {
 private:
    T* _data = nullptr;
    size_t _size = 0;
+   size_t _capacity = 0;
 };
@@ -0,0 +1,169 @@
+#ifdef _MSC_VER
+#pragma warning(disable : 4530)
+#endif
+
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <thread>
+
+/// @brief A thread's slice of the job indices. Begin is in the low half and end in the high half
+/// so the owner taking from the front and thieves taking from the back agree through a single
+/// compare exchange.
+struct alignas(64) work_queue {
+   std::atomic<uint64_t> range{0};
+};
+
+static constexpr auto pack_range(uint32_t begin, uint32_t end) noexcept -> uint64_t
+{
+   return (uint64_t)end << 32 | begin;
+}
+
+static constexpr auto range_begin(uint64_t range) noexcept -> uint32_t
+{
+   return (uint32_t)range;
+}
+
+static constexpr auto range_end(uint64_t range) noexcept -> uint32_t
+{
+   return (uint32_t)(range >> 32);
+}
+
+struct pool_state {
+   work_queue* queues = nullptr;
+   uint32_t queue_count = 0;
+   void (*job)(void* context, size_t index) = nullptr;
+   void* context = nullptr;
+};
+
+/// @brief Take the next index from the front of a thread's own slice.
+static bool pop(work_queue& queue, uint32_t& index) noexcept
+{
+   uint64_t range = queue.range.load(std::memory_order_relaxed);
+
+   while (range_begin(range) < range_end(range)) {
+      if (queue.range.compare_exchange_weak(range,
+                                            pack_range(range_begin(range) + 1, range_end(range)),
+                                            std::memory_order_acquire, std::memory_order_relaxed)) {
+         index = range_begin(range);
+
+         return true;
+      }
+   }
+
+   return false;
+}
+
+/// @brief Move the back half of another thread's slice into an empty slice.
+static bool steal(work_queue& victim, work_queue& thief) noexcept
+{
+   uint64_t range = victim.range.load(std::memory_order_relaxed);
+
+   while (range_begin(range) < range_end(range)) {
+      const uint32_t remaining = range_end(range) - range_begin(range);
+      const uint32_t split = range_end(range) - (remaining + 1) / 2;
+
+      if (victim.range.compare_exchange_weak(range, pack_range(range_begin(range), split),
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+         thief.range.store(pack_range(split, range_end(range)), std::memory_order_release);
+
+         return true;
+      }
+   }
+
+   return false;
+}
+
+static void run_worker(pool_state& state, uint32_t self) noexcept
+{
+   work_queue& queue = state.queues[self];
+
+   for (;;) {
+      uint32_t index = 0;
+
+      while (pop(queue, index)) state.job(state.context, index);
+
+      // No work is ever added so a full pass over the other threads finding nothing means
+      // everything left is already running.
+      bool stolen = false;
+
+      for (uint32_t i = 1; i < state.queue_count and not stolen; ++i) {
+         stolen = steal(state.queues[(self + i) % state.queue_count], queue);
+      }
+
+      if (not stolen) return;
+   }
+}
+
+auto hardware_thread_count() noexcept -> uint32_t
+{
+   const uint32_t count = std::thread::hardware_concurrency();
+
+   return count ? count : 1;
+}
+
+void parallel_for(size_t count, uint32_t thread_count, void (*job)(void* context, size_t index),
+                  void* context) noexcept
+{
+   if (count == 0) return;
+   if (count > UINT32_MAX) count = UINT32_MAX;
+
+   if (thread_count == 0) thread_count = hardware_thread_count();
+   if (thread_count > count) thread_count = (uint32_t)count;
+
+   if (thread_count == 1) {
+      for (size_t i = 0; i < count; ++i) job(context, i);
+
+      return;
+   }
+
+   pool_state state;
+
+   state.queues = new work_queue[thread_count];
+   state.queue_count = thread_count;
+   state.job = job;
+   state.context = context;
+
+   for (uint32_t i = 0; i < thread_count; ++i) {
+      const uint32_t begin = (uint32_t)((uint64_t)count * i / thread_count);
+      const uint32_t end = (uint32_t)((uint64_t)count * (i + 1) / thread_count);
+
+      state.queues[i].range.store(pack_range(begin, end), std::memory_order_relaxed);
+   }
+
+   std::thread* threads = new std::thread[thread_count - 1];
+
+   for (uint32_t i = 1; i < thread_count; ++i) {
+      threads[i - 1] = std::thread{run_worker, std::ref(state), i};
+   }
+
+   run_worker(state, 0);
+
+   for (uint32_t i = 1; i < thread_count; ++i) threads[i - 1].join();
+
+   delete[] threads;
+   delete[] state.queues;
+}
+
+io_limiter::io_limiter(uint32_t limit) noexcept : _free{limit ? limit : 1} {}
+
+void io_limiter::acquire() noexcept
+{
+   std::unique_lock lock{_mutex};
+
+   _available.wait(lock, [this] { return _free != 0; });
+
+   _free -= 1;
+}
+
+void io_limiter::release() noexcept
+{
+   {
+      std::lock_guard lock{_mutex};
+
+      _free += 1;
+   }
+
+   _available.notify_one();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4530)
+#endif
+
+#include <condition_variable>
+#include <mutex>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Get the number of hardware threads, at least 1.
+[[nodiscard]] auto hardware_thread_count() noexcept -> uint32_t;
+
+/// @brief Call job for every index in [0, count) on a work-stealing pool. Every thread starts
+/// with an even slice of the indices and takes from the front of it, threads that run out steal
+/// half of what's left from the back of another thread's slice. The calling thread takes part
+/// and the call returns once every job has finished.
+/// @param count The number of jobs, at most UINT32_MAX.
+/// @param thread_count The number of threads to use including the calling thread. Clamped to
+/// count, 0 uses hardware_thread_count.
+/// @param job The job function.
+/// @param context Passed through to job.
+void parallel_for(size_t count, uint32_t thread_count, void (*job)(void* context, size_t index),
+                  void* context) noexcept;
+
+/// @brief Counting semaphore bounding how many jobs do disk I/O at once. Running more jobs than
+/// there are disks only thrashes them once the files are bigger than the page cache.
+struct io_limiter {
+   explicit io_limiter(uint32_t limit) noexcept;
+
+   io_limiter(const io_limiter&) = delete;
+   auto operator=(const io_limiter&) -> io_limiter& = delete;
+
+   /// @brief Block until one of the slots is free and take it.
+   void acquire() noexcept;
+
+   /// @brief Return a slot taken by acquire.
+   void release() noexcept;
+
+private:
+   std::mutex _mutex;
+   std::condition_variable _available;
+   uint32_t _free;
+};
+
+/// @brief Holds a slot of an io_limiter for a scope. A null limiter does nothing.
+struct io_scope {
+   explicit io_scope(io_limiter* limiter) noexcept : _limiter{limiter}
+   {
+      if (_limiter) _limiter->acquire();
+   }
+
+   ~io_scope()
+   {
+      if (_limiter) _limiter->release();
+   }
+
+   io_scope(const io_scope&) = delete;
+   auto operator=(const io_scope&) -> io_scope& = delete;
+
+private:
+   io_limiter* _limiter;
+};
@@ -0,0 +1,365 @@
+#include "undo_journal.hpp"
+#include "crc32c.hpp"
+#include "exe_patcher.hpp"
+#include "file_helpers.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The file is the header, then a journal_file_range for every range sorted by offset, then the
+// original bytes of every range in the same order.
+
+static const char journal_magic[8] = {'B', 'F', '2', 'U', 'N', 'D', 'O', 'J'};
+constexpr uint32_t journal_version = 1;
+constexpr const char* journal_extension = ".bf2undo";
+
+struct journal_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t range_count;
+   uint64_t original_size;
+   uint64_t patched_size;
+   /// @brief CRC-32C of everything after the header.
+   uint32_t crc;
+   uint32_t reserved;
+};
+
+struct journal_file_range {
+   uint64_t offset;
+   uint32_t size;
+   uint32_t patched_crc;
+};
+
+static_assert(sizeof(journal_header) == 40);
+static_assert(sizeof(journal_file_range) == 16);
+
+void undo_journal::reset(size_t original_size) noexcept
+{
+   _original_size = original_size;
+   _patched_size = original_size;
+   _ranges.clear();
+   _bytes.clear();
+}
+
+void undo_journal::record(size_t offset, const uint8_t* current, size_t size)
+{
+   // Headers are written over and over by prepare, most writes land in a range already kept.
+   for (const journal_range& range : _ranges) {
+      if (range.offset <= offset and offset + size <= range.offset + range.size) return;
+   }
+
+   const size_t bytes_offset = _bytes.size();
+
+   _bytes.append(current, size);
+
+   // What the image holds now may already be patched where an earlier range overlaps.
+   for (const journal_range& range : _ranges) {
+      const size_t start = range.offset > offset ? range.offset : offset;
+      const size_t end =
+         range.offset + range.size < offset + size ? range.offset + range.size : offset + size;
+
+      if (start < end) {
+         memcpy(_bytes.data() + bytes_offset + (start - offset),
+                _bytes.data() + range.bytes_offset + (start - range.offset), end - start);
+      }
+   }
+
+   _ranges.push_back({offset, (uint32_t)size, 0, bytes_offset});
+}
+
+static int compare_ranges(const void* left, const void* right)
+{
+   const size_t left_offset = static_cast<const journal_range*>(left)->offset;
+   const size_t right_offset = static_cast<const journal_range*>(right)->offset;
+
+   return (left_offset > right_offset) - (left_offset < right_offset);
+}
+
+bool undo_journal::finish(const exe_patcher& editor)
+{
+   if (_ranges.size() != 0) {
+      qsort(_ranges.data(), _ranges.size(), sizeof(journal_range), compare_ranges);
+   }
+
+   // Overlapping ranges agree on the bytes they share, so merging them just appends the tails.
+   slim_vector<journal_range> merged;
+   slim_vector<uint8_t> merged_bytes;
+
+   for (const journal_range& range : _ranges) {
+      const size_t end = range.offset + range.size;
+
+      if (merged.size() != 0) {
+         journal_range& last = merged[merged.size() - 1];
+         const size_t last_end = last.offset + last.size;
+
+         if (range.offset <= last_end) {
+            if (end > last_end) {
+               merged_bytes.append(original(range) + (last_end - range.offset), end - last_end);
+
+               last.size = (uint32_t)(end - last.offset);
+            }
+
+            continue;
+         }
+      }
+
+      merged.push_back({range.offset, range.size, 0, merged_bytes.size()});
+      merged_bytes.append(original(range), range.size);
+   }
+
+   _ranges = merged;
+   _bytes = merged_bytes;
+   _patched_size = editor.size();
+
+   slim_vector<uint8_t> patched;
+
+   for (size_t i = 0; i < _ranges.size(); ++i) {
+      journal_range& range = _ranges[i];
+
+      patched.resize(range.size);
+
+      if (not editor.read(range.offset, patched.data(), range.size)) return false;
+
+      range.patched_crc = crc32c(0, patched.data(), range.size);
+   }
+
+   return true;
+}
+
+auto undo_journal::check(const exe_patcher& editor) const noexcept -> journal_state
+{
+   const size_t size = editor.size();
+
+   if (size != _patched_size and size != _original_size) return journal_state::changed;
+
+   bool original = size == _original_size;
+   slim_vector<uint8_t> current;
+
+   for (const journal_range& range : _ranges) {
+      current.resize(range.size);
+
+      if (not editor.read(range.offset, current.data(), range.size)) return journal_state::changed;
+
+      if (memcmp(current.data(), this->original(range), range.size) == 0) continue;
+
+      original = false;
+
+      if (crc32c(0, current.data(), range.size) != range.patched_crc) {
+         return journal_state::changed;
+      }
+   }
+
+   return original ? journal_state::original : journal_state::patched;
+}
+
+bool undo_journal::load(const char* path)
+{
+   reset(0);
+
+   FILE* file = open_file(path, "rb");
+
+   if (not file) return false;
+
+   slim_vector<uint8_t> data;
+   journal_header header = {};
+   size_t position = sizeof(journal_header);
+   bool result = false;
+   size_t file_size = 0;
+
+   if (not get_file_size(file, file_size) or file_size < sizeof(journal_header)) goto cleanup;
+
+   // The header is checked before the rest is read, so something that isn't a journal, such as a
+   // directory, isn't sized by whatever size is reported for it.
+   if (fread(&header, sizeof(journal_header), 1, file) != 1) goto cleanup;
+   if (memcmp(header.magic, journal_magic, sizeof(journal_magic)) != 0) goto cleanup;
+   if (header.version != journal_version) goto cleanup;
+
+   data.resize(file_size);
+
+   memcpy(data.data(), &header, sizeof(journal_header));
+
+   if (fread(data.data() + position, sizeof(uint8_t), data.size() - position, file) !=
+       data.size() - position) {
+      goto cleanup;
+   }
+
+   if (header.original_size > header.patched_size) goto cleanup;
+   if (crc32c(0, data.data() + position, data.size() - position) != header.crc) goto cleanup;
+   if ((data.size() - position) / sizeof(journal_file_range) < header.range_count) goto cleanup;
+
+   {
+      size_t bytes_position = position + header.range_count * sizeof(journal_file_range);
+      size_t previous_end = 0;
+
+      for (uint32_t i = 0; i < header.range_count; ++i) {
+         journal_file_range range;
+
+         memcpy(&range, data.data() + position, sizeof(journal_file_range));
+
+         position += sizeof(journal_file_range);
+
+         // Sorted, not overlapping and inside the original file.
+         if (range.offset < previous_end or range.size == 0) goto cleanup;
+         if (range.offset > header.original_size or
+             range.size > header.original_size - range.offset) {
+            goto cleanup;
+         }
+         if (range.size > data.size() - bytes_position) goto cleanup;
+
+         _ranges.push_back({(size_t)range.offset, range.size, range.patched_crc, _bytes.size()});
+         _bytes.append(data.data() + bytes_position, range.size);
+
+         bytes_position += range.size;
+         previous_end = (size_t)(range.offset + range.size);
+      }
+
+      if (bytes_position != data.size()) goto cleanup;
+   }
+
+   _original_size = (size_t)header.original_size;
+   _patched_size = (size_t)header.patched_size;
+
+   result = true;
+
+cleanup:
+   fclose(file);
+
+   if (not result) reset(0);
+
+   return result;
+}
+
+bool undo_journal::save(const char* path) const
+{
+   slim_vector<uint8_t> data;
+   journal_header header = {};
+
+   memcpy(header.magic, journal_magic, sizeof(journal_magic));
+   header.version = journal_version;
+   header.range_count = (uint32_t)_ranges.size();
+   header.original_size = _original_size;
+   header.patched_size = _patched_size;
+
+   data.resize(sizeof(journal_header));
+
+   for (const journal_range& range : _ranges) {
+      const journal_file_range file_range{range.offset, range.size, range.patched_crc};
+
+      data.append(reinterpret_cast<const uint8_t*>(&file_range), sizeof(file_range));
+   }
+
+   data.append(_bytes.data(), _bytes.size());
+
+   header.crc =
+      crc32c(0, data.data() + sizeof(journal_header), data.size() - sizeof(journal_header));
+
+   memcpy(data.data(), &header, sizeof(journal_header));
+
+   return save_file(path, "BF2Undo", data.data(), data.size());
+}
+
+char* journal_path(const char* file_path)
+{
+   const size_t length = strlen(file_path);
+   const size_t extension_length = strlen(journal_extension);
+   char* path = (char*)malloc(length + extension_length + 1);
+
+   if (not path) return nullptr;
+
+   memcpy(path, file_path, length);
+   memcpy(path + length, journal_extension, extension_length + 1);
+
+   return path;
+}
+
+bool unpatch(const char* file_path, int (*print)(const char* format, ...)) noexcept
+{
+   if (not print) print = printf;
+
+   char* path = journal_path(file_path);
+   undo_journal journal;
+   journal_state state = journal_state::changed;
+   FILE* file = nullptr;
+   bool result = false;
+
+   if (not path) return false;
+
+   if (not journal.load(path)) {
+      print("%s has no undo journal, it can't be unpatched.\r\n", file_path);
+
+      goto cleanup;
+   }
+
+   {
+      exe_patcher editor;
+
+      if (not editor.load(file_path, load_mode::read_only)) {
+         print("Failed to open %s.\r\n", file_path);
+
+         goto cleanup;
+      }
+
+      state = journal.check(editor);
+   }
+
+   if (state == journal_state::changed) {
+      print("%s changed since it was patched, its undo journal doesn't match it.\r\n", file_path);
+
+      goto cleanup;
+   }
+
+   if (state == journal_state::patched) {
+      file = open_file(file_path, "r+b");
+
+      if (not file) {
+         print("Failed to open %s for writing.\r\n", file_path);
+
+         goto cleanup;
+      }
+
+      for (const journal_range& range : journal.ranges()) {
+         if (not seek_file(file, range.offset) or
+             fwrite(journal.original(range), sizeof(uint8_t), range.size, file) != range.size) {
+            print("Failed to restore %s. Unpatch it again to finish.\r\n", file_path);
+
+            goto cleanup;
+         }
+      }
+
+      if (fclose(file) != 0) {
+         file = nullptr;
+
+         print("Failed to restore %s. Unpatch it again to finish.\r\n", file_path);
+
+         goto cleanup;
+      }
+
+      file = nullptr;
+   }
+
+   // Last, so a file cut short always has its ranges restored.
+   if (not resize_file(file_path, journal.original_size())) {
+      print("Failed to truncate %s. Unpatch it again to finish.\r\n", file_path);
+
+      goto cleanup;
+   }
+
+   if (state == journal_state::original) {
+      print("%s is already unpatched.\r\n", file_path);
+   }
+   else {
+      print("Restored %s from its undo journal, %zu bytes in %zu ranges.\r\n", file_path,
+            journal.kept_size(), journal.ranges().size());
+   }
+
+   remove(path);
+
+   result = true;
+
+cleanup:
+   if (file) fclose(file);
+   free(path);
+
+   return result;
+}
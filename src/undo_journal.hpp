@@ -0,0 +1,100 @@
+#pragma once
+
+#include "slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct exe_patcher;
+
+/// @brief A range of the original file and the bytes it held.
+struct journal_range {
+   size_t offset = 0;
+   uint32_t size = 0;
+   /// @brief CRC-32C of what the range holds in the patched file, so a patched file can be told
+   /// apart from one that changed since.
+   uint32_t patched_crc = 0;
+   /// @brief Where the original bytes are in the journal's bytes.
+   size_t bytes_offset = 0;
+};
+
+/// @brief What a file holds compared to a journal.
+enum class journal_state : uint8_t {
+   /// @brief Every range holds its patched or its original bytes and the file is the size of
+   /// one or the other, so it can be restored. A file partly restored is still patched.
+   patched,
+   /// @brief Every range holds its original bytes and the file is its original size.
+   original,
+   /// @brief The file isn't what the journal was written for.
+   changed,
+};
+
+/// @brief The original bytes of everything patching wrote to a file, saved next to it so it can
+/// be restored without a backup. Everything prepare adds goes past the end of the original file
+/// and is truncated away, so only the headers and the patch sites are kept, a few KB.
+/// Patching a file again keeps the journal of the first patch and adds to it.
+struct undo_journal {
+   /// @brief Start an empty journal for a file that is the original.
+   void reset(size_t original_size) noexcept;
+
+   /// @brief Keep the bytes a write is about to replace. Bytes kept by an earlier write, or by
+   /// an earlier patch of the file, are the older ones and are kept instead.
+   /// @param offset Where the write is, before the end of the original file.
+   /// @param current What the image holds there now.
+   /// @param size The size of the write.
+   void record(size_t offset, const uint8_t* current, size_t size);
+
+   /// @brief Sort and merge the ranges and record what each holds in the patched image. Must come
+   /// after every write.
+   /// @return False if the image couldn't be read.
+   [[nodiscard]] bool finish(const exe_patcher& editor);
+
+   /// @brief Compare a file against the journal. Only the ranges are read.
+   [[nodiscard]] auto check(const exe_patcher& editor) const noexcept -> journal_state;
+
+   /// @brief Read a journal file. A missing or damaged file leaves the journal empty.
+   [[nodiscard]] bool load(const char* path);
+
+   /// @brief Write the journal, replacing the file atomically.
+   [[nodiscard]] bool save(const char* path) const;
+
+   /// @brief The size of the file before it was first patched, 0 for an empty journal.
+   [[nodiscard]] auto original_size() const noexcept -> size_t
+   {
+      return _original_size;
+   }
+
+   [[nodiscard]] auto ranges() const noexcept -> const slim_vector<journal_range>&
+   {
+      return _ranges;
+   }
+
+   /// @brief The original bytes of a range.
+   [[nodiscard]] auto original(const journal_range& range) const noexcept -> const uint8_t*
+   {
+      return _bytes.data() + range.bytes_offset;
+   }
+
+   /// @brief The total size of the kept bytes.
+   [[nodiscard]] auto kept_size() const noexcept -> size_t
+   {
+      return _bytes.size();
+   }
+
+private:
+   size_t _original_size = 0;
+   size_t _patched_size = 0;
+   slim_vector<journal_range> _ranges;
+   slim_vector<uint8_t> _bytes;
+};
+
+/// @brief The path of the journal for an executable, the executable's path with .bf2undo added.
+/// @return The path. Must be passed to free if not null.
+[[nodiscard]] char* journal_path(const char* file_path);
+
+/// @brief Restore an executable from its journal in place, writing only the kept ranges and
+/// truncating what patching appended, then delete the journal. Restoring a file that was
+/// partly restored picks up where it stopped.
+/// @return False if there's no journal, or the file isn't what it was written for.
+[[nodiscard]] bool unpatch(const char* file_path,
+                           int (*print)(const char* format, ...)) noexcept;
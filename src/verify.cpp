@@ -0,0 +1,262 @@
+#include "verify.hpp"
+#include "applied_config.hpp"
+#include "capacities.hpp"
+#include "es_layout.hpp"
+#include "fingerprint.hpp"
+#include "json_helpers.hpp"
+#include "patch_locator.hpp"
+#include "patch_table.hpp"
+#include "thread_pool.hpp"
+
+constexpr uint32_t states_per_word = 32;
+
+void patch_set_status::push(patch_state state)
+{
+   if (count % states_per_word == 0) bitmap.push_back(0);
+
+   bitmap[count / states_per_word] |= (uint64_t)state << (count % states_per_word * 2);
+   count += 1;
+
+   switch (state) {
+   case patch_state::original:
+      original += 1;
+      break;
+   case patch_state::patched:
+      patched += 1;
+      break;
+   case patch_state::foreign:
+      foreign += 1;
+      break;
+   }
+}
+
+auto patch_set_status::state(uint32_t index) const noexcept -> patch_state
+{
+   if (index >= count) return patch_state::foreign;
+
+   return (patch_state)(bitmap[index / states_per_word] >> (index % states_per_word * 2) & 0x3);
+}
+
+auto patch_set_status::summary() const noexcept -> const char*
+{
+   if (not found) return "not found";
+   if (count == 0) return "empty";
+   if (foreign != 0) return "foreign";
+   if (patched == count) return "patched";
+   if (original == count) return "original";
+
+   return "partial";
+}
+
+bool verify_report::fully_patched() const noexcept
+{
+   if (result != verify_result::verified) return false;
+
+   for (const patch_set_status& set : sets) {
+      if (not set.found or set.patched != set.count) return false;
+   }
+
+   return true;
+}
+
+bool verify(const char* file_path, verify_report& report, io_limiter* io,
+            const capacity_values* capacities) noexcept
+{
+   const capacity_values default_capacities;
+
+   if (not capacities) capacities = &default_capacities;
+
+   report = {};
+
+   // Everything verify does is reading the mapping, so the whole call counts as I/O.
+   io_scope scope{io};
+
+   exe_patcher editor;
+
+   if (not editor.load(file_path, load_mode::read_only)) {
+      report.result = verify_result::open_failed;
+
+      return false;
+   }
+
+   patch_locator locator;
+   bool located = false;
+   const exe_patch_list* exe_list = identify_exe(editor, locator, located);
+
+   if (not exe_list) {
+      report.result = verify_result::unrecognized;
+
+      return false;
+   }
+
+   report.result = verify_result::verified;
+   report.exe_name = exe_list->name;
+   report.located = located;
+
+   // The extension section is laid out as apply would have, for the sets it would have applied.
+   bool enabled[PATCH_COUNT] = {};
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      enabled[i] = not located or locator.can_locate(exe_list->patches[i]);
+   }
+
+   es_layout layout;
+   applied_config legacy;
+
+   // Unless it was patched by a version from before the layout was planned.
+   if (not located and read_legacy_config(editor, *exe_list, legacy, layout)) {
+      report.has_ext_section = true;
+   }
+   else {
+      report.has_ext_section = plan_es_layout(*exe_list, enabled, *capacities, layout) and
+                               editor.find_ext_section(layout);
+   }
+   report.large_address_aware = editor.large_address_aware();
+
+   if (not fingerprint_exe(editor, report.fingerprint)) report.fingerprint = 0;
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      const patch_set& set = exe_list->patches[i];
+      patch_set_status status;
+
+      status.name = set.name;
+
+      if (not enabled[i]) {
+         status.found = false;
+
+         report.sets.push_back(status);
+
+         continue;
+      }
+
+      for (const patch& patch : set.patches) {
+         ::patch located_patch = patch;
+
+         if (located) (void)locator.locate(patch.address, located_patch.address);
+
+         // A value that doesn't fit can't have been patched in, the site can only be original.
+         if (not patch_value(patch, *capacities, located_patch.replacement_value)) {
+            located_patch.replacement_value = patch.expected_value;
+         }
+
+         status.push(editor.classify(located_patch));
+      }
+
+      for (const code_patch& patch : set.code_patches) {
+         code_patch located_patch = patch;
+
+         if (located) (void)locator.locate(patch.address, located_patch.address);
+
+         status.push(editor.classify(located_patch));
+      }
+
+      for (const trampoline& patch : set.trampolines) {
+         trampoline located_patch = patch;
+
+         if (located) (void)locator.locate(patch.address, located_patch.address);
+
+         status.push(editor.classify(located_patch));
+      }
+
+      report.sets.push_back(status);
+   }
+
+   return true;
+}
+
+static auto state_character(patch_state state) noexcept -> char
+{
+   switch (state) {
+   case patch_state::original:
+      return '.';
+   case patch_state::patched:
+      return 'P';
+   case patch_state::foreign:
+   default:
+      return 'x';
+   }
+}
+
+static void print_sites(const patch_set_status& set, int (*print)(const char* format, ...))
+{
+   char sites[65];
+   uint32_t length = 0;
+
+   for (uint32_t i = 0; i < set.count; ++i) {
+      sites[length++] = state_character(set.state(i));
+
+      if (length == sizeof(sites) - 1 or i + 1 == set.count) {
+         sites[length] = '\0';
+
+         print("%s", sites);
+
+         length = 0;
+      }
+   }
+}
+
+static auto result_name(verify_result result) noexcept -> const char*
+{
+   switch (result) {
+   case verify_result::verified:
+      return "verified";
+   case verify_result::open_failed:
+      return "open failed";
+   case verify_result::unrecognized:
+   default:
+      return "unrecognized";
+   }
+}
+
+void print_verify_report(const char* file_path, const verify_report& report, report_format format,
+                         int (*print)(const char* format, ...))
+{
+   if (format == report_format::json) {
+      print("{\"file\":");
+      print_json_string(print, file_path);
+      print(",\"result\":\"%s\"", result_name(report.result));
+
+      if (report.result == verify_result::verified) {
+         print(",\"build\":");
+         print_json_string(print, report.exe_name);
+         print(",\"fingerprint\":\"0x%08x\",\"located\":%s,\"ext_section\":%s,"
+               "\"large_address_aware\":%s,\"sets\":[",
+               report.fingerprint, report.located ? "true" : "false",
+               report.has_ext_section ? "true" : "false",
+               report.large_address_aware ? "true" : "false");
+
+         for (size_t i = 0; i < report.sets.size(); ++i) {
+            const patch_set_status& set = report.sets[i];
+
+            print(i == 0 ? "{\"name\":" : ",{\"name\":");
+            print_json_string(print, set.name);
+            print(",\"state\":\"%s\",\"original\":%u,\"patched\":%u,\"foreign\":%u,\"sites\":\"",
+                  set.summary(), set.original, set.patched, set.foreign);
+            print_sites(set, print);
+            print("\"}");
+         }
+
+         print("]");
+      }
+
+      print("}\r\n");
+
+      return;
+   }
+
+   if (report.result != verify_result::verified) {
+      print("%s: %s\r\n", file_path, result_name(report.result));
+
+      return;
+   }
+
+   print("%s: %s%s%s%s\r\n", file_path, report.exe_name, report.located ? " (signatures)" : "",
+         report.has_ext_section ? "" : ", no extension section",
+         report.large_address_aware ? ", large address aware" : "");
+
+   for (const patch_set_status& set : report.sets) {
+      print("   %-10s %-42s ", set.summary(), set.name);
+      print_sites(set, print);
+      print("\r\n");
+   }
+}
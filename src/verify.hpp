@@ -0,0 +1,68 @@
+#pragma once
+
+#include "exe_patcher.hpp"
+#include "slim_vector.hpp"
+
+#include <stdint.h>
+
+struct capacity_values;
+struct io_limiter;
+
+/// @brief The state of every site of a patch set, packed two bits to a site. Sites are numbered
+/// with the set's patches first and its code patches after them.
+struct patch_set_status {
+   const char* name = "";
+   /// @brief False if the set's sites couldn't be located in an unrecognized build. The set has
+   /// no sites then.
+   bool found = true;
+   uint32_t count = 0;
+   uint32_t original = 0;
+   uint32_t patched = 0;
+   uint32_t foreign = 0;
+   slim_vector<uint64_t> bitmap;
+
+   void push(patch_state state);
+
+   [[nodiscard]] auto state(uint32_t index) const noexcept -> patch_state;
+
+   /// @brief Summarize the set as "patched", "original", "partial", "foreign", "empty" or
+   /// "not found". Any foreign site makes the set foreign.
+   [[nodiscard]] auto summary() const noexcept -> const char*;
+};
+
+enum class verify_result : uint8_t { verified, open_failed, unrecognized };
+
+struct verify_report {
+   verify_result result = verify_result::open_failed;
+   /// @brief The name of the patch list the executable was checked against.
+   const char* exe_name = nullptr;
+   /// @brief If the patch sites were found using signatures instead of a known build's id.
+   bool located = false;
+   /// @brief If the executable has an extension section from an earlier patch.
+   bool has_ext_section = false;
+   /// @brief If the executable is marked large address aware.
+   bool large_address_aware = false;
+   /// @brief The executable's fingerprint, see fingerprint_exe. 0 if it couldn't be computed.
+   uint32_t fingerprint = 0;
+   slim_vector<patch_set_status> sets;
+
+   /// @brief Check if the executable was verified and every site of every set is patched.
+   [[nodiscard]] bool fully_patched() const noexcept;
+};
+
+enum class report_format { text, json };
+
+/// @brief Classify every site of every patch set in an executable without modifying it. The file
+/// is mapped read-only and nothing is ever written.
+/// @param file_path The executable.
+/// @param report The report to fill in.
+/// @param io Limits how many calls read at once. May be null.
+/// @param capacities The capacities the executable is expected to be patched with. Null for the
+/// defaults. Sites patched for other capacities are reported as foreign.
+/// @return If the executable was opened and identified.
+[[nodiscard]] bool verify(const char* file_path, verify_report& report, io_limiter* io = nullptr,
+                          const capacity_values* capacities = nullptr) noexcept;
+
+/// @brief Print a report, as a few lines of text or as a single line JSON object.
+void print_verify_report(const char* file_path, const verify_report& report, report_format format,
+                         int (*print)(const char* format, ...));
@@ -0,0 +1,365 @@
+#include "verify_cache.hpp"
+#include "crc32c.hpp"
+#include "patch_table.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every structure in the file is a multiple of 8 bytes so the bitmaps that follow them stay
+// aligned. Fields are read out with memcpy regardless.
+
+static const char cache_magic[8] = {'B', 'F', '2', 'V', 'C', 'A', 'C', 'H'};
+constexpr uint32_t cache_version = 2;
+constexpr uint8_t no_list = 0xff;
+
+struct cache_header {
+   char magic[8];
+   uint32_t version;
+   /// @brief See patch_table_hash, reports made against a different table or other capacities
+   /// are useless.
+   uint32_t table_hash;
+   uint32_t entry_count;
+   uint32_t reserved;
+};
+
+constexpr uint8_t entry_has_ext_section = 0x1;
+constexpr uint8_t entry_large_address_aware = 0x2;
+
+struct cache_entry_header {
+   file_identity identity;
+   /// @brief The size of the entry including its sets.
+   uint32_t size;
+   uint32_t fingerprint;
+   uint8_t result;
+   uint8_t list_index;
+   uint8_t located;
+   /// @brief entry_has_ext_section and entry_large_address_aware.
+   uint8_t flags;
+   uint32_t set_count;
+};
+
+/// @brief Followed by one uint64_t of patch_set_status::bitmap for every 32 sites.
+struct cache_set_header {
+   uint32_t count;
+   uint8_t found;
+   uint8_t reserved[3];
+};
+
+static_assert(sizeof(cache_header) == 24);
+static_assert(sizeof(cache_entry_header) == 48);
+static_assert(sizeof(cache_set_header) == 8);
+
+constexpr uint32_t sites_per_word = 32;
+
+static auto bitmap_words(uint32_t site_count) noexcept -> uint32_t
+{
+   return (site_count + sites_per_word - 1) / sites_per_word;
+}
+
+static auto compare_identity(const file_identity& left, const file_identity& right) noexcept -> int
+{
+   const uint64_t left_fields[] = {left.device, left.inode, left.size, left.modified};
+   const uint64_t right_fields[] = {right.device, right.inode, right.size, right.modified};
+
+   for (int i = 0; i < 4; ++i) {
+      if (left_fields[i] != right_fields[i]) return left_fields[i] < right_fields[i] ? -1 : 1;
+   }
+
+   return 0;
+}
+
+/// @brief Read and check the entry at offset.
+/// @return False if the entry is damaged or runs past the end of the data.
+static bool read_entry(const uint8_t* data, size_t size, size_t offset,
+                       cache_entry_header& out) noexcept
+{
+   if (offset > size or size - offset < sizeof(cache_entry_header)) return false;
+
+   memcpy(&out, data + offset, sizeof(cache_entry_header));
+
+   if (out.size > size - offset) return false;
+   if (out.result > (uint8_t)verify_result::unrecognized) return false;
+   if (out.list_index != no_list and out.list_index >= EXE_COUNT) return false;
+
+   const bool verified = out.result == (uint8_t)verify_result::verified;
+
+   if (verified != (out.list_index != no_list)) return false;
+   if (out.set_count != (verified ? PATCH_COUNT : 0)) return false;
+
+   size_t position = offset + sizeof(cache_entry_header);
+
+   for (uint32_t i = 0; i < out.set_count; ++i) {
+      cache_set_header set;
+
+      if (offset + out.size - position < sizeof(cache_set_header)) return false;
+
+      memcpy(&set, data + position, sizeof(cache_set_header));
+
+      position += sizeof(cache_set_header);
+
+      const size_t bitmap_size = bitmap_words(set.count) * sizeof(uint64_t);
+
+      if (offset + out.size - position < bitmap_size) return false;
+
+      position += bitmap_size;
+   }
+
+   return position == offset + out.size;
+}
+
+int verify_cache::compare_index_entries(const void* left, const void* right)
+{
+   const index_entry& left_entry = *static_cast<const index_entry*>(left);
+   const index_entry& right_entry = *static_cast<const index_entry*>(right);
+
+   if (const int order = compare_identity(left_entry.identity, right_entry.identity); order != 0) {
+      return order;
+   }
+
+   return (left_entry.offset > right_entry.offset) - (left_entry.offset < right_entry.offset);
+}
+
+verify_cache::~verify_cache()
+{
+   close();
+}
+
+void verify_cache::open(const char* path, const capacity_values* capacities) noexcept
+{
+   close();
+
+   const capacity_values values = capacities ? *capacities : capacity_values{};
+
+   // Patch values change with the capacities, so reports made for other ones are useless too.
+   _table_hash = crc32c(patch_table_hash(), values.values, sizeof(values.values));
+
+   if (not map_file_read_only(path, _mapping)) return;
+
+   cache_header header;
+
+   if (_mapping.size < sizeof(cache_header)) {
+      close();
+
+      return;
+   }
+
+   memcpy(&header, _mapping.data, sizeof(cache_header));
+
+   if (memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 or
+       header.version != cache_version or header.table_hash != _table_hash) {
+      close();
+
+      return;
+   }
+
+   size_t offset = sizeof(cache_header);
+
+   for (uint32_t i = 0; i < header.entry_count; ++i) {
+      cache_entry_header entry;
+
+      // Everything after a damaged entry is unreachable, the entries before it are still good.
+      if (not read_entry(_mapping.data, _mapping.size, offset, entry)) break;
+
+      _index.push_back({entry.identity, offset});
+
+      offset += entry.size;
+   }
+
+   if (_index.size() != 0) {
+      qsort(_index.data(), _index.size(), sizeof(index_entry), compare_index_entries);
+   }
+}
+
+bool verify_cache::find(const file_identity& identity, verify_report& report) const noexcept
+{
+   size_t first = 0;
+   size_t last = _index.size();
+
+   while (first < last) {
+      const size_t middle = first + (last - first) / 2;
+      const int order = compare_identity(_index[middle].identity, identity);
+
+      if (order == 0) {
+         first = middle;
+
+         break;
+      }
+
+      if (order < 0) {
+         first = middle + 1;
+      }
+      else {
+         last = middle;
+      }
+   }
+
+   if (first >= _index.size() or compare_identity(_index[first].identity, identity) != 0) {
+      return false;
+   }
+
+   const size_t offset = _index[first].offset;
+   cache_entry_header entry;
+
+   if (not read_entry(_mapping.data, _mapping.size, offset, entry)) return false;
+
+   report = {};
+   report.result = (verify_result)entry.result;
+   report.fingerprint = entry.fingerprint;
+   report.located = entry.located != 0;
+   report.has_ext_section = (entry.flags & entry_has_ext_section) != 0;
+   report.large_address_aware = (entry.flags & entry_large_address_aware) != 0;
+
+   if (entry.list_index == no_list) return true;
+
+   const exe_patch_list& list = patch_lists[entry.list_index];
+
+   report.exe_name = list.name;
+
+   size_t position = offset + sizeof(cache_entry_header);
+
+   for (uint32_t i = 0; i < entry.set_count; ++i) {
+      cache_set_header set;
+      patch_set_status status;
+
+      memcpy(&set, _mapping.data + position, sizeof(cache_set_header));
+
+      position += sizeof(cache_set_header);
+
+      status.name = list.patches[i].name;
+      status.found = set.found != 0;
+
+      for (uint32_t site = 0; site < set.count; ++site) {
+         uint64_t word = 0;
+
+         memcpy(&word, _mapping.data + position + site / sites_per_word * sizeof(uint64_t),
+                sizeof(uint64_t));
+
+         const uint32_t state = word >> (site % sites_per_word * 2) & 0x3;
+
+         status.push(state <= (uint32_t)patch_state::foreign ? (patch_state)state
+                                                             : patch_state::foreign);
+      }
+
+      position += bitmap_words(set.count) * sizeof(uint64_t);
+
+      report.sets.push_back(status);
+   }
+
+   return true;
+}
+
+void verify_cache::store(const file_identity& identity, const verify_report& report)
+{
+   if (report.result == verify_result::open_failed) return;
+
+   cache_entry_header entry = {};
+
+   entry.identity = identity;
+   entry.fingerprint = report.fingerprint;
+   entry.result = (uint8_t)report.result;
+   entry.list_index = no_list;
+   entry.located = report.located;
+   entry.flags = (report.has_ext_section ? entry_has_ext_section : 0) |
+                 (report.large_address_aware ? entry_large_address_aware : 0);
+
+   if (report.result == verify_result::verified) {
+      for (uint32_t i = 0; i < EXE_COUNT; ++i) {
+         if (patch_lists[i].name == report.exe_name) entry.list_index = (uint8_t)i;
+      }
+
+      if (entry.list_index == no_list or report.sets.size() != PATCH_COUNT) return;
+
+      entry.set_count = PATCH_COUNT;
+   }
+
+   const size_t offset = _stored.size();
+
+   _stored.resize(offset + sizeof(cache_entry_header));
+
+   for (const patch_set_status& status : report.sets) {
+      cache_set_header set = {};
+
+      set.count = status.count;
+      set.found = status.found;
+
+      _stored.append(reinterpret_cast<const uint8_t*>(&set), sizeof(set));
+      _stored.append(reinterpret_cast<const uint8_t*>(status.bitmap.data()),
+                     bitmap_words(status.count) * sizeof(uint64_t));
+   }
+
+   entry.size = (uint32_t)(_stored.size() - offset);
+
+   memcpy(_stored.data() + offset, &entry, sizeof(cache_entry_header));
+
+   _stored_index.push_back({identity, offset});
+}
+
+bool verify_cache::save(const char* path)
+{
+   slim_vector<uint8_t> file;
+   cache_header header = {};
+
+   memcpy(header.magic, cache_magic, sizeof(cache_magic));
+   header.version = cache_version;
+   header.table_hash = _table_hash;
+
+   file.resize(sizeof(cache_header));
+
+   const auto append_entry = [&](const uint8_t* data, size_t offset) {
+      cache_entry_header entry;
+
+      memcpy(&entry, data + offset, sizeof(cache_entry_header));
+
+      file.append(data + offset, entry.size);
+      header.entry_count += 1;
+   };
+
+   // Sorting by identity then offset puts the latest report for each identity last in its run.
+   if (_stored_index.size() != 0) {
+      qsort(_stored_index.data(), _stored_index.size(), sizeof(index_entry),
+            compare_index_entries);
+   }
+
+   for (size_t i = 0; i < _stored_index.size() and header.entry_count < max_cache_entries; ++i) {
+      if (i + 1 < _stored_index.size() and
+          compare_identity(_stored_index[i].identity, _stored_index[i + 1].identity) == 0) {
+         continue;
+      }
+
+      append_entry(_stored.data(), _stored_index[i].offset);
+   }
+
+   // Both indices are sorted, so old entries replaced by new ones are found by merging.
+   size_t stored = 0;
+
+   for (size_t i = 0; i < _index.size() and header.entry_count < max_cache_entries; ++i) {
+      while (stored < _stored_index.size() and
+             compare_identity(_stored_index[stored].identity, _index[i].identity) < 0) {
+         stored += 1;
+      }
+
+      if (stored < _stored_index.size() and
+          compare_identity(_stored_index[stored].identity, _index[i].identity) == 0) {
+         continue;
+      }
+
+      append_entry(_mapping.data, _index[i].offset);
+   }
+
+   memcpy(file.data(), &header, sizeof(cache_header));
+
+   // Windows refuses to replace a file that is still mapped.
+   close();
+
+   return save_file(path, "BF2Cache", file.data(), file.size());
+}
+
+void verify_cache::close() noexcept
+{
+   unmap_file(_mapping);
+
+   _index.clear();
+   _stored.clear();
+   _stored_index.clear();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "capacities.hpp"
+#include "file_helpers.hpp"
+#include "slim_vector.hpp"
+#include "verify.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief The most entries a cache file keeps. Entries from the latest run are kept first, then
+/// as many of the old ones as fit.
+constexpr uint32_t max_cache_entries = 65536;
+
+/// @brief On-disk cache of verify reports, keyed by file_identity so unchanged files can be
+/// reported without being opened. The file is mapped read-only and looked up in place. New
+/// reports are collected in memory and written out together by save, which replaces the file
+/// atomically. A cache written by a build with a different patch table is ignored.
+struct verify_cache {
+   verify_cache() = default;
+
+   ~verify_cache();
+
+   verify_cache(const verify_cache&) = delete;
+   auto operator=(const verify_cache&) -> verify_cache& = delete;
+
+   /// @brief Map a cache file and index its entries. A missing, damaged or outdated file leaves
+   /// the cache empty.
+   /// @param capacities The capacities the reports are made against, null for the defaults. A
+   /// cache written for other capacities is outdated.
+   void open(const char* path, const capacity_values* capacities = nullptr) noexcept;
+
+   /// @brief Look up the report of a file version. Safe to call from many threads at once.
+   /// @return False if the cache has no report for it.
+   [[nodiscard]] bool find(const file_identity& identity, verify_report& report) const noexcept;
+
+   /// @brief Add the report of a file version, replacing any earlier one. Not thread safe.
+   /// Reports that failed to open aren't stored.
+   void store(const file_identity& identity, const verify_report& report);
+
+   /// @brief Write the stored reports and the old entries they don't replace to a cache file.
+   /// The cache is empty afterwards.
+   [[nodiscard]] bool save(const char* path);
+
+private:
+   struct index_entry {
+      file_identity identity;
+      size_t offset = 0;
+   };
+
+   mapped_file _mapping;
+   slim_vector<index_entry> _index;
+   uint32_t _table_hash = 0;
+
+   slim_vector<uint8_t> _stored;
+   slim_vector<index_entry> _stored_index;
+
+   void close() noexcept;
+
+   /// @brief Order index entries by identity, then by offset.
+   static int compare_index_entries(const void* left, const void* right);
+};
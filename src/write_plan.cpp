@@ -0,0 +1,200 @@
+#include "write_plan.hpp"
+#include "cpu_features.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if BF2_X86
+#include <immintrin.h>
+#endif
+
+void write_plan::add(size_t offset, const void* expected, const void* replacement, uint32_t size,
+                     uint32_t tag)
+{
+   _sites.push_back({offset, size, tag, _site_bytes.size()});
+
+   _site_bytes.append(static_cast<const uint8_t*>(expected), size);
+   _site_bytes.append(static_cast<const uint8_t*>(replacement), size);
+
+   _built = false;
+}
+
+bool write_plan::build(size_t image_size)
+{
+   _runs.clear();
+   _run_bytes.clear();
+   _built = false;
+
+   if (_sites.size() == 0) {
+      _built = true;
+
+      return true;
+   }
+
+   qsort(_sites.data(), _sites.size(), sizeof(write_site),
+         [](const void* left, const void* right) -> int {
+            const size_t left_offset = static_cast<const write_site*>(left)->offset;
+            const size_t right_offset = static_cast<const write_site*>(right)->offset;
+
+            return (left_offset > right_offset) - (left_offset < right_offset);
+         });
+
+   for (size_t i = 0; i < _sites.size(); ++i) {
+      const write_site& site = _sites[i];
+
+      if (site.offset > image_size or site.size > image_size - site.offset) return false;
+      if (i != 0 and site.offset < _sites[i - 1].offset + _sites[i - 1].size) return false;
+   }
+
+   for (uint32_t i = 0; i < _sites.size();) {
+      write_run run;
+
+      run.offset = _sites[i].offset;
+      run.first_site = i;
+
+      size_t end = _sites[i].offset + _sites[i].size;
+      uint32_t next = i + 1;
+
+      while (next < _sites.size() and _sites[next].offset - end <= max_run_gap) {
+         end = _sites[next].offset + _sites[next].size;
+         next += 1;
+      }
+
+      run.size = (uint32_t)(end - run.offset);
+      run.site_count = next - i;
+      run.bytes_offset = _run_bytes.size();
+
+      // Expected, replacement and mask, all zero until the sites are laid over them.
+      _run_bytes.reserve(_run_bytes.size() + run.size * 3);
+
+      for (uint32_t j = 0; j < run.size * 3; ++j) _run_bytes.push_back(0);
+
+      uint8_t* expected = _run_bytes.data() + run.bytes_offset;
+      uint8_t* replacement = expected + run.size;
+      uint8_t* mask = replacement + run.size;
+
+      for (uint32_t j = i; j < next; ++j) {
+         const write_site& site = _sites[j];
+         const size_t position = site.offset - run.offset;
+
+         memcpy(expected + position, site_expected(site), site.size);
+         memcpy(replacement + position, site_replacement(site), site.size);
+         memset(mask + position, 0xff, site.size);
+      }
+
+      _runs.push_back(run);
+
+      i = next;
+   }
+
+   _built = true;
+
+   return true;
+}
+
+void write_plan::fill_gaps(const write_run& run, const uint8_t* current) noexcept
+{
+   uint8_t* expected = _run_bytes.data() + run.bytes_offset;
+   uint8_t* replacement = expected + run.size;
+   const uint8_t* mask = replacement + run.size;
+
+   for (uint32_t i = 0; i < run.size; ++i) {
+      if (mask[i]) continue;
+
+      expected[i] = current[i];
+      replacement[i] = current[i];
+   }
+}
+
+void write_plan::clear() noexcept
+{
+   _sites.clear();
+   _runs.clear();
+   _site_bytes.clear();
+   _run_bytes.clear();
+   _built = false;
+}
+
+bool write_plan::built() const noexcept
+{
+   return _built;
+}
+
+auto write_plan::sites() const noexcept -> const slim_vector<write_site>&
+{
+   return _sites;
+}
+
+auto write_plan::runs() const noexcept -> const slim_vector<write_run>&
+{
+   return _runs;
+}
+
+auto write_plan::site_expected(const write_site& site) const noexcept -> const uint8_t*
+{
+   return _site_bytes.data() + site.bytes_offset;
+}
+
+auto write_plan::site_replacement(const write_site& site) const noexcept -> const uint8_t*
+{
+   return _site_bytes.data() + site.bytes_offset + site.size;
+}
+
+auto write_plan::run_expected(const write_run& run) const noexcept -> const uint8_t*
+{
+   return _run_bytes.data() + run.bytes_offset;
+}
+
+auto write_plan::run_replacement(const write_run& run) const noexcept -> const uint8_t*
+{
+   return _run_bytes.data() + run.bytes_offset + run.size;
+}
+
+auto write_plan::run_mask(const write_run& run) const noexcept -> const uint8_t*
+{
+   return _run_bytes.data() + run.bytes_offset + run.size * 2;
+}
+
+static bool masked_equal_scalar(const uint8_t* left, const uint8_t* right, const uint8_t* mask,
+                                size_t size) noexcept
+{
+   for (size_t i = 0; i < size; ++i) {
+      if ((left[i] ^ right[i]) & mask[i]) return false;
+   }
+
+   return true;
+}
+
+#if BF2_X86
+
+BF2_TARGET("sse2")
+bool masked_equal(const uint8_t* left, const uint8_t* right, const uint8_t* mask,
+                  size_t size) noexcept
+{
+   const __m128i zero = _mm_setzero_si128();
+   size_t i = 0;
+
+   for (; i + 16 <= size; i += 16) {
+      const __m128i left_block = _mm_loadu_si128((const __m128i*)(left + i));
+      const __m128i right_block = _mm_loadu_si128((const __m128i*)(right + i));
+      const __m128i mask_block = _mm_loadu_si128((const __m128i*)(mask + i));
+
+      // A byte matches if it's equal or masked out.
+      const __m128i match = _mm_or_si128(_mm_cmpeq_epi8(left_block, right_block),
+                                         _mm_cmpeq_epi8(mask_block, zero));
+
+      if (_mm_movemask_epi8(match) != 0xffff) return false;
+   }
+
+   return masked_equal_scalar(left + i, right + i, mask + i, size - i);
+}
+
+#else
+
+bool masked_equal(const uint8_t* left, const uint8_t* right, const uint8_t* mask,
+                  size_t size) noexcept
+{
+   return masked_equal_scalar(left, right, mask, size);
+}
+
+#endif
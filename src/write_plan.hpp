@@ -0,0 +1,88 @@
+#pragma once
+
+#include "slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Sites closer together than this are merged into one run. The bytes between them are
+/// left as they are, masked out of the compares and copied back unchanged.
+constexpr uint32_t max_run_gap = 32;
+
+/// @brief A single patch or code patch resolved to a file offset.
+struct write_site {
+   size_t offset = 0;
+   uint32_t size = 0;
+   /// @brief Caller defined, reported back when the site fails to verify.
+   uint32_t tag = 0;
+   /// @brief Where the site's expected and replacement bytes are in the plan.
+   size_t bytes_offset = 0;
+};
+
+/// @brief A contiguous range of the image covering one or more sites.
+struct write_run {
+   size_t offset = 0;
+   uint32_t size = 0;
+   uint32_t first_site = 0;
+   uint32_t site_count = 0;
+   /// @brief Where the run's expected, replacement and mask bytes are in the plan.
+   size_t bytes_offset = 0;
+};
+
+/// @brief A set of writes to an image, sorted by offset and merged into runs. Each run is checked
+/// with one masked compare against its expected and replacement bytes and committed with one
+/// copy, so applying costs scale with the number of regions touched instead of the number of
+/// patches. Runs are also the unit dirty ranges are recorded in.
+struct write_plan {
+   /// @brief Add a site. Sites may be added in any order.
+   void add(size_t offset, const void* expected, const void* replacement, uint32_t size,
+            uint32_t tag);
+
+   /// @brief Sort the sites and merge them into runs. The bytes between the sites of a run are
+   /// unknown until fill_gaps is called for it.
+   /// @param image_size The size of the image the plan will be applied to.
+   /// @return False if sites overlap or run past the end of the image.
+   [[nodiscard]] bool build(size_t image_size);
+
+   /// @brief Copy the bytes between a run's sites from the image into its expected and
+   /// replacement bytes, so committing the run leaves them unchanged.
+   /// @param run A run of this plan.
+   /// @param current The image's bytes at the run's offset, run.size of them.
+   void fill_gaps(const write_run& run, const uint8_t* current) noexcept;
+
+   /// @brief Drop all sites and runs, keeping the storage for reuse.
+   void clear() noexcept;
+
+   [[nodiscard]] bool built() const noexcept;
+
+   [[nodiscard]] auto sites() const noexcept -> const slim_vector<write_site>&;
+
+   [[nodiscard]] auto runs() const noexcept -> const slim_vector<write_run>&;
+
+   [[nodiscard]] auto site_expected(const write_site& site) const noexcept -> const uint8_t*;
+
+   [[nodiscard]] auto site_replacement(const write_site& site) const noexcept -> const uint8_t*;
+
+   [[nodiscard]] auto run_expected(const write_run& run) const noexcept -> const uint8_t*;
+
+   [[nodiscard]] auto run_replacement(const write_run& run) const noexcept -> const uint8_t*;
+
+   /// @brief 0xff for bytes belonging to a site, 0 for the gaps between them.
+   [[nodiscard]] auto run_mask(const write_run& run) const noexcept -> const uint8_t*;
+
+private:
+   slim_vector<write_site> _sites;
+   slim_vector<write_run> _runs;
+
+   // Expected bytes then replacement bytes of every site, in the order they were added.
+   slim_vector<uint8_t> _site_bytes;
+
+   // Expected, replacement and mask bytes of every run.
+   slim_vector<uint8_t> _run_bytes;
+
+   bool _built = false;
+};
+
+/// @brief Compare two buffers, ignoring bytes with a zero mask. Vectorized on x86.
+[[nodiscard]] bool masked_equal(const uint8_t* left, const uint8_t* right, const uint8_t* mask,
+                                size_t size) noexcept;
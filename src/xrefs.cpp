@@ -0,0 +1,501 @@
+#include "xrefs.hpp"
+#include "capacities.hpp"
+#include "chunk_reader.hpp"
+#include "cpu_features.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if BF2_X86
+#include <immintrin.h>
+#endif
+
+static const char* const region_identifiers[es_region_id_count] = {
+   "none",
+   "dlc_missions",
+   "matrix_pool",
+   "hirez_area",
+};
+
+constexpr uint16_t reloc_type_highlow = 3;
+
+/// @brief The dwords one scan compares against.
+struct dword_filter {
+   uint32_t range_begin = 0;
+   /// @brief 0 for no range, nothing is below it.
+   uint32_t range_size = 0;
+   const uint32_t* constants = nullptr;
+   uint32_t constant_count = 0;
+
+   [[nodiscard]] bool in_range(uint32_t value) const noexcept
+   {
+      return value - range_begin < range_size;
+   }
+
+   [[nodiscard]] bool is_constant(uint32_t value) const noexcept
+   {
+      for (uint32_t i = 0; i < constant_count; ++i) {
+         if (constants[i] == value) return true;
+      }
+
+      return false;
+   }
+};
+
+/// @brief Called with the position and value of every dword that passed the filter.
+using dword_hit_callback = void (*)(void* context, size_t position, uint32_t value);
+
+static auto load_dword(const uint8_t* data) noexcept -> uint32_t
+{
+   uint32_t value = 0;
+
+   memcpy(&value, data, sizeof(value));
+
+   return value;
+}
+
+static void scan_dwords_scalar(const uint8_t* data, size_t size, size_t start, size_t limit,
+                               const dword_filter& filter, dword_hit_callback hit,
+                               void* context) noexcept
+{
+   for (size_t position = start; position + sizeof(uint32_t) <= size and position < limit;
+        ++position) {
+      const uint32_t value = load_dword(data + position);
+
+      if (filter.in_range(value) or filter.is_constant(value)) hit(context, position, value);
+   }
+}
+
+/// @brief Report the hits of a block in position order. Bit 4 * k + j of lanes is the dword
+/// starting j bytes into the k-th dword of the block.
+static void report_block(const uint8_t* data, size_t position, size_t limit, uint32_t lanes,
+                         const dword_filter& filter, dword_hit_callback hit,
+                         void* context) noexcept
+{
+   while (lanes) {
+#ifdef _MSC_VER
+      unsigned long bit = 0;
+
+      _BitScanForward(&bit, lanes);
+#else
+      const uint32_t bit = (uint32_t)__builtin_ctz(lanes);
+#endif
+
+      const size_t hit_position = position + bit;
+
+      // The SIMD compare lets through anything equal to a constant or in the range, recheck to
+      // drop the positions past the limit.
+      if (hit_position < limit) {
+         const uint32_t value = load_dword(data + hit_position);
+
+         if (filter.in_range(value) or filter.is_constant(value)) {
+            hit(context, hit_position, value);
+         }
+      }
+
+      lanes &= lanes - 1;
+   }
+}
+
+#if BF2_X86
+
+BF2_TARGET("sse2")
+static auto scan_dwords_sse2(const uint8_t* data, size_t size, size_t limit,
+                             const dword_filter& filter, dword_hit_callback hit,
+                             void* context) noexcept -> size_t
+{
+   const __m128i bias = _mm_set1_epi32((int)0x80000000);
+   const __m128i begin = _mm_set1_epi32((int)filter.range_begin);
+   const __m128i biased_size = _mm_xor_si128(_mm_set1_epi32((int)filter.range_size), bias);
+   __m128i constants[max_simd_xref_constants];
+
+   for (uint32_t i = 0; i < filter.constant_count; ++i) {
+      constants[i] = _mm_set1_epi32((int)filter.constants[i]);
+   }
+
+   size_t position = 0;
+
+   // Four loads a byte apart hold the 16 dwords starting in the block.
+   for (; position + 16 + 3 <= size and position < limit; position += 16) {
+      uint32_t lanes = 0;
+
+      for (uint32_t j = 0; j < 4; ++j) {
+         const __m128i values = _mm_loadu_si128((const __m128i*)(data + position + j));
+         const __m128i offsets = _mm_xor_si128(_mm_sub_epi32(values, begin), bias);
+         __m128i hits = _mm_cmplt_epi32(offsets, biased_size);
+
+         for (uint32_t i = 0; i < filter.constant_count; ++i) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi32(values, constants[i]));
+         }
+
+         const uint32_t mask = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(hits));
+
+         for (uint32_t k = 0; k < 4; ++k) {
+            if (mask & (1u << k)) lanes |= 1u << (k * 4 + j);
+         }
+      }
+
+      report_block(data, position, limit, lanes, filter, hit, context);
+   }
+
+   return position;
+}
+
+BF2_TARGET("avx2")
+static auto scan_dwords_avx2(const uint8_t* data, size_t size, size_t limit,
+                             const dword_filter& filter, dword_hit_callback hit,
+                             void* context) noexcept -> size_t
+{
+   const __m256i bias = _mm256_set1_epi32((int)0x80000000);
+   const __m256i begin = _mm256_set1_epi32((int)filter.range_begin);
+   const __m256i biased_size = _mm256_xor_si256(_mm256_set1_epi32((int)filter.range_size), bias);
+   __m256i constants[max_simd_xref_constants];
+
+   for (uint32_t i = 0; i < filter.constant_count; ++i) {
+      constants[i] = _mm256_set1_epi32((int)filter.constants[i]);
+   }
+
+   size_t position = 0;
+
+   for (; position + 32 + 3 <= size and position < limit; position += 32) {
+      uint32_t lanes = 0;
+
+      for (uint32_t j = 0; j < 4; ++j) {
+         const __m256i values = _mm256_loadu_si256((const __m256i*)(data + position + j));
+         const __m256i offsets = _mm256_xor_si256(_mm256_sub_epi32(values, begin), bias);
+         __m256i hits = _mm256_cmpgt_epi32(biased_size, offsets);
+
+         for (uint32_t i = 0; i < filter.constant_count; ++i) {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi32(values, constants[i]));
+         }
+
+         const uint32_t mask = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(hits));
+
+         for (uint32_t k = 0; k < 8; ++k) {
+            if (mask & (1u << k)) lanes |= 1u << (k * 4 + j);
+         }
+      }
+
+      report_block(data, position, limit, lanes, filter, hit, context);
+   }
+
+   return position;
+}
+
+#endif
+
+/// @brief Report every dword of a buffer that passes the filter.
+/// @param limit Dwords starting at or past this position are ignored, so a large section can be
+/// scanned in overlapping windows.
+static void scan_dwords(const uint8_t* data, size_t size, size_t limit, const dword_filter& filter,
+                        dword_hit_callback hit, void* context) noexcept
+{
+   size_t scanned = 0;
+
+#if BF2_X86
+   if (filter.constant_count <= max_simd_xref_constants) {
+      scanned = cpu_has_avx2() ? scan_dwords_avx2(data, size, limit, filter, hit, context)
+                               : scan_dwords_sse2(data, size, limit, filter, hit, context);
+   }
+#endif
+
+   scan_dwords_scalar(data, size, scanned, limit, filter, hit, context);
+}
+
+struct scan_context {
+   slim_vector<xref>* out = nullptr;
+   const xref_query* query = nullptr;
+   const pe_section_header* section = nullptr;
+   uint32_t image_base = 0;
+   /// @brief The file offset of the buffer being scanned.
+   size_t base_offset = 0;
+   bool code = false;
+   bool addresses = false;
+};
+
+static void copy_section_name(const pe_section_header& section, char (&out)[pe_sizeof_short_name + 1])
+{
+   memcpy(out, section.name, pe_sizeof_short_name);
+
+   out[pe_sizeof_short_name] = '\0';
+}
+
+static void record_hit(void* context_pointer, size_t position, uint32_t value)
+{
+   const scan_context& context = *static_cast<const scan_context*>(context_pointer);
+   const size_t offset = context.base_offset + position;
+   const bool address = context.addresses and value - context.query->range_begin <
+                                                 context.query->range_end - context.query->range_begin;
+
+   xref xref;
+
+   xref.offset = offset;
+   xref.va = context.image_base + context.section->virtual_address +
+             (uint32_t)(offset - context.section->pointer_to_raw_data);
+   xref.value = value;
+
+   copy_section_name(*context.section, xref.section);
+
+   if (address) {
+      // Pointers in data are aligned, anything else there is bytes that happen to match.
+      if (context.code or offset % sizeof(uint32_t) == 0) {
+         xref.kind = xref_kind::address;
+
+         context.out->push_back(xref);
+      }
+   }
+
+   if (context.code) {
+      for (const uint32_t constant : context.query->constants) {
+         if (constant != value) continue;
+
+         xref.kind = xref_kind::constant;
+
+         context.out->push_back(xref);
+
+         break;
+      }
+   }
+}
+
+bool read_relocations(const exe_patcher& editor, slim_vector<uint32_t>& out) noexcept
+{
+   out.clear();
+
+   const pe_image& image = editor.image();
+   pe_data_directory directory = {};
+
+   if (not image.data_directory(PE_DIRECTORY_BASERELOC, directory) or directory.size == 0) {
+      return false;
+   }
+
+   size_t directory_offset = 0;
+
+   if (not editor.resolve({directory.virtual_address, address_space::rva}, directory.size,
+                          directory_offset)) {
+      return false;
+   }
+
+   slim_vector<uint8_t> relocations;
+
+   relocations.resize(directory.size);
+
+   if (not editor.read(directory_offset, relocations.data(), relocations.size())) return false;
+
+   // Blocks of a page RVA, the block size and then a 16-bit entry per address in the page.
+   for (size_t block = 0; block + 8 <= relocations.size();) {
+      const uint32_t page_rva = load_dword(relocations.data() + block);
+      const uint32_t block_size = load_dword(relocations.data() + block + 4);
+
+      if (block_size < 8 or block_size > relocations.size() - block) break;
+
+      for (size_t entry = block + 8; entry + 2 <= block + block_size; entry += 2) {
+         uint16_t value = 0;
+
+         memcpy(&value, relocations.data() + entry, sizeof(value));
+
+         if (value >> 12 == reloc_type_highlow) out.push_back(page_rva + (value & 0xfff));
+      }
+
+      block += block_size;
+   }
+
+   return true;
+}
+
+/// @brief Add the references into the range listed in the base relocations.
+/// @return False if the image has no base relocations.
+static bool find_relocated_xrefs(const exe_patcher& editor, const xref_query& query,
+                                 slim_vector<xref>& out) noexcept
+{
+   const pe_image& image = editor.image();
+   slim_vector<uint32_t> relocations;
+
+   if (not read_relocations(editor, relocations)) return false;
+
+   const uint32_t image_base = image.optional_header().image_base;
+
+   for (const uint32_t rva : relocations) {
+      size_t offset = 0;
+      uint32_t target = 0;
+
+      if (not editor.resolve({rva, address_space::rva}, sizeof(uint32_t), offset)) continue;
+      if (not editor.read(offset, &target, sizeof(target))) continue;
+      if (target - query.range_begin >= query.range_end - query.range_begin) continue;
+
+      xref xref;
+
+      xref.offset = offset;
+      xref.va = image_base + rva;
+      xref.value = target;
+      xref.kind = xref_kind::address;
+      xref.relocated = true;
+
+      for (uint32_t i = 0; i < image.section_count(); ++i) {
+         const pe_section_header section = image.section(i);
+
+         if (rva - section.virtual_address < section.virtual_size) {
+            copy_section_name(section, xref.section);
+         }
+      }
+
+      out.push_back(xref);
+   }
+
+   return true;
+}
+
+bool find_xrefs(const exe_patcher& editor, const xref_query& query, slim_vector<xref>& out) noexcept
+{
+   out.clear();
+
+   const pe_image& image = editor.image();
+
+   if (not image.valid()) return false;
+
+   const bool relocated = query.range_end > query.range_begin and
+                          find_relocated_xrefs(editor, query, out);
+   const bool scan_addresses = query.range_end > query.range_begin and not relocated;
+
+   dword_filter filter;
+
+   if (scan_addresses) {
+      filter.range_begin = query.range_begin;
+      filter.range_size = query.range_end - query.range_begin;
+   }
+
+   filter.constants = query.constants.data();
+   filter.constant_count = (uint32_t)query.constants.size();
+
+   slim_vector<uint8_t> window;
+
+   window.resize(stream_chunk_size + sizeof(uint32_t) - 1);
+
+   for (uint32_t i = 0; i < image.section_count(); ++i) {
+      const pe_section_header section = image.section(i);
+      const bool code = (section.characteristics & (pe_scn_cnt_code | pe_scn_mem_execute)) != 0;
+
+      if (not code and not scan_addresses) continue;
+
+      size_t offset = 0;
+      size_t size = section.size_of_raw_data;
+
+      if (section.virtual_size != 0 and section.virtual_size < size) size = section.virtual_size;
+      if (size < sizeof(uint32_t)) continue;
+      if (not editor.resolve({section.virtual_address, address_space::rva}, (uint32_t)size,
+                             offset)) {
+         continue;
+      }
+
+      dword_filter section_filter = filter;
+
+      // Constants are only looked for in code.
+      if (not code) section_filter.constant_count = 0;
+
+      scan_context context;
+
+      context.out = &out;
+      context.query = &query;
+      context.section = &section;
+      context.image_base = image.optional_header().image_base;
+      context.code = code;
+      context.addresses = scan_addresses;
+
+      // Windows overlap by a dword less a byte so dwords across their edges are still seen.
+      for (size_t position = 0; position < size; position += stream_chunk_size) {
+         const size_t scan_size =
+            size - position < stream_chunk_size ? size - position : stream_chunk_size;
+         const size_t read_size = size - position < scan_size + sizeof(uint32_t) - 1
+                                     ? size - position
+                                     : scan_size + sizeof(uint32_t) - 1;
+
+         if (not editor.read(offset + position, window.data(), read_size)) return false;
+
+         context.base_offset = offset + position;
+
+         scan_dwords(window.data(), read_size, scan_size, section_filter, record_hit, &context);
+      }
+   }
+
+   qsort(out.data(), out.size(), sizeof(xref), [](const void* left, const void* right) -> int {
+      const xref& left_xref = *static_cast<const xref*>(left);
+      const xref& right_xref = *static_cast<const xref*>(right);
+
+      if (left_xref.offset != right_xref.offset) {
+         return (left_xref.offset > right_xref.offset) - (left_xref.offset < right_xref.offset);
+      }
+
+      return (int)left_xref.kind - (int)right_xref.kind;
+   });
+
+   return true;
+}
+
+void print_xrefs(const xref_query& query, const slim_vector<xref>& xrefs,
+                 int (*print)(const char* format, ...)) noexcept
+{
+   uint32_t address_count = 0;
+   uint32_t constant_count = 0;
+
+   for (const xref& xref : xrefs) {
+      if (xref.kind == xref_kind::address) {
+         address_count += 1;
+      }
+      else {
+         constant_count += 1;
+      }
+   }
+
+   if (query.range_end > query.range_begin) {
+      print("// %u references into 0x%08x..0x%08x\r\n", address_count, query.range_begin,
+            query.range_end);
+
+      for (const xref& xref : xrefs) {
+         if (xref.kind != xref_kind::address) continue;
+
+         const uint32_t field = xref.value - query.range_begin;
+
+         if (query.region != es_region_id::none) {
+            print("   patch{0x%zx, 0x%08x, 0x%x, es_region_id::%s}, // %s +0x%x%s\r\n", xref.offset,
+                  xref.value, field, region_identifier(query.region), xref.section,
+                  field, xref.relocated ? "" : " candidate");
+         }
+         else {
+            print("   patch{0x%zx, 0x%08x, 0x%08x}, // %s +0x%x%s\r\n", xref.offset, xref.value,
+                  xref.value, xref.section, field, xref.relocated ? "" : " candidate");
+         }
+      }
+   }
+
+   if (query.constants.size() != 0) {
+      print("// %u immediates equal to a constant\r\n", constant_count);
+
+      for (const xref& xref : xrefs) {
+         if (xref.kind != xref_kind::constant) continue;
+
+         if (query.capacity != capacity_id::none) {
+            print("   scaled_patch(0x%zx, 0x%x, capacity_id::%s), // %s candidate\r\n",
+                  xref.offset, xref.value, known_capacities[(uint32_t)query.capacity].name,
+                  xref.section);
+         }
+         else {
+            print("   patch{0x%zx, 0x%x, 0x%x}, // %s candidate\r\n", xref.offset, xref.value,
+                  xref.value, xref.section);
+         }
+      }
+   }
+}
+
+auto find_region_id(const char* name) noexcept -> es_region_id
+{
+   for (uint32_t i = 1; i < es_region_id_count; ++i) {
+      if (strcmp(region_identifiers[i], name) == 0) return (es_region_id)i;
+   }
+
+   return es_region_id::none;
+}
+
+auto region_identifier(es_region_id id) noexcept -> const char*
+{
+   return (uint32_t)id < es_region_id_count ? region_identifiers[(uint32_t)id] : "none";
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "exe_patcher.hpp"
+#include "patch_table.hpp"
+#include "slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief More constants than this are checked one by one instead of with SIMD compares.
+constexpr uint32_t max_simd_xref_constants = 8;
+
+/// @brief What to look for references to.
+struct xref_query {
+   /// @brief Absolute addresses in [range_begin, range_end) are reported, for finding every
+   /// reference into a global that's being moved. Empty if they're equal.
+   uint32_t range_begin = 0;
+   uint32_t range_end = 0;
+   /// @brief 32-bit immediates equal to one of these are reported, for finding every use of a
+   /// size or count. Only searched for in code.
+   slim_vector<uint32_t> constants;
+   /// @brief The region references into the range are pointed at in the printed patches.
+   es_region_id region = es_region_id::none;
+   /// @brief The capacity the printed patches of constants are derived from.
+   capacity_id capacity = capacity_id::none;
+};
+
+enum class xref_kind : uint8_t { address, constant };
+
+struct xref {
+   /// @brief The file offset of the referencing dword.
+   size_t offset = 0;
+   /// @brief The address the dword is loaded at.
+   uint32_t va = 0;
+   uint32_t value = 0;
+   xref_kind kind = xref_kind::address;
+   /// @brief The dword is listed in the base relocations, so it's certainly an address and not
+   /// bytes that happen to look like one.
+   bool relocated = false;
+   /// @brief The name of the section the dword is in.
+   char section[pe_sizeof_short_name + 1] = {};
+};
+
+/// @brief Find references to a range and to constants in one pass over the image. Where the image
+/// has base relocations addresses are taken from them. Otherwise, and for constants, every
+/// unaligned dword of the executable sections is compared, 32 at a time with AVX2 or 16 with
+/// SSE2. Without relocations addresses found in code are candidates, an instruction may only
+/// contain the bytes by chance.
+/// @param out The references in file order.
+/// @return False if the image isn't a PE image or couldn't be read.
+[[nodiscard]] bool find_xrefs(const exe_patcher& editor, const xref_query& query,
+                              slim_vector<xref>& out) noexcept;
+
+/// @brief Read the RVAs of the dwords listed in the image's base relocations.
+/// @return False if the image has none.
+[[nodiscard]] bool read_relocations(const exe_patcher& editor, slim_vector<uint32_t>& out) noexcept;
+
+/// @brief Print references as patch table entries ready to be pasted into a patch list.
+void print_xrefs(const xref_query& query, const slim_vector<xref>& xrefs,
+                 int (*print)(const char* format, ...)) noexcept;
+
+/// @brief Look up the region of an extension section by the name of its es_region_id.
+/// @return es_region_id::none if there's none with the name.
+[[nodiscard]] auto find_region_id(const char* name) noexcept -> es_region_id;
+
+/// @brief The name of an es_region_id as written in the patch table.
+[[nodiscard]] auto region_identifier(es_region_id id) noexcept -> const char*;
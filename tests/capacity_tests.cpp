@@ -0,0 +1,72 @@
+#include "tests.hpp"
+
+#include "../src/capacities.hpp"
+
+#include <stdio.h>
+
+void test_capacity_formulas(const char*) noexcept
+{
+   uint32_t value = 0;
+
+   // capacity * scale + offset, up to what a signed 32-bit immediate holds.
+   const value_formula scaled{capacity_id::dlc_missions, 0x110, 4, value_encoding::imm32};
+
+   CHECK(evaluate_formula(scaled, 0, 10, value));
+   CHECK(value == 10 * 0x110 + 4);
+
+   const value_formula doubled{capacity_id::matrix_pool, 2, 0, value_encoding::imm32};
+
+   CHECK(evaluate_formula(doubled, 0, 0x3fffffff, value));
+   CHECK(value == 0x7ffffffe);
+   CHECK(not evaluate_formula(doubled, 0, 0x40000000, value));
+   CHECK(not evaluate_formula(doubled, 0, UINT32_MAX, value));
+
+   // An imm8 replaces one byte of the dword and keeps the others.
+   const value_formula byte_1{capacity_id::hirez_units, 1, 0, value_encoding::imm8, 1};
+
+   CHECK(evaluate_formula(byte_1, 0x11223344, 0x7f, value));
+   CHECK(value == 0x11227f44);
+   CHECK(not evaluate_formula(byte_1, 0x11223344, 0x80, value));
+
+   const value_formula byte_4{capacity_id::hirez_units, 1, 0, value_encoding::imm8, 4};
+
+   CHECK(not evaluate_formula(byte_4, 0x11223344, 1, value));
+
+   // patch_value reads the capacity the formula names.
+   capacity_values values;
+
+   CHECK(set_capacity(values, "hirez_units=100", print_nothing));
+   CHECK(patch_value(imm8_patch(0x1000, 0x11223344, capacity_id::hirez_units, 0), values, value));
+   CHECK(value == 0x11223364);
+   CHECK(set_capacity(values, "hirez_units=200", print_nothing));
+   CHECK(not patch_value(imm8_patch(0x1000, 0x11223344, capacity_id::hirez_units, 0), values,
+                         value));
+
+   // Every value a capacity advertises as its minimum has to be usable with every set enabled.
+   bool enabled[PATCH_COUNT];
+
+   for (bool& set_enabled : enabled) set_enabled = true;
+
+   for (uint32_t i = 1; i < capacity_id_count; ++i) {
+      capacity_values minimum;
+
+      minimum.values[i] = known_capacities[i].min;
+
+      for (const exe_patch_list& list : patch_lists) {
+         if (not check_capacities(list, enabled, minimum, print_nothing)) {
+            printf("   %s = %u is rejected for %s\r\n", known_capacities[i].name,
+                   known_capacities[i].min, list.name);
+
+            CHECK(false);
+         }
+      }
+   }
+
+   // The DLC mission count is read from right after the stock game's 50 missions.
+   capacity_values stock;
+
+   stock.values[(uint32_t)capacity_id::dlc_missions] = 50;
+
+   CHECK(not set_capacity(values, "dlc_missions=50", print_nothing));
+   CHECK(not check_capacities(patch_lists[0], enabled, stock, print_nothing));
+}
@@ -0,0 +1,159 @@
+#include "tests.hpp"
+
+#include "../src/bench.hpp"
+#include "../src/capacities.hpp"
+#include "../src/es_layout.hpp"
+#include "../src/exe_patcher.hpp"
+#include "../src/file_helpers.hpp"
+#include "../src/pe_image.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+// No table entry has a trampoline yet, so one is made up over code the synthetic executable
+// already has and written through every load mode.
+
+constexpr uint32_t synthetic_image_base = 0x400000;
+constexpr uint32_t site_length = 8;
+
+static const char code_section_name[pe_sizeof_short_name] = {'.', 'b', 'f', '2', 'c', 'o', 'd', 'e'};
+
+/// @brief Prepare an image with room for a trampoline, plan it and apply it.
+static bool patch_trampoline(exe_patcher& editor, const trampoline& trampoline) noexcept
+{
+   bool enabled[PATCH_COUNT];
+   es_layout layout;
+
+   for (bool& set_enabled : enabled) set_enabled = true;
+
+   if (not plan_es_layout(patch_lists[0], enabled, capacity_values{}, layout)) return false;
+   if (not editor.prepare(layout, trampoline.cave_size())) return false;
+
+   write_plan plan;
+   uint32_t failed_set = 0;
+
+   return editor.plan(trampoline, 0, plan) and editor.apply(plan, failed_set);
+}
+
+/// @brief Patch a copy of the executable loaded in a mode and read the result back.
+static bool patch_copy(const char* base_path, const char* work_path, load_mode mode,
+                       const trampoline& trampoline, slim_vector<uint8_t>& out) noexcept
+{
+   exe_patcher editor;
+
+   return clone_file(base_path, work_path) and editor.load(work_path, mode) and
+          patch_trampoline(editor, trampoline) and editor.save(work_path) and
+          read_file(work_path, out);
+}
+
+void test_code_cave(const char* directory) noexcept
+{
+   char path[1024];
+   char work_path[1024];
+
+   test_path(path, directory, "bf2test_cave.exe");
+   test_path(work_path, directory, "bf2test_cave_work.exe");
+
+   synthetic_pe_options image;
+   slim_vector<patch> patches;
+   slim_vector<uint8_t> original;
+
+   CHECK(generate_synthetic_pe(image, path, patches));
+   CHECK(read_file(path, original));
+   CHECK(patches.size() != 0);
+
+   if (patches.size() == 0 or original.size() == 0) return;
+
+   // The extra patches sit on random code away from the list's sites.
+   const size_t site_offset = patches[0].address.value;
+   const uint32_t site_va = synthetic_image_base + (uint32_t)site_offset;
+   uint8_t expected[site_length];
+   static const uint8_t added[] = {0x83, 0xc0, 0x01};
+
+   memcpy(expected, original.data() + site_offset, sizeof(expected));
+
+   const patch_op routine[] = {op_bytes(expected), op_bytes(added)};
+   const trampoline trampoline{patch_address{(uint32_t)site_offset}, expected, routine};
+
+   slim_vector<uint8_t> buffered;
+
+   CHECK(patch_copy(path, work_path, load_mode::buffered, trampoline, buffered));
+   CHECK(buffered.size() > original.size());
+
+   {
+      exe_patcher editor;
+
+      CHECK(editor.load(work_path, load_mode::read_only));
+      CHECK(editor.classify(trampoline) == patch_state::patched);
+
+      // The site jumps to the routine and the routine jumps back after the site.
+      const int32_t index = editor.image().find_section(code_section_name);
+
+      CHECK(index >= 0);
+
+      if (index >= 0 and buffered.size() > original.size()) {
+         const pe_section_header section = editor.image().section((uint32_t)index);
+         const uint8_t* site = buffered.data() + site_offset;
+         const uint8_t* copy = buffered.data() + section.pointer_to_raw_data;
+         const uint32_t routine_size = sizeof(expected) + sizeof(added);
+         int32_t displacement = 0;
+
+         CHECK(section.pointer_to_raw_data >= original.size());
+         CHECK(site[0] == x86_jmp_rel32);
+
+         memcpy(&displacement, site + 1, sizeof(displacement));
+
+         CHECK(site_va + trampoline_jump_size + (uint32_t)displacement ==
+               synthetic_image_base + section.virtual_address);
+
+         for (uint32_t i = trampoline_jump_size; i < site_length; ++i) CHECK(site[i] == x86_nop);
+
+         CHECK(memcmp(copy, expected, sizeof(expected)) == 0);
+         CHECK(memcmp(copy + sizeof(expected), added, sizeof(added)) == 0);
+         CHECK(copy[routine_size] == x86_jmp_rel32);
+
+         memcpy(&displacement, copy + routine_size + 1, sizeof(displacement));
+
+         CHECK((uint32_t)(synthetic_image_base + section.virtual_address + routine_size +
+                          trampoline_jump_size + displacement) == site_va + site_length);
+      }
+   }
+
+   // Patching again finds the routine where it was and changes nothing.
+   {
+      exe_patcher editor;
+      slim_vector<uint8_t> again;
+
+      CHECK(editor.load(work_path, load_mode::buffered));
+      CHECK(patch_trampoline(editor, trampoline));
+      CHECK(editor.save(work_path));
+      CHECK(read_file(work_path, again));
+      CHECK(again == buffered);
+   }
+
+   // Every other way of saving writes the same file.
+   const load_mode modes[] = {load_mode::mapped, load_mode::streamed};
+
+   for (const load_mode mode : modes) {
+      slim_vector<uint8_t> saved;
+
+      CHECK(patch_copy(path, work_path, mode, trampoline, saved));
+      CHECK(saved == buffered);
+   }
+
+   {
+      exe_patcher editor;
+      slim_vector<uint8_t> saved;
+
+      saved.resize(buffered.size());
+
+      CHECK(editor.load_memory(original.data(), original.size()));
+      CHECK(patch_trampoline(editor, trampoline));
+      CHECK(editor.size() == buffered.size());
+      CHECK(editor.save(saved.data(), saved.size()));
+      CHECK(saved == buffered);
+   }
+
+   remove(work_path);
+   remove(path);
+}
@@ -0,0 +1,90 @@
+#include "tests.hpp"
+
+#include "../src/bench.hpp"
+#include "../src/delta.hpp"
+#include "../src/file_helpers.hpp"
+
+#include <stdio.h>
+
+void test_delta_round_trip(const char* directory) noexcept
+{
+   char path[1024];
+   char patched_path[1024];
+   char output_path[1024];
+   char other_path[1024];
+   char delta_path[1024];
+
+   test_path(path, directory, "bf2test_delta.exe");
+   test_path(patched_path, directory, "bf2test_delta_patched.exe");
+   test_path(output_path, directory, "bf2test_delta_out.exe");
+   test_path(other_path, directory, "bf2test_delta_other.exe");
+   test_path(delta_path, directory, "bf2test_delta.bf2delta");
+
+   synthetic_pe_options image;
+   slim_vector<patch> patches;
+   slim_vector<uint8_t> original;
+   slim_vector<uint8_t> expected;
+   slim_vector<uint8_t> result;
+   apply_options options;
+
+   options.large_address_aware = true;
+
+   // The delta has to rebuild exactly what patching the file itself writes.
+   CHECK(generate_synthetic_pe(image, path, patches));
+   CHECK(read_file(path, original));
+   CHECK(clone_file(path, patched_path));
+   CHECK(apply(patched_path, print_nothing, options));
+   CHECK(read_file(patched_path, expected));
+   CHECK(expected != original);
+
+   CHECK(export_delta(path, delta_path, print_nothing, options));
+   CHECK(read_file(path, result));
+   CHECK(result == original);
+
+   CHECK(apply_delta(delta_path, path, output_path, print_nothing));
+   CHECK(read_file(output_path, result));
+   CHECK(result == expected);
+   CHECK(read_file(path, result));
+   CHECK(result == original);
+
+   // In place.
+   CHECK(apply_delta(delta_path, path, nullptr, print_nothing));
+   CHECK(read_file(path, result));
+   CHECK(result == expected);
+
+   // A file that already has the delta applied is copied as it is.
+   remove(output_path);
+
+   CHECK(apply_delta(delta_path, patched_path, output_path, print_nothing));
+   CHECK(read_file(output_path, result));
+   CHECK(result == expected);
+
+   // Another build of the same size and a damaged delta are refused, and nothing is written.
+   image.seed = 2;
+
+   remove(output_path);
+
+   CHECK(generate_synthetic_pe(image, other_path, patches));
+   CHECK(not apply_delta(delta_path, other_path, output_path, print_nothing));
+   CHECK(not read_file(output_path, result));
+
+   slim_vector<uint8_t> delta;
+
+   CHECK(read_file(delta_path, delta));
+   CHECK(delta.size() != 0);
+
+   if (delta.size() != 0) {
+      delta[delta.size() - 1] ^= 0xff;
+
+      CHECK(save_file(delta_path, "BF2Test", delta.data(), delta.size()));
+      CHECK(save_file(path, "BF2Test", original.data(), original.size()));
+      CHECK(not apply_delta(delta_path, path, output_path, print_nothing));
+      CHECK(not read_file(output_path, result));
+   }
+
+   remove(delta_path);
+   remove(other_path);
+   remove(output_path);
+   remove(patched_path);
+   remove(path);
+}
@@ -0,0 +1,125 @@
+#include "tests.hpp"
+
+#include "../src/apply_patches.hpp"
+#include "../src/bench.hpp"
+#include "../src/delta.hpp"
+#include "../src/exe_patcher.hpp"
+#include "../src/undo_journal.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+// Saving writes a temporary file and moves it over the executable. Every way of saving has to
+// leave the executable's permissions as they were, or the game can't be started afterwards.
+
+#ifndef _WIN32
+
+/// @brief Not a mode mkstemp or the umask would give a file by chance.
+constexpr mode_t executable_mode = 0751;
+
+static bool make_executable(const char* path) noexcept
+{
+   synthetic_pe_options options;
+   slim_vector<patch> patches;
+
+   options.size = 4 * 1024 * 1024;
+
+   return generate_synthetic_pe(options, path, patches) and chmod(path, executable_mode) == 0;
+}
+
+static auto file_mode(const char* path) noexcept -> mode_t
+{
+   struct stat info = {};
+
+   if (stat(path, &info) != 0) return 0;
+
+   return info.st_mode & 07777;
+}
+
+static void remove_executable(const char* path) noexcept
+{
+   char* journal = journal_path(path);
+
+   if (journal) remove(journal);
+
+   free(journal);
+   remove(path);
+}
+
+void test_file_modes(const char* directory) noexcept
+{
+   char path[1024];
+   char output_path[1024];
+   char delta_path[1024];
+
+   test_path(path, directory, "bf2test_mode.exe");
+   test_path(output_path, directory, "bf2test_mode_out.exe");
+   test_path(delta_path, directory, "bf2test_mode.bf2delta");
+
+   // Mapped, saved by cloning the file and writing the dirty ranges.
+   CHECK(make_executable(path));
+   CHECK(apply(path, print_nothing));
+   CHECK(file_mode(path) == executable_mode);
+
+   // Streamed, written in full to a new file.
+   apply_options streamed;
+
+   streamed.streamed = true;
+
+   CHECK(make_executable(path));
+   CHECK(apply(path, print_nothing, streamed));
+   CHECK(file_mode(path) == executable_mode);
+
+   streamed.output_path = output_path;
+
+   CHECK(make_executable(path));
+   CHECK(apply(path, print_nothing, streamed));
+   CHECK(file_mode(output_path) == executable_mode);
+
+   remove_executable(output_path);
+
+   // Buffered, written in full.
+   {
+      exe_patcher editor;
+
+      CHECK(make_executable(path));
+      CHECK(editor.load(path, load_mode::buffered));
+      CHECK(editor.save(path));
+      CHECK(file_mode(path) == executable_mode);
+   }
+
+   // A variant, saved by cloning the base's file.
+   {
+      apply_base base;
+      apply_options variant;
+
+      variant.base = &base;
+      variant.output_path = output_path;
+
+      CHECK(make_executable(path));
+      CHECK(load_apply_base(path, base, print_nothing));
+      CHECK(apply(path, print_nothing, variant));
+      CHECK(file_mode(output_path) == executable_mode);
+   }
+
+   remove_executable(output_path);
+
+   // A delta applied in place, streamed to a new file.
+   CHECK(make_executable(path));
+   CHECK(export_delta(path, delta_path, print_nothing));
+   CHECK(apply_delta(delta_path, path, nullptr, print_nothing));
+   CHECK(file_mode(path) == executable_mode);
+
+   remove(delta_path);
+   remove_executable(path);
+}
+
+#else
+
+void test_file_modes(const char*) noexcept {}
+
+#endif
@@ -0,0 +1,77 @@
+#include "tests.hpp"
+
+#include "../src/apply_patches.hpp"
+#include "../src/bench.hpp"
+#include "../src/undo_journal.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// @brief A directory can't be replaced by a file, so it stands in for a journal that can't be
+/// written.
+static bool make_directory(const char* path) noexcept
+{
+#ifdef _WIN32
+   return _mkdir(path) == 0;
+#else
+   return mkdir(path, 0755) == 0;
+#endif
+}
+
+static void remove_directory(const char* path) noexcept
+{
+#ifdef _WIN32
+   (void)_rmdir(path);
+#else
+   (void)rmdir(path);
+#endif
+}
+
+void test_journal_first(const char* directory) noexcept
+{
+   char path[1024];
+
+   test_path(path, directory, "bf2test_journal.exe");
+
+   synthetic_pe_options image;
+   slim_vector<patch> patches;
+   apply_options options;
+   slim_vector<uint8_t> original;
+   slim_vector<uint8_t> current;
+   char* journal = journal_path(path);
+
+   CHECK(journal);
+   CHECK(generate_synthetic_pe(image, path, patches));
+   CHECK(read_file(path, original));
+
+   if (not journal) return;
+
+   options.journal = true;
+
+   // The journal is written first, failing to write it leaves the executable as it was.
+   CHECK(make_directory(journal));
+   CHECK(not apply(path, print_nothing, options));
+   CHECK(read_file(path, current));
+   CHECK(current == original);
+
+   remove_directory(journal);
+
+   CHECK(apply(path, print_nothing, options));
+   CHECK(read_file(path, current));
+   CHECK(current != original);
+
+   CHECK(unpatch(path, print_nothing));
+   CHECK(read_file(path, current));
+   CHECK(current == original);
+
+   remove(journal);
+   free(journal);
+   remove(path);
+}
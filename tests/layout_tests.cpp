@@ -0,0 +1,129 @@
+#include "tests.hpp"
+
+#include "../src/applied_config.hpp"
+#include "../src/apply_patches.hpp"
+#include "../src/bench.hpp"
+#include "../src/capacities.hpp"
+#include "../src/es_layout.hpp"
+#include "../src/exe_patcher.hpp"
+#include "../src/undo_journal.hpp"
+#include "../src/verify.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/// @brief Patch an executable as versions before plan_es_layout did: every set with the default
+/// capacities, regions at their fixed offsets and no record in the headers.
+static bool patch_legacy(const char* path) noexcept
+{
+   const exe_patch_list& list = patch_lists[0];
+   const capacity_values capacities;
+   exe_patcher editor;
+   es_layout layout;
+
+   if (not editor.load(path)) return false;
+
+   plan_legacy_es_layout(list, layout);
+
+   if (not editor.prepare(layout)) return false;
+
+   write_plan plan;
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      for (patch patch : list.patches[i].patches) {
+         if (not patch_value(patch, capacities, patch.replacement_value)) return false;
+         if (not editor.plan(patch, i, plan)) return false;
+      }
+
+      for (const code_patch& patch : list.patches[i].code_patches) {
+         if (not editor.plan(patch, i, plan)) return false;
+      }
+   }
+
+   uint32_t failed_set = 0;
+
+   return editor.apply(plan, failed_set) and editor.save(path);
+}
+
+/// @brief Check that every set of the first list verifies as patched.
+static void check_all_patched(const char* path) noexcept
+{
+   verify_report report;
+
+   CHECK(verify(path, report));
+   CHECK(report.has_ext_section);
+
+   for (const patch_set_status& set : report.sets) {
+      if (set.count == 0) continue;
+
+      if (set.patched != set.count) printf("   %s is %s\r\n", set.name, set.summary());
+
+      CHECK(set.patched == set.count);
+   }
+}
+
+void test_legacy_layout(const char* directory) noexcept
+{
+   char path[1024];
+
+   test_path(path, directory, "bf2test_legacy.exe");
+
+   synthetic_pe_options image;
+   slim_vector<patch> patches;
+
+   CHECK(generate_synthetic_pe(image, path, patches));
+   CHECK(patch_legacy(path));
+
+   // The released tool put the DLC missions first and the matrix pool after them, this version
+   // puts the matrix pool first. Both layouts have to be told apart by what the sites hold.
+   {
+      exe_patcher editor;
+      applied_config config;
+      es_layout layout;
+
+      CHECK(editor.load(path, load_mode::read_only));
+      CHECK(not read_applied_config(editor, config));
+      CHECK(read_legacy_config(editor, patch_lists[0], config, layout));
+   }
+
+   check_all_patched(path);
+
+   apply_options options;
+
+   options.journal = true;
+
+   CHECK(apply(path, print_nothing, options));
+
+   check_all_patched(path);
+
+   // The run is recorded with this version's layout, so the next one is incremental.
+   {
+      exe_patcher editor;
+      applied_config config;
+      bool enabled[PATCH_COUNT];
+      es_layout layout;
+
+      for (bool& set_enabled : enabled) set_enabled = true;
+
+      CHECK(plan_es_layout(patch_lists[0], enabled, capacity_values{}, layout));
+      CHECK(editor.load(path, load_mode::read_only));
+      CHECK(read_applied_config(editor, config));
+      CHECK(config.layout_hash == layout_hash(layout));
+      CHECK(not read_legacy_config(editor, patch_lists[0], config, layout));
+   }
+
+   capacity_values capacities;
+
+   CHECK(set_capacity(capacities, "matrix_pool=0x400000", print_nothing));
+
+   options.capacities = &capacities;
+
+   CHECK(apply(path, print_nothing, options));
+
+   if (char* journal = journal_path(path); journal) {
+      remove(journal);
+      free(journal);
+   }
+
+   remove(path);
+}
@@ -0,0 +1,73 @@
+#include "tests.hpp"
+
+#include "../src/bench.hpp"
+#include "../src/library_api.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+// bf2_patch_image saves through exe_patcher::save(uint8_t*, size_t). Patching in place skips
+// copying the base, every other output gets the whole image first.
+
+void test_library_in_place(const char* directory) noexcept
+{
+   char path[1024];
+
+   test_path(path, directory, "bf2test_library.exe");
+
+   synthetic_pe_options image;
+   slim_vector<patch> patches;
+   slim_vector<uint8_t> original;
+
+   CHECK(generate_synthetic_pe(image, path, patches));
+   CHECK(read_file(path, original));
+
+   remove(path);
+
+   if (original.size() == 0) return;
+
+   bf2_patch_result result;
+
+   // Into a separate buffer of exactly the image's size.
+   slim_vector<uint8_t> copied;
+
+   copied.resize(original.size());
+
+   CHECK(bf2_patch_image(original.data(), original.size(), copied.data(), copied.size(), nullptr,
+                         &result) == BF2_PATCHED);
+   CHECK(result.output_size == original.size());
+   CHECK(result.sites_patched != 0);
+   CHECK(copied != original);
+
+   // In place, the output is the image.
+   slim_vector<uint8_t> in_place = original;
+
+   CHECK(bf2_patch_image(in_place.data(), in_place.size(), in_place.data(), in_place.size(),
+                         nullptr, &result) == BF2_PATCHED);
+   CHECK(in_place == copied);
+
+   // Patching the result again leaves it as it is.
+   CHECK(bf2_patch_image(in_place.data(), in_place.size(), in_place.data(), in_place.size(),
+                         nullptr, &result) == BF2_ALREADY_PATCHED);
+   CHECK(in_place == copied);
+
+   // Too small, nothing is written and the size needed is reported.
+   slim_vector<uint8_t> small;
+
+   small.resize(original.size() - 1);
+   memset(small.data(), 0, small.size());
+
+   CHECK(bf2_patch_image(original.data(), original.size(), small.data(), small.size(), nullptr,
+                         &result) == BF2_OUTPUT_TOO_SMALL);
+   CHECK(result.output_size == original.size());
+
+   bool untouched = true;
+
+   for (const uint8_t byte : small) untouched = untouched and byte == 0;
+
+   CHECK(untouched);
+
+   // Overlapping the image without being it.
+   CHECK(bf2_patch_image(in_place.data(), in_place.size() - 1, in_place.data() + 1,
+                         in_place.size() - 1, nullptr, &result) == BF2_INVALID_ARGUMENT);
+}
@@ -0,0 +1,86 @@
+#include "tests.hpp"
+
+#include "../src/apply_patches.hpp"
+#include "../src/bench.hpp"
+#include "../src/capacities.hpp"
+#include "../src/cpu_features.hpp"
+#include "../src/patch_locator.hpp"
+
+#include <stdio.h>
+
+void test_locator_vector_width(const char*) noexcept
+{
+   // Every list's signatures, unpatched and patched, have to fit the vector filters or the
+   // locator walks the code a pair at a time.
+   const capacity_values capacities;
+
+   for (const exe_patch_list& list : patch_lists) {
+      list_signatures signatures;
+
+      CHECK(compile_signatures(list, capacities, signatures));
+
+      if (signatures.scanner.size() == 0) continue;
+
+#if BF2_X86
+      CHECK(signatures.scanner.vector_width() > 1);
+#endif
+   }
+}
+
+/// @brief Scan an executable for the first list's signatures and note which sets can be located.
+static void locate_sets(const char* path, bool (&located)[PATCH_COUNT]) noexcept
+{
+   exe_patcher editor;
+   patch_locator locator;
+
+   for (bool& set_located : located) set_located = false;
+
+   CHECK(editor.load(path, load_mode::read_only));
+   CHECK(locator.scan(editor, patch_lists[0]));
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      located[i] = locator.can_locate(patch_lists[0].patches[i]);
+   }
+}
+
+void test_locator_patched(const char* directory) noexcept
+{
+   char path[1024];
+
+   test_path(path, directory, "bf2test_locator.exe");
+
+   synthetic_pe_options image;
+   slim_vector<patch> patches;
+
+   CHECK(generate_synthetic_pe(image, path, patches));
+
+   bool unpatched[PATCH_COUNT];
+
+   locate_sets(path, unpatched);
+
+   // Capacity derived sites are part of some signatures, they have to be found with the values
+   // the executable was patched with.
+   capacity_values capacities;
+   apply_options options;
+
+   CHECK(set_capacity(capacities, "hirez_units=96", print_nothing));
+   CHECK(set_capacity(capacities, "red_heap_main=0x8000000", print_nothing));
+
+   options.capacities = &capacities;
+
+   CHECK(apply(path, print_nothing, options));
+
+   bool patched[PATCH_COUNT];
+
+   locate_sets(path, patched);
+
+   for (uint32_t i = 0; i < PATCH_COUNT; ++i) {
+      if (unpatched[i] and not patched[i]) {
+         printf("   %s can't be located once patched\r\n", patch_lists[0].patches[i].name);
+      }
+
+      CHECK(patched[i] == unpatched[i]);
+   }
+
+   remove(path);
+}
@@ -0,0 +1,89 @@
+#include "tests.hpp"
+
+#include <stdio.h>
+
+// Tests write their files to a scratch directory, the current one unless a path is given, and
+// delete them afterwards. The exit code is the number of failed tests.
+
+struct test {
+   const char* name;
+   void (*run)(const char* directory) noexcept;
+};
+
+constexpr test tests[] = {
+   {"file_modes", test_file_modes},
+   {"locator_vector_width", test_locator_vector_width},
+   {"locator_patched", test_locator_patched},
+   {"legacy_layout", test_legacy_layout},
+   {"journal_first", test_journal_first},
+   {"library_in_place", test_library_in_place},
+   {"code_cave", test_code_cave},
+   {"op_streams", test_op_streams},
+   {"capacity_formulas", test_capacity_formulas},
+   {"delta_round_trip", test_delta_round_trip},
+   {"write_plan", test_write_plan},
+   {"streamed_save", test_streamed_save},
+   {"variant_overlays", test_variant_overlays},
+};
+
+static int failed_checks = 0;
+
+void check_failed(const char* condition, const char* file, int line) noexcept
+{
+   printf("   %s:%d: CHECK(%s) failed\r\n", file, line, condition);
+
+   failed_checks += 1;
+}
+
+void test_path(char (&out)[1024], const char* directory, const char* name) noexcept
+{
+   snprintf(out, sizeof(out), "%s/%s", directory, name);
+}
+
+bool read_file(const char* path, slim_vector<uint8_t>& out) noexcept
+{
+   out.clear();
+
+   FILE* file = fopen(path, "rb");
+
+   if (not file) return false;
+
+   uint8_t buffer[65536];
+
+   for (size_t read = 0; (read = fread(buffer, 1, sizeof(buffer), file)) != 0;) {
+      out.append(buffer, read);
+   }
+
+   const bool result = ferror(file) == 0;
+
+   fclose(file);
+
+   return result;
+}
+
+int print_nothing(const char*, ...)
+{
+   return 0;
+}
+
+int main(int arg_count, char* args[])
+{
+   const char* directory = arg_count > 1 ? args[1] : ".";
+   int failed_tests = 0;
+
+   for (const test& test : tests) {
+      const int failed_before = failed_checks;
+
+      test.run(directory);
+
+      const bool passed = failed_checks == failed_before;
+
+      printf("%-24s %s\r\n", test.name, passed ? "passed" : "FAILED");
+
+      if (not passed) failed_tests += 1;
+   }
+
+   printf("%d of %zu tests failed.\r\n", failed_tests, sizeof(tests) / sizeof(tests[0]));
+
+   return failed_tests;
+}
@@ -0,0 +1,88 @@
+#include "tests.hpp"
+
+#include "../src/patch_table.hpp"
+
+#include <string.h>
+
+// Op streams are checked against bytes encoded by hand, so a displacement worked out from the
+// wrong end of its field shows up as a mismatch.
+
+constexpr uint32_t region_base = 0x01000000;
+
+static bool resolve_region(es_region_id region, uint32_t offset, uint32_t& out) noexcept
+{
+   if (region != es_region_id::matrix_pool) return false;
+
+   out = region_base + offset;
+
+   return true;
+}
+
+static bool resolve_nothing(es_region_id, uint32_t, uint32_t&) noexcept
+{
+   return false;
+}
+
+/// @brief Lay out and assemble a stream for a site of length bytes.
+static bool assemble_stream(slim_span<patch_op> ops, uint32_t length, uint8_t* out,
+                            bool (*resolve)(es_region_id, uint32_t, uint32_t&) noexcept =
+                               resolve_region) noexcept
+{
+   op_layout layout;
+
+   return layout_ops(ops, length, layout) and assemble_ops(ops, layout, resolve, out);
+}
+
+void test_op_streams(const char*) noexcept
+{
+   static const uint8_t test_eax[] = {0x85, 0xc0};
+   static const uint8_t jz[] = {0x74};
+   static const uint8_t jmp[] = {0xe9};
+   static const uint8_t mov_eax[] = {0xa1};
+
+   // top: test eax, eax / jz skip / jmp top / skip: mov eax, [matrix_pool + 8] / nop padding
+   const patch_op ops[] = {
+      op_label(1),       op_bytes(test_eax), op_bytes(jz),
+      op_rel8(2),        op_bytes(jmp),      op_rel32(1),
+      op_label(2),       op_bytes(mov_eax),  op_abs32(es_region_id::matrix_pool, 8),
+      op_fill(x86_nop),
+   };
+   static const uint8_t expected[] = {0x85, 0xc0, 0x74, 0x05, 0xe9, 0xf7, 0xff, 0xff,
+                                      0xff, 0xa1, 0x08, 0x00, 0x00, 0x01, 0x90, 0x90};
+   uint8_t assembled[sizeof(expected)] = {};
+
+   CHECK(assemble_stream(ops, sizeof(expected), assembled));
+   CHECK(memcmp(assembled, expected, sizeof(expected)) == 0);
+
+   // A forward rel32 to the end of the stream, as a code patch skipping the rest of its site.
+   const patch_op skip[] = {op_bytes(jmp), op_rel32(end_label), op_fill(0xcc)};
+   static const uint8_t expected_skip[] = {0xe9, 0x03, 0x00, 0x00, 0x00, 0xcc, 0xcc, 0xcc};
+   uint8_t assembled_skip[sizeof(expected_skip)] = {};
+
+   CHECK(assemble_stream(skip, sizeof(expected_skip), assembled_skip));
+   CHECK(memcmp(assembled_skip, expected_skip, sizeof(expected_skip)) == 0);
+
+   // Streams that don't fit their site.
+   CHECK(not assemble_stream(ops, sizeof(expected) - 10, nullptr));
+
+   const patch_op too_long[] = {op_bytes(test_eax), op_bytes(test_eax)};
+
+   CHECK(not assemble_stream(too_long, 3, nullptr));
+
+   // Labels defined twice or never.
+   const patch_op twice[] = {op_label(1), op_label(1), op_fill(x86_nop)};
+   const patch_op undefined[] = {op_bytes(jz), op_rel8(3), op_fill(x86_nop)};
+
+   CHECK(not assemble_stream(twice, 4, nullptr));
+   CHECK(not assemble_stream(undefined, 4, nullptr));
+
+   // An 8-bit jump past its reach.
+   const patch_op far_jump[] = {op_bytes(jz), op_rel8(end_label), op_fill(x86_nop, 128)};
+   const patch_op near_jump[] = {op_bytes(jz), op_rel8(end_label), op_fill(x86_nop, 127)};
+
+   CHECK(not assemble_stream(far_jump, 130, nullptr));
+   CHECK(assemble_stream(near_jump, 129, nullptr));
+
+   // An address that can't be resolved.
+   CHECK(not assemble_stream(ops, sizeof(expected), nullptr, resolve_nothing));
+}
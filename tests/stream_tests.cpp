@@ -0,0 +1,142 @@
+#include "tests.hpp"
+
+#include "../src/apply_patches.hpp"
+#include "../src/bench.hpp"
+#include "../src/capacities.hpp"
+#include "../src/chunk_reader.hpp"
+#include "../src/es_layout.hpp"
+#include "../src/exe_patcher.hpp"
+#include "../src/file_helpers.hpp"
+
+#include <stdio.h>
+
+// A streamed image only ever holds its headers and what's written to it, so everything it saves
+// is checked against a buffered image given the same writes.
+
+static const uint8_t straddling[4] = {0xde, 0xad, 0xbe, 0xef};
+
+/// @brief Find a chunk boundary none of the extra patches touch.
+/// @return The offset of a site straddling it, 0 if there's none.
+static auto free_boundary(const slim_vector<patch>& patches, size_t size) noexcept -> size_t
+{
+   for (size_t chunk_end = stream_chunk_size; chunk_end < size; chunk_end += stream_chunk_size) {
+      const size_t offset = chunk_end - sizeof(straddling) / 2;
+      bool overlaps = false;
+
+      for (const patch& patch : patches) {
+         const size_t patch_offset = patch.address.value;
+
+         if (offset < patch_offset + sizeof(uint32_t) and
+             patch_offset < offset + sizeof(straddling)) {
+            overlaps = true;
+         }
+      }
+
+      if (not overlaps) return offset;
+   }
+
+   return 0;
+}
+
+/// @brief Load a copy of the executable in a mode, prepare it, write the extra patches and a site
+/// across a chunk boundary, and read the saved file back.
+static bool patch_copy(const char* base_path, const char* work_path, load_mode mode,
+                       const slim_vector<patch>& patches, const slim_vector<uint8_t>& original,
+                       slim_vector<uint8_t>& out) noexcept
+{
+   exe_patcher editor;
+
+   if (not clone_file(base_path, work_path) or not editor.load(work_path, mode)) return false;
+
+   bool enabled[PATCH_COUNT];
+   es_layout layout;
+
+   for (bool& set_enabled : enabled) set_enabled = true;
+
+   if (not plan_es_layout(patch_lists[0], enabled, capacity_values{}, layout)) return false;
+   if (not editor.prepare(layout)) return false;
+
+   write_plan plan;
+   uint32_t failed_tag = 0;
+
+   for (uint32_t i = 0; i < patches.size(); ++i) {
+      if (not editor.plan(patches[i], i, plan)) return false;
+   }
+
+   const size_t boundary = free_boundary(patches, original.size());
+
+   if (boundary == 0) return false;
+
+   plan.add(boundary, original.data() + boundary, straddling, sizeof(straddling), patches.size());
+
+   return editor.apply(plan, failed_tag) and editor.save(work_path) and read_file(work_path, out);
+}
+
+void test_streamed_save(const char* directory) noexcept
+{
+   char path[1024];
+   char work_path[1024];
+   char output_path[1024];
+
+   test_path(path, directory, "bf2test_stream.exe");
+   test_path(work_path, directory, "bf2test_stream_work.exe");
+   test_path(output_path, directory, "bf2test_stream_out.exe");
+
+   // Several chunks and a partial one at the end.
+   synthetic_pe_options image;
+   slim_vector<patch> patches;
+   slim_vector<uint8_t> original;
+
+   image.size = 3 * stream_chunk_size + stream_chunk_size / 3;
+
+   CHECK(generate_synthetic_pe(image, path, patches));
+   CHECK(read_file(path, original));
+   CHECK(original.size() > 3 * stream_chunk_size);
+   CHECK(patches.size() != 0);
+
+   if (original.size() <= stream_chunk_size) return;
+
+   slim_vector<uint8_t> buffered;
+   slim_vector<uint8_t> streamed;
+
+   CHECK(patch_copy(path, work_path, load_mode::buffered, patches, original, buffered));
+   CHECK(buffered != original);
+   CHECK(patch_copy(path, work_path, load_mode::streamed, patches, original, streamed));
+   CHECK(streamed == buffered);
+
+   // The same through apply, in place and to another file.
+   slim_vector<uint8_t> mapped;
+   slim_vector<uint8_t> result;
+   apply_options options;
+
+   options.large_address_aware = true;
+
+   CHECK(clone_file(path, work_path));
+   CHECK(apply(work_path, print_nothing, options));
+   CHECK(read_file(work_path, mapped));
+   CHECK(mapped != original);
+
+   options.streamed = true;
+
+   CHECK(clone_file(path, work_path));
+   CHECK(apply(work_path, print_nothing, options));
+   CHECK(read_file(work_path, result));
+   CHECK(result == mapped);
+
+   // Streaming a patched file again changes nothing.
+   CHECK(apply(work_path, print_nothing, options));
+   CHECK(read_file(work_path, result));
+   CHECK(result == mapped);
+
+   options.output_path = output_path;
+
+   CHECK(apply(path, print_nothing, options));
+   CHECK(read_file(output_path, result));
+   CHECK(result == mapped);
+   CHECK(read_file(path, result));
+   CHECK(result == original);
+
+   remove(output_path);
+   remove(work_path);
+   remove(path);
+}
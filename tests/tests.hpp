@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../src/slim_vector.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Record a failed check, printing the condition and where it is. The test carries on.
+void check_failed(const char* condition, const char* file, int line) noexcept;
+
+/// @brief Check a condition, the test fails but keeps running if it's false.
+#define CHECK(condition)                                                                          \
+   do {                                                                                           \
+      if (not(condition)) check_failed(#condition, __FILE__, __LINE__);                          \
+   } while (false)
+
+/// @brief Join the scratch directory and a file name.
+void test_path(char (&out)[1024], const char* directory, const char* name) noexcept;
+
+/// @brief Read a whole file.
+bool read_file(const char* path, slim_vector<uint8_t>& out) noexcept;
+
+/// @brief A print function that drops everything, for calls whose output isn't checked.
+int print_nothing(const char* format, ...);
+
+void test_file_modes(const char* directory) noexcept;
+void test_locator_vector_width(const char* directory) noexcept;
+void test_locator_patched(const char* directory) noexcept;
+void test_legacy_layout(const char* directory) noexcept;
+void test_journal_first(const char* directory) noexcept;
+void test_library_in_place(const char* directory) noexcept;
+void test_code_cave(const char* directory) noexcept;
+void test_op_streams(const char* directory) noexcept;
+void test_capacity_formulas(const char* directory) noexcept;
+void test_delta_round_trip(const char* directory) noexcept;
+void test_write_plan(const char* directory) noexcept;
+void test_streamed_save(const char* directory) noexcept;
+void test_variant_overlays(const char* directory) noexcept;
@@ -0,0 +1,93 @@
+#include "tests.hpp"
+
+#include "../src/apply_patches.hpp"
+#include "../src/bench.hpp"
+#include "../src/capacities.hpp"
+#include "../src/file_helpers.hpp"
+
+#include <stdio.h>
+
+// Variants are overlays of one base holding only what they write, each with its own capacities.
+// Every variant has to come out as if its copy of the executable had been patched on its own.
+
+void test_variant_overlays(const char* directory) noexcept
+{
+   char path[1024];
+   char separate_path[1024];
+   char output_path[1024];
+
+   test_path(path, directory, "bf2test_variant.exe");
+   test_path(separate_path, directory, "bf2test_variant_separate.exe");
+   test_path(output_path, directory, "bf2test_variant_out.exe");
+
+   synthetic_pe_options image;
+   slim_vector<patch> patches;
+   slim_vector<uint8_t> original;
+
+   CHECK(generate_synthetic_pe(image, path, patches));
+   CHECK(read_file(path, original));
+
+   capacity_values variants[3];
+
+   CHECK(set_capacity(variants[1], "dlc_missions=0x40", print_nothing));
+   CHECK(set_capacity(variants[1], "hirez_units=100", print_nothing));
+   CHECK(set_capacity(variants[2], "matrix_pool=0x8000", print_nothing));
+   CHECK(set_capacity(variants[2], "red_heap_main=0x10000000", print_nothing));
+
+   slim_vector<uint8_t> results[3];
+
+   // The base keeps the file mapped until it goes out of scope.
+   {
+      apply_base base;
+
+      CHECK(load_apply_base(path, base, print_nothing));
+
+      for (uint32_t i = 0; i < 3; ++i) {
+         apply_options options;
+         slim_vector<uint8_t> separate;
+         slim_vector<uint8_t>& result = results[i];
+
+         options.capacities = &variants[i];
+         options.large_address_aware = true;
+
+         CHECK(clone_file(path, separate_path));
+         CHECK(apply(separate_path, print_nothing, options));
+         CHECK(read_file(separate_path, separate));
+         CHECK(separate != original);
+
+         options.base = &base;
+         options.output_path = output_path;
+
+         CHECK(apply(path, print_nothing, options));
+         CHECK(read_file(output_path, result));
+         CHECK(result == separate);
+
+         // The same variant written to memory.
+         slim_vector<uint8_t> buffer;
+
+         buffer.resize(separate.size());
+
+         options.output_path = nullptr;
+         options.output_buffer = buffer.data();
+         options.output_capacity = buffer.size();
+
+         CHECK(apply(path, print_nothing, options));
+         CHECK(buffer == separate);
+
+         remove(output_path);
+      }
+   }
+
+   // Each variant got its own capacities and the base was left as it was.
+   CHECK(results[0] != results[1]);
+   CHECK(results[0] != results[2]);
+   CHECK(results[1] != results[2]);
+
+   slim_vector<uint8_t> unchanged;
+
+   CHECK(read_file(path, unchanged));
+   CHECK(unchanged == original);
+
+   remove(separate_path);
+   remove(path);
+}
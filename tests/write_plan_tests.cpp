@@ -0,0 +1,146 @@
+#include "tests.hpp"
+
+#include "../src/bench.hpp"
+#include "../src/exe_patcher.hpp"
+#include "../src/write_plan.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+static const uint8_t replacement[4] = {0xde, 0xad, 0xbe, 0xef};
+
+/// @brief Add a site expecting what the image holds at offset.
+static void add_site(write_plan& plan, const slim_vector<uint8_t>& image, size_t offset,
+                     uint32_t tag) noexcept
+{
+   plan.add(offset, image.data() + offset, replacement, sizeof(replacement), tag);
+}
+
+void test_write_plan(const char* directory) noexcept
+{
+   char path[1024];
+
+   test_path(path, directory, "bf2test_plan.exe");
+
+   synthetic_pe_options options;
+   slim_vector<patch> patches;
+   slim_vector<uint8_t> original;
+
+   CHECK(generate_synthetic_pe(options, path, patches));
+   CHECK(read_file(path, original));
+   CHECK(patches.size() != 0);
+
+   remove(path);
+
+   if (patches.size() == 0 or original.size() == 0) return;
+
+   // Touching sites and sites up to max_run_gap apart share a run, further ones start another.
+   const size_t first = patches[0].address.value;
+   const size_t gap_end = first + 8 + max_run_gap;
+   const size_t far = gap_end + sizeof(replacement) + max_run_gap + 1;
+
+   CHECK(far + sizeof(replacement) < original.size());
+
+   write_plan plan;
+
+   add_site(plan, original, far, 4);
+   add_site(plan, original, first + 4, 2);
+   add_site(plan, original, gap_end, 3);
+   add_site(plan, original, first, 1);
+
+   CHECK(plan.build(original.size()));
+   CHECK(plan.runs().size() == 2);
+
+   if (plan.runs().size() == 2) {
+      const write_run& run = plan.runs()[0];
+      const uint8_t* mask = plan.run_mask(run);
+
+      CHECK(run.offset == first);
+      CHECK(run.size == gap_end + sizeof(replacement) - first);
+      CHECK(run.first_site == 0);
+      CHECK(run.site_count == 3);
+
+      for (uint32_t i = 0; i < run.size; ++i) {
+         const bool in_site = i < 8 or i >= gap_end - first;
+
+         CHECK((mask[i] == 0xff) == in_site);
+      }
+
+      CHECK(plan.runs()[1].offset == far);
+      CHECK(plan.runs()[1].site_count == 1);
+   }
+
+   // Overlapping sites and sites past the end are refused.
+   write_plan overlapping;
+
+   add_site(overlapping, original, first, 1);
+   add_site(overlapping, original, first + 2, 2);
+
+   CHECK(not overlapping.build(original.size()));
+
+   write_plan past_end;
+
+   add_site(past_end, original, original.size() - 2, 1);
+
+   CHECK(not past_end.build(original.size()));
+
+   // A site holding neither its expected nor its replacement bytes stops the whole plan, even
+   // when every other run is fine and comes first.
+   {
+      exe_patcher editor;
+      slim_vector<uint8_t> saved;
+      uint32_t failed_tag = 0;
+
+      saved.resize(original.size());
+
+      CHECK(editor.load_memory(original.data(), original.size()));
+
+      static const uint8_t foreign[sizeof(replacement)] = {0x01, 0x02, 0x03, 0x04};
+
+      plan.add(far + sizeof(replacement) + 1, foreign, replacement, sizeof(replacement), 5);
+
+      CHECK(not editor.apply(plan, failed_tag));
+      CHECK(failed_tag == 5);
+      CHECK(editor.save(saved.data(), saved.size()));
+      CHECK(saved == original);
+   }
+
+   // A run with some sites already patched commits the rest and leaves the gaps alone.
+   {
+      exe_patcher editor;
+      slim_vector<uint8_t> saved;
+      slim_vector<uint8_t> expected = original;
+      uint32_t failed_tag = 0;
+      plan_outcome outcome;
+
+      saved.resize(original.size());
+
+      CHECK(editor.load_memory(original.data(), original.size()));
+
+      write_plan single;
+
+      add_site(single, original, first + 4, 2);
+
+      CHECK(editor.apply(single, failed_tag));
+
+      plan.clear();
+
+      add_site(plan, original, far, 4);
+      add_site(plan, original, first + 4, 2);
+      add_site(plan, original, gap_end, 3);
+      add_site(plan, original, first, 1);
+
+      CHECK(editor.apply(plan, failed_tag, &outcome));
+      CHECK(outcome.sites_already_patched == 1);
+      CHECK(outcome.sites_patched == 3);
+
+      const size_t offsets[] = {first, first + 4, gap_end, far};
+
+      for (const size_t offset : offsets) {
+         memcpy(expected.data() + offset, replacement, sizeof(replacement));
+      }
+
+      CHECK(editor.save(saved.data(), saved.size()));
+      CHECK(saved == expected);
+   }
+}